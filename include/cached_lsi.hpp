@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstdint>
+#include <hashing.hpp>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "convenience/builtins.hpp"
+#include "lsi.hpp"
+#include "util/instrumentation.hpp"
+#include "util/ordered_key.hpp"
+
+namespace learned_secondary_index {
+/**
+ * Learned secondary index with a small, direct mapped cache of recent
+ * equality lookup results in front of it. Repeated lookups of hot keys skip
+ * model evaluation and base data probes entirely, which pays off for skewed
+ * (e.g., zipfian) probe distributions.
+ *
+ * Since lookups update the cache, a CachedLearnedSecondaryIndex must not be
+ * shared between threads. Instead, construct one per thread around a shared
+ * Index, see the constructor taking an Index reference.
+ *
+ * @tparam Key key type
+ * @tparam Index learned secondary index answering cache misses
+ * @tparam cache_slots amount of cached lookup results. Must be a power of two.
+ * Default occupies 64 KiB for 8 byte keys
+ */
+template <class Key, class Index = LearnedSecondaryIndex<Key>,
+          size_t cache_slots = 4096>
+class CachedLearnedSecondaryIndex {
+  static_assert(cache_slots > 0 && (cache_slots & (cache_slots - 1)) == 0,
+                "cache_slots must be a power of two");
+
+  using Iter = decltype(std::declval<const Index &>().begin());
+
+  static constexpr size_t empty = std::numeric_limits<size_t>::max();
+
+  struct Slot {
+    Key key{};
+    /// position within the index' permutation vector, empty if unused
+    size_t pos = empty;
+  };
+
+  /// only set if this instance owns its index
+  std::unique_ptr<Index> _owned;
+  const Index *_index;
+
+  std::vector<Slot> _slots = std::vector<Slot>(cache_slots);
+  hashing::MurmurFinalizer<util::ordered_key_t<Key>> _hash;
+
+  size_t _hits = 0;
+  size_t _misses = 0;
+
+  /// Lower hash bits, which are independent of (upper) fingerprint bits
+  forceinline size_t slot(const Key &key) const {
+    return _hash(util::to_ordered(key)) & (cache_slots - 1);
+  }
+
+ public:
+  /// Constructs an empty index
+  CachedLearnedSecondaryIndex()
+      : _owned(std::make_unique<Index>()), _index(_owned.get()) {}
+
+  template <class It>
+  CachedLearnedSecondaryIndex(const It &begin, const It &end,
+                              const size_t threads = 1)
+      : _owned(std::make_unique<Index>(begin, end, threads)),
+        _index(_owned.get()) {}
+
+  /// Caches lookups on a shared index, which must outlive this instance
+  explicit CachedLearnedSecondaryIndex(const Index &index) : _index(&index) {}
+
+  /// (Re)builds the owned index on [begin, end) and clears the cache
+  template <class It>
+  void fit(const It &begin, const It &end, const size_t threads = 1) {
+    _owned = std::make_unique<Index>(begin, end, threads);
+    _index = _owned.get();
+    clear_cache();
+  }
+
+  /// Invalidates all cached lookup results, e.g., after the shared index
+  /// was rebuilt
+  void clear_cache() {
+    for (auto &s : _slots) s.pos = empty;
+    _hits = 0;
+    _misses = 0;
+  }
+
+  /**
+   * Lookup key in range [begin, end). Equality lookups are answered from the
+   * cache if possible, all other lookups are delegated to the index.
+   *
+   * @tparam lowerbound whether to perform a lowerbound or equality lookup
+   * @param stats receives lookup statistics of cache misses
+   *
+   * @returns same as Index::lookup()
+   */
+  template <bool lowerbound, class It>
+  Iter lookup(const It &begin, const It &end, const Key &key,
+              util::LookupStats &stats =
+                  Index::instrumentation::thread_stats()) {
+    if constexpr (lowerbound) {
+      return _index->template lookup<true>(begin, end, key, stats);
+    } else {
+      auto &s = _slots[slot(key)];
+      if (likely(s.pos != empty && s.key == key)) {
+        _hits++;
+        return _index->begin() + s.pos;
+      }
+
+      _misses++;
+      const auto iter = _index->template lookup<false>(begin, end, key, stats);
+      s.key = key;
+      s.pos = iter - _index->begin();
+      return iter;
+    }
+  }
+
+  Iter begin() const { return _index->begin(); }
+
+  Iter end() const { return _index->end(); }
+
+  [[nodiscard]] const Index &index() const { return *_index; }
+
+  /// Equality lookups answered from the cache since the last clear_cache()
+  [[nodiscard]] size_t cache_hits() const { return _hits; }
+
+  /// Equality lookups delegated to the index since the last clear_cache()
+  [[nodiscard]] size_t cache_misses() const { return _misses; }
+
+  /// Stats recorded by lookups of the calling thread which were not provided
+  /// with caller owned stats
+  static const util::LookupStats &thread_stats() {
+    return Index::thread_stats();
+  }
+
+  size_t model_byte_size() const { return _index->model_byte_size(); }
+
+  size_t perm_vector_byte_size() const {
+    return _index->perm_vector_byte_size();
+  }
+
+  static constexpr size_t cache_byte_size() {
+    return cache_slots * sizeof(Slot);
+  }
+
+  /// Computes total index size in bytes, including the cache
+  size_t byte_size() const { return _index->byte_size() + cache_byte_size(); }
+
+  static std::string name() {
+    return "Cached<" + Index::name() + ", " + std::to_string(cache_slots) +
+           ">";
+  }
+};
+}  // namespace learned_secondary_index
@@ -0,0 +1,523 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <learned_hashing.hpp>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "convenience/builtins.hpp"
+#include "util/fingerprinter.hpp"
+#include "util/instrumentation.hpp"
+#include "util/ordered_key.hpp"
+#include "util/parallel.hpp"
+#include "util/perm_storage.hpp"
+#include "util/permvector.hpp"
+#include "util/row_set.hpp"
+
+namespace learned_secondary_index {
+/**
+ * Secondary index on a composite key (prefix, suffix), e.g., (tenant_id,
+ * timestamp), which orders rows lexicographically. Rows are partitioned by
+ * their prefix: a sorted directory of distinct prefixes locates each
+ * partition's contiguous slice of a single permutation vector, within which
+ * rows are sorted by suffix. Partitions of at least min_model_size rows are
+ * searched via a model of their own on the suffix distribution, smaller ones
+ * are binary searched entirely.
+ *
+ * Since the directory is exact, lookups only access the suffix column. All
+ * rows with a given prefix and a suffix within a range are adjacent, i.e.,
+ * are obtained by a single permutation vector scan instead of intersecting
+ * the offsets of one index per column.
+ *
+ * @tparam Prefix type of the first key column, compared via operator<
+ * @tparam Suffix type of the second key column. Any type with an order
+ * preserving util::OrderedKey mapping is supported
+ * @tparam Model CDF model on util::ordered_key_t<Suffix> fitted per large
+ * partition. Since there may be many partitions, the default's radix table
+ * is small
+ * @tparam PermStorage memory layout of the permutation vector, see
+ * LearnedSecondaryIndex
+ * @tparam Instrumentation whether lookups record util::LookupStats, see
+ * LearnedSecondaryIndex
+ */
+template <class Prefix, class Suffix,
+          class Model = learned_hashing::RadixSplineHash<
+              util::ordered_key_t<Suffix>, 10, 16>,
+          class PermStorage = util::SeparateStorage,
+          class Instrumentation = util::CountingInstrumentation>
+class CompositeLearnedSecondaryIndex {
+  /// (composite key, offset) pairs sorted by fit()
+  using Rows = std::vector<std::pair<std::pair<Prefix, Suffix>, size_t>>;
+
+  /// Random access iterator yielding the offsets of Rows, i.e., the input of
+  /// PermVector::build(). key() yields the row's suffix
+  class OffsetIter {
+    typename Rows::const_iterator _iter;
+
+   public:
+    using iterator_category = std::random_access_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = size_t;
+    using pointer = const value_type *;
+    using reference = const value_type &;
+
+    explicit OffsetIter(typename Rows::const_iterator iter) : _iter(iter) {}
+
+    reference operator*() const { return _iter->second; }
+
+    [[nodiscard]] const Suffix &key() const { return _iter->first.second; }
+
+    OffsetIter operator+(const size_t i) const { return OffsetIter(_iter + i); }
+
+    friend difference_type operator-(const OffsetIter &a,
+                                     const OffsetIter &b) {
+      return a._iter - b._iter;
+    }
+  };
+
+  util::PermVector<util::Fingerprinter<Suffix, 0>, PermStorage> _perm_vector;
+
+  /// distinct prefixes in ascending order
+  std::vector<Prefix> _prefixes;
+
+  /// rows of _prefixes[p] occupy sorted positions [_bounds[p], _bounds[p+1])
+  std::vector<size_t> _bounds;
+
+  /// _model_ids[p] indexes partition p's model and max error, no_model if
+  /// the partition is binary searched entirely
+  std::vector<std::uint32_t> _model_ids;
+  std::vector<Model> _models;
+  std::vector<size_t> _max_errors;
+
+  size_t _min_model_size;
+
+  static constexpr std::uint32_t no_model =
+      std::numeric_limits<std::uint32_t>::max();
+
+ public:
+  /// Instrumentation policy, see util::CountingInstrumentation
+  using instrumentation = Instrumentation;
+
+  static constexpr size_t default_min_model_size = 4096;
+
+  /**
+   * Lookup result, i.e., position within the lexicographic order of all
+   * rows. Dereferencing yields an offset into the base data
+   */
+  class Iter {
+    using Vector = decltype(_perm_vector);
+
+    size_t _index;
+    const Vector *_vector;
+
+    Iter(const size_t index, const Vector &perm_vector)
+        : _index(index), _vector(&perm_vector) {}
+
+   public:
+    using iterator_category = std::random_access_iterator_tag;
+    using difference_type = size_t;
+    using value_type = size_t;
+    using pointer = value_type *;
+    using reference = value_type &;
+
+    /// Obtain current offset into original data
+    value_type operator*() const { return _vector->offset(_index); }
+
+    // Prefix increment
+    Iter &operator++() {
+      _index++;
+      return *this;
+    }
+
+    // Postfix increment
+    Iter operator++(int) {
+      Iter tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+
+    template <class I>
+    Iter operator+(const I &other) const {
+      return Iter(_index + other, *_vector);
+    }
+
+    template <class I>
+    Iter operator-(const I &other) const {
+      return Iter(_index - other, *_vector);
+    }
+
+    friend difference_type operator-(const Iter &a, const Iter &b) {
+      return a._index - b._index;
+    }
+
+    friend bool operator<(const Iter &a, const Iter &b) {
+      return a._index < b._index;
+    }
+
+    friend bool operator==(const Iter &a, const Iter &b) {
+      return a._index == b._index && a._vector == b._vector;
+    }
+
+    friend bool operator!=(const Iter &a, const Iter &b) {
+      return !(a == b);  // NOLINT
+    }
+
+    friend CompositeLearnedSecondaryIndex;
+  };
+
+  /**
+   * Constructs an empty index
+   *
+   * @param min_model_size partitions with fewer rows are binary searched
+   * instead of obtaining a model
+   */
+  explicit CompositeLearnedSecondaryIndex(
+      const size_t min_model_size = default_min_model_size)
+      : _min_model_size(std::max<size_t>(min_model_size, 1)) {}
+
+  template <class PrefixIt, class SuffixIt>
+  CompositeLearnedSecondaryIndex(
+      const PrefixIt &prefixes_begin, const PrefixIt &prefixes_end,
+      const SuffixIt &suffixes_begin, const size_t threads = 1,
+      const size_t min_model_size = default_min_model_size)
+      : CompositeLearnedSecondaryIndex(min_model_size) {
+    fit(prefixes_begin, prefixes_end, suffixes_begin, threads);
+  }
+
+  /**
+   * Builds the index on the rows of a prefix column [prefixes_begin,
+   * prefixes_end) and an equally long suffix column starting at
+   * suffixes_begin, i.e., row i's key is (*(prefixes_begin + i),
+   * *(suffixes_begin + i)).
+   *
+   * @param threads amount of threads used for sorting, packing the
+   * permutation vector and training partition models
+   */
+  template <class PrefixIt, class SuffixIt>
+  void fit(const PrefixIt &prefixes_begin, const PrefixIt &prefixes_end,
+           const SuffixIt &suffixes_begin, const size_t threads = 1) {
+    const size_t n = std::distance(prefixes_begin, prefixes_end);
+
+    Rows rows(n);
+    util::parallel_for(n, threads, [&](size_t, size_t b, size_t e) {
+      for (size_t i = b; i < e; i++)
+        rows[i] = {{*(prefixes_begin + i), *(suffixes_begin + i)}, i};
+    });
+    util::parallel_sort(
+        rows.begin(), rows.end(),
+        [](const auto &r1, const auto &r2) { return r1.first < r2.first; },
+        threads);
+
+    _prefixes.clear();
+    _bounds.clear();
+    for (size_t i = 0; i < n; i++) {
+      if (i == 0 || rows[i - 1].first.first < rows[i].first.first) {
+        _prefixes.push_back(rows[i].first.first);
+        _bounds.push_back(i);
+      }
+    }
+    _bounds.push_back(n);
+
+    std::vector<size_t> modeled;
+    _model_ids.assign(_prefixes.size(), no_model);
+    for (size_t p = 0; p < _prefixes.size(); p++) {
+      if (_bounds[p + 1] - _bounds[p] < _min_model_size) continue;
+      _model_ids[p] = modeled.size();
+      modeled.push_back(p);
+    }
+
+    _models.clear();
+    _models.resize(modeled.size());
+    _max_errors.assign(modeled.size(), 0);
+    const auto train = [&](size_t, size_t b, size_t e) {
+      std::vector<util::ordered_key_t<Suffix>> keys;
+      for (size_t m = b; m < e; m++) {
+        const size_t first = _bounds[modeled[m]];
+        keys.resize(_bounds[modeled[m] + 1] - first);
+        for (size_t j = 0; j < keys.size(); j++)
+          keys[j] = util::to_ordered(rows[first + j].first.second);
+
+        auto &model = _models[m];
+        model.train(keys.begin(), keys.end(), keys.size());
+
+        // max error towards the first row of each suffix's duplicates
+        size_t lower_bound = 0;
+        for (size_t j = 0; j < keys.size(); j++) {
+          if (keys[j] != keys[lower_bound]) lower_bound = j;
+          const size_t pred = model(keys[j]);
+          _max_errors[m] =
+              std::max(_max_errors[m], std::max(pred, lower_bound) -
+                                           std::min(pred, lower_bound));
+        }
+      }
+    };
+    util::parallel_for(modeled.size(), threads, train);
+
+    _perm_vector.build(OffsetIter(rows.cbegin()), OffsetIter(rows.cend()),
+                       threads);
+  }
+
+ private:
+  /// Increments counter by amount if instrumentation is enabled
+  forceinline static void count(size_t &counter, const size_t amount = 1) {
+    if constexpr (Instrumentation::enabled) counter += amount;
+  }
+
+  /// Index of the first distinct prefix not less than prefix
+  [[nodiscard]] forceinline size_t partition_of(const Prefix &prefix) const {
+    return std::lower_bound(_prefixes.begin(), _prefixes.end(), prefix) -
+           _prefixes.begin();
+  }
+
+  /// Whether partition p exists and holds exactly the rows of prefix
+  [[nodiscard]] forceinline bool holds(const size_t p,
+                                       const Prefix &prefix) const {
+    return p < _prefixes.size() && !(prefix < _prefixes[p]);
+  }
+
+  /// First sorted position within partition p whose suffix is not less than
+  /// suffix, the position past the partition if there is none
+  template <class It>
+  forceinline size_t lower_bound(const It &suffixes_begin, const size_t p,
+                                 const Suffix &suffix,
+                                 util::LookupStats &stats) const {
+    const size_t end_i = _bounds[p + 1];
+    size_t start_i = _bounds[p];
+    size_t stop_i = end_i;
+
+    // narrow to the model's prediction and max error within the partition
+    if (const auto m = _model_ids[p]; m != no_model) {
+      const size_t pred = _models[m](util::to_ordered(suffix));
+      const size_t err = _max_errors[m];
+      stop_i = std::min(start_i + pred + err + 1, end_i);
+      start_i = std::min(start_i + pred - std::min(pred, err), stop_i);
+    }
+    count(stats.lookups);
+    count(stats.window_size, stop_i - start_i);
+    const size_t window_end = stop_i;
+
+    // narrows [start_i, stop_i) to the first position whose suffix is not
+    // less than suffix
+    const auto binary_search = [&]() {
+      while (start_i < stop_i) {
+        const auto mid_i = start_i + (stop_i - start_i) / 2;
+
+        // permutation entries of both possible next probes
+        _perm_vector.prefetch(start_i + (mid_i - start_i) / 2);
+        _perm_vector.prefetch(mid_i + 1 + (stop_i - mid_i - 1) / 2);
+
+        count(stats.base_data_accesses);
+        if (*(suffixes_begin + _perm_vector.offset(mid_i)) < suffix) {
+          start_i = mid_i + 1;
+        } else {
+          stop_i = mid_i;
+        }
+      }
+    };
+    binary_search();
+
+    // the window only bounds suffixes the model was trained on. The lower
+    // bound of others, e.g., of an absent suffix succeeding many duplicates,
+    // may lie past an exhausted window. Galloping in doubling steps finds it
+    // in O(log d) base data accesses for a distance d past the window
+    if (start_i == window_end && start_i < end_i) {
+      size_t probe_i = start_i;
+      for (size_t step = 1; probe_i < end_i; step *= 2) {
+        count(stats.base_data_accesses);
+        if (!(*(suffixes_begin + _perm_vector.offset(probe_i)) < suffix))
+          break;
+        start_i = probe_i + 1;
+        probe_i = start_i + step;
+      }
+      stop_i = std::min(probe_i, end_i);
+      binary_search();
+    }
+
+    return start_i;
+  }
+
+ public:
+  /**
+   * Lookup (prefix, suffix) in the data the index was fitted on, of which
+   * only the suffix column [suffixes_begin, suffixes_end) is accessed.
+   *
+   * @tparam lowerbound whether to perform a lowerbound or equality lookup
+   * @param stats receives lookup statistics if instrumentation is enabled.
+   * Defaults to stats private to the calling thread
+   *
+   * @returns iterator yielding the offset of the first row with key (prefix,
+   * suffix) (lowerbound = false) or of the first row whose key is
+   * lexicographically not less than (prefix, suffix) (lowerbound = true),
+   * end() if there is no such row
+   */
+  template <bool lowerbound, class It>
+  Iter lookup(
+      const It &suffixes_begin, const It & /*suffixes_end*/,
+      const Prefix &prefix, const Suffix &suffix,
+      util::LookupStats &stats = Instrumentation::thread_stats()) const {
+    const size_t p = partition_of(prefix);
+    if (!holds(p, prefix)) {
+      count(stats.lookups);
+      return lowerbound ? Iter(_bounds[p], _perm_vector) : this->end();
+    }
+
+    const size_t i = lower_bound(suffixes_begin, p, suffix, stats);
+    if constexpr (!lowerbound) {
+      if (i == _bounds[p + 1]) return this->end();
+      count(stats.base_data_accesses);
+      if (*(suffixes_begin + _perm_vector.offset(i)) != suffix)
+        return this->end();
+    }
+    return Iter(i, _perm_vector);
+  }
+
+  /**
+   * Scans all rows with prefix and a suffix in [lo_suffix, hi_suffix), which
+   * form a single slice of the permutation vector. After locating both of
+   * its bounds within prefix's partition, the slice's offsets are streamed
+   * through buffer, decoding up to buffer_size offsets at a time.
+   *
+   * @param suffixes_begin start of the suffix column
+   * @param suffixes_end past-the-end of the suffix column
+   * @param prefix prefix all scanned rows share
+   * @param lo_suffix inclusive lower bound of the scanned suffix range
+   * @param hi_suffix exclusive upper bound of the scanned suffix range
+   * @param buffer caller provided buffer receiving decoded offsets
+   * @param buffer_size capacity of buffer, must be > 0
+   * @param fn invoked as fn(buffer, cnt) for every filled chunk of buffer,
+   * in suffix order
+   * @param stats receives lookup statistics of the bound lookups if
+   * instrumentation is enabled. Defaults to stats private to the calling
+   * thread
+   *
+   * @returns total amount of offsets within range
+   */
+  template <class It, class Fn>
+  size_t range(
+      const It &suffixes_begin, const It & /*suffixes_end*/,
+      const Prefix &prefix, const Suffix &lo_suffix, const Suffix &hi_suffix,
+      std::uint64_t *buffer, const size_t buffer_size, const Fn &fn,
+      util::LookupStats &stats = Instrumentation::thread_stats()) const {
+    assert(buffer_size > 0);
+    const size_t p = partition_of(prefix);
+    if (!holds(p, prefix) || !(lo_suffix < hi_suffix)) return 0;
+
+    const size_t first = lower_bound(suffixes_begin, p, lo_suffix, stats);
+    const size_t last = lower_bound(suffixes_begin, p, hi_suffix, stats);
+
+    for (size_t i = first; i < last; i += buffer_size) {
+      const size_t cnt = std::min(buffer_size, last - i);
+      _perm_vector.decode(i, cnt, buffer);
+      fn(static_cast<const std::uint64_t *>(buffer), cnt);
+    }
+
+    return last - first;
+  }
+
+  /**
+   * Determines all rows with prefix, which is answered by the prefix
+   * directory alone, i.e., without accessing base data
+   *
+   * @returns [first, last) such that iterating yields the offsets of all rows
+   * with prefix in suffix order, first == last == end() if there are none
+   */
+  std::pair<Iter, Iter> equal_range(const Prefix &prefix) const {
+    const size_t p = partition_of(prefix);
+    if (!holds(p, prefix)) return {this->end(), this->end()};
+    return {Iter(_bounds[p], _perm_vector), Iter(_bounds[p + 1], _perm_vector)};
+  }
+
+  /**
+   * Emits the offsets of [first, last), e.g., of equal_range() or a pair of
+   * lowerbound lookups, as row ids in ascending order, see
+   * LearnedSecondaryIndex::row_ids()
+   *
+   * @returns amount of row ids
+   */
+  size_t row_ids(const Iter &first, const Iter &last,
+                 std::vector<std::uint64_t> &out,
+                 std::vector<std::uint64_t> &scratch) const {
+    const size_t n = last._index - first._index;
+    out.resize(n);
+    if (n > 0) _perm_vector.decode(first._index, n, out.data());
+    util::sort_row_ids(out.data(), n, scratch);
+    return n;
+  }
+
+  /// row_ids() with a temporary scratch buffer
+  size_t row_ids(const Iter &first, const Iter &last,
+                 std::vector<std::uint64_t> &out) const {
+    std::vector<std::uint64_t> scratch;
+    return row_ids(first, last, out, scratch);
+  }
+
+  /// Emits the offsets of [first, last) as a compressed bitmap of row ids,
+  /// see LearnedSecondaryIndex::row_bitmap()
+  size_t row_bitmap(const Iter &first, const Iter &last, util::RowBitmap &out,
+                    std::vector<std::uint64_t> &scratch) const {
+    const size_t n = last._index - first._index;
+    scratch.resize(n);
+    if (n > 0) _perm_vector.decode(first._index, n, scratch.data());
+    out.assign(scratch.data(), n);
+    return n;
+  }
+
+  /// row_bitmap() with a temporary scratch buffer
+  size_t row_bitmap(const Iter &first, const Iter &last,
+                    util::RowBitmap &out) const {
+    std::vector<std::uint64_t> scratch;
+    return row_bitmap(first, last, out, scratch);
+  }
+
+  /// Iterator on the lexicographically smallest key's offset
+  Iter begin() const { return Iter(0, _perm_vector); }
+
+  /// Past-the-end iterator
+  Iter end() const { return Iter(_perm_vector.size(), _perm_vector); }
+
+  /// Amount of distinct prefixes, i.e., partitions
+  [[nodiscard]] size_t partition_count() const { return _prefixes.size(); }
+
+  /// Amount of partitions searched via a model of their own
+  [[nodiscard]] size_t model_count() const { return _models.size(); }
+
+  /// Stats recorded by lookups of the calling thread which were not provided
+  /// with caller owned stats
+  static const util::LookupStats &thread_stats() {
+    return Instrumentation::thread_stats();
+  }
+
+  size_t model_byte_size() const {
+    size_t bytes = _prefixes.size() * sizeof(Prefix) +
+                   _bounds.size() * sizeof(size_t) +
+                   _model_ids.size() * sizeof(std::uint32_t) +
+                   _max_errors.size() * sizeof(size_t);
+    for (const auto &model : _models) bytes += model.byte_size();
+    return bytes;
+  }
+
+  size_t perm_vector_byte_size() const { return _perm_vector.byte_size(); }
+
+  /// Computes total index size in bytes
+  size_t byte_size() const {
+    return model_byte_size() + perm_vector_byte_size();
+  }
+
+  static std::string name() {
+    return "Composite<" + Model::name() +
+           (std::is_same_v<PermStorage, util::SeparateStorage>
+                ? ""
+                : ", " + PermStorage::name()) +
+           (std::is_same_v<Instrumentation, util::CountingInstrumentation>
+                ? ""
+                : ", " + Instrumentation::name()) +
+           ">";
+  }
+};
+}  // namespace learned_secondary_index
@@ -1,8 +1,16 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <learned_hashing.hpp>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -10,7 +18,19 @@
 #include "convenience/builtins.hpp"
 #include "include/rs.hpp"
 #include "include/util/fingerprinter.hpp"
+#include "util/base_data.hpp"
+#include "util/bloom_filter.hpp"
+#include "util/coroutine.hpp"
+#include "util/external_sort.hpp"
+#include "util/instrumentation.hpp"
+#include "util/key_prefixes.hpp"
+#include "util/ordered_key.hpp"
+#include "util/parallel.hpp"
 #include "util/permvector.hpp"
+#include "util/row_set.hpp"
+#include "util/run_boundaries.hpp"
+#include "util/serialization.hpp"
+#include "util/support.hpp"
 
 namespace learned_secondary_index {
 
@@ -18,31 +38,138 @@ namespace learned_secondary_index {
  * Secondary Index implementation utilizing a learned CDF
  * tuned to the data at hand.
  *
- * @tparam Key key type, e.g., std::uint64_t for most SOSD datasets
- * @tparam Model CDF Model
+ * @tparam Key key type, e.g., std::uint64_t for most SOSD datasets. Any key
+ * type with an order preserving util::OrderedKey mapping is supported, e.g.,
+ * 32 bit integers, signed integers, doubles or util::FixedString
+ * @tparam Model CDF Model on util::ordered_key_t<Key>
  * @tparam Displacement data type used for internal displacement/permutations
  * vector. Choose large enough to fit data.size()! Should become irrelevant in
  * the future due to bitpacking etc.
+ * @tparam error_bucket_size if > 0, additionally retain local search bounds
+ * for every error_bucket_size consecutive model predictions. Lookups are then
+ * confined to the bounds of the bucket their prediction falls into instead of
+ * only the global max error
+ * @tparam PermStorage memory layout of the permutation vector, see
+ * util::SeparateStorage, util::InterleavedStorage, util::CompressedStorage and
+ * util::AlignedStorage
+ * @tparam Instrumentation whether lookups record util::LookupStats, see
+ * util::CountingInstrumentation and util::NoInstrumentation. Stats are never
+ * stored within the index itself, i.e., lookups are read only and may be
+ * issued concurrently
+ * @tparam run_boundaries whether to encode where runs of duplicate keys end,
+ * which lets equal_range() avoid probing base data for every duplicate
+ * @tparam FingerprintHash hash function fingerprints are derived from, e.g.,
+ * the cheaper util::MultiplyShift
+ * @tparam Filter filter on all indexed keys checked before equality lookups,
+ * e.g., util::BlockedBloomFilter. Absent keys are then mostly rejected after
+ * a single cache line access instead of a model evaluation and search
+ * @tparam key_sample_rate if > 0, additionally retain every key_sample_rate-th
+ * key in sorted order within the index. Lookups first narrow their search
+ * window to key_sample_rate entries by searching this contiguous sample,
+ * such that only the final steps access base data
+ * @tparam key_prefix_bits 0, 8, 16 or 32. If > 0, additionally retain a
+ * key_prefix_bits wide prefix of every key in sorted order, see
+ * util::KeyPrefixes. Binary search steps, final lower bound and equality
+ * checks as well as equal_range() scans then compare against these prefixes
+ * and only access base data if a prefix does not decide the comparison
  */
 template <class Key,
-          class Model = learned_hashing::RadixSplineHash<Key, 18, 16>,
-          std::uint8_t fingerprint_size = 0, bool force_linear_search = false>
+          class Model = learned_hashing::RadixSplineHash<
+              util::ordered_key_t<Key>, 18, 16>,
+          std::uint8_t fingerprint_size = 0, bool force_linear_search = false,
+          size_t error_bucket_size = 0,
+          class PermStorage = util::SeparateStorage,
+          class Instrumentation = util::CountingInstrumentation,
+          bool run_boundaries = false,
+          class FingerprintHash =
+              hashing::MurmurFinalizer<util::ordered_key_t<Key>>,
+          class Filter = util::NoFilter, size_t key_sample_rate = 0,
+          std::uint8_t key_prefix_bits = 0>
 class LearnedSecondaryIndex {
-  util::PermVector<util::Fingerprinter<Key, fingerprint_size>> _perm_vector;
+  static_assert(key_prefix_bits == 0 || key_prefix_bits == 8 ||
+                    key_prefix_bits == 16 || key_prefix_bits == 32,
+                "key_prefix_bits must be 0, 8, 16 or 32");
+
+  util::PermVector<
+      util::Fingerprinter<Key, fingerprint_size, FingerprintHash>, PermStorage>
+      _perm_vector;
   Model _model;
   size_t max_error = 0;
 
-  using DisplacementVector = std::vector<std::pair<Key, size_t>>;
+  /// _error_buckets[b] is the sorted position of the first key whose
+  /// prediction falls into bucket b or any later bucket. Since models are
+  /// monotone, [_error_buckets[b], _error_buckets[b+1]] contains the lower
+  /// bound of every key predicted to land in bucket b
+  std::vector<size_t> _error_buckets;
+
+  /// only built if run_boundaries
+  util::RunBoundaries _runs;
+
+  Filter _filter;
+
+  /// _samples[j] is the key at sorted position j * key_sample_rate in its
+  /// util::OrderedKey representation. Only built if key_sample_rate > 0
+  std::vector<util::ordered_key_t<Key>> _samples;
+
+  /// only built if key_prefix_bits > 0
+  util::KeyPrefixes<
+      Key, std::conditional_t<
+               key_prefix_bits == 32, std::uint32_t,
+               std::conditional_t<key_prefix_bits == 16, std::uint16_t,
+                                  std::uint8_t>>>
+      _prefixes;
+
+  /// time spent in each phase of the last fit
+  util::BuildStats _build_stats;
+
+  /// keeps the file alive which _perm_vector points into after load()
+  std::shared_ptr<const util::MappedFile> _mapping;
 
-  size_t _base_data_accesses = 0;
-  size_t _false_positive_accesses = 0;
+  /// Offsets bit widths lookup() is specialized on, i.e., permutation
+  /// vectors of 2^15 up to 2^40 entries. Smaller ones are mostly cache
+  /// resident anyways, while kernels for every width would multiply compile
+  /// times. Lookups on other widths use the generic_width kernel
+  static constexpr int min_kernel_width = 16;
+  static constexpr int max_kernel_width = 40;
+  static constexpr int generic_width = -1;
+
+  /// lookup() kernel chosen by select_kernel(), 0 for the generic kernel
+  size_t _kernel = 0;
+
+  /// entries whose base data linear scans prefetch ahead of their probe
+  static constexpr size_t scan_prefetch_distance = 4;
+
+  /// leading candidates per window whose base data lookup_batch() gathers
+  /// for the whole group before resolving linear searches
+  static constexpr size_t batch_candidates = 4;
+
+  /// "LSIINDX" in little endian
+  static constexpr std::uint64_t file_magic = 0x0058444E4949534CLLU;
+  /// version 2 derives fingerprints from upper instead of lower hash bits,
+  /// version 3 tags the key type and stores models via util::ModelSerializer
+  static constexpr std::uint32_t file_version = 3;
 
  public:
-  /// Speeds up permutation and model build
-  template <bool first = true>
-  class PairIter {
-    using BaseIter = typename DisplacementVector::iterator;
+  /// (key, offset) pairs an index is built from
+  using DisplacementVector = std::vector<std::pair<Key, size_t>>;
+
+  /// Instrumentation policy, see util::CountingInstrumentation
+  using instrumentation = Instrumentation;
+
+  /// Fingerprint bits stored per permutation entry
+  static constexpr std::uint8_t fingerprint_width = fingerprint_size;
 
+  /// Whether lookups scan their search window instead of binary searching it
+  static constexpr bool scans_linearly =
+      force_linear_search || fingerprint_size > 0;
+
+  /// Speeds up permutation and model build. PairIter<true> yields keys in
+  /// their util::OrderedKey representation models are trained on. BaseIter
+  /// may be any random access iterator over (key, offset) pairs exposing
+  /// first and second members, e.g., into util::ExternalSorter's output
+  template <bool first = true,
+            class BaseIter = typename DisplacementVector::iterator>
+  class PairIter {
     BaseIter _iter;
     const size_t _skip;
 
@@ -50,27 +177,29 @@ class LearnedSecondaryIndex {
     forceinline constexpr size_t gap() const { return _skip + (_skip == 0); }
 
    public:
-    using iterator_category = typename BaseIter::iterator_category;
-    using difference_type = typename BaseIter::difference_type;
-    using value_type = typename std::conditional<first, Key, size_t>::type;
+    using iterator_category =
+        typename std::iterator_traits<BaseIter>::iterator_category;
+    using difference_type =
+        typename std::iterator_traits<BaseIter>::difference_type;
+    using value_type =
+        typename std::conditional<first, util::ordered_key_t<Key>,
+                                  size_t>::type;
     using pointer = value_type *;
-    using reference = value_type &;
+    using reference = typename std::conditional<first, value_type,
+                                                const value_type &>::type;
 
     explicit PairIter(BaseIter iter, size_t skip = 0)
         : _iter(iter), _skip(skip) {}
 
-    [[nodiscard]] typename BaseIter::value_type::first_type &key() const {
-      return _iter->first;
-    }
+    [[nodiscard]] decltype(auto) key() const { return (_iter->first); }
 
-    [[nodiscard]] typename BaseIter::value_type::second_type &displacement()
-        const {
-      return _iter->second;
+    [[nodiscard]] decltype(auto) displacement() const {
+      return (_iter->second);
     }
 
     reference operator*() const {
       if constexpr (first) {
-        return _iter->first;
+        return util::to_ordered(_iter->first);
       } else {
         return _iter->second;
       }
@@ -123,8 +252,7 @@ class LearnedSecondaryIndex {
       return a._iter != b._iter;
     };
 
-    friend LearnedSecondaryIndex<Key, Model, fingerprint_size,
-                                 force_linear_search>;
+    friend LearnedSecondaryIndex;
   };
 
  public:
@@ -132,8 +260,9 @@ class LearnedSecondaryIndex {
   LearnedSecondaryIndex() noexcept = default;
 
   template <class It>
-  LearnedSecondaryIndex(const It &begin, const It &end) {
-    fit(begin, end);
+  LearnedSecondaryIndex(const It &begin, const It &end,
+                        const size_t threads = 1) {
+    fit(begin, end, threads);
   }
 
   /**
@@ -144,53 +273,284 @@ class LearnedSecondaryIndex {
    *
    * @param begin start of data to index
    * @param end start of data to index
+   * @param threads amount of threads to use for sorting, packing the
+   * permutations vector and determining the model's max error. Model training
+   * itself is always single threaded
    */
   template <class It>
-  void fit(const It &begin, const It &end) {
+  void fit(const It &begin, const It &end, const size_t threads = 1) {
     const auto n = std::distance(begin, end);
 
     // retain original displacement for each key to build permutations vector
-    DisplacementVector data;
-    data.reserve(n);
-    size_t i = 0;
-    for (auto it = begin; it < end; it++) {
-      data.push_back(std::make_pair(*it, i++));
+    DisplacementVector data(n);
+    size_t sort_ns = 0;
+    {
+      const util::PhaseTimer timer(&sort_ns);
+      util::parallel_for(n, threads, [&](size_t, size_t b, size_t e) {
+        for (size_t i = b; i < e; i++)
+          data[i] = std::make_pair(*(begin + i), i);
+      });
+
+      // sort data
+      util::parallel_sort(
+          data.begin(), data.end(),
+          [](const auto &d1, const auto &d2) { return d1.first < d2.first; },
+          threads);
     }
 
-    // sort data
-    std::sort(data.begin(), data.end(), [](const auto &d1, const auto &d2) {
-      return d1.first < d2.first;
-    });
+    fit_sorted(data.begin(), data.end(), threads);
+    _build_stats.sort_ns = sort_ns;
+  }
+
+  /**
+   * Builds the index like fit(), but bounds the memory required for sorting
+   * by memory_budget bytes. (key, offset) pairs are sorted in runs of at most
+   * memory_budget bytes, spilled to disk and merged into a single file,
+   * which is trained on and packed from in place via mmap. Permutation
+   * entries are packed directly into their final buffer, i.e., peak memory
+   * is the budget plus the index itself, with keys and sorted pairs only
+   * occupying page cache. Combine with util::MappedKeys to also avoid
+   * loading [begin, end) into memory.
+   *
+   * @param begin start of data to index
+   * @param end past-the-end of data to index
+   * @param tmp_path path of the merged temporary file. Runs are spilled to
+   *   tmp_path + ".run<i>". All temporary files are removed before returning
+   * @param memory_budget bytes of (key, offset) pairs sorted in memory at once
+   * @param threads see fit()
+   *
+   * @throws std::runtime_error if temporary files can't be written
+   */
+  template <class It>
+  void fit_external(const It &begin, const It &end,
+                    const std::string &tmp_path, const size_t memory_budget,
+                    const size_t threads = 1) {
+    util::ExternalSorter<Key> sorter(tmp_path, memory_budget);
+    size_t sort_ns = 0;
+    {
+      const util::PhaseTimer timer(&sort_ns);
+      sorter.sort(begin, end, threads);
+    }
+    fit_sorted(sorter.begin(), sorter.end(), threads);
+    _build_stats.sort_ns = sort_ns;
+  }
 
-    // build permutations vector
-    const PairIter<false> pb(data.begin());
-    const PairIter<false> pe(data.end());
-    assert(std::distance(pb, pe) == n);
-    _perm_vector.build(pb, pe);
+  /**
+   * Builds the index on (key, offset) pairs in [first, last), which must be
+   * sorted by key. Offsets are retained as is, i.e., [first, last) may be a
+   * key range partition of a larger relation. Lookups must then be issued on
+   * that entire relation.
+   *
+   * @param first start of sorted pairs, e.g., a DisplacementVector iterator
+   * @param last past-the-end of sorted pairs
+   * @param threads see fit()
+   */
+  template <class RandomIt>
+  void fit_sorted(const RandomIt &first, const RandomIt &last,
+                  const size_t threads = 1) {
+    const size_t n = std::distance(first, last);
+    _build_stats = {};
 
     // build learned model
     // TODO(dominik): don't build on full data by utilizing available skip
     // property (?)
-    const PairIter<true> db(data.begin());
-    const PairIter<true> de(data.end());
-    assert(std::distance(db, de) == n);
-    _model.train(db, de, data.size());
+    const PairIter<true, RandomIt> db(first);
+    const PairIter<true, RandomIt> de(last);
+    assert(static_cast<size_t>(std::distance(db, de)) == n);
+    {
+      const util::PhaseTimer timer(&_build_stats.train_ns);
+      _model.train(db, de, n);
+    }
 
-    // retain model's max error on this data
-    // TODO(dominik): speed up by determining this during training
-    max_error = 0;
-    size_t current_lower_bound = 0;
-    for (size_t j = 0; j < data.size(); j++) {
-      if (data[current_lower_bound].first != data[j].first) {
-        current_lower_bound = j;
+    // build permutations vector and retain model's max error (as well as
+    // local error bounds) on this data in the same pass over data
+    const size_t bucket_cnt =
+        error_bucket_size > 0 ? n / error_bucket_size + 1 : 0;
+    _error_buckets.assign(bucket_cnt + (bucket_cnt > 0), n);
+
+    struct alignit(64) ChunkState {
+      bool initialized = false;
+      size_t current_lower_bound = 0;
+      size_t current_bucket = 0;
+      size_t max_error = 0;
+    };
+    std::vector<ChunkState> chunks(std::max<size_t>(threads, 1));
+
+    const PairIter<false, RandomIt> pb(first);
+    const PairIter<false, RandomIt> pe(last);
+    assert(static_cast<size_t>(std::distance(pb, pe)) == n);
+    const auto track_max_error = [&](size_t c, size_t j, const auto &it) {
+      auto &chunk = chunks[c];
+      const auto &key = it.key();
+      const auto pred = _model(util::to_ordered(key));
+
+      if (unlikely(!chunk.initialized)) {
+        // first key's run of duplicates might start in a preceding chunk
+        chunk.current_lower_bound =
+            std::lower_bound(
+                first, first + j, key,
+                [](const auto &d, const Key &k) { return d.first < k; }) -
+            first;
+
+        // buckets up to (including) the preceding key's bucket are owned by
+        // preceding chunks
+        if constexpr (error_bucket_size > 0) {
+          if (j > 0) {
+            const auto &prev = (first + j - 1)->first;
+            chunk.current_bucket =
+                error_bucket(_model(util::to_ordered(prev))) + 1;
+          }
+        }
+        chunk.initialized = true;
+      } else if ((first + chunk.current_lower_bound)->first != key) {
+        chunk.current_lower_bound = j;
+      }
+
+      const size_t err = std::max(pred, chunk.current_lower_bound) -
+                         std::min(pred, chunk.current_lower_bound);
+      chunk.max_error = std::max(chunk.max_error, err);
+
+      // j is the first key predicted to land in any bucket not yet assigned
+      if constexpr (error_bucket_size > 0) {
+        for (const auto b = error_bucket(pred); chunk.current_bucket <= b;
+             chunk.current_bucket++) {
+          _error_buckets[chunk.current_bucket] = j;
+        }
       }
+    };
+    _perm_vector.build(pb, pe, threads, track_max_error, &_build_stats);
 
-      const auto pred = _model(data[j].first);
-      const decltype(max_error) err = std::max(pred, current_lower_bound) -
-                                      std::min(pred, current_lower_bound);
+    max_error = 0;
+    for (const auto &chunk : chunks)
+      max_error = std::max(max_error, chunk.max_error);
+
+    const util::PhaseTimer timer(&_build_stats.auxiliary_ns);
+    if constexpr (run_boundaries) _runs.build(first, last, threads);
+    _filter.build(first, last, threads);
+
+    if constexpr (key_sample_rate > 0) {
+      _samples.resize((n + key_sample_rate - 1) / key_sample_rate);
+      util::parallel_for(_samples.size(), threads,
+                         [&](size_t, size_t b, size_t e) {
+                           for (size_t j = b; j < e; j++)
+                             _samples[j] = util::to_ordered(
+                                 (first + j * key_sample_rate)->first);
+                         });
+    }
+    if constexpr (key_prefix_bits > 0) _prefixes.build(first, last, threads);
+
+    select_kernel();
+    _mapping.reset();
+  }
+
+  /**
+   * Persists the fitted index to path in a versioned binary format, which
+   * may be restored via load(). The packed permutations vector is stored
+   * verbatim such that loading does not need to decode it.
+   */
+  void save(const std::string &path) const {
+    util::Writer out(path);
+    out.write<std::uint64_t>(file_magic);
+    out.write<std::uint32_t>(file_version);
+    out.write<std::uint32_t>(util::type_tag<Key>());
+    out.write_string(name());
+
+    out.write<std::uint64_t>(max_error);
+    out.write<std::uint64_t>(_error_buckets.size());
+    out.write_bytes(reinterpret_cast<const char *>(_error_buckets.data()),
+                    _error_buckets.size() * sizeof(size_t));
+
+    // models util::ModelSerializer does not support are retrained during
+    // load() instead
+    out.write<std::uint8_t>(util::ModelSerializer<Model>::supported);
+    if constexpr (util::ModelSerializer<Model>::supported)
+      util::ModelSerializer<Model>::save(out, _model);
+
+    if constexpr (run_boundaries) _runs.save(out);
+    _filter.save(out);
+    if constexpr (key_sample_rate > 0) {
+      out.write<std::uint64_t>(_samples.size());
+      out.write_bytes(reinterpret_cast<const char *>(_samples.data()),
+                      _samples.size() * sizeof(_samples[0]));
+    }
+    if constexpr (key_prefix_bits > 0) _prefixes.save(out);
+    _perm_vector.save(out);
+  }
+
+  /**
+   * Restores an index written by save() with the exact same template
+   * parameters. The file is mapped into memory and the permutations vector
+   * is accessed in place, i.e., neither copied nor decoded. Models are
+   * restored via util::ModelSerializer, i.e., without accessing [begin,
+   * end). Only models it does not support are retrained in a single pass
+   * over [begin, end) in sorted order as provided by the permutations
+   * vector, which is still much cheaper than fit() as no sorting is required.
+   *
+   * @param path file written by save()
+   * @param begin start of the data range the index was fitted on
+   * @param end past-the-end of the data range the index was fitted on
+   * @param threads amount of threads to use for gathering sorted keys
+   *
+   * @throws std::runtime_error if the file can't be read, is truncated, was
+   * written by an incompatible version/index type or does not match [begin,
+   * end) in size
+   */
+  template <class It>
+  void load(const std::string &path, const It &begin, const It &end,
+            const size_t threads = 1) {
+    auto mapping = std::make_shared<const util::MappedFile>(path);
+    util::Reader in(mapping->data(), mapping->size());
+
+    if (in.read<std::uint64_t>() != file_magic)
+      throw std::runtime_error("'" + path + "' is not an LSI file");
+    if (in.read<std::uint32_t>() != file_version)
+      throw std::runtime_error("'" + path + "' has unsupported version");
+    if (in.read<std::uint32_t>() != util::type_tag<Key>() ||
+        in.read_string() != name())
+      throw std::runtime_error("'" + path + "' stores a different LSI type");
+
+    max_error = in.read<std::uint64_t>();
+    const size_t bucket_cnt = in.read<std::uint64_t>();
+    const char *buckets = in.read_bytes(bucket_cnt * sizeof(size_t));
+    _error_buckets.resize(bucket_cnt);
+    if (bucket_cnt > 0)
+      std::memcpy(_error_buckets.data(), buckets, bucket_cnt * sizeof(size_t));
+
+    const bool stored_model = in.read<std::uint8_t>();
+    if constexpr (util::ModelSerializer<Model>::supported) {
+      if (stored_model) util::ModelSerializer<Model>::load(in, _model);
+    }
 
-      max_error = std::max(max_error, err);
+    if constexpr (run_boundaries) _runs.load(in);
+    _filter.load(in);
+    if constexpr (key_sample_rate > 0) {
+      _samples.resize(in.read<std::uint64_t>());
+      const char *samples =
+          in.read_bytes(_samples.size() * sizeof(_samples[0]));
+      if (!_samples.empty())
+        std::memcpy(_samples.data(), samples,
+                    _samples.size() * sizeof(_samples[0]));
     }
+    if constexpr (key_prefix_bits > 0) _prefixes.load(in);
+    _perm_vector.load(in);
+
+    const size_t n = std::distance(begin, end);
+    if (_perm_vector.size() != n)
+      throw std::runtime_error("'" + path + "' indexes " +
+                               std::to_string(_perm_vector.size()) +
+                               " instead of " + std::to_string(n) + " keys");
+
+    if (!stored_model) {
+      std::vector<util::ordered_key_t<Key>> sorted(n);
+      util::parallel_for(n, threads, [&](size_t, size_t b, size_t e) {
+        for (size_t i = b; i < e; i++)
+          sorted[i] = util::to_ordered(*(begin + _perm_vector.offset(i)));
+      });
+      _model.train(sorted.begin(), sorted.end(), n);
+    }
+
+    select_kernel();
+    _mapping = std::move(mapping);
   }
 
   /**
@@ -208,8 +568,6 @@ class LearnedSecondaryIndex {
     PermIter(size_t index, decltype(_perm_vector) &perm_vector)
         : _index(index), _perm_vector(perm_vector) {}
 
-    typename Vector::value value() const { return _perm_vector[_index]; }
-
    public:
     using iterator_category = typename BaseIter::iterator_category;
     using difference_type = typename BaseIter::difference_type;
@@ -218,7 +576,7 @@ class LearnedSecondaryIndex {
     using reference = value_type &;
 
     /// Obtain current offset into original data [begin, end)
-    value_type operator*() const { return _perm_vector[_index].index; }
+    value_type operator*() const { return _perm_vector.offset(_index); }
 
     // Prefix increment
     PermIter &operator++() {
@@ -263,15 +621,14 @@ class LearnedSecondaryIndex {
     }
 
     friend bool operator==(const PermIter &a, const PermIter &b) {
-      return a._index == b._index && a._perm_vector == b._perm_vector;
+      return a._index == b._index && &a._perm_vector == &b._perm_vector;
     };
 
     friend bool operator!=(const PermIter &a, const PermIter &b) {
-      return a._index != b._index || a._perm_vector != b._perm_vector;
+      return a._index != b._index || &a._perm_vector != &b._perm_vector;
     };
 
-    friend LearnedSecondaryIndex<Key, Model, fingerprint_size,
-                                 force_linear_search>;
+    friend LearnedSecondaryIndex;
   };
 
   /// PermIter pointing to the first stored displacement
@@ -280,6 +637,277 @@ class LearnedSecondaryIndex {
   /// Past-the-end iterator
   PermIter end() const { return PermIter(_perm_vector.size(), _perm_vector); }
 
+ private:
+  /// Increments counter by amount if instrumentation is enabled
+  forceinline static void count(size_t &counter, const size_t amount = 1) {
+    if constexpr (Instrumentation::enabled) counter += amount;
+  }
+
+  /// Computes the search interval [start_i, stop_i) in which key must be
+  /// located according to the model's prediction and max error
+  forceinline std::pair<size_t, size_t> search_bounds(
+      const Key &key, util::LookupStats &stats) const {
+    // predict rough displacement location
+    const auto pred = _model(util::to_ordered(key));
+
+    // compute start iter of search interval
+    size_t stop_i = std::min(pred + max_error + 1, _perm_vector.size());
+    size_t start_i =
+        pred - std::min(pred, static_cast<decltype(pred)>(max_error));
+
+    // narrow down to local error bounds
+    if constexpr (error_bucket_size > 0) {
+      const auto b = error_bucket(pred);
+      start_i = std::max(start_i, _error_buckets[b]);
+      stop_i = std::min(stop_i, _error_buckets[b + 1] + 1);
+    }
+
+    start_i = std::min(start_i, stop_i);
+    count(stats.lookups);
+    count(stats.window_size, stop_i - start_i);
+
+    if constexpr (key_sample_rate > 0)
+      narrow_bounds(util::to_ordered(key), start_i, stop_i, stats);
+
+    return {start_i, stop_i};
+  }
+
+  /**
+   * Narrows [start_i, stop_i) to at most key_sample_rate entries by a
+   * lowerbound search on the samples located within it. Since samples are
+   * contiguous, the search is branchless and prefetches both candidates of
+   * the subsequent step, i.e., its cache misses are mostly overlapping and
+   * never touch base data.
+   */
+  forceinline void narrow_bounds(const util::ordered_key_t<Key> &key,
+                                 size_t &start_i, size_t &stop_i,
+                                 util::LookupStats &stats) const {
+    // samples with positions in [start_i, stop_i)
+    const size_t first_j = (start_i + key_sample_rate - 1) / key_sample_rate;
+    const size_t last_j = (stop_i + key_sample_rate - 1) / key_sample_rate;
+    if (first_j >= last_j) return;
+
+    const auto *base = _samples.data() + first_j;
+    for (size_t len = last_j - first_j; len > 1;) {
+      const size_t half = len / 2;
+      prefetchit(base + half / 2, 0, 3);
+      prefetchit(base + half + half / 2, 0, 3);
+      count(stats.sample_accesses);
+      base = base[half] < key ? base + half : base;
+      len -= half;
+    }
+    count(stats.sample_accesses);
+    const size_t j = (base - _samples.data()) + (*base < key);
+
+    // lower bound succeeds sample j - 1 and is at most sample j's position
+    if (j > first_j) start_i = (j - 1) * key_sample_rate + 1;
+    if (j < last_j) stop_i = j * key_sample_rate;
+  }
+
+  /// Local error bucket responsible for prediction pred
+  forceinline size_t error_bucket(const size_t pred) const {
+    return std::min(pred / error_bucket_size, _error_buckets.size() - 2);
+  }
+
+  /// Offset stored at index i, decoded with the compile time bit width
+  /// offsets_bit_width if it is not generic_width
+  template <int offsets_bit_width>
+  forceinline size_t offset(const size_t i) const {
+    if constexpr (offsets_bit_width == generic_width) {
+      return _perm_vector.offset(i);
+    } else {
+      return _perm_vector.template offset<offsets_bit_width>(i);
+    }
+  }
+
+  /// Linear search for key in [start_i, stop_i), using fingerprint bits to
+  /// skip non-hits for equality lookups
+  template <bool lowerbound, int offsets_bit_width = generic_width, class It>
+  forceinline PermIter linear_search(const It &begin, const Key &key,
+                                     const size_t start_i, const size_t stop_i,
+                                     util::LookupStats &stats) const {
+    if constexpr (!lowerbound && fingerprint_size > 0) {
+      // match fingerprint bits of whole blocks against key's fingerprint
+      // (computed only once) and only decode offsets of candidates
+      const auto print = _perm_vector.fingerprint(key);
+      for (size_t block_i = start_i; block_i < stop_i; block_i += 64) {
+        const auto cnt = std::min<size_t>(64, stop_i - block_i);
+        uint64_t matches;
+        if constexpr (offsets_bit_width == generic_width) {
+          matches = _perm_vector.match(print, block_i, cnt);
+        } else {
+          // specialized kernels are only chosen if fingerprint bits are
+          // packed with exactly fingerprint_size bits
+          matches = _perm_vector.template match<fingerprint_size>(
+              print, block_i, cnt);
+        }
+
+        // prefetch base data of all candidates of the block at once, such
+        // that misses of false positives overlap with the actual hit's
+        for (auto m = matches; m != 0; m &= m - 1)
+          util::prefetch_base(
+              begin, offset<offsets_bit_width>(block_i + util::ctz(m)));
+
+        for (; matches != 0; matches &= matches - 1) {
+          const auto ind = block_i + util::ctz(matches);
+          count(stats.fingerprint_hits);
+
+          // access base data to see if we may stop
+          count(stats.base_data_accesses);
+          const auto &probed = *(begin + offset<offsets_bit_width>(ind));
+          if (probed >= key) {
+            if (probed != key) return this->end();
+            return PermIter(ind, _perm_vector);
+          }
+          count(stats.false_positive_accesses);
+        }
+      }
+
+      return finalize<lowerbound>(begin, key, PermIter(stop_i, _perm_vector),
+                                  stats);
+    } else {
+      PermIter ind(start_i, _perm_vector);
+      const auto stop = this->begin() + stop_i;
+
+      // keep base data of the next scan_prefetch_distance entries in flight
+      const auto prefetch_ahead = [&](const size_t i) {
+        if (i < stop_i)
+          util::prefetch_base(begin, offset<offsets_bit_width>(i));
+      };
+      for (size_t i = 0; i < scan_prefetch_distance; i++)
+        prefetch_ahead(start_i + i);
+
+      for (; ind < stop; ind++) {
+        prefetch_ahead(ind._index + scan_prefetch_distance);
+
+        // access base data to see if we may stop
+        count(stats.base_data_accesses);
+        if (*(begin + offset<offsets_bit_width>(ind._index)) >= key) break;
+        count(stats.false_positive_accesses);
+      }
+
+      return finalize<lowerbound>(begin, key, ind, stats);
+    }
+  }
+
+  /// Search of a single lookup() decoding offsets with the compile time bit
+  /// width offsets_bit_width, or the runtime one if it is generic_width
+  template <bool lowerbound, int offsets_bit_width, class It>
+  PermIter search(const It &begin, const Key &key,
+                  util::LookupStats &stats) const {
+    auto [start_i, stop_i] = search_bounds(key, stats);
+
+    if constexpr (force_linear_search || fingerprint_size > 0) {
+      return linear_search<lowerbound, offsets_bit_width>(begin, key, start_i,
+                                                          stop_i, stats);
+    } else {
+      // binary search
+      while (start_i < stop_i) {
+        // probe key at mid
+        const auto mid_i = start_i + (stop_i - start_i) / 2;
+
+        // permutation entries of both possible next probes, which are
+        // fetched while waiting for mid's base data
+        const auto lower_mid = start_i + (mid_i - start_i) / 2;
+        const auto upper_mid = mid_i + 1 + (stop_i - mid_i - 1) / 2;
+        _perm_vector.prefetch(lower_mid);
+        _perm_vector.prefetch(upper_mid);
+        if constexpr (key_prefix_bits > 0) {
+          _prefixes.prefetch(lower_mid);
+          _prefixes.prefetch(upper_mid);
+        }
+
+        // base data is only probed if mid's key prefix is undecided
+        const auto order = prefix_order(mid_i, key, stats);
+        bool less = order == util::PrefixOrder::less;
+        if (order == util::PrefixOrder::unknown) {
+          count(stats.base_data_accesses);
+          less = *(begin + offset<offsets_bit_width>(mid_i)) < key;
+        }
+
+        if (less) {
+          start_i = mid_i + 1;
+        } else {
+          stop_i = mid_i;
+        }
+      }
+
+      return finalize<lowerbound>(begin, key, PermIter(start_i, _perm_vector),
+                                  stats);
+    }
+  }
+
+  template <bool lowerbound, class It>
+  using Kernel = PermIter (LearnedSecondaryIndex::*)(const It &, const Key &,
+                                                     util::LookupStats &) const;
+
+  /// Amount of kernels specialized on a bit width. Storages without a fixed
+  /// width per entry only use the generic kernel
+  static constexpr int specialized_kernels =
+      PermStorage::fixed_width ? max_kernel_width - min_kernel_width + 1 : 0;
+
+  /// Kernel table indexed by _kernel: the generic kernel followed by one
+  /// kernel per bit width in [min_kernel_width, max_kernel_width]
+  template <bool lowerbound, class It, int... widths>
+  static constexpr std::array<Kernel<lowerbound, It>, sizeof...(widths) + 1>
+  make_kernels(std::integer_sequence<int, widths...>) {
+    return {&LearnedSecondaryIndex::search<lowerbound, generic_width, It>,
+            &LearnedSecondaryIndex::search<lowerbound,
+                                           min_kernel_width + widths, It>...};
+  }
+
+  /// Chooses the lookup kernel specialized on the permutation vector's
+  /// offsets bit width, if there is one for it
+  void select_kernel() {
+    _kernel = 0;
+    if constexpr (PermStorage::fixed_width) {
+      const int width = _perm_vector.offsets_bit_width();
+      if (width >= min_kernel_width && width <= max_kernel_width &&
+          _perm_vector.fingerprint_bits_bit_width() == fingerprint_size)
+        _kernel = width - min_kernel_width + 1;
+    }
+  }
+
+  /// Post processes a search result, i.e., repairs lower bounds outside of
+  /// the error interval and maps equality misses to end()
+  template <bool lowerbound, class It>
+  forceinline PermIter finalize(const It &begin, const Key &key, PermIter ind,
+                                util::LookupStats &stats) const {
+    if constexpr (lowerbound) {
+      for (; ind != this->end(); ind++) {
+        const auto order = prefix_order(ind._index, key, stats);
+        if (order == util::PrefixOrder::less) continue;
+        if (order != util::PrefixOrder::unknown || !(*(begin + *ind) < key))
+          break;
+        count(stats.base_data_accesses);
+      }
+    } else {
+      if (ind == this->end()) return this->end();
+
+      const auto order = prefix_order(ind._index, key, stats);
+      if (order == util::PrefixOrder::equal) return ind;
+      if (order != util::PrefixOrder::unknown || *(begin + *ind) != key) {
+        return this->end();
+      }
+    }
+
+    return ind;
+  }
+
+  /// Compares the key at sorted position i with key via its key prefix,
+  /// i.e., without accessing base data. unknown if key_prefix_bits == 0
+  forceinline util::PrefixOrder prefix_order(const size_t i, const Key &key,
+                                             util::LookupStats &stats) const {
+    if constexpr (key_prefix_bits > 0) {
+      const auto order = _prefixes.compare(i, util::to_ordered(key));
+      if (order != util::PrefixOrder::unknown) count(stats.prefix_resolutions);
+      return order;
+    } else {
+      return util::PrefixOrder::unknown;
+    }
+  }
+
+ public:
   /**
    * Lookup key in range [begin, end). Note that [begin, end) must
    * point to a range of the same size and ordering as provided to the previous
@@ -289,6 +917,8 @@ class LearnedSecondaryIndex {
    * @param begin start of relation range
    * @param end past-the-end of relation range
    * @param key to search
+   * @param stats receives lookup statistics if instrumentation is enabled.
+   * Defaults to stats private to the calling thread
    *
    * @returns if lowerbound=false iterator that yields the offset into [begin,
    * end) at which key may be found or end() if there is no such key. If
@@ -297,117 +927,511 @@ class LearnedSecondaryIndex {
    * smaller
    */
   template <bool lowerbound, class It>
-  PermIter lookup(const It &begin, const It &end, const Key &key) const {
-    const auto incr_false_positives = [&]() {
-      // false_positive_accesses is a debug variable, only attached to LSI for
-      // convenience/to not break the interface (const). Don't do this
-      // for production code :)
-      ((typename std::remove_const<  // NOLINT google-readability-casting
-           typename std::remove_pointer<decltype(this)>::type>::type *)this)
-          ->_false_positive_accesses++;
-    };
-
-    const auto incr_base_accesses = [&]() {
-      // base_data_accesses is a debug variable, only attached to LSI for
-      // convenience/to not break the interface (const). Don't do this
-      // for production code :)
-      ((typename std::remove_const<  // NOLINT google-readability-casting
-           typename std::remove_pointer<decltype(this)>::type>::type *)this)
-          ->_base_data_accesses++;
-    };
+  PermIter lookup(
+      const It &begin, const It & /*end*/, const Key &key,
+      util::LookupStats &stats = Instrumentation::thread_stats()) const {
+    if (!lowerbound && !_filter.contains(key)) {
+      count(stats.lookups);
+      count(stats.filter_rejections);
+      return this->end();
+    }
 
-    // predict rough displacement location
-    const auto pred = _model(key);
+    // one indirect call into the kernel chosen by select_kernel()
+    static constexpr auto kernels = make_kernels<lowerbound, It>(
+        std::make_integer_sequence<int, specialized_kernels>{});
+    return (this->*kernels[_kernel])(begin, key, stats);
+  }
 
-    // compute start iter of search interval
-    auto start_i =
-        pred - std::min(pred, static_cast<decltype(pred)>(max_error));
+  /**
+   * Batched lookup of all keys in [keys_first, keys_last). Keys are processed
+   * in groups of group_size, advancing the searches of all keys in a group
+   * in lockstep. Each PermVector slot and base data location is prefetched
+   * one stage before it is accessed, such that the otherwise dependent cache
+   * misses of independent lookups overlap.
+   *
+   * @tparam lowerbound whether to perform lowerbound or equality lookups
+   * @tparam group_size amount of lookups in flight at any time
+   * @param begin start of relation range
+   * @param end past-the-end of relation range
+   * @param keys_first start of keys to search
+   * @param keys_last past-the-end of keys to search
+   * @param out output iterator receiving one PermIter per key, in input
+   * order, with the same semantics as the result of lookup()
+   * @param stats receives lookup statistics if instrumentation is enabled.
+   * Defaults to stats private to the calling thread
+   *
+   * @returns output iterator past the last written result
+   */
+  template <bool lowerbound, size_t group_size = 16, class It, class KeyIt,
+            class OutIt>
+  OutIt lookup_batch(
+      const It &begin, const It & /*end*/, KeyIt keys_first,
+      const KeyIt &keys_last, OutIt out,
+      util::LookupStats &stats = Instrumentation::thread_stats()) const {
+    static_assert(group_size > 0, "group_size must be positive");
+
+    // base data locations gathered per stage, i.e., one per key for binary
+    // searches and up to batch_candidates per key for linear searches
+    static constexpr size_t max_probes =
+        force_linear_search || fingerprint_size > 0
+            ? group_size * batch_candidates
+            : group_size;
+
+    std::array<Key, group_size> keys;
+    std::array<size_t, group_size> start_i;
+    std::array<size_t, group_size> stop_i;
+    std::array<size_t, group_size> mid_i;
+    std::array<size_t, group_size + 1> first_probe;
+    std::array<std::uint64_t, max_probes> offset;
+    // lane (binary search) or slot (linear search) of each probe
+    std::array<size_t, max_probes> lanes;
+    std::array<typename std::iterator_traits<It>::value_type, max_probes>
+        probed;
+    std::array<bool, group_size> rejected;
+
+    while (keys_first != keys_last) {
+      // stage 0: filter and predict search interval for next group of keys.
+      // Rejected keys obtain an empty interval and never access base data
+      size_t cnt = 0;
+      for (; cnt < group_size && keys_first != keys_last; cnt++, ++keys_first) {
+        keys[cnt] = *keys_first;
+        rejected[cnt] = !lowerbound && !_filter.contains(keys[cnt]);
+        if (rejected[cnt]) {
+          count(stats.lookups);
+          count(stats.filter_rejections);
+          start_i[cnt] = stop_i[cnt] = 0;
+          continue;
+        }
+        std::tie(start_i[cnt], stop_i[cnt]) = search_bounds(keys[cnt], stats);
+      }
 
-    // function global constants
-    auto stop_i = std::min(pred + max_error + 1, _perm_vector.size());
-    const auto stop = this->begin() + stop_i;
+      if constexpr (force_linear_search || fingerprint_size > 0) {
+        static constexpr bool fingerprinted =
+            !lowerbound && fingerprint_size > 0;
+
+        // stage 1: prefetch the first slots of every window
+        for (size_t j = 0; j < cnt; j++)
+          if (!rejected[j]) _perm_vector.prefetch(start_i[j]);
+
+        // stage 2: collect up to batch_candidates leading candidates per
+        // window, i.e., fingerprint matches of its first block or its first
+        // entries if there are no fingerprints to match, and gather their
+        // base data at once, overlapping the misses of the entire group.
+        // mid_i receives the slot at which each search resumes afterwards
+        size_t probe_cnt = 0;
+        for (size_t j = 0; j < cnt; j++) {
+          first_probe[j] = probe_cnt;
+          mid_i[j] = stop_i[j];
+          if (rejected[j]) continue;
+
+          if constexpr (fingerprinted) {
+            const auto block_cnt = std::min<size_t>(64, stop_i[j] - start_i[j]);
+            if (block_cnt == 0) continue;
+            auto matches = _perm_vector.match(_perm_vector.fingerprint(keys[j]),
+                                              start_i[j], block_cnt);
+            mid_i[j] = start_i[j] + block_cnt;
+            for (; matches != 0 &&
+                   probe_cnt - first_probe[j] < batch_candidates;
+                 matches &= matches - 1) {
+              lanes[probe_cnt] = start_i[j] + util::ctz(matches);
+              offset[probe_cnt] = _perm_vector.offset(lanes[probe_cnt]);
+              probe_cnt++;
+            }
+            if (matches != 0) mid_i[j] = start_i[j] + util::ctz(matches);
+          } else {
+            mid_i[j] = std::min(stop_i[j], start_i[j] + batch_candidates);
+            for (size_t i = start_i[j]; i < mid_i[j]; i++) {
+              lanes[probe_cnt] = i;
+              offset[probe_cnt++] = _perm_vector.offset(i);
+            }
+          }
+        }
+        first_probe[cnt] = probe_cnt;
+        util::gather_base(begin, offset.data(), probe_cnt, probed.data());
+
+        // stage 3: resolve searches by their candidates, continuing the
+        // linear search after them if none of them decided it
+        for (size_t j = 0; j < cnt; j++) {
+          if (rejected[j]) {
+            *out++ = this->end();
+            continue;
+          }
 
-    if constexpr (force_linear_search || fingerprint_size > 0) {
-      PermIter ind(start_i, _perm_vector);
+          size_t p = first_probe[j];
+          for (; p < first_probe[j + 1]; p++) {
+            if constexpr (fingerprinted) count(stats.fingerprint_hits);
+            count(stats.base_data_accesses);
+            if (probed[p] >= keys[j]) break;
+            count(stats.false_positive_accesses);
+          }
 
-      // linear search algorithm
-      for (; ind < stop; ind++) {
-        const auto perm_val = ind.value();
+          if (p == first_probe[j + 1]) {
+            *out++ = linear_search<lowerbound>(begin, keys[j], mid_i[j],
+                                               stop_i[j], stats);
+          } else if constexpr (fingerprinted) {
+            *out++ = probed[p] != keys[j] ? this->end()
+                                          : PermIter(lanes[p], _perm_vector);
+          } else {
+            *out++ = finalize<lowerbound>(
+                begin, keys[j], PermIter(lanes[p], _perm_vector), stats);
+          }
+        }
+      } else {
+        for (bool active = true; active;) {
+          // stage 1: prefetch permutation vector entries at mid
+          for (size_t j = 0; j < cnt; j++) {
+            if (start_i[j] >= stop_i[j]) continue;
+            mid_i[j] = start_i[j] + (stop_i[j] - start_i[j]) / 2;
+            _perm_vector.prefetch(mid_i[j]);
+            if constexpr (key_prefix_bits > 0) _prefixes.prefetch(mid_i[j]);
+          }
 
-        // use fingerprint bits to fast track non-hits.
-        if constexpr (!lowerbound) {
-          if (!_perm_vector.test(key, perm_val)) {
-            assert(*(begin + perm_val.index) != key);
-            continue;
+          // stage 2: narrow searches decided by key prefixes, decode offsets
+          // of all remaining active searches & gather their base data at
+          // once, overlapping the misses of the entire group
+          active = false;
+          size_t probe_cnt = 0;
+          for (size_t j = 0; j < cnt; j++) {
+            if (start_i[j] >= stop_i[j]) continue;
+            if (const auto order = prefix_order(mid_i[j], keys[j], stats);
+                order != util::PrefixOrder::unknown) {
+              if (order == util::PrefixOrder::less) {
+                start_i[j] = mid_i[j] + 1;
+              } else {
+                stop_i[j] = mid_i[j];
+              }
+              active |= start_i[j] < stop_i[j];
+              continue;
+            }
+            lanes[probe_cnt] = j;
+            offset[probe_cnt++] = _perm_vector.offset(mid_i[j]);
+          }
+          util::gather_base(begin, offset.data(), probe_cnt, probed.data());
+
+          // stage 3: narrow search intervals
+          for (size_t p = 0; p < probe_cnt; p++) {
+            const size_t j = lanes[p];
+            count(stats.base_data_accesses);
+            if (probed[p] < keys[j]) {
+              start_i[j] = mid_i[j] + 1;
+            } else {
+              stop_i[j] = mid_i[j];
+            }
+            active |= start_i[j] < stop_i[j];
           }
         }
 
-        // access base data to see if we may stop
-        incr_base_accesses();
-        if (*(begin + perm_val.index) >= key) break;
-        incr_false_positives();
+        for (size_t j = 0; j < cnt; j++) {
+          *out++ = rejected[j]
+                       ? this->end()
+                       : finalize<lowerbound>(
+                             begin, keys[j], PermIter(start_i[j], _perm_vector),
+                             stats);
+        }
       }
+    }
 
-      if constexpr (lowerbound) {
-        while (ind != this->end() && *(begin + *ind) < key) {
-          incr_base_accesses();
-          ind++;
-        }
-      } else {
-        if (*(begin + *ind) != key) {
-          return this->end();
+    return out;
+  }
+
+  /**
+   * Resumable lookup of key in range [begin, end) with the same semantics
+   * as lookup(). The task is lazily started and suspends whenever its
+   * search depends on a memory access it just prefetched, i.e., the model's
+   * initial PermVector slot as well as every slot and base data location
+   * probed subsequently. Callers may interleave many lookups, or arbitrary
+   * other work such as hash table probes, by resuming tasks round robin
+   * to overlap their cache misses, see util::LookupTask. Unlike
+   * lookup_batch(), no lockstep pipeline is imposed onto the caller.
+   *
+   * begin and key are copied into the coroutine frame, whereas the index,
+   * the base data and stats must outlive the task. Offsets are always
+   * decoded with the generic (runtime bit width) kernel.
+   *
+   * @tparam lowerbound whether to perform a lowerbound or equality lookup
+   * @param stats receives lookup statistics if instrumentation is enabled.
+   * Defaults to stats private to the calling thread, i.e., tasks must then
+   * be resumed on the thread which created them
+   */
+  template <bool lowerbound, class It>
+  util::LookupTask<PermIter> lookup_coroutine(
+      const It begin, const It /*end*/, const Key key,
+      util::LookupStats &stats = Instrumentation::thread_stats()) const {
+    if (!lowerbound && !_filter.contains(key)) {
+      count(stats.lookups);
+      count(stats.filter_rejections);
+      co_return this->end();
+    }
+
+    auto [start_i, stop_i] = search_bounds(key, stats);
+
+    if constexpr (!lowerbound && fingerprint_size > 0) {
+      const auto print = _perm_vector.fingerprint(key);
+      _perm_vector.prefetch(start_i);
+      co_await std::suspend_always{};
+
+      for (size_t block_i = start_i; block_i < stop_i; block_i += 64) {
+        const auto cnt = std::min<size_t>(64, stop_i - block_i);
+        for (auto matches = _perm_vector.match(print, block_i, cnt);
+             matches != 0; matches &= matches - 1) {
+          const auto ind = block_i + util::ctz(matches);
+          count(stats.fingerprint_hits);
+
+          const auto offset = _perm_vector.offset(ind);
+          util::prefetch_base(begin, offset);
+          co_await std::suspend_always{};
+
+          count(stats.base_data_accesses);
+          const auto &probed = *(begin + offset);
+          if (probed >= key) {
+            if (probed != key) co_return this->end();
+            co_return PermIter(ind, _perm_vector);
+          }
+          count(stats.false_positive_accesses);
         }
       }
 
-      return ind;
+      co_return finalize<lowerbound>(begin, key,
+                                     PermIter(stop_i, _perm_vector), stats);
+    } else if constexpr (force_linear_search || fingerprint_size > 0) {
+      // every entry of the window probes base data, whereas the window
+      // itself is read sequentially
+      _perm_vector.prefetch(start_i);
+      co_await std::suspend_always{};
+
+      size_t ind = start_i;
+      for (; ind < stop_i; ind++) {
+        const auto offset = _perm_vector.offset(ind);
+        util::prefetch_base(begin, offset);
+        co_await std::suspend_always{};
+
+        count(stats.base_data_accesses);
+        if (*(begin + offset) >= key) break;
+        count(stats.false_positive_accesses);
+      }
+
+      co_return finalize<lowerbound>(begin, key, PermIter(ind, _perm_vector),
+                                     stats);
     } else {
-      // binary search
+      // binary search, suspending before both dependent misses per step
       while (start_i < stop_i) {
-        // probe key at mid
         const auto mid_i = start_i + (stop_i - start_i) / 2;
-        incr_base_accesses();
-        const auto probed = *(begin + _perm_vector[mid_i].index);
+        _perm_vector.prefetch(mid_i);
+        if constexpr (key_prefix_bits > 0) _prefixes.prefetch(mid_i);
+        co_await std::suspend_always{};
+
+        if (const auto order = prefix_order(mid_i, key, stats);
+            order != util::PrefixOrder::unknown) {
+          if (order == util::PrefixOrder::less) {
+            start_i = mid_i + 1;
+          } else {
+            stop_i = mid_i;
+          }
+          continue;
+        }
 
-        if (probed < key) {
+        const auto offset = _perm_vector.offset(mid_i);
+        util::prefetch_base(begin, offset);
+        co_await std::suspend_always{};
+
+        count(stats.base_data_accesses);
+        if (*(begin + offset) < key) {
           start_i = mid_i + 1;
         } else {
           stop_i = mid_i;
         }
       }
 
-      PermIter ind(start_i, _perm_vector);
+      co_return finalize<lowerbound>(begin, key,
+                                     PermIter(start_i, _perm_vector), stats);
+    }
+  }
 
-      if constexpr (lowerbound) {
-        while (ind != this->end() && *(begin + *ind) < key) {
-          incr_base_accesses();
-          ind++;
-        }
-      } else {
-        if (*(begin + *ind) != key) {
-          return this->end();
-        }
-      }
+  /**
+   * Range scan over all keys in [lo_key, hi_key). Determines both bounds via
+   * lowerbound lookups and subsequently streams the offsets in between
+   * through buffer, bulk decoding up to buffer_size offsets at a time.
+   *
+   * @param begin start of relation range
+   * @param end past-the-end of relation range
+   * @param lo_key inclusive lower bound of the scanned key range
+   * @param hi_key exclusive upper bound of the scanned key range
+   * @param buffer caller provided buffer receiving decoded offsets
+   * @param buffer_size capacity of buffer, must be > 0
+   * @param fn invoked as fn(buffer, cnt) for every filled chunk of buffer,
+   * in key order
+   * @param stats receives lookup statistics of the bound lookups if
+   * instrumentation is enabled. Defaults to stats private to the calling
+   * thread
+   *
+   * @returns total amount of offsets within range
+   */
+  template <class It, class Fn>
+  size_t range(
+      const It &begin, const It &end, const Key &lo_key, const Key &hi_key,
+      std::uint64_t *buffer, const size_t buffer_size, const Fn &fn,
+      util::LookupStats &stats = Instrumentation::thread_stats()) const {
+    assert(buffer_size > 0);
+    if (!(lo_key < hi_key)) return 0;
+
+    const size_t first =
+        lookup<true>(begin, end, lo_key, stats) - this->begin();
+    const size_t last = lookup<true>(begin, end, hi_key, stats) - this->begin();
+
+    for (size_t i = first; i < last; i += buffer_size) {
+      const size_t cnt = std::min(buffer_size, last - i);
+      _perm_vector.decode(i, cnt, buffer);
+      fn(static_cast<const std::uint64_t *>(buffer), cnt);
+    }
 
-      return ind;
+    return last - first;
+  }
+
+  /**
+   * Determines all rows with key, i.e., the run of duplicates starting at
+   * lookup<false>(begin, end, key). If the index encodes run boundaries, the
+   * run's end is obtained without accessing base data. Otherwise, successors
+   * are probed until a different key is encountered.
+   *
+   * @param begin start of relation range
+   * @param end past-the-end of relation range
+   * @param key to search
+   * @param stats receives lookup statistics if instrumentation is enabled.
+   * Defaults to stats private to the calling thread
+   *
+   * @returns [first, last) such that iterating yields the offsets of all rows
+   * with key, first == last == end() if there are none
+   */
+  template <class It>
+  std::pair<PermIter, PermIter> equal_range(
+      const It &begin, const It &end, const Key &key,
+      util::LookupStats &stats = Instrumentation::thread_stats()) const {
+    const auto first = lookup<false>(begin, end, key, stats);
+    if (first == this->end()) return {first, first};
+
+    if constexpr (run_boundaries) {
+      return {first, PermIter(_runs.run_end(first._index), _perm_vector)};
+    } else {
+      auto last = first + 1;
+      for (; last != this->end(); ++last) {
+        const auto order = prefix_order(last._index, key, stats);
+        if (order == util::PrefixOrder::equal) continue;
+        if (order != util::PrefixOrder::unknown) break;
+
+        count(stats.base_data_accesses);
+        if (*(begin + *last) != key) break;
+      }
+      return {first, last};
     }
   }
 
-  size_t base_data_accesses() const { return _base_data_accesses; }
+  /**
+   * Emits the offsets of [first, last), e.g., of equal_range() or a pair of
+   * lowerbound lookups, as row ids in ascending order instead of key order.
+   * Offsets are bulk decoded into out and subsequently radix sorted, see
+   * util::sort_row_ids()
+   *
+   * @param out receives the row ids, resized to last - first
+   * @param scratch buffer reused across calls by the radix sort
+   *
+   * @returns amount of row ids
+   */
+  size_t row_ids(const PermIter &first, const PermIter &last,
+                 std::vector<std::uint64_t> &out,
+                 std::vector<std::uint64_t> &scratch) const {
+    const size_t n = last._index - first._index;
+    out.resize(n);
+    if (n > 0) _perm_vector.decode(first._index, n, out.data());
+    util::sort_row_ids(out.data(), n, scratch);
+    return n;
+  }
 
-  size_t false_positive_accesses() const { return _false_positive_accesses; }
+  /// row_ids() with a temporary scratch buffer
+  size_t row_ids(const PermIter &first, const PermIter &last,
+                 std::vector<std::uint64_t> &out) const {
+    std::vector<std::uint64_t> scratch;
+    return row_ids(first, last, out, scratch);
+  }
 
-  size_t model_byte_size() const { return _model.byte_size(); }
+  /**
+   * Emits the offsets of [first, last) as a compressed bitmap of row ids,
+   * which may be intersected with those of other predicates. Offsets are
+   * bulk decoded and scattered into their chunks without sorting them, see
+   * util::RowBitmap::assign()
+   *
+   * @param scratch buffer reused across calls receiving the decoded offsets
+   *
+   * @returns amount of row ids
+   */
+  size_t row_bitmap(const PermIter &first, const PermIter &last,
+                    util::RowBitmap &out,
+                    std::vector<std::uint64_t> &scratch) const {
+    const size_t n = last._index - first._index;
+    scratch.resize(n);
+    if (n > 0) _perm_vector.decode(first._index, n, scratch.data());
+    out.assign(scratch.data(), n);
+    return n;
+  }
+
+  /// row_bitmap() with a temporary scratch buffer
+  size_t row_bitmap(const PermIter &first, const PermIter &last,
+                    util::RowBitmap &out) const {
+    std::vector<std::uint64_t> scratch;
+    return row_bitmap(first, last, out, scratch);
+  }
+
+  /// Stats recorded by lookups of the calling thread which were not provided
+  /// with caller owned stats
+  static const util::LookupStats &thread_stats() {
+    return Instrumentation::thread_stats();
+  }
+
+  /// Time spent in each phase of the last fit(), fit_external() or
+  /// fit_sorted() call. Phases fit_sorted() skips, i.e., sorting, are zero
+  const util::BuildStats &build_stats() const { return _build_stats; }
+
+  size_t model_byte_size() const {
+    return _model.byte_size() + _error_buckets.size() * sizeof(size_t) +
+           (run_boundaries ? _runs.byte_size() : 0) +
+           _samples.size() * sizeof(util::ordered_key_t<Key>) +
+           _prefixes.byte_size();
+  }
 
   size_t perm_vector_byte_size() const { return _perm_vector.byte_size(); }
 
+  size_t filter_byte_size() const { return _filter.byte_size(); }
+
   /// Computes total index size in bytes
   size_t byte_size() const {
-    return sizeof(max_error) + model_byte_size() + perm_vector_byte_size();
+    return sizeof(max_error) + model_byte_size() + perm_vector_byte_size() +
+           filter_byte_size();
   }
 
   static std::string name() {
     return "LSI<" + Model::name() + ", " + std::to_string(fingerprint_size) +
-           ", " + std::to_string(force_linear_search) + ">";
+           ", " + std::to_string(force_linear_search) +
+           (error_bucket_size > 0 ? ", " + std::to_string(error_bucket_size)
+                                  : "") +
+           (std::is_same_v<PermStorage, util::SeparateStorage>
+                ? ""
+                : ", " + PermStorage::name()) +
+           (std::is_same_v<Instrumentation, util::CountingInstrumentation>
+                ? ""
+                : ", " + Instrumentation::name()) +
+           (run_boundaries ? ", runs" : "") +
+           (std::is_same_v<FingerprintHash,
+                           hashing::MurmurFinalizer<util::ordered_key_t<Key>>>
+                ? ""
+                : ", " + FingerprintHash::name()) +
+           (std::is_same_v<Filter, util::NoFilter> ? ""
+                                                   : ", " + Filter::name()) +
+           (key_sample_rate > 0
+                ? ", sampled" + std::to_string(key_sample_rate)
+                : "") +
+           (key_prefix_bits > 0
+                ? ", prefix" + std::to_string(key_prefix_bits)
+                : "") +
+           ">";
   }
 };
 }  // namespace learned_secondary_index
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "convenience/builtins.hpp"
+#include "lsi.hpp"
+#include "util/instrumentation.hpp"
+#include "util/parallel.hpp"
+
+namespace learned_secondary_index {
+/**
+ * Range partitioned learned secondary index. The key space is split into
+ * independent shards, each with its own model, permutation vector and max
+ * error. A small root router of splitter keys forwards lookups to the
+ * responsible shard. Smaller shards typically exhibit smaller model errors,
+ * can be built in parallel and are placed on different NUMA nodes.
+ *
+ * @tparam Key key type
+ * @tparam Index learned secondary index used for every shard. Must provide
+ * fit_sorted(), see LearnedSecondaryIndex
+ */
+template <class Key, class Index = LearnedSecondaryIndex<Key>>
+class ShardedLearnedSecondaryIndex {
+  using DisplacementVector = typename Index::DisplacementVector;
+
+  /// _splitters[s] is the smallest key of shard s + 1
+  std::vector<Key> _splitters;
+
+  /// shards are never moved after their build to retain placement
+  std::vector<std::unique_ptr<Index>> _shards;
+
+  size_t _shard_count;
+  bool _place_shards;
+
+  /// shards whose build thread was pinned to their NUMA node's cpus
+  size_t _placed_shards = 0;
+
+ public:
+  static constexpr size_t default_shard_count = 16;
+
+  /**
+   * Lookup result, i.e., position within a shard. Incrementing
+   * continues with the subsequent shard once a shard is exhausted.
+   * Dereferencing yields an offset into the base data
+   */
+  class Iter {
+    const ShardedLearnedSecondaryIndex *_sharded;
+    size_t _shard;
+    size_t _pos;
+
+    Iter(const ShardedLearnedSecondaryIndex *sharded, const size_t shard,
+         const size_t pos)
+        : _sharded(sharded), _shard(shard), _pos(pos) {}
+
+   public:
+    using value_type = size_t;
+
+    /// Obtain offset into original data [begin, end)
+    value_type operator*() const {
+      return *(_sharded->_shards[_shard]->begin() + _pos);
+    }
+
+    // Prefix increment
+    Iter &operator++() {
+      const auto &shard = *_sharded->_shards[_shard];
+      if (++_pos == static_cast<size_t>(shard.end() - shard.begin()) &&
+          _shard + 1 < _sharded->_shards.size()) {
+        _shard++;
+        _pos = 0;
+      }
+      return *this;
+    }
+
+    // Postfix increment
+    Iter operator++(int) {
+      Iter tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+
+    friend bool operator==(const Iter &a, const Iter &b) {
+      return a._shard == b._shard && a._pos == b._pos;
+    }
+
+    friend bool operator!=(const Iter &a, const Iter &b) {
+      return !(a == b);  // NOLINT
+    }
+
+    friend ShardedLearnedSecondaryIndex;
+  };
+
+  /**
+   * Constructs an empty index
+   *
+   * @param shard_count desired amount of shards. Fewer shards are built if
+   * the data does not contain enough distinct keys
+   * @param place_shards whether to build shard s on the cpus of NUMA node
+   * s % nodes, which places shards round robin across all NUMA nodes of the
+   * machine, see util::numa_nodes()
+   */
+  explicit ShardedLearnedSecondaryIndex(
+      const size_t shard_count = default_shard_count,
+      const bool place_shards = true)
+      : _shard_count(std::max<size_t>(shard_count, 1)),
+        _place_shards(place_shards) {}
+
+  template <class It>
+  ShardedLearnedSecondaryIndex(const It &begin, const It &end,
+                               const size_t threads = 1,
+                               const size_t shard_count = default_shard_count,
+                               const bool place_shards = true)
+      : ShardedLearnedSecondaryIndex(shard_count, place_shards) {
+    fit(begin, end, threads);
+  }
+
+  /**
+   * Partitions [begin, end) into key ranges of roughly equal size and builds
+   * one shard per range. All rows of a key are assigned to the same shard.
+   *
+   * @param begin start of data to index
+   * @param end past-the-end of data to index
+   * @param threads amount of threads used for sorting and building shards.
+   * Shards are built concurrently, surplus threads assist each shard's build
+   */
+  template <class It>
+  void fit(const It &begin, const It &end, const size_t threads = 1) {
+    const size_t n = std::distance(begin, end);
+
+    DisplacementVector data(n);
+    util::parallel_for(n, threads, [&](size_t, size_t b, size_t e) {
+      for (size_t i = b; i < e; i++) data[i] = std::make_pair(*(begin + i), i);
+    });
+    util::parallel_sort(
+        data.begin(), data.end(),
+        [](const auto &d1, const auto &d2) { return d1.first < d2.first; },
+        threads);
+
+    // split at quantiles, moved to the start of their run of duplicates
+    std::vector<size_t> bounds{0};
+    for (size_t s = 1; s < _shard_count && n > 0; s++) {
+      const auto quantile = data.begin() + s * n / _shard_count;
+      const size_t bound =
+          std::lower_bound(
+              data.begin() + bounds.back(), quantile, quantile->first,
+              [](const auto &d, const Key &k) { return d.first < k; }) -
+          data.begin();
+      if (bound > bounds.back()) bounds.push_back(bound);
+    }
+    bounds.push_back(n);
+
+    const size_t shards = n > 0 ? bounds.size() - 1 : 0;
+    _splitters.clear();
+    for (size_t s = 1; s < shards; s++)
+      _splitters.push_back(data[bounds[s]].first);
+
+    _shards.clear();
+    _shards.resize(shards);
+    _placed_shards = 0;
+    if (shards == 0) return;
+
+    // always build on fresh threads, i.e., never pin the calling thread
+    const auto worker_bounds =
+        util::chunk_bounds(shards, std::max<size_t>(threads, 1));
+    const size_t shard_threads = std::max<size_t>(threads / shards, 1);
+    const auto nodes =
+        _place_shards ? util::numa_nodes() : std::vector<std::vector<size_t>>{};
+    std::atomic<size_t> placed = 0;
+    std::vector<std::thread> workers;
+    workers.reserve(worker_bounds.size() - 1);
+    for (size_t c = 0; c + 1 < worker_bounds.size(); c++) {
+      workers.emplace_back([&, c]() {
+        for (size_t s = worker_bounds[c]; s < worker_bounds[c + 1]; s++) {
+          if (_place_shards && util::pin_thread(nodes[s % nodes.size()]))
+            placed++;
+
+          auto shard = std::make_unique<Index>();
+          shard->fit_sorted(data.begin() + bounds[s],
+                            data.begin() + bounds[s + 1], shard_threads);
+          _shards[s] = std::move(shard);
+        }
+      });
+    }
+    for (auto &worker : workers) worker.join();
+    _placed_shards = placed;
+  }
+
+  /// Shard responsible for key
+  [[nodiscard]] size_t shard_of(const Key &key) const {
+    return std::upper_bound(_splitters.begin(), _splitters.end(), key) -
+           _splitters.begin();
+  }
+
+  /**
+   * Lookup key in range [begin, end), which must be the data the index was
+   * fitted on. Routes to the responsible shard and delegates.
+   *
+   * @tparam lowerbound whether to perform a lowerbound or equality lookup
+   * @param stats receives lookup statistics of the responsible shard
+   *
+   * @returns iterator yielding the offset of the first row with key
+   * (lowerbound = false) or of the row with the smallest key not less than
+   * key (lowerbound = true), end() if there is no such row
+   */
+  template <bool lowerbound, class It>
+  Iter lookup(const It &begin, const It &end, const Key &key,
+              util::LookupStats &stats =
+                  Index::instrumentation::thread_stats()) const {
+    if (unlikely(_shards.empty())) return this->end();
+
+    const auto s = shard_of(key);
+    const auto &shard = *_shards[s];
+    const auto iter = shard.template lookup<lowerbound>(begin, end, key, stats);
+    if (iter != shard.end()) return Iter(this, s, iter - shard.begin());
+
+    // lower bound is the subsequent shard's smallest key, if any
+    if (lowerbound && s + 1 < _shards.size()) return Iter(this, s + 1, 0);
+    return this->end();
+  }
+
+  /// Iterator on the smallest key's offset
+  Iter begin() const { return Iter(this, 0, 0); }
+
+  /// Past-the-end iterator
+  Iter end() const {
+    if (_shards.empty()) return begin();
+    const auto &last = *_shards.back();
+    return Iter(this, _shards.size() - 1, last.end() - last.begin());
+  }
+
+  /// Amount of shards actually built
+  [[nodiscard]] size_t shard_count() const { return _shards.size(); }
+
+  /// Amount of shards built on their NUMA node's cpus. Less than
+  /// shard_count() if placement was disabled or pinning a build thread
+  /// failed, in which case that shard's pages land wherever it ran
+  [[nodiscard]] size_t placed_shards() const { return _placed_shards; }
+
+  [[nodiscard]] const Index &shard(const size_t s) const {
+    return *_shards[s];
+  }
+
+  /// Stats recorded by lookups of the calling thread which were not provided
+  /// with caller owned stats
+  static const util::LookupStats &thread_stats() {
+    return Index::thread_stats();
+  }
+
+  size_t model_byte_size() const {
+    size_t bytes = _splitters.size() * sizeof(Key);
+    for (const auto &shard : _shards) bytes += shard->model_byte_size();
+    return bytes;
+  }
+
+  size_t perm_vector_byte_size() const {
+    size_t bytes = 0;
+    for (const auto &shard : _shards) bytes += shard->perm_vector_byte_size();
+    return bytes;
+  }
+
+  /// Computes total index size in bytes
+  size_t byte_size() const {
+    size_t bytes = _splitters.size() * sizeof(Key);
+    for (const auto &shard : _shards) bytes += shard->byte_size();
+    return bytes;
+  }
+
+  static std::string name() { return "Sharded<" + Index::name() + ">"; }
+};
+}  // namespace learned_secondary_index
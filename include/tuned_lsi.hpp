@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <learned_hashing.hpp>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "convenience/builtins.hpp"
+#include "lsi.hpp"
+#include "util/instrumentation.hpp"
+#include "util/ordered_key.hpp"
+#include "util/tuner.hpp"
+
+namespace learned_secondary_index {
+/// Compile time list of index configurations to tune among
+template <class... Indices>
+struct Candidates {};
+
+/// Spans the model error / fingerprint size trade-off of the EXP_4 and EXP_5
+/// heatmaps, i.e., small & fast to large & slow models with and without
+/// fingerprints
+template <class Key>
+using DefaultCandidates = Candidates<
+    LearnedSecondaryIndex<
+        Key, learned_hashing::TrieSplineHash<util::ordered_key_t<Key>, 16>, 0>,
+    LearnedSecondaryIndex<
+        Key, learned_hashing::TrieSplineHash<util::ordered_key_t<Key>, 16>, 8>,
+    LearnedSecondaryIndex<
+        Key, learned_hashing::TrieSplineHash<util::ordered_key_t<Key>, 64>, 0>,
+    LearnedSecondaryIndex<
+        Key, learned_hashing::TrieSplineHash<util::ordered_key_t<Key>, 64>, 8>,
+    LearnedSecondaryIndex<
+        Key, learned_hashing::TrieSplineHash<util::ordered_key_t<Key>, 256>, 0>,
+    LearnedSecondaryIndex<
+        Key, learned_hashing::TrieSplineHash<util::ordered_key_t<Key>, 256>, 4>,
+    LearnedSecondaryIndex<
+        Key, learned_hashing::TrieSplineHash<util::ordered_key_t<Key>, 1024>,
+        0>,
+    LearnedSecondaryIndex<
+        Key, learned_hashing::TrieSplineHash<util::ordered_key_t<Key>, 1024>,
+        2>>;
+
+template <class Key, class It = typename std::vector<Key>::const_iterator,
+          class CandidateList = DefaultCandidates<Key>>
+class TunedLearnedSecondaryIndex;
+
+/**
+ * Learned secondary index whose configuration is chosen at fit() time.
+ * Every candidate is built on a uniform random sample of the keys and its
+ * size and lookup latency on the full data are predicted from the sample's
+ * model size, search windows and base data accesses, see
+ * util::estimate_candidate(). The candidate best meeting util::TunerOptions'
+ * memory budget or latency target is then built on all keys behind a type
+ * erased facade, i.e., lookups pay one virtual call.
+ *
+ * @tparam Key key type
+ * @tparam It iterator type of the base data passed to fit() and lookups.
+ * Fixed at compile time since virtual functions can't be templates
+ * @tparam CandidateList Candidates<...> of LearnedSecondaryIndex
+ * configurations with util::CountingInstrumentation
+ */
+template <class Key, class It, class... Indices>
+class TunedLearnedSecondaryIndex<Key, It, Candidates<Indices...>> {
+  static_assert(sizeof...(Indices) > 0, "at least one candidate is required");
+
+  /// Type erased interface of the chosen candidate
+  struct Variant {
+    virtual ~Variant() = default;
+
+    virtual void fit(const It &begin, const It &end, size_t threads) = 0;
+    /// position of the lookup result within the permutation vector
+    virtual size_t lookup(const It &begin, const It &end, const Key &key,
+                          bool lowerbound, util::LookupStats &stats) const = 0;
+    virtual size_t offset(size_t pos) const = 0;
+    virtual size_t size() const = 0;
+    virtual size_t model_byte_size() const = 0;
+    virtual size_t perm_vector_byte_size() const = 0;
+    virtual size_t byte_size() const = 0;
+    virtual std::string name() const = 0;
+  };
+
+  template <class Index>
+  struct Holder final : Variant {
+    Index index;
+
+    void fit(const It &begin, const It &end, const size_t threads) override {
+      index.fit(begin, end, threads);
+    }
+    size_t lookup(const It &begin, const It &end, const Key &key,
+                  const bool lowerbound,
+                  util::LookupStats &stats) const override {
+      const auto it =
+          lowerbound
+              ? index.template lookup<true>(begin, end, key, stats)
+              : index.template lookup<false>(begin, end, key, stats);
+      return it - index.begin();
+    }
+    size_t offset(const size_t pos) const override {
+      return *(index.begin() + pos);
+    }
+    size_t size() const override { return index.end() - index.begin(); }
+    size_t model_byte_size() const override { return index.model_byte_size(); }
+    size_t perm_vector_byte_size() const override {
+      return index.perm_vector_byte_size();
+    }
+    size_t byte_size() const override { return index.byte_size(); }
+    std::string name() const override { return Index::name(); }
+  };
+
+  util::TunerOptions _options;
+  std::vector<util::CandidateEstimate> _estimates;
+  size_t _chosen = 0;
+  std::unique_ptr<Variant> _variant;
+
+ public:
+  /**
+   * Lookup result, i.e., position within the chosen candidate's permutation
+   * vector. Dereferencing yields an offset into the base data
+   */
+  class Iter {
+    const Variant *_variant;
+    size_t _pos;
+
+    Iter(const Variant *variant, const size_t pos)
+        : _variant(variant), _pos(pos) {}
+
+   public:
+    using value_type = size_t;
+
+    /// Obtain offset into original data [begin, end)
+    value_type operator*() const { return _variant->offset(_pos); }
+
+    // Prefix increment
+    Iter &operator++() {
+      _pos++;
+      return *this;
+    }
+
+    // Postfix increment
+    Iter operator++(int) {
+      Iter tmp = *this;
+      ++(*this);
+      return tmp;
+    }
+
+    friend std::ptrdiff_t operator-(const Iter &a, const Iter &b) {
+      return static_cast<std::ptrdiff_t>(a._pos - b._pos);
+    }
+
+    friend bool operator==(const Iter &a, const Iter &b) {
+      return a._pos == b._pos && a._variant == b._variant;
+    }
+
+    friend bool operator!=(const Iter &a, const Iter &b) {
+      return !(a == b);  // NOLINT
+    }
+
+    friend TunedLearnedSecondaryIndex;
+  };
+
+  /// Constructs an empty index tuned according to options on fit()
+  explicit TunedLearnedSecondaryIndex(util::TunerOptions options = {})
+      : _options(options) {}
+
+  TunedLearnedSecondaryIndex(const It &begin, const It &end,
+                             const size_t threads = 1,
+                             util::TunerOptions options = {})
+      : TunedLearnedSecondaryIndex(options) {
+    fit(begin, end, threads);
+  }
+
+  /**
+   * Estimates every candidate on a sample of [begin, end), chooses one
+   * according to the tuner options and builds it on all of [begin, end)
+   *
+   * @param threads amount of threads used for building the chosen
+   * candidate, see LearnedSecondaryIndex::fit(). Candidates are estimated
+   * single threaded
+   */
+  void fit(const It &begin, const It &end, const size_t threads = 1) {
+    const size_t n = std::distance(begin, end);
+
+    // uniform random sample with replacement, i.e., including duplicates
+    std::vector<Key> sample;
+    if (n <= _options.sample_size) {
+      sample.assign(begin, end);
+    } else {
+      std::mt19937_64 rng(_options.seed);
+      std::uniform_int_distribution<size_t> dist(0, n - 1);
+      sample.reserve(_options.sample_size);
+      for (size_t i = 0; i < _options.sample_size; i++)
+        sample.push_back(*(begin + dist(rng)));
+    }
+    std::sort(sample.begin(), sample.end());
+
+    _estimates.clear();
+    (_estimates.push_back(
+         util::estimate_candidate<Indices>(sample, n, _options)),
+     ...);
+    _chosen = util::select_candidate(_estimates, _options);
+
+    // instantiate the chosen candidate at runtime
+    using Factory = std::unique_ptr<Variant> (*)();
+    static constexpr std::array<Factory, sizeof...(Indices)> factories = {
+        +[]() -> std::unique_ptr<Variant> {
+          return std::make_unique<Holder<Indices>>();
+        }...};
+    _variant = factories[_chosen]();
+    _variant->fit(begin, end, threads);
+  }
+
+  /**
+   * Lookup key in range [begin, end), see LearnedSecondaryIndex::lookup()
+   *
+   * @throws std::logic_error if the index was not fitted
+   */
+  template <bool lowerbound>
+  Iter lookup(const It &begin, const It &end, const Key &key,
+              util::LookupStats &stats =
+                  util::CountingInstrumentation::thread_stats()) const {
+    if (unlikely(_variant == nullptr))
+      throw std::logic_error("TunedLearnedSecondaryIndex is not fitted");
+    return Iter(_variant.get(),
+                _variant->lookup(begin, end, key, lowerbound, stats));
+  }
+
+  Iter begin() const { return Iter(_variant.get(), 0); }
+
+  Iter end() const {
+    return Iter(_variant.get(), _variant == nullptr ? 0 : _variant->size());
+  }
+
+  /// Predictions of all candidates of the last fit(), in CandidateList order
+  const std::vector<util::CandidateEstimate> &estimates() const {
+    return _estimates;
+  }
+
+  /// Index of the chosen candidate within CandidateList
+  size_t chosen() const { return _chosen; }
+
+  size_t model_byte_size() const {
+    return _variant == nullptr ? 0 : _variant->model_byte_size();
+  }
+
+  size_t perm_vector_byte_size() const {
+    return _variant == nullptr ? 0 : _variant->perm_vector_byte_size();
+  }
+
+  size_t byte_size() const {
+    return _variant == nullptr ? 0 : _variant->byte_size();
+  }
+
+  /// Name of the chosen candidate
+  std::string name() const {
+    return "Tuned<" + (_variant == nullptr ? "" : _variant->name()) + ">";
+  }
+};
+}  // namespace learned_secondary_index
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <tlx/container.hpp>
+#include <utility>
+#include <vector>
+
+#include "convenience/builtins.hpp"
+#include "lsi.hpp"
+
+namespace learned_secondary_index {
+/**
+ * Updatable wrapper around a (build once) learned secondary index for append
+ * mostly relations. Newly appended rows are indexed in a small, sorted delta
+ * btree. Once the delta exceeds a threshold, the learned index is rebuilt on
+ * the entire relation in a background thread while lookups and appends
+ * continue to be served by the previous learned index and the delta.
+ *
+ * @tparam Key key type
+ * @tparam Index learned secondary index responsible for the bulk of the data
+ */
+template <class Key, class Index = LearnedSecondaryIndex<Key>>
+class UpdatableLearnedSecondaryIndex {
+  using Delta = tlx::btree_multimap<Key, size_t>;
+  using IndexIter = decltype(std::declval<const Index &>().begin());
+  using DeltaIter = typename Delta::const_iterator;
+
+  /// learned index on rows [0, _indexed)
+  std::unique_ptr<Index> _index = std::make_unique<Index>();
+  size_t _indexed = 0;
+
+  /// all rows inserted since _index was built
+  Delta _delta;
+
+  /// rows [0, _appended) are indexed, i.e., where append() continues
+  size_t _appended = 0;
+  /// offsets >= _appended already indexed via insert(), which append() skips
+  std::set<size_t> _ahead;
+
+  /// rebuild once _delta contains this many entries
+  size_t _merge_threshold;
+  size_t _threads;
+
+  /// background rebuild on rows [0, _pending_indexed), if any
+  std::future<std::unique_ptr<Index>> _pending;
+  size_t _pending_indexed = 0;
+
+ public:
+  static constexpr size_t default_merge_threshold = 0x1LLU << 16;
+
+  /**
+   * Lookup result, i.e., either points into the learned index or into the
+   * delta. Dereferencing yields an offset into the base data
+   */
+  class Iter {
+    IndexIter _index_iter;
+    DeltaIter _delta_iter;
+    bool _in_delta;
+
+    Iter(IndexIter index_iter, DeltaIter delta_iter, bool in_delta)
+        : _index_iter(index_iter),
+          _delta_iter(delta_iter),
+          _in_delta(in_delta) {}
+
+   public:
+    using value_type = size_t;
+
+    /// Obtain offset into original data [begin, end)
+    value_type operator*() const {
+      return _in_delta ? _delta_iter->second : *_index_iter;
+    }
+
+    friend bool operator==(const Iter &a, const Iter &b) {
+      return a._in_delta == b._in_delta &&
+             (a._in_delta ? a._delta_iter == b._delta_iter
+                          : a._index_iter == b._index_iter);
+    }
+
+    friend bool operator!=(const Iter &a, const Iter &b) {
+      return !(a == b);  // NOLINT
+    }
+
+    friend UpdatableLearnedSecondaryIndex;
+  };
+
+  explicit UpdatableLearnedSecondaryIndex(
+      const size_t merge_threshold = default_merge_threshold,
+      const size_t threads = 1)
+      : _merge_threshold(merge_threshold), _threads(threads) {}
+
+  template <class It>
+  UpdatableLearnedSecondaryIndex(
+      const It &begin, const It &end,
+      const size_t merge_threshold = default_merge_threshold,
+      const size_t threads = 1)
+      : _merge_threshold(merge_threshold), _threads(threads) {
+    fit(begin, end);
+  }
+
+  ~UpdatableLearnedSecondaryIndex() {
+    if (_pending.valid()) _pending.wait();
+  }
+
+  UpdatableLearnedSecondaryIndex(const UpdatableLearnedSecondaryIndex &) =
+      delete;
+  UpdatableLearnedSecondaryIndex &operator=(
+      const UpdatableLearnedSecondaryIndex &) = delete;
+
+  /// (Re)builds the learned index on [begin, end) and clears the delta
+  template <class It>
+  void fit(const It &begin, const It &end) {
+    if (_pending.valid()) _pending.wait();
+    _pending = {};
+
+    _index = std::make_unique<Index>(begin, end, _threads);
+    _indexed = std::distance(begin, end);
+    _delta.clear();
+    _appended = _indexed;
+    _ahead.clear();
+  }
+
+  /**
+   * Indexes rows appended to the base data since the previous call, i.e.,
+   * [begin + appended(), end), skipping rows already indexed via insert().
+   * Triggers a background rebuild on [begin, end) once the delta grows
+   * beyond the merge threshold. While a rebuild is pending, rows [begin,
+   * end) must neither move nor change, e.g., reserve() vectors
+   */
+  template <class It>
+  void append(const It &begin, const It &end) {
+    const size_t n = std::distance(begin, end);
+    for (; _appended < n; _appended++) {
+      if (!_ahead.empty() && *_ahead.begin() == _appended) {
+        _ahead.erase(_ahead.begin());
+        continue;
+      }
+      _delta.insert2(*(begin + _appended), _appended);
+    }
+
+    try_finish_merge();
+    if (!_pending.valid() && _delta.size() >= _merge_threshold)
+      merge_async(begin, end);
+  }
+
+  /**
+   * Indexes a single (key, offset) pair. Offsets may leave gaps, which are
+   * filled by subsequent insert() or append() calls
+   *
+   * @throws std::invalid_argument if offset is already indexed
+   */
+  void insert(const Key &key, const size_t offset) {
+    if (offset < _appended || _ahead.count(offset) > 0)
+      throw std::invalid_argument("offset " + std::to_string(offset) +
+                                  " is already indexed");
+
+    _delta.insert2(key, offset);
+    if (offset > _appended) {
+      _ahead.insert(offset);
+      return;
+    }
+    for (_appended++; !_ahead.empty() && *_ahead.begin() == _appended;
+         _appended++)
+      _ahead.erase(_ahead.begin());
+  }
+
+  /**
+   * Starts rebuilding the learned index on [begin, end) in the background.
+   * Has no effect if a rebuild is already pending. Rows [begin, end) must
+   * neither move nor change until the rebuild is finished
+   */
+  template <class It>
+  void merge_async(const It &begin, const It &end) {
+    if (_pending.valid()) return;
+
+    _pending_indexed = std::distance(begin, end);
+    _pending = std::async(std::launch::async, [begin, end,
+                                               threads = _threads]() {
+      return std::make_unique<Index>(begin, end, threads);
+    });
+  }
+
+  /// Installs a finished background rebuild, if any. Never blocks.
+  /// @returns whether a rebuild was installed
+  bool try_finish_merge() {
+    if (!_pending.valid() || _pending.wait_for(std::chrono::seconds(0)) !=
+                                 std::future_status::ready)
+      return false;
+
+    finish_merge();
+    return true;
+  }
+
+  /// Blocks until a pending background rebuild finishes and installs it
+  void finish_merge() {
+    if (!_pending.valid()) return;
+
+    _index = _pending.get();
+    _indexed = _pending_indexed;
+    if (_appended < _indexed) _appended = _indexed;
+    _ahead.erase(_ahead.begin(), _ahead.lower_bound(_appended));
+
+    // drop delta entries now covered by the learned index. Survivors remain
+    // sorted, i.e., may be bulk loaded into a fresh delta
+    std::vector<std::pair<Key, size_t>> survivors;
+    for (const auto &entry : _delta)
+      if (entry.second >= _indexed) survivors.push_back(entry);
+    _delta.clear();
+    _delta.bulk_load(survivors.begin(), survivors.end());
+  }
+
+  /// Rebuilds the learned index on [begin, end) synchronously
+  template <class It>
+  void merge(const It &begin, const It &end) {
+    if (_pending.valid()) finish_merge();
+    merge_async(begin, end);
+    finish_merge();
+  }
+
+  /**
+   * Lookup key in range [begin, end), which must contain at least all rows
+   * indexed so far.
+   *
+   * @tparam lowerbound whether to perform a lowerbound or equality lookup
+   *
+   * @returns iterator yielding the offset of a row with key (lowerbound =
+   * false) or of the row with the smallest key not less than key (lowerbound
+   * = true) across learned index and delta, end() if there is no such row
+   */
+  template <bool lowerbound, class It>
+  Iter lookup(const It &begin, const It & /*end*/, const Key &key) const {
+    const auto index_iter =
+        _indexed > 0 ? _index->template lookup<lowerbound>(
+                           begin, begin + _indexed, key)
+                     : _index->end();
+    const bool in_index = index_iter != _index->end();
+    if (!lowerbound && in_index) return {index_iter, _delta.end(), false};
+
+    const auto delta_iter = _delta.lower_bound(key);
+    const bool in_delta =
+        delta_iter != _delta.end() && (lowerbound || delta_iter->first == key);
+
+    if (in_index && (!in_delta || *(begin + *index_iter) <= delta_iter->first))
+      return {index_iter, _delta.end(), false};
+    if (in_delta) return {index_iter, delta_iter, true};
+    return end();
+  }
+
+  /// Calls fn(offset) for every row in [begin, end) whose key equals key
+  template <class It, class Fn>
+  void for_each_match(const It &begin, const It & /*end*/, const Key &key,
+                      const Fn &fn) const {
+    if (_indexed > 0) {
+      for (auto it = _index->template lookup<false>(begin, begin + _indexed,
+                                                    key);
+           it != _index->end() && *(begin + *it) == key; ++it)
+        fn(*it);
+    }
+
+    const auto [first, last] = _delta.equal_range(key);
+    for (auto it = first; it != last; ++it) fn(it->second);
+  }
+
+  /// Past-the-end lookup result
+  Iter end() const { return {_index->end(), _delta.end(), false}; }
+
+  /// Amount of indexed rows
+  [[nodiscard]] size_t size() const { return _indexed + _delta.size(); }
+
+  /// Amount of leading rows indexed without gaps, i.e., append() indexes
+  /// rows starting at this offset
+  [[nodiscard]] size_t appended() const { return _appended; }
+
+  /// Amount of rows only indexed by the delta
+  [[nodiscard]] size_t delta_size() const { return _delta.size(); }
+
+  /// Whether a background rebuild is in progress
+  [[nodiscard]] bool merge_pending() const { return _pending.valid(); }
+
+  /// Stats recorded by lookups of the calling thread which were not provided
+  /// with caller owned stats
+  static const util::LookupStats &thread_stats() {
+    return Index::thread_stats();
+  }
+
+  size_t model_byte_size() const { return _index->model_byte_size(); }
+
+  size_t perm_vector_byte_size() const {
+    return _index->perm_vector_byte_size();
+  }
+
+  size_t delta_byte_size() const {
+    const auto stats = _delta.get_stats();
+    return stats.leaves * stats.leaf_slots * sizeof(std::pair<Key, size_t>) +
+           stats.inner_nodes * stats.inner_slots * sizeof(Key) +
+           stats.inner_nodes * (stats.inner_slots + 1) * sizeof(void *);
+  }
+
+  /// Computes total index size in bytes, excluding pending rebuilds
+  size_t byte_size() const { return _index->byte_size() + delta_byte_size(); }
+
+  static std::string name() { return "Updatable<" + Index::name() + ">"; }
+};
+}  // namespace learned_secondary_index
@@ -0,0 +1,317 @@
+#pragma once
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace learned_secondary_index::util {
+/// Pages backing memory obtained from a HugePageResource
+enum class PageSize : std::uint8_t { standard, huge_2mb, huge_1gb };
+
+/**
+ * Memory resource mapping every allocation separately onto pages of the
+ * chosen size. Huge pages cover a large buffer with few TLB entries, i.e.,
+ * random probes into it mostly avoid page walks. Huge pages are first taken
+ * from the kernel's reserved pool (MAP_HUGETLB). If none are available,
+ * allocations fall back to huge page aligned standard pages advised to be
+ * backed by transparent huge pages (MADV_HUGEPAGE) instead.
+ *
+ * Allocations are rounded up to whole pages, i.e., many small buffers should
+ * rather be served by an Arena using this resource as upstream. On platforms
+ * other than Linux, allocations are served by aligned operator new.
+ */
+class HugePageResource : public std::pmr::memory_resource {
+  PageSize _page_size;
+  std::atomic<size_t> _fallbacks{0};
+
+ public:
+  explicit HugePageResource(const PageSize page_size = PageSize::huge_2mb)
+      : _page_size(page_size) {}
+
+  [[nodiscard]] PageSize page_size() const { return _page_size; }
+
+  /// Bytes per page, i.e., the granularity allocations are rounded up to
+  [[nodiscard]] size_t page_bytes() const {
+    switch (_page_size) {
+      case PageSize::huge_2mb:
+        return size_t{1} << 21;
+      case PageSize::huge_1gb:
+        return size_t{1} << 30;
+      default:
+#ifdef __linux__
+        return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+        return 4096;
+#endif
+    }
+  }
+
+  /// Amount of huge page allocations not served from the reserved pool, see
+  /// HugePageResource
+  [[nodiscard]] size_t fallbacks() const { return _fallbacks.load(); }
+
+ private:
+  [[nodiscard]] size_t mapped_bytes(const size_t bytes) const {
+    const size_t page = page_bytes();
+    return (std::max<size_t>(bytes, 1) + page - 1) / page * page;
+  }
+
+  void *do_allocate(const size_t bytes, const size_t alignment) override {
+    assert(alignment <= page_bytes());
+#ifdef __linux__
+    const size_t len = mapped_bytes(bytes);
+    if (_page_size != PageSize::standard) {
+      const int size_flag = (_page_size == PageSize::huge_2mb ? 21 : 30)
+                            << MAP_HUGE_SHIFT;
+      void *huge = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | size_flag,
+                        -1, 0);
+      if (huge != MAP_FAILED) return huge;
+      _fallbacks++;
+    }
+
+    // over map by one page to trim the mapping to a page aligned range
+    const size_t page = _page_size != PageSize::standard ? page_bytes() : 0;
+    void *raw = mmap(nullptr, len + page, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) throw std::bad_alloc();
+    if (page == 0) return raw;
+
+    auto *begin = static_cast<char *>(raw);
+    auto *aligned = reinterpret_cast<char *>(
+        (reinterpret_cast<std::uintptr_t>(begin) + page - 1) / page * page);
+    if (aligned != begin) munmap(begin, aligned - begin);
+    if (aligned + len != begin + len + page)
+      munmap(aligned + len, begin + page - aligned);
+    madvise(aligned, len, MADV_HUGEPAGE);
+    return aligned;
+#else
+    return ::operator new(bytes, std::align_val_t(alignment));
+#endif
+  }
+
+  void do_deallocate(void *p, const size_t bytes,
+                     const size_t alignment) override {
+#ifdef __linux__
+    munmap(p, mapped_bytes(bytes));
+    (void)alignment;
+#else
+    ::operator delete(p, std::align_val_t(alignment));
+#endif
+  }
+
+  [[nodiscard]] bool do_is_equal(
+      const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+/**
+ * Thread safe bump allocator serving many buffers, e.g., those of all
+ * shards or all indices of a database, from a few large chunks obtained
+ * from upstream. Buffers are never freed individually but only once the
+ * arena is destroyed, which therefore must outlive every buffer allocated
+ * from it. With a HugePageResource as upstream, small indices share huge
+ * pages instead of each rounding up to whole ones.
+ */
+class Arena : public std::pmr::memory_resource {
+  std::pmr::memory_resource *_upstream;
+  size_t _chunk_size;
+
+  struct Chunk {
+    void *data;
+    size_t size;
+  };
+
+  mutable std::mutex _mutex;
+  std::vector<Chunk> _chunks;
+  char *_cursor = nullptr;
+  size_t _remaining = 0;
+  size_t _allocated = 0;
+
+ public:
+  static constexpr size_t chunk_alignment = 64;
+
+  /**
+   * @param chunk_size bytes obtained from upstream at once. Larger requests
+   *   obtain a chunk of their own
+   * @param upstream resource chunks are allocated from, must outlive this
+   */
+  explicit Arena(
+      const size_t chunk_size = size_t{1} << 30,
+      std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+      : _upstream(upstream), _chunk_size(std::max<size_t>(chunk_size, 1)) {}
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  ~Arena() override {
+    for (const auto &chunk : _chunks)
+      _upstream->deallocate(chunk.data, chunk.size, chunk_alignment);
+  }
+
+  /// Bytes handed out so far, including alignment padding
+  [[nodiscard]] size_t allocated_bytes() const {
+    std::lock_guard lock(_mutex);
+    return _allocated;
+  }
+
+  /// Bytes obtained from upstream so far
+  [[nodiscard]] size_t reserved_bytes() const {
+    std::lock_guard lock(_mutex);
+    size_t bytes = 0;
+    for (const auto &chunk : _chunks) bytes += chunk.size;
+    return bytes;
+  }
+
+ private:
+  void *do_allocate(const size_t bytes, const size_t alignment) override {
+    assert(alignment <= chunk_alignment);
+    std::lock_guard lock(_mutex);
+
+    // oversized requests don't discard the current chunk's remainder
+    if (bytes > _chunk_size) {
+      _chunks.push_back({_upstream->allocate(bytes, chunk_alignment), bytes});
+      _allocated += bytes;
+      return _chunks.back().data;
+    }
+
+    const size_t padding =
+        (alignment - reinterpret_cast<std::uintptr_t>(_cursor) % alignment) %
+        alignment;
+    if (_cursor == nullptr || padding + bytes > _remaining) {
+      _chunks.push_back(
+          {_upstream->allocate(_chunk_size, chunk_alignment), _chunk_size});
+      _cursor = static_cast<char *>(_chunks.back().data);
+      _remaining = _chunk_size;
+    } else {
+      _cursor += padding;
+      _remaining -= padding;
+      _allocated += padding;
+    }
+
+    void *p = _cursor;
+    _cursor += bytes;
+    _remaining -= bytes;
+    _allocated += bytes;
+    return p;
+  }
+
+  void do_deallocate(void *, size_t, size_t) override {}
+
+  [[nodiscard]] bool do_is_equal(
+      const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+namespace detail {
+inline std::atomic<std::pmr::memory_resource *> &buffer_resource_ref() {
+  static std::atomic<std::pmr::memory_resource *> resource{
+      std::pmr::new_delete_resource()};
+  return resource;
+}
+}  // namespace detail
+
+/**
+ * Resource the large buffers of subsequently built indices, e.g., their
+ * packed permutation vectors, are allocated from. Defaults to
+ * std::pmr::new_delete_resource()
+ */
+inline std::pmr::memory_resource *buffer_resource() {
+  return detail::buffer_resource_ref().load();
+}
+
+/**
+ * Replaces buffer_resource() for all threads, e.g., by a HugePageResource or
+ * an Arena, which must outlive all buffers allocated from it. Buffers
+ * allocated before remain with their resource
+ *
+ * @param resource new resource, std::pmr::new_delete_resource() if nullptr
+ *
+ * @returns previous buffer_resource()
+ */
+inline std::pmr::memory_resource *set_buffer_resource(
+    std::pmr::memory_resource *resource) {
+  return detail::buffer_resource_ref().exchange(
+      resource != nullptr ? resource : std::pmr::new_delete_resource());
+}
+
+/**
+ * Zero initialized, cache line aligned bytes owned by this buffer and
+ * allocated from a memory resource. Move only, such that pointers into a
+ * buffer remain valid when it is moved.
+ */
+class Buffer {
+  std::pmr::memory_resource *_resource = nullptr;
+  char *_data = nullptr;
+  size_t _size = 0;
+
+ public:
+  static constexpr size_t alignment = 64;
+
+  Buffer() = default;
+
+  explicit Buffer(const size_t size,
+                  std::pmr::memory_resource *resource = buffer_resource())
+      : _resource(resource), _size(size) {
+    if (_size == 0) return;
+    _data = static_cast<char *>(_resource->allocate(_size, alignment));
+    std::memset(_data, 0, _size);
+  }
+
+  Buffer(Buffer &&other) noexcept
+      : _resource(std::exchange(other._resource, nullptr)),
+        _data(std::exchange(other._data, nullptr)),
+        _size(std::exchange(other._size, 0)) {}
+
+  Buffer &operator=(Buffer &&other) noexcept {
+    if (this != &other) {
+      clear();
+      _resource = std::exchange(other._resource, nullptr);
+      _data = std::exchange(other._data, nullptr);
+      _size = std::exchange(other._size, 0);
+    }
+    return *this;
+  }
+
+  Buffer(const Buffer &) = delete;
+  Buffer &operator=(const Buffer &) = delete;
+
+  ~Buffer() { clear(); }
+
+  /// Returns the bytes to their resource, leaving this buffer empty
+  void clear() {
+    if (_data != nullptr) _resource->deallocate(_data, _size, alignment);
+    _data = nullptr;
+    _size = 0;
+  }
+
+  [[nodiscard]] char *data() { return _data; }
+  [[nodiscard]] const char *data() const { return _data; }
+  [[nodiscard]] size_t size() const { return _size; }
+  [[nodiscard]] bool empty() const { return _size == 0; }
+
+  /// Resource the bytes were allocated from, nullptr if empty
+  [[nodiscard]] std::pmr::memory_resource *resource() const {
+    return _data != nullptr ? _resource : nullptr;
+  }
+};
+}  // namespace learned_secondary_index::util
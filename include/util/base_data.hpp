@@ -0,0 +1,317 @@
+#pragma once
+
+#include <bit>
+#include <compare>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../convenience/builtins.hpp"
+#include "serialization.hpp"
+
+namespace learned_secondary_index::util {
+/**
+ * Random access to base data which need not be contiguous in memory, e.g.,
+ * paged or memory-mapped columns. get(i) yields row i, prefetch(i) hints
+ * that row i will be accessed soon and gather(indices, count, out) reads
+ * count rows at once, allowing implementations to overlap their misses.
+ */
+template <class A>
+concept BaseDataAccessor = requires(const A &a, const size_t i,
+                                    const std::uint64_t *indices,
+                                    typename A::value_type *out) {
+  typename A::value_type;
+  { a.get(i) } -> std::convertible_to<typename A::value_type>;
+  a.prefetch(i);
+  a.gather(indices, i, out);
+  { a.size() } -> std::convertible_to<size_t>;
+};
+
+/**
+ * Random access iterator over the rows of a BaseDataAccessor, i.e., allows
+ * passing accessors wherever base data iterators [begin, end) are expected,
+ * e.g., to LearnedSecondaryIndex::fit() and lookup(). Lookups forward their
+ * prefetches and gathers to the accessor, see prefetch_base() and
+ * gather_base(). The accessor must outlive all of its iterators.
+ */
+template <class A>
+class AccessorIterator {
+  const A *_accessor = nullptr;
+  size_t _pos = 0;
+
+ public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = typename A::value_type;
+  using difference_type = std::ptrdiff_t;
+  using reference = decltype(std::declval<const A &>().get(0));
+  using pointer = void;
+
+  AccessorIterator() = default;
+  AccessorIterator(const A &accessor, const size_t pos)
+      : _accessor(&accessor), _pos(pos) {
+    // checked here since accessors name their iterators while incomplete
+    static_assert(BaseDataAccessor<A>, "A must be a BaseDataAccessor");
+  }
+
+  [[nodiscard]] const A &accessor() const { return *_accessor; }
+
+  /// Row index this iterator points to
+  [[nodiscard]] size_t pos() const { return _pos; }
+
+  reference operator*() const { return _accessor->get(_pos); }
+
+  reference operator[](const difference_type n) const {
+    return _accessor->get(_pos + n);
+  }
+
+  AccessorIterator &operator++() {
+    _pos++;
+    return *this;
+  }
+
+  AccessorIterator operator++(int) {
+    AccessorIterator tmp = *this;
+    ++(*this);
+    return tmp;
+  }
+
+  AccessorIterator &operator--() {
+    _pos--;
+    return *this;
+  }
+
+  AccessorIterator operator--(int) {
+    AccessorIterator tmp = *this;
+    --(*this);
+    return tmp;
+  }
+
+  AccessorIterator &operator+=(const difference_type n) {
+    _pos += n;
+    return *this;
+  }
+
+  AccessorIterator &operator-=(const difference_type n) {
+    _pos -= n;
+    return *this;
+  }
+
+  friend AccessorIterator operator+(AccessorIterator it,
+                                    const difference_type n) {
+    return it += n;
+  }
+
+  friend AccessorIterator operator+(const difference_type n,
+                                    AccessorIterator it) {
+    return it += n;
+  }
+
+  friend AccessorIterator operator-(AccessorIterator it,
+                                    const difference_type n) {
+    return it -= n;
+  }
+
+  friend difference_type operator-(const AccessorIterator &a,
+                                   const AccessorIterator &b) {
+    return static_cast<difference_type>(a._pos) -
+           static_cast<difference_type>(b._pos);
+  }
+
+  friend bool operator==(const AccessorIterator &a,
+                         const AccessorIterator &b) {
+    return a._pos == b._pos && a._accessor == b._accessor;
+  }
+
+  friend auto operator<=>(const AccessorIterator &a,
+                          const AccessorIterator &b) {
+    return a._pos <=> b._pos;
+  }
+};
+
+template <class It>
+struct is_accessor_iterator : std::false_type {};
+
+template <class A>
+struct is_accessor_iterator<AccessorIterator<A>> : std::true_type {};
+
+/**
+ * Hints that row i of base data [begin, ...) will be accessed soon. Forwards
+ * to the accessor of AccessorIterators, prefetches the row's address for
+ * iterators yielding lvalues and is a no-op otherwise
+ */
+template <class It>
+forceinline void prefetch_base(const It &begin, const size_t i) {
+  if constexpr (is_accessor_iterator<It>::value) {
+    begin.accessor().prefetch(begin.pos() + i);
+  } else if constexpr (std::is_lvalue_reference_v<decltype(*begin)>) {
+    prefetchit(&*(begin + i), 0, 3);
+  }
+}
+
+/**
+ * Reads rows indices[0, count) of base data [begin, ...) into out. Forwards
+ * to the accessor of AccessorIterators, otherwise prefetches all rows before
+ * reading any of them
+ */
+template <class It, class T>
+forceinline void gather_base(const It &begin, const std::uint64_t *indices,
+                             const size_t count, T *out) {
+  if constexpr (is_accessor_iterator<It>::value) {
+    if (begin.pos() == 0) {
+      begin.accessor().gather(indices, count, out);
+      return;
+    }
+  }
+
+  for (size_t k = 0; k < count; k++) prefetch_base(begin, indices[k]);
+  for (size_t k = 0; k < count; k++) out[k] = *(begin + indices[k]);
+}
+
+/// Accessor CRTP base providing iterators and prefetch-then-read gathers
+template <class Derived, class T>
+class AccessorBase {
+  const Derived &self() const { return static_cast<const Derived &>(*this); }
+
+ public:
+  using value_type = T;
+  using iterator = AccessorIterator<Derived>;
+
+  void gather(const std::uint64_t *indices, const size_t count,
+              T *out) const {
+    for (size_t k = 0; k < count; k++) self().prefetch(indices[k]);
+    for (size_t k = 0; k < count; k++) out[k] = self().get(indices[k]);
+  }
+
+  [[nodiscard]] iterator begin() const { return iterator(self(), 0); }
+
+  [[nodiscard]] iterator end() const { return iterator(self(), self().size()); }
+
+  decltype(auto) operator[](const size_t i) const { return self().get(i); }
+};
+
+/// Accessor on a contiguous in memory array, which must outlive it
+template <class T>
+class ContiguousColumn : public AccessorBase<ContiguousColumn<T>, T> {
+  const T *_data = nullptr;
+  size_t _size = 0;
+
+ public:
+  ContiguousColumn() = default;
+  ContiguousColumn(const T *data, const size_t size)
+      : _data(data), _size(size) {}
+
+  forceinline const T &get(const size_t i) const { return _data[i]; }
+
+  forceinline void prefetch(const size_t i) const {
+    prefetchit(_data + i, 0, 3);
+  }
+
+  [[nodiscard]] size_t size() const { return _size; }
+};
+
+/**
+ * Accessor on a column split into fixed-size pages, e.g., a paged column
+ * store's buffer frames. Locating a row takes one shift and mask plus an
+ * access to the (small, mostly cached) page table. Pages must outlive it
+ */
+template <class T>
+class PagedColumn : public AccessorBase<PagedColumn<T>, T> {
+  std::vector<const T *> _pages;
+  size_t _size = 0;
+  int _page_shift = 0;
+  size_t _page_mask = 0;
+
+ public:
+  PagedColumn() = default;
+
+  /**
+   * @param pages page i holds rows [i * page_size, (i + 1) * page_size)
+   * @param page_size rows per page, must be a power of two
+   * @param size total amount of rows, i.e., the last page may be partial
+   *
+   * @throws std::invalid_argument if page_size is not a power of two or
+   *   pages can't hold size rows
+   */
+  PagedColumn(std::vector<const T *> pages, const size_t page_size,
+              const size_t size)
+      : _pages(std::move(pages)),
+        _size(size),
+        _page_shift(std::countr_zero(page_size)),
+        _page_mask(page_size - 1) {
+    if (!std::has_single_bit(page_size))
+      throw std::invalid_argument("page size " + std::to_string(page_size) +
+                                  " is not a power of two");
+    if (_pages.size() < (size + page_size - 1) / page_size)
+      throw std::invalid_argument("too few pages for " + std::to_string(size) +
+                                  " rows");
+  }
+
+  forceinline const T &get(const size_t i) const {
+    return _pages[i >> _page_shift][i & _page_mask];
+  }
+
+  forceinline void prefetch(const size_t i) const { prefetchit(&get(i), 0, 3); }
+
+  [[nodiscard]] size_t size() const { return _size; }
+
+  [[nodiscard]] size_t page_size() const { return _page_mask + 1; }
+};
+
+/**
+ * Accessor on a column file of trivially copyable values which is mapped
+ * read-only instead of loaded, i.e., rows only occupy page cache while
+ * being accessed. Copies share the mapping
+ */
+template <class T>
+class MappedColumn : public AccessorBase<MappedColumn<T>, T> {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "only trivially copyable values may be mapped");
+
+  std::shared_ptr<const MappedFile> _file;
+  const T *_data = nullptr;
+  size_t _size = 0;
+
+ public:
+  MappedColumn() = default;
+
+  /**
+   * Maps rows [0, size) stored at byte offset of path
+   *
+   * @param size amount of rows, all rows up to the end of the file if npos
+   *
+   * @throws std::runtime_error if path can't be mapped, is too small or
+   *   offset is misaligned for T
+   */
+  explicit MappedColumn(const std::string &path, const size_t offset = 0,
+                        size_t size = std::string::npos)
+      : _file(std::make_shared<const MappedFile>(path)) {
+    if (offset % alignof(T) != 0)
+      throw std::runtime_error("misaligned column offset in '" + path + "'");
+    if (offset > _file->size())
+      throw std::runtime_error("'" + path + "' is truncated");
+
+    const size_t available = (_file->size() - offset) / sizeof(T);
+    if (size == std::string::npos) size = available;
+    if (size > available)
+      throw std::runtime_error("'" + path + "' is truncated");
+
+    _size = size;
+    _data = reinterpret_cast<const T *>(_file->data() + offset);
+  }
+
+  forceinline const T &get(const size_t i) const { return _data[i]; }
+
+  forceinline void prefetch(const size_t i) const {
+    prefetchit(_data + i, 0, 3);
+  }
+
+  [[nodiscard]] size_t size() const { return _size; }
+};
+}  // namespace learned_secondary_index::util
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <hashing.hpp>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "../convenience/builtins.hpp"
+#include "ordered_key.hpp"
+#include "parallel.hpp"
+#include "serialization.hpp"
+
+namespace learned_secondary_index::util {
+/// Filter policy which never rejects any key, i.e., compiles filtering away
+struct NoFilter {
+  template <class RandomIt>
+  void build(const RandomIt & /*first*/, const RandomIt & /*last*/,
+             const size_t /*threads*/ = 1) {}
+
+  template <class Key>
+  forceinline constexpr bool contains(const Key & /*key*/) const {
+    return true;
+  }
+
+  [[nodiscard]] size_t byte_size() const { return 0; }
+
+  void save(Writer & /*out*/) const {}
+
+  void load(Reader & /*in*/) {}
+
+  static std::string name() { return "unfiltered"; }
+
+  friend bool operator==(const NoFilter &, const NoFilter &) { return true; }
+};
+
+/**
+ * Split block bloom filter on keys: Every key maps to a single 32 byte block,
+ * i.e., a single cache line, and sets exactly one bit in each of its eight
+ * 32 bit words. A membership test therefore costs one cache miss and, with
+ * AVX2, a handful of instructions. False positive rate is roughly 2% at 8 and
+ * 0.05% at 16 bits per key.
+ *
+ * @tparam bits_per_key filter bits per distinct key
+ */
+template <size_t bits_per_key = 8>
+class BlockedBloomFilter {
+  static_assert(bits_per_key > 0, "bits_per_key must be positive");
+
+  struct alignit(32) Block {
+    std::uint32_t words[8];
+  };
+  static_assert(sizeof(Block) == 32);
+
+  /// odd multipliers spreading a 32 bit hash across words, as in Apache
+  /// Parquet's split block bloom filter
+  static constexpr std::uint32_t salt[8] = {
+      0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+      0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+  std::vector<Block> _blocks;
+
+  /// Not the fingerprint hash, i.e., filter and fingerprint false positives
+  /// are independent even if both derive from MurmurFinalizer
+  template <class Key>
+  forceinline std::uint64_t hash(const Key &key) const {
+    return hashing::MurmurFinalizer<ordered_key_t<Key>>{}(to_ordered(key)) *
+           0x9E3779B97F4A7C15LLU;
+  }
+
+  forceinline size_t block(const std::uint64_t h) const {
+    // fast range reduction of the lower 32 hash bits
+    return ((h & 0xFFFFFFFFLLU) * _blocks.size()) >> 32;
+  }
+
+ public:
+  /**
+   * Inserts all distinct keys of [first, last), which must be sorted by
+   * it->first, e.g., (key, offset) pairs. Sized to bits_per_key bits per
+   * distinct key
+   */
+  template <class RandomIt>
+  void build(const RandomIt &first, const RandomIt &last,
+             const size_t threads = 1) {
+    const size_t n = std::distance(first, last);
+    const auto is_distinct = [&](size_t i) {
+      return i == 0 || (first + i)->first != (first + i - 1)->first;
+    };
+
+    size_t distinct = 0;
+    for (size_t i = 0; i < n; i++) distinct += is_distinct(i);
+
+    _blocks.assign(
+        std::max<size_t>(1, (distinct * bits_per_key + 8 * sizeof(Block) - 1) /
+                                (8 * sizeof(Block))),
+        Block{});
+
+    // concurrent inserts may hit the same words
+    parallel_for(n, threads, [&](size_t, size_t b, size_t e) {
+      for (size_t i = b; i < e; i++) {
+        if (!is_distinct(i)) continue;
+
+        const auto h = hash((first + i)->first);
+        auto &blk = _blocks[block(h)];
+        for (size_t w = 0; w < 8; w++) {
+          const std::uint32_t bit =
+              0x1U << ((static_cast<std::uint32_t>(h >> 32) * salt[w]) >> 27);
+          if (threads > 1) {
+            std::atomic_ref<std::uint32_t>(blk.words[w])
+                .fetch_or(bit, std::memory_order_relaxed);
+          } else {
+            blk.words[w] |= bit;
+          }
+        }
+      }
+    });
+  }
+
+  /// Whether key may be contained. False positives are possible, false
+  /// negatives are not
+  template <class Key>
+  forceinline bool contains(const Key &key) const {
+    const auto h = hash(key);
+    const auto &blk = _blocks[block(h)];
+    const auto hi = static_cast<std::uint32_t>(h >> 32);
+
+#if defined(__AVX2__)
+    const __m256i vsalt = _mm256_setr_epi32(
+        static_cast<int>(salt[0]), static_cast<int>(salt[1]),
+        static_cast<int>(salt[2]), static_cast<int>(salt[3]),
+        static_cast<int>(salt[4]), static_cast<int>(salt[5]),
+        static_cast<int>(salt[6]), static_cast<int>(salt[7]));
+    const __m256i shifts = _mm256_srli_epi32(
+        _mm256_mullo_epi32(_mm256_set1_epi32(static_cast<int>(hi)), vsalt), 27);
+    const __m256i bits = _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+    const __m256i words =
+        _mm256_load_si256(reinterpret_cast<const __m256i *>(blk.words));
+    // testc: all bits set in words
+    return _mm256_testc_si256(words, bits);
+#else
+    for (size_t w = 0; w < 8; w++) {
+      const std::uint32_t bit = 0x1U << ((hi * salt[w]) >> 27);
+      if ((blk.words[w] & bit) == 0) return false;
+    }
+    return true;
+#endif
+  }
+
+  [[nodiscard]] size_t byte_size() const {
+    return _blocks.size() * sizeof(Block);
+  }
+
+  /// Serializes all blocks, see BlockedBloomFilter::load()
+  void save(Writer &out) const {
+    out.write<std::uint64_t>(_blocks.size());
+    out.write_bytes(reinterpret_cast<const char *>(_blocks.data()),
+                    byte_size());
+  }
+
+  /// Restores a filter written by save()
+  void load(Reader &in) {
+    _blocks.resize(in.read<std::uint64_t>());
+    const char *blocks = in.read_bytes(byte_size());
+    if (!_blocks.empty()) std::memcpy(_blocks.data(), blocks, byte_size());
+  }
+
+  static std::string name() {
+    return "bloom" + std::to_string(bits_per_key);
+  }
+
+  friend bool operator==(const BlockedBloomFilter &a,
+                         const BlockedBloomFilter &b) {
+    return a.byte_size() == b.byte_size() &&
+           (a._blocks.empty() ||
+            std::memcmp(a._blocks.data(), b._blocks.data(), a.byte_size()) ==
+                0);
+  }
+};
+}  // namespace learned_secondary_index::util
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <optional>
+#include <utility>
+
+namespace learned_secondary_index::util {
+/**
+ * Thread local free lists of coroutine frames in size classes of 64 bytes,
+ * such that steady state coroutine lookups don't allocate. Frames larger
+ * than max_frame_size bypass the pool. Frames freed on another thread than
+ * they were allocated on migrate to that thread's pool. Frames must not be
+ * freed during thread or program shutdown, i.e., coroutines must not be
+ * owned by objects of static or thread storage duration.
+ */
+class FramePool {
+  static constexpr size_t class_size = 64;
+  static constexpr size_t class_count = 16;
+  /// frames retained per size class at most, surplus ones are deleted
+  static constexpr size_t max_free_frames = 256;
+
+  struct Frame {
+    Frame *next;
+  };
+
+  struct FreeLists {
+    std::array<Frame *, class_count> heads{};
+    std::array<size_t, class_count> sizes{};
+
+    ~FreeLists() {
+      for (auto *head : heads) {
+        while (head != nullptr) {
+          auto *next = head->next;
+          ::operator delete(head);
+          head = next;
+        }
+      }
+    }
+  };
+
+  static FreeLists &free_lists() {
+    static thread_local FreeLists lists;
+    return lists;
+  }
+
+  static size_t size_class(const size_t bytes) {
+    return (bytes + class_size - 1) / class_size - 1;
+  }
+
+ public:
+  static constexpr size_t max_frame_size = class_size * class_count;
+
+  static void *allocate(const size_t bytes) {
+    if (bytes == 0 || bytes > max_frame_size) return ::operator new(bytes);
+
+    auto &lists = free_lists();
+    const size_t c = size_class(bytes);
+    if (auto *frame = lists.heads[c]; frame != nullptr) {
+      lists.heads[c] = frame->next;
+      lists.sizes[c]--;
+      return frame;
+    }
+    return ::operator new((c + 1) * class_size);
+  }
+
+  /// bytes must equal the size passed to allocate()
+  static void deallocate(void *frame, const size_t bytes) {
+    if (bytes == 0 || bytes > max_frame_size) {
+      ::operator delete(frame);
+      return;
+    }
+
+    auto &lists = free_lists();
+    const size_t c = size_class(bytes);
+    if (lists.sizes[c] >= max_free_frames) {
+      ::operator delete(frame);
+      return;
+    }
+    lists.heads[c] = new (frame) Frame{.next = lists.heads[c]};
+    lists.sizes[c]++;
+  }
+};
+
+/**
+ * Lazily started coroutine computing a single lookup result. Nothing is
+ * computed until the first resume(), every resume() then runs up to the next
+ * suspension point, i.e., right after a prefetch of the next dependent
+ * memory access was issued. Resuming many tasks round robin therefore
+ * overlaps their cache misses.
+ *
+ * @tparam T result type
+ */
+template <class T>
+class LookupTask {
+ public:
+  struct promise_type {
+    std::optional<T> value;
+    std::exception_ptr exception;
+
+    LookupTask get_return_object() {
+      return LookupTask(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+    void return_value(T result) { value.emplace(std::move(result)); }
+    void unhandled_exception() { exception = std::current_exception(); }
+
+    static void *operator new(const size_t bytes) {
+      return FramePool::allocate(bytes);
+    }
+    static void operator delete(void *frame, const size_t bytes) {
+      FramePool::deallocate(frame, bytes);
+    }
+  };
+
+ private:
+  std::coroutine_handle<promise_type> _handle;
+
+  explicit LookupTask(std::coroutine_handle<promise_type> handle)
+      : _handle(handle) {}
+
+ public:
+  LookupTask(LookupTask &&other) noexcept
+      : _handle(std::exchange(other._handle, nullptr)) {}
+
+  LookupTask &operator=(LookupTask &&other) noexcept {
+    if (this != &other) {
+      if (_handle) _handle.destroy();
+      _handle = std::exchange(other._handle, nullptr);
+    }
+    return *this;
+  }
+
+  LookupTask(const LookupTask &) = delete;
+  LookupTask &operator=(const LookupTask &) = delete;
+
+  ~LookupTask() {
+    if (_handle) _handle.destroy();
+  }
+
+  /// Whether the result is available, i.e., the task must not be resumed
+  [[nodiscard]] bool done() const { return _handle.done(); }
+
+  /**
+   * Advances the lookup up to its next suspension point
+   *
+   * @returns done()
+   */
+  bool resume() {
+    assert(!done());
+    _handle.resume();
+    return _handle.done();
+  }
+
+  /**
+   * Result of a done() task
+   *
+   * @throws any exception the lookup (e.g., a key comparison) threw
+   */
+  const T &result() const {
+    assert(done());
+    if (_handle.promise().exception)
+      std::rethrow_exception(_handle.promise().exception);
+    return *_handle.promise().value;
+  }
+
+  /// Resumes until done() without interleaving, then returns result()
+  const T &get() {
+    while (!done()) resume();
+    return result();
+  }
+};
+}  // namespace learned_secondary_index::util
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <queue>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "parallel.hpp"
+#include "serialization.hpp"
+
+namespace learned_secondary_index::util {
+/**
+ * Sorts (key, offset) pairs of arbitrarily large inputs within a fixed memory
+ * budget: runs of at most memory_budget bytes are sorted in memory and
+ * spilled to disk, then merged k-way into a single file which is mapped
+ * read-only. Pairs are ordered by key and then offset, i.e., the output is
+ * deterministic even in the presence of duplicates.
+ *
+ * @tparam Key trivially copyable key type
+ */
+template <class Key>
+class ExternalSorter {
+ public:
+  /// Trivially copyable stand-in for std::pair<Key, size_t>, i.e., may be
+  /// spilled and mapped as is
+  struct Pair {
+    Key first;
+    size_t second;
+  };
+  static_assert(std::is_trivially_copyable_v<Pair>,
+                "only trivially copyable keys may be spilled");
+
+ private:
+  std::string _path;
+  size_t _run_size;
+  std::vector<std::string> _runs;
+
+  std::unique_ptr<const MappedFile> _sorted;
+  size_t _size = 0;
+
+  static bool less(const Pair &a, const Pair &b) {
+    return a.first < b.first || (!(b.first < a.first) && a.second < b.second);
+  }
+
+  static void remove(const std::string &path) {
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+  }
+
+  void write(const std::string &path, const Pair *pairs, const size_t n) {
+    Writer out(path);
+    out.write_bytes(reinterpret_cast<const char *>(pairs), n * sizeof(Pair));
+  }
+
+  /// Merges all runs into _path, bounding buffered output to one run
+  void merge() {
+    std::vector<std::unique_ptr<const MappedFile>> runs;
+    std::vector<const Pair *> heads, ends;
+    for (const auto &path : _runs) {
+      runs.push_back(std::make_unique<const MappedFile>(path));
+      heads.push_back(reinterpret_cast<const Pair *>(runs.back()->data()));
+      ends.push_back(heads.back() + runs.back()->size() / sizeof(Pair));
+    }
+
+    // min heap of run indices ordered by their current head
+    const auto greater = [&](const size_t a, const size_t b) {
+      return less(*heads[b], *heads[a]);
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(
+        greater);
+    for (size_t r = 0; r < runs.size(); r++)
+      if (heads[r] != ends[r]) heap.push(r);
+
+    Writer out(_path);
+    std::vector<Pair> buffer;
+    buffer.reserve(std::min(_run_size, _size));
+    const auto flush = [&]() {
+      out.write_bytes(reinterpret_cast<const char *>(buffer.data()),
+                      buffer.size() * sizeof(Pair));
+      buffer.clear();
+    };
+
+    while (!heap.empty()) {
+      const size_t r = heap.top();
+      heap.pop();
+
+      buffer.push_back(*heads[r]);
+      if (buffer.size() == buffer.capacity()) flush();
+
+      if (++heads[r] != ends[r]) heap.push(r);
+    }
+    flush();
+
+    runs.clear();
+    for (const auto &path : _runs) remove(path);
+    _runs.clear();
+  }
+
+ public:
+  /**
+   * @param path location of the sorted output. Runs are spilled to path +
+   *   ".run<i>" if the input exceeds memory_budget
+   * @param memory_budget bytes of pairs to sort in memory at once
+   */
+  ExternalSorter(std::string path, const size_t memory_budget)
+      : _path(std::move(path)),
+        _run_size(std::max<size_t>(1, memory_budget / sizeof(Pair))) {}
+
+  ExternalSorter(const ExternalSorter &) = delete;
+  ExternalSorter &operator=(const ExternalSorter &) = delete;
+
+  /// Removes all temporary files, including the sorted output
+  ~ExternalSorter() {
+    _sorted.reset();
+    for (const auto &path : _runs) remove(path);
+    remove(_path);
+  }
+
+  /**
+   * Sorts (*(begin + i), i) for every i in [0, end - begin). Runs are
+   * generated and sorted using up to `threads` threads, the final merge is
+   * single threaded.
+   *
+   * @throws std::runtime_error if temporary files can't be written or mapped
+   */
+  template <class It>
+  void sort(const It &begin, const It &end, const size_t threads = 1) {
+    _sorted.reset();
+    _size = std::distance(begin, end);
+
+    const size_t run_cnt = (_size + _run_size - 1) / _run_size;
+    {
+      std::vector<Pair> run;
+      run.reserve(std::min(_run_size, _size));
+      for (size_t r = 0; r < _size; r += _run_size) {
+        run.resize(std::min(_run_size, _size - r));
+        parallel_for(run.size(), threads, [&](size_t, size_t b, size_t e) {
+          for (size_t i = b; i < e; i++)
+            run[i] = Pair{.first = *(begin + r + i), .second = r + i};
+        });
+        parallel_sort(run.begin(), run.end(), less, threads);
+
+        // a single run already is the sorted output
+        _runs.push_back(run_cnt == 1 ? _path
+                                     : _path + ".run" +
+                                           std::to_string(_runs.size()));
+        write(_runs.back(), run.data(), run.size());
+      }
+    }
+
+    if (run_cnt == 1) {
+      _runs.clear();
+    } else {
+      // also creates an empty output if there is no run at all
+      merge();
+    }
+
+    _sorted = std::make_unique<const MappedFile>(_path);
+  }
+
+  /// Start of the sorted pairs, valid until destruction or the next sort()
+  [[nodiscard]] const Pair *begin() const {
+    return reinterpret_cast<const Pair *>(_sorted->data());
+  }
+
+  [[nodiscard]] const Pair *end() const { return begin() + _size; }
+
+  [[nodiscard]] size_t size() const { return _size; }
+};
+}  // namespace learned_secondary_index::util
@@ -7,25 +7,95 @@
 #include <hashing.hpp>
 #include <limits>
 #include <random>
+#include <string>
+#include <type_traits>
 #include <unordered_set>
 
 #include "../convenience/builtins.hpp"
+#include "ordered_key.hpp"
+#include "simd.hpp"
 
 namespace learned_secondary_index::util {
-template <class Value, size_t fingerprint_size>
+/**
+ * Multiply-shift hashing, i.e., a single multiplication by an odd constant
+ * whose upper bits are well mixed. Considerably cheaper than
+ * hashing::MurmurFinalizer and vectorized for batches of 64 bit keys.
+ */
+template <class Key>
+struct MultiplyShift {
+  /// 2^64 / golden ratio, rounded to odd
+  static constexpr std::uint64_t multiplier = 0x9E3779B97F4A7C15LLU;
+
+  forceinline std::uint64_t operator()(const Key &key) const {
+    return static_cast<std::uint64_t>(key) * multiplier;
+  }
+
+  /// Computes out[i] = (*this)(keys[i]) for all i < n
+  void batch(const Key *keys, const size_t n, std::uint64_t *out) const {
+    if constexpr (sizeof(Key) == sizeof(std::uint64_t) &&
+                  std::is_integral_v<Key>) {
+      multiply_batch(reinterpret_cast<const std::uint64_t *>(keys), n,
+                     multiplier, out);
+    } else if constexpr (std::is_integral_v<Key>) {
+      // widen narrower keys in place, i.e., out doubles as input buffer
+      for (size_t i = 0; i < n; i++)
+        out[i] = static_cast<std::uint64_t>(keys[i]);
+      multiply_batch(out, n, multiplier, out);
+    } else {
+      for (size_t i = 0; i < n; i++) out[i] = (*this)(keys[i]);
+    }
+  }
+
+  static std::string name() { return "multiply_shift"; }
+};
+
+/**
+ * Derives fingerprint_size bit fingerprints from the upper bits of Hash,
+ * which are well mixed for multiplicative hash functions as well.
+ *
+ * @tparam Hash 64 bit hash function on util::ordered_key_t<Value>, e.g.,
+ * hashing::MurmurFinalizer or MultiplyShift. If Hash provides batch(keys, n,
+ * out) on Values, fingerprint_batch() uses it, e.g., to hash multiple keys
+ * per SIMD instruction
+ */
+template <class Value, size_t fingerprint_size,
+          class Hash = hashing::MurmurFinalizer<ordered_key_t<Value>>>
 class Fingerprinter {
   static_assert(
       fingerprint_size < 64,
       "Due to implementation limitations a maximum of 64 fingerprint bits "
       "is supported");
 
-  hashing::MurmurFinalizer<Value> _hash;
+  Hash _hash;
 
  public:
   static constexpr size_t size = fingerprint_size;
+  using value_type = Value;
 
   std::uint64_t fingerprint(const Value &v) const {
-    return _hash(v) & ((0x1LLU << fingerprint_size) - 1);
+    if constexpr (fingerprint_size == 0) {
+      return 0;
+    } else {
+      return _hash(to_ordered(v)) >> (64 - fingerprint_size);
+    }
+  }
+
+  /// Computes out[i] = fingerprint(values[i]) for all i < n
+  void fingerprint_batch(const Value *values, const size_t n,
+                         std::uint64_t *out) const {
+    if constexpr (fingerprint_size == 0) {
+      for (size_t i = 0; i < n; i++) out[i] = 0;
+    } else {
+      // batches hash Values as is, i.e., only if that equals their ordered
+      // representation hashed by fingerprint()
+      if constexpr (std::is_same_v<ordered_key_t<Value>, Value> &&
+                    requires { _hash.batch(values, n, out); }) {
+        _hash.batch(values, n, out);
+      } else {
+        for (size_t i = 0; i < n; i++) out[i] = _hash(to_ordered(values[i]));
+      }
+      for (size_t i = 0; i < n; i++) out[i] >>= 64 - fingerprint_size;
+    }
   }
 
   bool test(const Value &v, const std::uint64_t &print) const {
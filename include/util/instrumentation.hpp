@@ -0,0 +1,115 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace learned_secondary_index::util {
+/// Counters collected by instrumented lookups
+struct LookupStats {
+  size_t lookups = 0;
+  size_t base_data_accesses = 0;
+  /// base data accesses that did not yield the searched key
+  size_t false_positive_accesses = 0;
+  /// sum of search window sizes, i.e., stop_i - start_i, over all lookups
+  size_t window_size = 0;
+  /// entries whose fingerprint bits matched the searched key's
+  size_t fingerprint_hits = 0;
+  /// equality lookups rejected by the index' filter without a search
+  size_t filter_rejections = 0;
+  /// key sample entries compared while narrowing search windows
+  size_t sample_accesses = 0;
+  /// key comparisons decided by key prefixes without accessing base data
+  size_t prefix_resolutions = 0;
+
+  LookupStats &operator+=(const LookupStats &other) {
+    lookups += other.lookups;
+    base_data_accesses += other.base_data_accesses;
+    false_positive_accesses += other.false_positive_accesses;
+    window_size += other.window_size;
+    fingerprint_hits += other.fingerprint_hits;
+    filter_rejections += other.filter_rejections;
+    sample_accesses += other.sample_accesses;
+    prefix_resolutions += other.prefix_resolutions;
+    return *this;
+  }
+};
+
+/// Nanoseconds spent in each phase of building an index
+struct BuildStats {
+  /// sorting (key, offset) pairs by key
+  size_t sort_ns = 0;
+  /// training the model on sorted keys
+  size_t train_ns = 0;
+  /// first pass of PermVector::build(), which fuses the max error scan
+  size_t scan_ns = 0;
+  /// second pass of PermVector::build(), i.e., packing offsets and
+  /// fingerprints
+  size_t pack_ns = 0;
+  /// building optional structures, e.g., run boundaries, filters, key
+  /// samples and key prefixes
+  size_t auxiliary_ns = 0;
+
+  [[nodiscard]] size_t total_ns() const {
+    return sort_ns + train_ns + scan_ns + pack_ns + auxiliary_ns;
+  }
+
+  BuildStats &operator+=(const BuildStats &other) {
+    sort_ns += other.sort_ns;
+    train_ns += other.train_ns;
+    scan_ns += other.scan_ns;
+    pack_ns += other.pack_ns;
+    auxiliary_ns += other.auxiliary_ns;
+    return *this;
+  }
+};
+
+/// Adds the nanoseconds elapsed during its lifetime to *ns, if not nullptr
+class PhaseTimer {
+  size_t *_ns;
+  std::chrono::steady_clock::time_point _start;
+
+ public:
+  explicit PhaseTimer(size_t *ns)
+      : _ns(ns), _start(std::chrono::steady_clock::now()) {}
+
+  PhaseTimer(const PhaseTimer &) = delete;
+  PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+  ~PhaseTimer() {
+    if (_ns == nullptr) return;
+    *_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - _start)
+                .count();
+  }
+};
+
+/// Instrumentation policy compiling all counting away
+struct NoInstrumentation {
+  static constexpr bool enabled = false;
+
+  /// Never written to, i.e., safe to share between threads
+  static LookupStats &thread_stats() {
+    static LookupStats ignored;
+    return ignored;
+  }
+
+  static std::string name() { return "uninstrumented"; }
+};
+
+/**
+ * Instrumentation policy counting into caller owned LookupStats or, if none
+ * are provided, into stats private to the calling thread. Thread stats are
+ * shared by all indices using this policy
+ */
+struct CountingInstrumentation {
+  static constexpr bool enabled = true;
+
+  static LookupStats &thread_stats() {
+    thread_local LookupStats stats;
+    return stats;
+  }
+
+  static std::string name() { return "counting"; }
+};
+}  // namespace learned_secondary_index::util
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include "../convenience/builtins.hpp"
+#include "allocation.hpp"
+#include "ordered_key.hpp"
+#include "parallel.hpp"
+#include "serialization.hpp"
+
+namespace learned_secondary_index::util {
+/// Outcome of comparing a stored key with a searched key via its prefix
+enum class PrefixOrder : std::uint8_t { less, equal, greater, unknown };
+
+/**
+ * Truncated keys of a sorted sequence, which let lookups compare against
+ * the key at any sorted position without accessing base data. Positions are
+ * grouped into blocks of block_size sorted keys sharing a frame of
+ * reference, i.e., each position stores (key - block minimum) >> shift in
+ * as many bits as Prefix has, where shift is the smallest one fitting the
+ * block's largest difference. Since keys within a block are close, the
+ * retained bits mostly discriminate them. Comparisons are only undecided if
+ * both keys truncate to the same prefix, and are exact for blocks whose
+ * differences fit Prefix entirely.
+ *
+ * @tparam Key key type, compared in its util::OrderedKey representation
+ * @tparam Prefix unsigned integer storing a single prefix
+ */
+template <class Key, class Prefix>
+class KeyPrefixes {
+  static_assert(std::is_unsigned_v<Prefix>, "Prefix must be unsigned");
+
+  using T = ordered_key_t<Key>;
+  static constexpr size_t prefix_bits = 8 * sizeof(Prefix);
+
+  struct Block {
+    T min;
+    std::uint8_t shift;
+
+    friend bool operator==(const Block &, const Block &) = default;
+  };
+
+  std::vector<Block> _blocks;
+  /// one Prefix per position, allocated from buffer_resource() when built
+  /// and empty when loaded
+  Buffer _data;
+  /// points into _data or into the memory handed to load()
+  const Prefix *_prefixes = nullptr;
+  size_t _size = 0;
+
+  [[nodiscard]] forceinline const Prefix *prefixes() const {
+    return _prefixes;
+  }
+
+ public:
+  static constexpr size_t block_size = 64;
+
+  /**
+   * Retains prefixes of all keys of [first, last), which must be sorted by
+   * it->first, e.g., (key, offset) pairs. Blocks are encoded on up to
+   * `threads` chunks in parallel.
+   */
+  template <class RandomIt>
+  void build(const RandomIt &first, const RandomIt &last,
+             const size_t threads = 1) {
+    const size_t n = std::distance(first, last);
+    _blocks.resize((n + block_size - 1) / block_size);
+    _data = Buffer(n * sizeof(Prefix));
+    _prefixes = reinterpret_cast<const Prefix *>(_data.data());
+    _size = n;
+    auto *out = reinterpret_cast<Prefix *>(_data.data());
+
+    parallel_for(_blocks.size(), threads, [&](size_t, size_t b, size_t e) {
+      for (size_t blk = b; blk < e; blk++) {
+        const size_t begin_i = blk * block_size;
+        const size_t end_i = std::min(n, begin_i + block_size);
+
+        // keys are sorted, i.e., the block's extremes are its first and last
+        const T min = to_ordered((first + begin_i)->first);
+        const T max = to_ordered((first + end_i - 1)->first);
+        const size_t width = std::bit_width(static_cast<T>(max - min));
+        const auto shift = static_cast<std::uint8_t>(
+            width > prefix_bits ? width - prefix_bits : 0);
+
+        _blocks[blk] = {.min = min, .shift = shift};
+        for (size_t i = begin_i; i < end_i; i++)
+          out[i] = static_cast<Prefix>(
+              static_cast<T>(to_ordered((first + i)->first) - min) >> shift);
+      }
+    });
+  }
+
+  /**
+   * Compares the key at sorted position i with key
+   *
+   * @param key searched key in its util::OrderedKey representation
+   *
+   * @returns whether the key at position i is less than, equal to or
+   * greater than key, or unknown if their prefixes are indistinguishable
+   */
+  [[nodiscard]] forceinline PrefixOrder compare(const size_t i,
+                                                const T key) const {
+    const auto &block = _blocks[i / block_size];
+    if (key < block.min) return PrefixOrder::greater;
+
+    // may exceed any stored prefix, which then correctly compares less
+    const T truncated = static_cast<T>(key - block.min) >> block.shift;
+    const T prefix = prefixes()[i];
+    if (prefix < truncated) return PrefixOrder::less;
+    if (prefix > truncated) return PrefixOrder::greater;
+    return block.shift == 0 ? PrefixOrder::equal : PrefixOrder::unknown;
+  }
+
+  /// Hints that position i will be compared soon
+  forceinline void prefetch(const size_t i) const {
+    prefetchit(prefixes() + i, 0, 3);
+  }
+
+  [[nodiscard]] size_t size() const { return _size; }
+
+  [[nodiscard]] size_t byte_size() const {
+    return _blocks.size() * sizeof(Block) + _size * sizeof(Prefix);
+  }
+
+  /// Serializes blocks member by member, i.e., without Block's padding, and
+  /// the aligned prefixes, see KeyPrefixes::load()
+  void save(Writer &out) const {
+    out.write<std::uint64_t>(_blocks.size());
+    for (const auto &block : _blocks) {
+      out.write<T>(block.min);
+      out.write<std::uint8_t>(block.shift);
+    }
+    out.write<std::uint64_t>(_size);
+    out.align();
+    out.write_bytes(reinterpret_cast<const char *>(_prefixes),
+                    _size * sizeof(Prefix));
+  }
+
+  /// Restores KeyPrefixes written by save(). Prefixes point directly into
+  /// in's memory which must outlive this instance
+  void load(Reader &in) {
+    _blocks.resize(in.read<std::uint64_t>());
+    for (auto &block : _blocks) {
+      block.min = in.read<T>();
+      block.shift = in.read<std::uint8_t>();
+    }
+    _size = in.read<std::uint64_t>();
+    in.align();
+
+    _data.clear();
+    _prefixes = reinterpret_cast<const Prefix *>(
+        in.read_bytes(_size * sizeof(Prefix)));
+  }
+
+  friend bool operator==(const KeyPrefixes &a, const KeyPrefixes &b) {
+    return a._blocks == b._blocks && a._size == b._size &&
+           (a._size == 0 || std::memcmp(a.prefixes(), b.prefixes(),
+                                        a._size * sizeof(Prefix)) == 0);
+  }
+};
+}  // namespace learned_secondary_index::util
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <compare>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "../convenience/builtins.hpp"
+
+namespace learned_secondary_index::util {
+/**
+ * Fixed width string key, e.g., a short prefix of a string column. Shorter
+ * strings are zero padded, longer strings are truncated. Compares
+ * lexicographically by unsigned bytes, i.e., like std::memcmp.
+ *
+ * @tparam width amount of bytes, at most 8
+ */
+template <size_t width>
+struct FixedString {
+  static_assert(width > 0 && width <= 8,
+                "FixedString supports between 1 and 8 bytes");
+
+  std::array<unsigned char, width> bytes{};
+
+  FixedString() = default;
+
+  explicit FixedString(const std::string_view s) {
+    std::memcpy(bytes.data(), s.data(), std::min(width, s.size()));
+  }
+
+  /// String without zero padding
+  [[nodiscard]] std::string str() const {
+    const auto end = std::find(bytes.begin(), bytes.end(), 0);
+    return std::string(bytes.begin(), end);
+  }
+
+  friend auto operator<=>(const FixedString &, const FixedString &) = default;
+};
+
+/**
+ * Order preserving mapping of Key to an unsigned integer representation
+ * `type`, i.e., a < b iff to(a) < to(b). Models are trained on and hash
+ * functions are applied to this representation, which lets every key type
+ * with a specialization be indexed like an unsigned integer of the same
+ * width. Specializations exist for integers, floating point numbers (except
+ * NaN) and FixedString.
+ */
+template <class Key>
+struct OrderedKey;
+
+template <std::unsigned_integral Key>
+struct OrderedKey<Key> {
+  using type = Key;
+
+  static constexpr type to(const Key key) { return key; }
+  static constexpr Key from(const type u) { return u; }
+};
+
+/// Flips the sign bit, i.e., maps [min, max] to [0, 2 * max + 1]
+template <std::signed_integral Key>
+struct OrderedKey<Key> {
+  using type = std::make_unsigned_t<Key>;
+  static constexpr type sign = type{1} << (8 * sizeof(Key) - 1);
+
+  static constexpr type to(const Key key) {
+    return static_cast<type>(key) ^ sign;
+  }
+  static constexpr Key from(const type u) { return static_cast<Key>(u ^ sign); }
+};
+
+/// Flips all bits of negative and the sign bit of positive numbers. -0.0 is
+/// mapped like 0.0 as both compare equal
+template <std::floating_point Key>
+struct OrderedKey<Key> {
+  static_assert(sizeof(Key) == 4 || sizeof(Key) == 8,
+                "only IEEE 754 single and double precision are supported");
+
+  using type =
+      std::conditional_t<sizeof(Key) == 4, std::uint32_t, std::uint64_t>;
+  static constexpr type sign = type{1} << (8 * sizeof(Key) - 1);
+
+  static constexpr type to(const Key key) {
+    const auto bits = std::bit_cast<type>(key == 0 ? Key{0} : key);
+    return (bits & sign) ? ~bits : bits | sign;
+  }
+  static constexpr Key from(const type u) {
+    return std::bit_cast<Key>((u & sign) ? u ^ sign : ~u);
+  }
+};
+
+/// Big endian interpretation of the bytes, left aligned within type
+template <size_t width>
+struct OrderedKey<FixedString<width>> {
+  using type = std::conditional_t<width <= 4, std::uint32_t, std::uint64_t>;
+  static constexpr size_t padding = 8 * (sizeof(type) - width);
+
+  static constexpr type to(const FixedString<width> &key) {
+    type u = 0;
+    for (const auto b : key.bytes) u = (u << 8) | b;
+    return u << padding;
+  }
+  static constexpr FixedString<width> from(type u) {
+    FixedString<width> key;
+    u >>= padding;
+    for (size_t i = width; i > 0; i--, u >>= 8)
+      key.bytes[i - 1] = static_cast<unsigned char>(u);
+    return key;
+  }
+};
+
+template <class Key>
+using ordered_key_t = typename OrderedKey<Key>::type;
+
+/// Order preserving unsigned integer representation of key
+template <class Key>
+forceinline constexpr ordered_key_t<Key> to_ordered(const Key &key) {
+  return OrderedKey<Key>::to(key);
+}
+
+/// Inverse of to_ordered()
+template <class Key>
+forceinline constexpr Key from_ordered(const ordered_key_t<Key> &u) {
+  return OrderedKey<Key>::from(u);
+}
+}  // namespace learned_secondary_index::util
@@ -0,0 +1,208 @@
+#pragma once
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace learned_secondary_index::util {
+/**
+ * Splits [0, n) into at most `threads` contiguous chunks of equal size.
+ * Every chunk boundary except for n is a multiple of alignment.
+ *
+ * @returns chunk boundaries, i.e., chunk i is [bounds[i], bounds[i+1])
+ */
+inline std::vector<size_t> chunk_bounds(const size_t n, const size_t threads,
+                                        const size_t alignment = 1) {
+  const size_t chunks = std::max<size_t>(1, std::min(threads, n));
+  const size_t chunk_size =
+      ((n + chunks - 1) / chunks + alignment - 1) / alignment * alignment;
+
+  std::vector<size_t> bounds;
+  bounds.reserve(chunks + 1);
+  for (size_t c = 0; c < chunks; c++)
+    bounds.push_back(std::min(n, c * chunk_size));
+  bounds.push_back(n);
+
+  return bounds;
+}
+
+/**
+ * Invokes fn(chunk, chunk_begin, chunk_end) for each chunk of [0, n) as
+ * determined by chunk_bounds(n, threads, alignment), one thread per chunk.
+ * chunk is guaranteed to be smaller than max(threads, 1). If only one chunk
+ * exists, fn is executed on the calling thread.
+ */
+template <class Fn>
+void parallel_for(const size_t n, const size_t threads, const Fn &fn,
+                  const size_t alignment = 1) {
+  const auto bounds = chunk_bounds(n, threads, alignment);
+  const size_t chunks = bounds.size() - 1;
+
+  if (chunks == 1) {
+    fn(0, bounds[0], bounds[1]);
+    return;
+  }
+
+  std::vector<std::thread> workers;
+  workers.reserve(chunks);
+  for (size_t c = 0; c < chunks; c++)
+    workers.emplace_back(
+        [&fn, &bounds, c]() { fn(c, bounds[c], bounds[c + 1]); });
+  for (auto &worker : workers) worker.join();
+}
+
+/**
+ * Parses a Linux cpu list, e.g., "0-17,36-53" as found in
+ * /sys/devices/system/node/node<i>/cpulist
+ *
+ * @returns listed cpu ids in ascending order
+ */
+inline std::vector<size_t> parse_cpu_list(const std::string &list) {
+  std::vector<size_t> cpus;
+  std::stringstream ranges(list);
+  for (std::string range; std::getline(ranges, range, ',');) {
+    const auto dash = range.find('-');
+    try {
+      const size_t first = std::stoul(range.substr(0, dash));
+      const size_t last = dash == std::string::npos
+                              ? first
+                              : std::stoul(range.substr(dash + 1));
+      for (size_t cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+    } catch (const std::logic_error &) {
+      // skip malformed ranges, e.g., trailing whitespace
+    }
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+
+/// Cpus the calling process may run on, i.e., its affinity mask on Linux
+/// and all hardware threads otherwise
+inline std::vector<size_t> allowed_cpus() {
+  std::vector<size_t> cpus;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (size_t cpu = 0; cpu < CPU_SETSIZE; cpu++)
+      if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+  }
+#endif
+  if (cpus.empty()) {
+    cpus.resize(std::max<size_t>(std::thread::hardware_concurrency(), 1));
+    for (size_t cpu = 0; cpu < cpus.size(); cpu++) cpus[cpu] = cpu;
+  }
+  return cpus;
+}
+
+/**
+ * Cpus of every NUMA node as listed in /sys/devices/system/node, restricted
+ * to allowed_cpus(). Nodes without allowed cpus are omitted. Falls back to a
+ * single node of all allowed cpus if no node information is available, e.g.,
+ * on non Linux platforms.
+ *
+ * @returns cpu ids of each node in ascending node id order
+ */
+inline std::vector<std::vector<size_t>> numa_nodes() {
+  const auto allowed = allowed_cpus();
+
+  std::vector<std::pair<size_t, std::vector<size_t>>> nodes;
+  std::error_code error;
+  for (const auto &entry : std::filesystem::directory_iterator(
+           "/sys/devices/system/node", error)) {
+    const auto name = entry.path().filename().string();
+    if (name.rfind("node", 0) != 0 || name.size() == 4 ||
+        !std::all_of(name.begin() + 4, name.end(),
+                     [](const char c) { return c >= '0' && c <= '9'; }))
+      continue;
+
+    std::ifstream file(entry.path() / "cpulist");
+    std::string list;
+    if (!std::getline(file, list)) continue;
+
+    const auto listed = parse_cpu_list(list);
+    std::vector<size_t> cpus;
+    std::set_intersection(listed.begin(), listed.end(), allowed.begin(),
+                          allowed.end(), std::back_inserter(cpus));
+    if (!cpus.empty())
+      nodes.emplace_back(std::stoul(name.substr(4)), std::move(cpus));
+  }
+  std::sort(nodes.begin(), nodes.end());
+
+  std::vector<std::vector<size_t>> result;
+  for (auto &node : nodes) result.push_back(std::move(node.second));
+  if (result.empty()) result.push_back(allowed);
+  return result;
+}
+
+/**
+ * Restricts the calling thread, and threads it spawns afterwards, to cpus,
+ * e.g., a NUMA node's cpus as determined by numa_nodes(). Since Linux places
+ * pages on the NUMA node of the thread first touching them, memory allocated
+ * and initialized afterwards is local to these cpus' node(s).
+ *
+ * @returns whether the thread was pinned. Always false on non Linux platforms
+ */
+inline bool pin_thread(const std::vector<size_t> &cpus) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (const auto cpu : cpus)
+    if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+  return CPU_COUNT(&set) > 0 &&
+         pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  (void)cpus;
+  return false;
+#endif
+}
+
+/**
+ * Sorts [begin, end) using up to `threads` threads. Chunks are sorted
+ * independently and subsequently merged pairwise in log2(threads) rounds.
+ * Falls back to std::sort for threads <= 1.
+ */
+template <class RandomIt, class Compare>
+void parallel_sort(const RandomIt &begin, const RandomIt &end,
+                   const Compare &comp, const size_t threads) {
+  const size_t n = std::distance(begin, end);
+  if (threads <= 1) {
+    std::sort(begin, end, comp);
+    return;
+  }
+
+  // sort each chunk independently
+  const auto bounds = chunk_bounds(n, threads);
+  const size_t chunks = bounds.size() - 1;
+  parallel_for(n, threads, [&](size_t, size_t b, size_t e) {
+    std::sort(begin + b, begin + e, comp);
+  });
+
+  // merge sorted runs pairwise until only a single run remains
+  for (size_t width = 1; width < chunks; width *= 2) {
+    std::vector<std::thread> workers;
+    for (size_t c = 0; c + width < chunks; c += 2 * width) {
+      const auto first = begin + bounds[c];
+      const auto middle = begin + bounds[c + width];
+      const auto last = begin + bounds[std::min(c + 2 * width, chunks)];
+      workers.emplace_back(
+          [=, &comp]() { std::inplace_merge(first, middle, last, comp); });
+    }
+    for (auto &worker : workers) worker.join();
+  }
+}
+}  // namespace learned_secondary_index::util
@@ -0,0 +1,948 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../convenience/builtins.hpp"
+#include "allocation.hpp"
+#include "bitpacking/bit_packing.h"
+#include "parallel.hpp"
+#include "serialization.hpp"
+#include "simd.hpp"
+
+namespace learned_secondary_index::util {
+/**
+ * Entries storages obtain per fill() invocation while building. Since this is
+ * a multiple of 512, every batch starts on a byte as well as on a block
+ * boundary of all storages, i.e., batches may be packed independently of
+ * each other. Bounds the temporary memory required per build thread.
+ */
+static constexpr size_t pack_batch_size = 4096;
+
+/**
+ * Bit-packs count values with the given bit width in the format of
+ * ci::StoreBitPacked directly into out, which must start on a byte boundary.
+ * Unlike ci::StoreBitPacked, only writes the
+ * ci::BitPackingBytesRequired(count * bit_width) bytes the values occupy,
+ * i.e., adjacent ranges of the same buffer may be packed concurrently. Doesn't
+ * write any slop bytes, which out must provide already
+ */
+inline void store_bit_packed(const uint64_t *values, const size_t count,
+                             const int bit_width, char *out) {
+  if (count == 0 || bit_width == 0) return;
+
+  uint64_t word = 0;
+  int filled = 0;
+  for (size_t k = 0; k < count; k++) {
+    word |= values[k] << filled;
+    filled += bit_width;
+    if (filled >= 64) {
+      absl::little_endian::Store64(out, word);
+      out += 8;
+      filled -= 64;
+      word = filled > 0 ? values[k] >> (bit_width - filled) : 0;
+    }
+  }
+
+  char tail[8];
+  absl::little_endian::Store64(tail, word);
+  std::memcpy(out, tail, (filled + 7) / 8);
+}
+
+/**
+ * Invokes pack(first, count, offsets, fingerprint_bits) for all batches of
+ * pack_batch_size entries of [0, n) with up to `threads` threads, after
+ * fill(first, count, offsets, fingerprint_bits) decoded the batch into per
+ * thread buffers. fingerprint_bits is nullptr unless with_fingerprints
+ */
+template <class Fill, class Pack>
+void for_each_batch(const size_t n, const bool with_fingerprints,
+                    const Fill &fill, const Pack &pack, const size_t threads) {
+  parallel_for(
+      n, threads,
+      [&](size_t, size_t b, size_t e) {
+        std::vector<uint64_t> offsets(std::min(pack_batch_size, e - b));
+        std::vector<uint64_t> fingerprint_bits(
+            with_fingerprints ? offsets.size() : 0);
+        uint64_t *prints =
+            with_fingerprints ? fingerprint_bits.data() : nullptr;
+
+        for (size_t i = b; i < e; i += pack_batch_size) {
+          const size_t cnt = std::min(pack_batch_size, e - i);
+          fill(i, cnt, offsets.data(), prints);
+          pack(i, cnt, offsets.data(), prints);
+        }
+      },
+      pack_batch_size);
+}
+
+/**
+ * Value at index of values bit-packed with bit_width (see ci::StoreBitPacked),
+ * i.e., ci::BitPackedReader<uint64_t>::Get() with a compile time bit width.
+ * Shifts and masks become constants and the multi word case is compiled away
+ * for all but the largest bit widths
+ */
+template <int bit_width>
+forceinline uint64_t get_bit_packed(const char *data, const size_t index) {
+  static_assert(bit_width >= 0 && bit_width <= 64, "invalid bit width");
+
+  if constexpr (bit_width == 0) {
+    return 0;
+  } else {
+    const size_t bit0_offset = index * bit_width;
+    const char *byte0 = data + (bit0_offset >> 3);
+    const int start = bit0_offset & 0x7;
+    uint64_t val = absl::little_endian::Load64(byte0) >> start;
+
+    if constexpr (bit_width > ci::internal::kMaxSingleWordBitWidth) {
+      const int next_word_bits = start + bit_width - 64;
+      if (next_word_bits > 0)
+        val |= absl::little_endian::Load64(byte0 + 8)
+               << (bit_width - next_word_bits);
+    }
+
+    if constexpr (bit_width == 64) {
+      return val;
+    } else {
+      return val & ((0x1LLU << bit_width) - 1);
+    }
+  }
+}
+
+/**
+ * Decodes count consecutive bit-packed values [first, first + count) into
+ * out, adding base to each. Whenever possible, bulk decodes via
+ * ci::BitPackedReader<uint32_t>::GetBatch, which requires bit widths <= 32
+ * and must start at a multiple of 32 values, i.e., a 32 bit word boundary
+ */
+forceinline void decode_bit_packed(const char *data, const int bit_width,
+                                   const size_t first, const size_t count,
+                                   std::uint64_t *out,
+                                   const std::uint64_t base = 0) {
+  const ci::BitPackedReader<uint64_t> reader(bit_width, data);
+  if (bit_width > 32) {
+    for (size_t k = 0; k < count; k++) out[k] = base + reader.Get(first + k);
+    return;
+  }
+
+  // decode individually up to the next word boundary
+  const size_t head = std::min(count, (32 - first % 32) % 32);
+  for (size_t k = 0; k < head; k++) out[k] = base + reader.Get(first + k);
+  if (head == count) return;
+
+  ci::BitPackedReader<uint32_t> batch(bit_width,
+                                      data + (first + head) * bit_width / 8);
+  std::uint64_t *batch_out = out + head;
+  batch.GetBatch(count - head, [&](size_t i, std::uint32_t value) {
+    batch_out[i] = base + value;
+  });
+}
+
+/**
+ * Default PermVector storage: all bit-packed offsets, followed by all
+ * bit-packed fingerprint bits in a separate region
+ */
+class SeparateStorage {
+ public:
+  /// All offsets share one bit width, as do all fingerprint bits, i.e.,
+  /// entries may be decoded via offset<bit_width>() and match<bit_width>()
+  static constexpr bool fixed_width = true;
+
+ private:
+  /// owned packed bytes, empty if _packed points into a mapped file instead
+  Buffer _data;
+  const char *_packed = nullptr;
+  size_t _packed_size = 0;
+
+  ci::BitPackedReader<uint64_t> _offsets_reader;
+  ci::BitPackedReader<uint64_t> _fingerprint_bits_reader;
+
+  // retained to compute memory locations of individual entries for prefetching
+  int _offsets_bit_width = 0;
+  int _fingerprint_bits_bit_width = 0;
+  size_t _fingerprint_bits_pos = 0;
+
+ public:
+  /**
+   * Packs n entries using the given bit widths with up to `threads` threads
+   * directly into their final location. fill(first, count, offsets,
+   * fingerprint_bits) must decode entries [first, first + count) into the
+   * provided buffers. fingerprint_bits is nullptr if
+   * fingerprint_bits_bit_width is 0
+   */
+  template <class Fill>
+  void build(const size_t n, const int offsets_bit_width,
+             const int fingerprint_bits_bit_width, const Fill &fill,
+             const size_t threads) {
+    _offsets_bit_width = offsets_bit_width;
+    _fingerprint_bits_bit_width = fingerprint_bits_bit_width;
+
+    const size_t offsets_bytes =
+        ci::BitPackingBytesRequired(n * _offsets_bit_width);
+    const size_t fingerprint_bits_bytes =
+        ci::BitPackingBytesRequired(n * _fingerprint_bits_bit_width);
+    _fingerprint_bits_pos = offsets_bytes;
+
+    // zero initialization doubles as slop bytes
+    _data = Buffer(offsets_bytes + fingerprint_bits_bytes +
+                   ci::internal::kSlopBytes);
+    _packed_size = _data.size();
+
+    char *offsets_out = _data.data();
+    char *fingerprint_bits_out = _data.data() + _fingerprint_bits_pos;
+    for_each_batch(
+        n, _fingerprint_bits_bit_width > 0, fill,
+        [&](size_t first, size_t count, const uint64_t *offsets,
+            const uint64_t *fingerprint_bits) {
+          store_bit_packed(offsets, count, _offsets_bit_width,
+                           offsets_out + first * _offsets_bit_width / 8);
+          if (fingerprint_bits != nullptr)
+            store_bit_packed(
+                fingerprint_bits, count, _fingerprint_bits_bit_width,
+                fingerprint_bits_out + first * _fingerprint_bits_bit_width / 8);
+        },
+        threads);
+    attach(_data.data());
+  }
+
+  /// Writes bit widths and packed bytes (including slop bytes)
+  void save(Writer &out) const {
+    out.write<std::int32_t>(_offsets_bit_width);
+    out.write<std::int32_t>(_fingerprint_bits_bit_width);
+    out.write<std::uint64_t>(_fingerprint_bits_pos);
+    out.write<std::uint64_t>(_packed_size);
+    out.align();
+    out.write_bytes(_packed, _packed_size);
+  }
+
+  /// Restores state written by save(), pointing directly into in's memory
+  /// which must outlive this storage
+  void load(Reader &in) {
+    _offsets_bit_width = in.read<std::int32_t>();
+    _fingerprint_bits_bit_width = in.read<std::int32_t>();
+    _fingerprint_bits_pos = in.read<std::uint64_t>();
+    _packed_size = in.read<std::uint64_t>();
+    in.align();
+
+    _data.clear();
+    attach(in.read_bytes(_packed_size));
+  }
+
+ private:
+  void attach(const char *packed) {
+    _packed = packed;
+    _offsets_reader = ci::BitPackedReader<uint64_t>(_offsets_bit_width, packed);
+    _fingerprint_bits_reader = ci::BitPackedReader<uint64_t>(
+        _fingerprint_bits_bit_width, packed + _fingerprint_bits_pos);
+  }
+
+ public:
+
+  /// Offset stored at index
+  forceinline uint64_t offset(const size_t &index) const {
+    return _offsets_reader.Get(index);
+  }
+
+  /// Offset stored at index, which must have been packed with bit_width,
+  /// see offsets_bit_width()
+  template <int bit_width>
+  forceinline uint64_t offset(const size_t &index) const {
+    return get_bit_packed<bit_width>(_packed, index);
+  }
+
+  [[nodiscard]] int offsets_bit_width() const { return _offsets_bit_width; }
+
+  [[nodiscard]] int fingerprint_bits_bit_width() const {
+    return _fingerprint_bits_bit_width;
+  }
+
+  /// Decodes offsets [first, first + count) into out
+  void decode(const size_t first, const size_t count,
+              std::uint64_t *out) const {
+    decode_bit_packed(_packed, _offsets_bit_width, first, count, out);
+  }
+
+  /// Fingerprint bits stored at index
+  forceinline uint64_t fingerprint_bits(const size_t &index) const {
+    return _fingerprint_bits_reader.Get(index);
+  }
+
+  /// Bitmask of entries in [first, first + count), count <= 64, whose
+  /// fingerprint bits equal print
+  forceinline uint64_t match(const uint64_t print, const size_t first,
+                             const size_t count) const {
+    if (likely(_fingerprint_bits_bit_width <=
+               ci::internal::kMaxSingleWordBitWidth)) {
+      return match_bit_packed(_packed + _fingerprint_bits_pos,
+                              _fingerprint_bits_bit_width, first, count, print);
+    }
+
+    uint64_t matches = 0;
+    for (size_t k = 0; k < count; k++) {
+      matches |= static_cast<uint64_t>(fingerprint_bits(first + k) == print)
+                 << k;
+    }
+    return matches;
+  }
+
+  /// match() for fingerprint bits packed with bit_width, see
+  /// fingerprint_bits_bit_width()
+  template <int bit_width>
+  forceinline uint64_t match(const uint64_t print, const size_t first,
+                             const size_t count) const {
+    if constexpr (bit_width <= ci::internal::kMaxSingleWordBitWidth) {
+      return match_bit_packed(_packed + _fingerprint_bits_pos, bit_width,
+                              first, count, print);
+    } else {
+      return match(print, first, count);
+    }
+  }
+
+  /// Prefetches the packed bytes of entry index into cache
+  forceinline void prefetch(const size_t &index) const {
+    prefetchit(_packed + ((index * _offsets_bit_width) >> 3), 0, 3);
+
+    if (_fingerprint_bits_bit_width > 0) {
+      prefetchit(_packed + _fingerprint_bits_pos +
+                     ((index * _fingerprint_bits_bit_width) >> 3),
+                 0, 3);
+    }
+  }
+
+  /// Bytes occupied by packed data
+  [[nodiscard]] size_t byte_size() const { return _packed_size; }
+
+  static std::string name() { return "separate"; }
+
+  friend bool operator==(const SeparateStorage &a, const SeparateStorage &b) {
+    return a._packed_size == b._packed_size &&
+           (a._packed_size == 0 ||
+            std::memcmp(a._packed, b._packed, a._packed_size) == 0);
+  }
+};
+
+/**
+ * PermVector storage interleaving fingerprint bits and offsets. Entries are
+ * grouped into blocks of a power of two (at least 8) entries, each holding
+ * the block's bit-packed fingerprint bits followed by its bit-packed
+ * offsets. Blocks are cache line aligned and, whenever
+ * fingerprint + offset bits permit, fit into a single cache line. Reading an
+ * entry's fingerprint bits and then its offset therefore only touches one
+ * cache line.
+ */
+class InterleavedStorage {
+ public:
+  /// Offsets are located via block geometry, i.e., not specialized
+  static constexpr bool fixed_width = false;
+
+ private:
+  static constexpr size_t cache_line_size = 64;
+  static_assert(payload_alignment % cache_line_size == 0,
+                "mapped blocks must remain cache line aligned");
+  static_assert(Buffer::alignment % cache_line_size == 0,
+                "owned blocks must be cache line aligned");
+
+  /// owned packed bytes, empty if _blocks points into a mapped file instead
+  Buffer _data;
+  const char *_blocks = nullptr;
+  size_t _blocks_bytes = 0;
+
+  int _offsets_bit_width = 0;
+  int _fingerprint_bits_bit_width = 0;
+
+  /// log2 of entries per block
+  size_t _block_shift = 0;
+  /// bytes between the start of consecutive blocks
+  size_t _block_stride = 0;
+  /// position of offsets within each block
+  size_t _offsets_pos = 0;
+
+  forceinline const char *block(const size_t &index) const {
+    return _blocks + (index >> _block_shift) * _block_stride;
+  }
+
+  forceinline size_t in_block(const size_t &index) const {
+    return index & ((0x1LLU << _block_shift) - 1);
+  }
+
+ public:
+  /**
+   * Packs n entries using the given bit widths with up to `threads` threads
+   * directly into their final blocks, see SeparateStorage::build()
+   */
+  template <class Fill>
+  void build(const size_t n, const int offsets_bit_width,
+             const int fingerprint_bits_bit_width, const Fill &fill,
+             const size_t threads) {
+    _offsets_bit_width = offsets_bit_width;
+    _fingerprint_bits_bit_width = fingerprint_bits_bit_width;
+
+    // largest power of two entries (>= 8, such that regions start on byte
+    // boundaries) fitting into one cache line
+    const size_t entry_bits = std::max(
+        1, _offsets_bit_width + _fingerprint_bits_bit_width);
+    _block_shift = 3;
+    while ((0x1LLU << (_block_shift + 1)) * entry_bits <= cache_line_size * 8)
+      _block_shift++;
+
+    const size_t block_size = 0x1LLU << _block_shift;
+    _offsets_pos = block_size * _fingerprint_bits_bit_width / 8;
+    _block_stride = (block_size * entry_bits / 8 + cache_line_size - 1) /
+                    cache_line_size * cache_line_size;
+
+    // zero initialization doubles as slop bytes as well as the gap between
+    // regions of a partially filled last block. Buffers are cache line
+    // aligned, i.e., so are all blocks
+    const size_t block_cnt = (n + block_size - 1) / block_size;
+    _blocks_bytes = block_cnt * _block_stride;
+    _data = Buffer(_blocks_bytes + ci::internal::kSlopBytes);
+    char *blocks = _data.data();
+    _blocks = blocks;
+
+    // blocks are independent of each other, i.e., may be packed in parallel.
+    // Batches always consist of whole blocks except for the last one
+    for_each_batch(
+        n, _fingerprint_bits_bit_width > 0, fill,
+        [&](size_t first, size_t count, const uint64_t *offsets,
+            const uint64_t *fingerprint_bits) {
+          for (size_t k = 0; k < count; k += block_size) {
+            const size_t cnt = std::min(block_size, count - k);
+            char *out = blocks + ((first + k) >> _block_shift) * _block_stride;
+
+            if (fingerprint_bits != nullptr)
+              store_bit_packed(fingerprint_bits + k, cnt,
+                               _fingerprint_bits_bit_width, out);
+            store_bit_packed(offsets + k, cnt, _offsets_bit_width,
+                             out + _offsets_pos);
+          }
+        },
+        threads);
+  }
+
+  /// Writes block geometry and packed blocks (including slop bytes)
+  void save(Writer &out) const {
+    out.write<std::int32_t>(_offsets_bit_width);
+    out.write<std::int32_t>(_fingerprint_bits_bit_width);
+    out.write<std::uint64_t>(_block_shift);
+    out.write<std::uint64_t>(_block_stride);
+    out.write<std::uint64_t>(_offsets_pos);
+    out.write<std::uint64_t>(_blocks_bytes);
+    out.align();
+    out.write_bytes(_blocks, _blocks_bytes + ci::internal::kSlopBytes);
+  }
+
+  /// Restores state written by save(), pointing directly into in's memory
+  /// which must outlive this storage
+  void load(Reader &in) {
+    _offsets_bit_width = in.read<std::int32_t>();
+    _fingerprint_bits_bit_width = in.read<std::int32_t>();
+    _block_shift = in.read<std::uint64_t>();
+    _block_stride = in.read<std::uint64_t>();
+    _offsets_pos = in.read<std::uint64_t>();
+    _blocks_bytes = in.read<std::uint64_t>();
+    in.align();
+
+    _data.clear();
+    _blocks = in.read_bytes(_blocks_bytes + ci::internal::kSlopBytes);
+  }
+
+  /// Offset stored at index
+  forceinline uint64_t offset(const size_t &index) const {
+    return ci::BitPackedReader<uint64_t>(_offsets_bit_width,
+                                         block(index) + _offsets_pos)
+        .Get(in_block(index));
+  }
+
+  /// Decodes offsets [first, first + count) into out block by block
+  void decode(const size_t first, const size_t count,
+              std::uint64_t *out) const {
+    for (size_t k = 0; k < count;) {
+      const size_t i = first + k;
+      const size_t r = in_block(i);
+      const size_t cnt =
+          std::min<size_t>(count - k, (0x1LLU << _block_shift) - r);
+
+      decode_bit_packed(block(i) + _offsets_pos, _offsets_bit_width, r, cnt,
+                        out + k);
+      k += cnt;
+    }
+  }
+
+  /// Fingerprint bits stored at index
+  forceinline uint64_t fingerprint_bits(const size_t &index) const {
+    return ci::BitPackedReader<uint64_t>(_fingerprint_bits_bit_width,
+                                         block(index))
+        .Get(in_block(index));
+  }
+
+  /// Bitmask of entries in [first, first + count), count <= 64, whose
+  /// fingerprint bits equal print
+  forceinline uint64_t match(const uint64_t print, const size_t first,
+                             const size_t count) const {
+    uint64_t matches = 0;
+
+    // match block wise since fingerprint bits are only contiguous per block
+    for (size_t k = 0; k < count;) {
+      const size_t i = first + k;
+      const size_t r = in_block(i);
+      const size_t cnt =
+          std::min<size_t>(count - k, (0x1LLU << _block_shift) - r);
+
+      if (likely(_fingerprint_bits_bit_width <=
+                 ci::internal::kMaxSingleWordBitWidth)) {
+        matches |= match_bit_packed(block(i), _fingerprint_bits_bit_width, r,
+                                    cnt, print)
+                   << k;
+      } else {
+        for (size_t j = 0; j < cnt; j++) {
+          matches |= static_cast<uint64_t>(fingerprint_bits(i + j) == print)
+                     << (k + j);
+        }
+      }
+
+      k += cnt;
+    }
+
+    return matches;
+  }
+
+  /// Prefetches the cache line holding entry index
+  forceinline void prefetch(const size_t &index) const {
+    prefetchit(block(index), 0, 3);
+  }
+
+  /// Bytes occupied by packed data
+  [[nodiscard]] size_t byte_size() const {
+    return _data.empty() ? _blocks_bytes + ci::internal::kSlopBytes
+                         : _data.size();
+  }
+
+  static std::string name() { return "interleaved"; }
+
+  friend bool operator==(const InterleavedStorage &a,
+                         const InterleavedStorage &b) {
+    // alignment padding may differ
+    return a._blocks_bytes == b._blocks_bytes &&
+           (a._blocks_bytes == 0 ||
+            std::memcmp(a._blocks, b._blocks, a._blocks_bytes) == 0);
+  }
+};
+
+/**
+ * Compressed PermVector storage using frame of reference encoding. Offsets
+ * are grouped into blocks of 64 consecutive entries, each storing its
+ * smallest offset as base and all (offset - base) deltas bit-packed with the
+ * block's own minimal bit width. Whenever the base data is partially sorted,
+ * offsets of neighbouring entries are close to each other and deltas require
+ * far fewer than log2(n) bits, while random access remains O(1) at the cost
+ * of one additional (block header) memory access. Fingerprint bits are
+ * incompressible and stored as in SeparateStorage.
+ */
+class CompressedStorage {
+ public:
+  /// Every block has its own offsets bit width, i.e., not specialized
+  static constexpr bool fixed_width = false;
+
+ private:
+  static constexpr size_t block_shift = 6;
+  static constexpr size_t block_size = 0x1LLU << block_shift;
+
+  struct BlockHeader {
+    std::uint64_t base;
+    /// byte position of the block's deltas within the payload region
+    std::uint64_t pos : 56;
+    std::uint64_t bit_width : 8;
+  };
+  static_assert(sizeof(BlockHeader) == 16);
+
+  /// owned packed bytes, empty if _packed points into a mapped file instead.
+  /// Layout: block headers, delta payload, fingerprint bits, slop bytes
+  Buffer _data;
+  const char *_packed = nullptr;
+  size_t _packed_size = 0;
+
+  const BlockHeader *_headers = nullptr;
+  const char *_payload = nullptr;
+  ci::BitPackedReader<uint64_t> _fingerprint_bits_reader;
+
+  size_t _block_cnt = 0;
+  size_t _payload_pos = 0;
+  size_t _fingerprint_bits_pos = 0;
+  int _fingerprint_bits_bit_width = 0;
+
+  void attach(const char *packed) {
+    _packed = packed;
+    _headers = reinterpret_cast<const BlockHeader *>(packed);
+    _payload = packed + _payload_pos;
+    _fingerprint_bits_reader = ci::BitPackedReader<uint64_t>(
+        _fingerprint_bits_bit_width, packed + _fingerprint_bits_pos);
+  }
+
+ public:
+  /**
+   * Packs n entries using up to `threads` threads directly into their final
+   * location, see SeparateStorage::build(). Since every block determines its
+   * own bit width, offsets_bit_width is ignored and fill is invoked twice per
+   * entry: once to determine block headers, once to pack deltas
+   */
+  template <class Fill>
+  void build(const size_t n, const int /*offsets_bit_width*/,
+             const int fingerprint_bits_bit_width, const Fill &fill,
+             const size_t threads) {
+    static_assert(pack_batch_size % block_size == 0);
+
+    _fingerprint_bits_bit_width = fingerprint_bits_bit_width;
+    _block_cnt = (n + block_size - 1) / block_size;
+
+    // determine frame of reference and bit width per block. Headers are the
+    // only temporaries spanning all entries, i.e., 16 bytes per 64 entries
+    std::vector<BlockHeader> headers(_block_cnt);
+    for_each_batch(
+        n, false, fill,
+        [&](size_t first, size_t count, const uint64_t *offsets,
+            const uint64_t *) {
+          for (size_t k = 0; k < count; k += block_size) {
+            const auto [min, max] = std::minmax_element(
+                offsets + k, offsets + std::min(count, k + block_size));
+            auto &header = headers[(first + k) >> block_shift];
+            header.base = *min;
+            header.bit_width = ci::BitWidth<uint64_t>(*max - *min);
+          }
+        },
+        threads);
+
+    // each block's deltas start at a byte boundary directly after the
+    // preceding block's deltas
+    size_t payload_bytes = 0;
+    for (size_t block = 0; block < _block_cnt; block++) {
+      headers[block].pos = payload_bytes;
+      payload_bytes += ci::BitPackingBytesRequired(
+          std::min(block_size, n - block * block_size) *
+          headers[block].bit_width);
+    }
+
+    _payload_pos = _block_cnt * sizeof(BlockHeader);
+    _fingerprint_bits_pos = _payload_pos + payload_bytes;
+    const size_t fingerprint_bits_bytes =
+        ci::BitPackingBytesRequired(n * _fingerprint_bits_bit_width);
+
+    // zero initialization doubles as slop bytes
+    _data = Buffer(_fingerprint_bits_pos + fingerprint_bits_bytes +
+                   ci::internal::kSlopBytes);
+    _packed_size = _data.size();
+    if (_block_cnt > 0)
+      std::memcpy(_data.data(), headers.data(), _payload_pos);
+    headers = {};
+
+    // blocks are independent of each other, i.e., may be packed in parallel
+    const auto *packed_headers =
+        reinterpret_cast<const BlockHeader *>(_data.data());
+    char *payload = _data.data() + _payload_pos;
+    char *fingerprint_bits_out = _data.data() + _fingerprint_bits_pos;
+    for_each_batch(
+        n, _fingerprint_bits_bit_width > 0, fill,
+        [&](size_t first, size_t count, const uint64_t *offsets,
+            const uint64_t *fingerprint_bits) {
+          std::array<uint64_t, block_size> deltas{};
+          for (size_t k = 0; k < count; k += block_size) {
+            const auto &header = packed_headers[(first + k) >> block_shift];
+            const size_t cnt = std::min(block_size, count - k);
+            for (size_t j = 0; j < cnt; j++)
+              deltas[j] = offsets[k + j] - header.base;
+
+            store_bit_packed(deltas.data(), cnt, header.bit_width,
+                             payload + header.pos);
+          }
+
+          if (fingerprint_bits != nullptr)
+            store_bit_packed(
+                fingerprint_bits, count, _fingerprint_bits_bit_width,
+                fingerprint_bits_out + first * _fingerprint_bits_bit_width / 8);
+        },
+        threads);
+    attach(_data.data());
+  }
+
+  /// Writes block layout and packed bytes (including slop bytes)
+  void save(Writer &out) const {
+    out.write<std::int32_t>(_fingerprint_bits_bit_width);
+    out.write<std::uint64_t>(_block_cnt);
+    out.write<std::uint64_t>(_payload_pos);
+    out.write<std::uint64_t>(_fingerprint_bits_pos);
+    out.write<std::uint64_t>(_packed_size);
+    out.align();
+    out.write_bytes(_packed, _packed_size);
+  }
+
+  /// Restores state written by save(), pointing directly into in's memory
+  /// which must outlive this storage
+  void load(Reader &in) {
+    _fingerprint_bits_bit_width = in.read<std::int32_t>();
+    _block_cnt = in.read<std::uint64_t>();
+    _payload_pos = in.read<std::uint64_t>();
+    _fingerprint_bits_pos = in.read<std::uint64_t>();
+    _packed_size = in.read<std::uint64_t>();
+    in.align();
+
+    _data.clear();
+    attach(in.read_bytes(_packed_size));
+  }
+
+  /// Offset stored at index
+  forceinline uint64_t offset(const size_t &index) const {
+    const auto &header = _headers[index >> block_shift];
+    return header.base +
+           ci::BitPackedReader<uint64_t>(static_cast<int>(header.bit_width),
+                                         _payload + header.pos)
+               .Get(index & (block_size - 1));
+  }
+
+  /// Decodes offsets [first, first + count) into out block by block
+  void decode(const size_t first, const size_t count,
+              std::uint64_t *out) const {
+    for (size_t k = 0; k < count;) {
+      const size_t i = first + k;
+      const size_t r = i & (block_size - 1);
+      const size_t cnt = std::min(count - k, block_size - r);
+
+      const auto &header = _headers[i >> block_shift];
+      decode_bit_packed(_payload + header.pos,
+                        static_cast<int>(header.bit_width), r, cnt, out + k,
+                        header.base);
+      k += cnt;
+    }
+  }
+
+  /// Fingerprint bits stored at index
+  forceinline uint64_t fingerprint_bits(const size_t &index) const {
+    return _fingerprint_bits_reader.Get(index);
+  }
+
+  /// Bitmask of entries in [first, first + count), count <= 64, whose
+  /// fingerprint bits equal print
+  forceinline uint64_t match(const uint64_t print, const size_t first,
+                             const size_t count) const {
+    if (likely(_fingerprint_bits_bit_width <=
+               ci::internal::kMaxSingleWordBitWidth)) {
+      return match_bit_packed(_packed + _fingerprint_bits_pos,
+                              _fingerprint_bits_bit_width, first, count, print);
+    }
+
+    uint64_t matches = 0;
+    for (size_t k = 0; k < count; k++) {
+      matches |= static_cast<uint64_t>(fingerprint_bits(first + k) == print)
+                 << k;
+    }
+    return matches;
+  }
+
+  /// Prefetches the block header as well as fingerprint bits of entry index.
+  /// The delta's location depends on the header and is therefore not known
+  forceinline void prefetch(const size_t &index) const {
+    prefetchit(_headers + (index >> block_shift), 0, 3);
+
+    if (_fingerprint_bits_bit_width > 0) {
+      prefetchit(_packed + _fingerprint_bits_pos +
+                     ((index * _fingerprint_bits_bit_width) >> 3),
+                 0, 3);
+    }
+  }
+
+  /// Bytes occupied by packed data
+  [[nodiscard]] size_t byte_size() const { return _packed_size; }
+
+  static std::string name() { return "compressed"; }
+
+  friend bool operator==(const CompressedStorage &a,
+                         const CompressedStorage &b) {
+    return a._packed_size == b._packed_size &&
+           (a._packed_size == 0 ||
+            std::memcmp(a._packed, b._packed, a._packed_size) == 0);
+  }
+};
+
+/**
+ * Byte aligned PermVector storage trading space for decode speed: every
+ * entry occupies a whole number of bytes, i.e., its offset rounded up to
+ * 1, 2, 3, ... bytes (e.g., 3 bytes for up to 16M rows) immediately followed
+ * by its fingerprint bits rounded up to whole bytes. Decoding an entry is a
+ * single unaligned load and mask without any shifts, offset and fingerprint
+ * bits share a cache line, and fingerprint blocks are matched with one
+ * strided gather per SIMD register (see match_strided()).
+ */
+class AlignedStorage {
+ public:
+  /// Offsets and fingerprint bits occupy the low offsets_bit_width() and
+  /// fingerprint_bits_bit_width() bits of their bytes, i.e., entries may be
+  /// decoded via offset<bit_width>() and match<bit_width>()
+  static constexpr bool fixed_width = true;
+
+ private:
+  /// owned entry bytes, empty if _entries points into a mapped file instead
+  Buffer _data;
+  const char *_entries = nullptr;
+  size_t _entries_bytes = 0;
+
+  int _offsets_bit_width = 0;
+  int _fingerprint_bits_bit_width = 0;
+
+  /// entry layout derived from the bit widths
+  size_t _offset_bytes = 0;
+  size_t _stride = 0;
+  uint64_t _offsets_mask = 0;
+  uint64_t _fingerprint_bits_mask = 0;
+
+  static constexpr uint64_t low_bits(const int bit_width) {
+    return bit_width >= 64 ? ~0x0LLU : (0x1LLU << bit_width) - 1;
+  }
+
+  void layout(const int offsets_bit_width,
+              const int fingerprint_bits_bit_width) {
+    _offsets_bit_width = offsets_bit_width;
+    _fingerprint_bits_bit_width = fingerprint_bits_bit_width;
+    _offset_bytes = (_offsets_bit_width + 7) / 8;
+    _stride = _offset_bytes + (_fingerprint_bits_bit_width + 7) / 8;
+    _offsets_mask = low_bits(_offsets_bit_width);
+    _fingerprint_bits_mask = low_bits(_fingerprint_bits_bit_width);
+  }
+
+  forceinline const char *entry(const size_t &index) const {
+    return _entries + index * _stride;
+  }
+
+  /// Writes the low bytes of value to out, leaving neighbouring bytes intact
+  static forceinline void store_bytes(char *out, const uint64_t value,
+                                      const size_t bytes) {
+    char le[sizeof(uint64_t)];
+    absl::little_endian::Store64(le, value);
+    std::memcpy(out, le, bytes);
+  }
+
+ public:
+  /**
+   * Stores n entries using the given bit widths rounded up to whole bytes
+   * with up to `threads` threads, see SeparateStorage::build()
+   */
+  template <class Fill>
+  void build(const size_t n, const int offsets_bit_width,
+             const int fingerprint_bits_bit_width, const Fill &fill,
+             const size_t threads) {
+    layout(offsets_bit_width, fingerprint_bits_bit_width);
+
+    // zero initialization doubles as slop bytes
+    _entries_bytes = n * _stride;
+    _data = Buffer(_entries_bytes + ci::internal::kSlopBytes);
+    char *entries = _data.data();
+    _entries = entries;
+
+    const size_t fingerprint_bytes = _stride - _offset_bytes;
+    for_each_batch(
+        n, _fingerprint_bits_bit_width > 0, fill,
+        [&](size_t first, size_t count, const uint64_t *offsets,
+            const uint64_t *fingerprint_bits) {
+          char *out = entries + first * _stride;
+          for (size_t k = 0; k < count; k++, out += _stride) {
+            store_bytes(out, offsets[k], _offset_bytes);
+            if (fingerprint_bits != nullptr)
+              store_bytes(out + _offset_bytes, fingerprint_bits[k],
+                          fingerprint_bytes);
+          }
+        },
+        threads);
+  }
+
+  /// Writes bit widths and entry bytes (including slop bytes)
+  void save(Writer &out) const {
+    out.write<std::int32_t>(_offsets_bit_width);
+    out.write<std::int32_t>(_fingerprint_bits_bit_width);
+    out.write<std::uint64_t>(_entries_bytes);
+    out.align();
+    out.write_bytes(_entries, _entries_bytes + ci::internal::kSlopBytes);
+  }
+
+  /// Restores state written by save(), pointing directly into in's memory
+  /// which must outlive this storage
+  void load(Reader &in) {
+    const int offsets_bit_width = in.read<std::int32_t>();
+    const int fingerprint_bits_bit_width = in.read<std::int32_t>();
+    layout(offsets_bit_width, fingerprint_bits_bit_width);
+    _entries_bytes = in.read<std::uint64_t>();
+    in.align();
+
+    _data.clear();
+    _entries = in.read_bytes(_entries_bytes + ci::internal::kSlopBytes);
+  }
+
+  /// Offset stored at index
+  forceinline uint64_t offset(const size_t &index) const {
+    return absl::little_endian::Load64(entry(index)) & _offsets_mask;
+  }
+
+  /// Offset stored at index, whose offsets_bit_width() must be bit_width
+  template <int bit_width>
+  forceinline uint64_t offset(const size_t &index) const {
+    static_assert(bit_width >= 0 && bit_width <= 64, "invalid bit width");
+    return absl::little_endian::Load64(entry(index)) & low_bits(bit_width);
+  }
+
+  [[nodiscard]] int offsets_bit_width() const { return _offsets_bit_width; }
+
+  [[nodiscard]] int fingerprint_bits_bit_width() const {
+    return _fingerprint_bits_bit_width;
+  }
+
+  /// Decodes offsets [first, first + count) into out
+  void decode(const size_t first, const size_t count,
+              std::uint64_t *out) const {
+    const char *in = entry(first);
+    for (size_t k = 0; k < count; k++, in += _stride)
+      out[k] = absl::little_endian::Load64(in) & _offsets_mask;
+  }
+
+  /// Fingerprint bits stored at index
+  forceinline uint64_t fingerprint_bits(const size_t &index) const {
+    return absl::little_endian::Load64(entry(index) + _offset_bytes) &
+           _fingerprint_bits_mask;
+  }
+
+  /// Bitmask of entries in [first, first + count), count <= 64, whose
+  /// fingerprint bits equal print
+  forceinline uint64_t match(const uint64_t print, const size_t first,
+                             const size_t count) const {
+    return match_strided(_entries + _offset_bytes, _stride, first, count,
+                         _fingerprint_bits_mask, print);
+  }
+
+  /// match() for fingerprint_bits_bit_width() == bit_width
+  template <int bit_width>
+  forceinline uint64_t match(const uint64_t print, const size_t first,
+                             const size_t count) const {
+    return match_strided(_entries + _offset_bytes, _stride, first, count,
+                         low_bits(bit_width), print);
+  }
+
+  /// Prefetches the cache line holding entry index
+  forceinline void prefetch(const size_t &index) const {
+    prefetchit(entry(index), 0, 3);
+  }
+
+  /// Bytes occupied by entries
+  [[nodiscard]] size_t byte_size() const {
+    return _entries_bytes + ci::internal::kSlopBytes;
+  }
+
+  static std::string name() { return "aligned"; }
+
+  friend bool operator==(const AlignedStorage &a, const AlignedStorage &b) {
+    return a._entries_bytes == b._entries_bytes &&
+           a._stride == b._stride &&
+           (a._entries_bytes == 0 ||
+            std::memcmp(a._entries, b._entries, a._entries_bytes) == 0);
+  }
+};
+}  // namespace learned_secondary_index::util
@@ -1,38 +1,51 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <iterator>
 #include <limits>
+#include <vector>
 
 #include "../convenience/builtins.hpp"
 #include "bitpacking/bit_packing.h"
 #include "fingerprinter.hpp"
+#include "instrumentation.hpp"
+#include "parallel.hpp"
+#include "perm_storage.hpp"
+#include "serialization.hpp"
 #include "support.hpp"
 
 namespace learned_secondary_index::util {
-/// Packed vector containing permutation information
-template <class F>
+/**
+ * Packed vector containing permutation information
+ *
+ * @tparam F fingerprinter used to generate fingerprint bits
+ * @tparam Storage storage layout policy, e.g., SeparateStorage,
+ *   InterleavedStorage or AlignedStorage
+ */
+template <class F, class Storage = SeparateStorage>
 class PermVector {
-  size_t _size;
-  std::string _data;
-  ci::BitPackedReader<uint64_t> _offsets_reader;
-  ci::BitPackedReader<uint64_t> _fingerprint_bits_reader;
+  size_t _size = 0;
+  Storage _storage;
 
   // generate fingerprint bits using this
   F _fingerprinter;
 
+  /// keys hashed at once during build()
+  static constexpr size_t fingerprint_batch_size = 16;
+
   struct Value {
     const uint64_t index = 0;
     const uint64_t fingerprint_bits = 0;
   };
 
   Value deserialize(const size_t &i) const {
-    const size_t index = _offsets_reader.Get(i);
+    const size_t index = _storage.offset(i);
 
     if constexpr (F::size == 0) {
       return {.index = index, .fingerprint_bits = 0};
     } else {
-      uint64_t fingerprint_bits = _fingerprint_bits_reader.Get(i);
+      uint64_t fingerprint_bits = _storage.fingerprint_bits(i);
       return {.index = index, .fingerprint_bits = fingerprint_bits};
     }
   }
@@ -107,59 +120,121 @@ class PermVector {
       return a._index != b._index || &a._ref != &b._ref;
     };
 
-    friend PermVector<F>;
+    friend PermVector;
   };
 
   using iterator = PermIterator;
 
   /**
-   * Builds permutations vector on elements in [begin, end), returning Bloomer
-   * used for generating associated fingerprint bits.
+   * Builds permutations vector on elements in [begin, end), generating the
+   * associated fingerprint bits for each element on the fly. Packing is
+   * performed on up to `threads` chunks in parallel.
    */
   template <class ForwardIt>
-  void build(const ForwardIt &begin, const ForwardIt &end) {
-    _size = std::distance(begin, end);
-
-    std::vector<uint64_t> offsets;
-    std::vector<uint64_t> fingerprint_bits;
+  void build(const ForwardIt &begin, const ForwardIt &end,
+             const size_t threads = 1) {
+    build(begin, end, threads, [](size_t, size_t, const ForwardIt &) {});
+  }
 
-    for (auto it = begin; it < end; it++) {
-      offsets.push_back(*it);
+  /**
+   * Builds permutations vector on elements in [begin, end) like build(begin,
+   * end, threads). Additionally invokes visit(chunk, i, it) for every element
+   * it = begin + i while it is read anyways, which allows callers to fuse
+   * their own per element computations into this pass. Elements of the same
+   * chunk are visited in order and on the same thread.
+   *
+   * @param stats if not nullptr, time spent in the first (visiting) and
+   *   second (packing) pass is added to stats->scan_ns and stats->pack_ns
+   */
+  template <class ForwardIt, class Visitor>
+  void build(const ForwardIt &begin, const ForwardIt &end,
+             const size_t threads, const Visitor &visit,
+             BuildStats *stats = nullptr) {
+    _size = std::distance(begin, end);
 
-      if constexpr (F::size > 0) {
-        fingerprint_bits.push_back(_fingerprinter.fingerprint(it.key()));
-      }
+    // first pass: visit elements and determine the offsets' bit width
+    std::vector<uint64_t> chunk_max_offsets(std::max<size_t>(threads, 1), 0);
+    {
+      const PhaseTimer timer(stats != nullptr ? &stats->scan_ns : nullptr);
+      parallel_for(_size, threads, [&](size_t c, size_t b, size_t e) {
+        // accumulate locally to avoid false sharing between chunks
+        uint64_t max_offset = 0;
+        for (size_t j = b; j < e; j++) {
+          const auto it = begin + j;
+          max_offset = std::max<uint64_t>(max_offset, *it);
+          visit(c, j, it);
+        }
+        chunk_max_offsets[c] = max_offset;
+      });
     }
 
-    ci::ByteBuffer result;
+    const int offsets_bit_width = ci::BitWidth<uint64_t>(
+        *std::max_element(chunk_max_offsets.begin(), chunk_max_offsets.end()));
+
+    const PhaseTimer timer(stats != nullptr ? &stats->pack_ns : nullptr);
+    // second pass: storage pulls batches of offsets and fingerprint bits,
+    // which are packed directly into their final location. Fingerprints are
+    // always packed with F::size bits, i.e., need not be known upfront
+    _storage.build(
+        _size, offsets_bit_width, F::size,
+        [&](size_t first, size_t count, uint64_t *offsets,
+            uint64_t *fingerprint_bits) {
+          for (size_t k = 0; k < count; k++) offsets[k] = *(begin + first + k);
+
+          if constexpr (F::size > 0) {
+            if (fingerprint_bits == nullptr) return;
+
+            // hash keys of an entire batch at once, which may be vectorized
+            for (size_t i = 0; i < count; i += fingerprint_batch_size) {
+              const size_t cnt = std::min(fingerprint_batch_size, count - i);
+              typename F::value_type keys[fingerprint_batch_size];
+              for (size_t k = 0; k < cnt; k++)
+                keys[k] = (begin + first + i + k).key();
+              _fingerprinter.fingerprint_batch(keys, cnt,
+                                               fingerprint_bits + i);
+            }
+          }
+        },
+        threads);
+  }
 
-    const int offsets_bit_width = ci::MaxBitWidth<uint64_t>(offsets);
-    ci::StoreBitPacked<uint64_t>(offsets, offsets_bit_width, &result);
+  /// Index based access into permutations vector
+  Value operator[](const size_t &index) const {
+    return *PermIterator(*this, index);
+  }
 
-    int fingerprint_bits_bit_width;
-    size_t fingerprint_bits_pos;
-    if constexpr (F::size > 0) {
-      fingerprint_bits_bit_width = ci::MaxBitWidth<uint64_t>(fingerprint_bits);
-      fingerprint_bits_pos = result.pos();
-      ci::StoreBitPacked<uint64_t>(fingerprint_bits, fingerprint_bits_bit_width,
-                                   &result);
-    }
+  /// Prefetches the packed bytes of entry index into cache
+  forceinline void prefetch(const size_t &index) const {
+    _storage.prefetch(index);
+  }
 
-    PutSlopBytes(&result);
+  /// Offset into the original data stored at index, skipping fingerprint bits
+  forceinline uint64_t offset(const size_t &index) const {
+    return _storage.offset(index);
+  }
 
-    _data = std::string(result.data(), result.pos());
-    _offsets_reader =
-        ci::BitPackedReader<uint64_t>(offsets_bit_width, _data.data());
+  /// offset() decoding with a compile time bit width, which must equal
+  /// offsets_bit_width(). Only supported by Storage::fixed_width storages
+  template <int bit_width>
+  forceinline uint64_t offset(const size_t &index) const {
+    return _storage.template offset<bit_width>(index);
+  }
 
-    if constexpr (F::size > 0) {
-      _fingerprint_bits_reader = ci::BitPackedReader<uint64_t>(
-          fingerprint_bits_bit_width, _data.data() + fingerprint_bits_pos);
-    }
+  /// Bit width all offsets are packed with, see Storage::fixed_width
+  [[nodiscard]] int offsets_bit_width() const {
+    return _storage.offsets_bit_width();
   }
 
-  /// Index based access into permutations vector
-  Value operator[](const size_t &index) const {
-    return *PermIterator(*this, index);
+  /// Bit width all fingerprint bits are packed with, see Storage::fixed_width
+  [[nodiscard]] int fingerprint_bits_bit_width() const {
+    return _storage.fingerprint_bits_bit_width();
+  }
+
+  /// Bulk decodes offsets [first, first + count) into out, skipping
+  /// fingerprint bits
+  void decode(const size_t first, const size_t count,
+              std::uint64_t *out) const {
+    _storage.decode(first, count, out);
   }
 
   /// Tests whether a key k matches the fingerprint bits stored in value v
@@ -168,6 +243,49 @@ class PermVector {
     return _fingerprinter.test(k, v.fingerprint_bits);
   }
 
+  /// Fingerprint bits expected for key k. Compute once per lookup and pass
+  /// to match() to avoid rehashing k for every candidate
+  template <class K>
+  forceinline uint64_t fingerprint(const K &k) const {
+    return _fingerprinter.fingerprint(k);
+  }
+
+  /**
+   * Matches the fingerprint bits of up to 64 consecutive entries
+   * [first, first + count) against print in one go
+   *
+   * @returns bitmask in which bit k is set iff entry first + k carries
+   *   fingerprint bits print
+   */
+  forceinline uint64_t match(const uint64_t print, const size_t first,
+                             const size_t count) const {
+    static_assert(F::size > 0, "no fingerprint bits to match");
+    return _storage.match(print, first, count);
+  }
+
+  /// match() with a compile time bit width, which must equal
+  /// fingerprint_bits_bit_width(). Only supported by Storage::fixed_width
+  /// storages
+  template <int bit_width>
+  forceinline uint64_t match(const uint64_t print, const size_t first,
+                             const size_t count) const {
+    static_assert(F::size > 0, "no fingerprint bits to match");
+    return _storage.template match<bit_width>(print, first, count);
+  }
+
+  /// Serializes this PermVector, see Storage::save()
+  void save(Writer &out) const {
+    out.write<std::uint64_t>(_size);
+    _storage.save(out);
+  }
+
+  /// Restores a PermVector written by save() without copying its packed
+  /// bytes, i.e., in's memory must outlive this PermVector
+  void load(Reader &in) {
+    _size = in.read<std::uint64_t>();
+    _storage.load(in);
+  }
+
   /// Iterator to first entry in PermVector
   PermIterator begin() const { return PermIterator(*this, 0); }
 
@@ -179,11 +297,11 @@ class PermVector {
 
   /// Total memory occupied by this PermVector in bytes
   [[nodiscard]] size_t byte_size() const {
-    return sizeof(PermVector) + _data.size();
+    return sizeof(PermVector) + _storage.byte_size();
   }
 
   friend bool operator==(const PermVector &a, const PermVector &b) {
-    return a._data == b._data && a._size == b._size;
+    return a._storage == b._storage && a._size == b._size;
   }
 
   friend bool operator!=(const PermVector &a, const PermVector &b) {
@@ -0,0 +1,355 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace learned_secondary_index::util {
+/// Inputs shorter than this are sorted by sort_row_ids() via std::sort
+static constexpr size_t radix_sort_threshold = 1024;
+
+/**
+ * Sorts row ids [ids, ids + n) ascending. Long inputs are LSD radix sorted
+ * on digits of 11 bits, whose counters fit into L1. Only as many passes as
+ * the largest id's bit width requires are performed, and passes in which all
+ * ids share their digit are skipped. All digits are counted in a single
+ * initial pass over the ids.
+ *
+ * @param scratch buffer reused across calls, resized to n if radix sorting
+ */
+inline void sort_row_ids(std::uint64_t *ids, const size_t n,
+                         std::vector<std::uint64_t> &scratch) {
+  if (n < radix_sort_threshold) {
+    std::sort(ids, ids + n);
+    return;
+  }
+
+  constexpr int radix_bits = 11;
+  constexpr size_t radix = size_t{1} << radix_bits;
+  constexpr std::uint64_t mask = radix - 1;
+
+  std::uint64_t bits = 0;
+  for (size_t i = 0; i < n; i++) bits |= ids[i];
+  const int passes =
+      (static_cast<int>(std::bit_width(bits)) + radix_bits - 1) / radix_bits;
+
+  std::vector<size_t> counts(passes * radix, 0);
+  for (size_t i = 0; i < n; i++)
+    for (int p = 0; p < passes; p++)
+      counts[p * radix + ((ids[i] >> (p * radix_bits)) & mask)]++;
+
+  scratch.resize(n);
+  std::uint64_t *src = ids;
+  std::uint64_t *dst = scratch.data();
+  for (int p = 0; p < passes; p++) {
+    const int shift = p * radix_bits;
+    size_t *digit_counts = counts.data() + p * radix;
+    if (digit_counts[(src[0] >> shift) & mask] == n) continue;
+
+    // exclusive prefix sums yield each digit's first output slot
+    size_t sum = 0;
+    for (size_t d = 0; d < radix; d++)
+      sum += std::exchange(digit_counts[d], sum);
+
+    for (size_t i = 0; i < n; i++)
+      dst[digit_counts[(src[i] >> shift) & mask]++] = src[i];
+    std::swap(src, dst);
+  }
+  if (src != ids) std::memcpy(ids, src, n * sizeof(std::uint64_t));
+}
+
+/// sort_row_ids() with a temporary scratch buffer
+inline void sort_row_ids(std::uint64_t *ids, const size_t n) {
+  std::vector<std::uint64_t> scratch;
+  sort_row_ids(ids, n, scratch);
+}
+
+/**
+ * Compressed set of row ids in the style of Roaring bitmaps. Ids are grouped
+ * into chunks of 2^16 consecutive ids, each stored in a container of either
+ * its ids' sorted lower 16 bits (sparse chunks) or a bitmap of 2^16 bits
+ * (dense chunks), whichever is smaller. Sets intersect container by
+ * container, i.e., by merging arrays, probing bitmaps with array elements or
+ * and-ing bitmaps word by word. Ids must be less than 2^48.
+ */
+class RowBitmap {
+ public:
+  static constexpr size_t chunk_bits = 16;
+  /// chunks with more ids are stored as bitmaps such that an array never
+  /// exceeds the 8 KiB of a bitmap
+  static constexpr size_t array_limit = 4096;
+
+ private:
+  static constexpr size_t words = (size_t{1} << chunk_bits) / 64;
+
+  struct Container {
+    std::uint32_t key = 0;
+    std::uint32_t cardinality = 0;
+    /// sorted lower bits, only if cardinality <= array_limit
+    std::vector<std::uint16_t> array;
+    /// bitmap of all ids, only if cardinality > array_limit
+    std::vector<std::uint64_t> bits;
+
+    [[nodiscard]] bool contains(const std::uint16_t low) const {
+      if (bits.empty())
+        return std::binary_search(array.begin(), array.end(), low);
+      return (bits[low / 64] >> (low % 64)) & 1;
+    }
+
+    /// Converts bitmaps of at most array_limit ids into arrays
+    void shrink() {
+      if (bits.empty() || cardinality > array_limit) return;
+      array.clear();
+      for_each([&](const std::uint16_t low) { array.push_back(low); });
+      bits = {};
+    }
+
+    template <class Fn>
+    void for_each(const Fn &fn) const {
+      if (bits.empty()) {
+        for (const auto low : array) fn(low);
+        return;
+      }
+      for (size_t w = 0; w < words; w++) {
+        for (auto word = bits[w]; word != 0; word &= word - 1)
+          fn(static_cast<std::uint16_t>(w * 64 + std::countr_zero(word)));
+      }
+    }
+
+    [[nodiscard]] size_t byte_size() const {
+      return sizeof(Container) + array.size() * sizeof(std::uint16_t) +
+             bits.size() * sizeof(std::uint64_t);
+    }
+
+    friend bool operator==(const Container &a, const Container &b) = default;
+  };
+
+  /// ordered by key
+  std::vector<Container> _containers;
+  size_t _cardinality = 0;
+
+  static Container intersect(const Container &a, const Container &b) {
+    Container c;
+    c.key = a.key;
+    if (!a.bits.empty() && !b.bits.empty()) {
+      c.bits.resize(words);
+      for (size_t w = 0; w < words; w++) {
+        c.bits[w] = a.bits[w] & b.bits[w];
+        c.cardinality += std::popcount(c.bits[w]);
+      }
+      c.shrink();
+    } else if (a.bits.empty() && b.bits.empty()) {
+      std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(),
+                            b.array.end(), std::back_inserter(c.array));
+      c.cardinality = c.array.size();
+    } else {
+      const auto &sparse = a.bits.empty() ? a : b;
+      const auto &dense = a.bits.empty() ? b : a;
+      for (const auto low : sparse.array)
+        if (dense.contains(low)) c.array.push_back(low);
+      c.cardinality = c.array.size();
+    }
+    return c;
+  }
+
+ public:
+  RowBitmap() = default;
+
+  /// Constructs the set of ids [ids, ids + n), see assign_sorted()
+  RowBitmap(const std::uint64_t *ids, const size_t n) {
+    assign_sorted(ids, n);
+  }
+
+  /**
+   * Replaces this set's ids with [ids, ids + n), which must be sorted
+   * ascending, e.g., by sort_row_ids(). Duplicates are retained once
+   */
+  void assign_sorted(const std::uint64_t *ids, const size_t n) {
+    _containers.clear();
+    _cardinality = 0;
+
+    for (size_t i = 0; i < n;) {
+      assert(ids[i] >> (32 + chunk_bits) == 0);
+      const auto key = static_cast<std::uint32_t>(ids[i] >> chunk_bits);
+      size_t j = i;
+      while (j < n && ids[j] >> chunk_bits == key) j++;
+
+      Container c;
+      c.key = key;
+      if (j - i <= array_limit) {
+        for (size_t k = i; k < j; k++) {
+          const auto low = static_cast<std::uint16_t>(ids[k]);
+          if (c.array.empty() || c.array.back() != low) c.array.push_back(low);
+        }
+        c.cardinality = c.array.size();
+      } else {
+        c.bits.resize(words);
+        for (size_t k = i; k < j; k++) {
+          const auto low = static_cast<std::uint16_t>(ids[k]);
+          c.bits[low / 64] |= std::uint64_t{1} << (low % 64);
+        }
+        for (const auto word : c.bits) c.cardinality += std::popcount(word);
+        c.shrink();
+      }
+
+      _cardinality += c.cardinality;
+      _containers.push_back(std::move(c));
+      i = j;
+    }
+  }
+
+  /**
+   * Replaces this set's ids with [ids, ids + n) in any order, e.g., as
+   * decoded from a permutation vector. Instead of sorting all ids, they are
+   * counted per chunk and then scattered into their chunk's bitmap or array,
+   * of which only the latter's at most array_limit lower bits are sorted.
+   * Duplicates are retained once
+   */
+  void assign(const std::uint64_t *ids, const size_t n) {
+    _containers.clear();
+    _cardinality = 0;
+    if (n == 0) return;
+
+    const auto [min_id, max_id] = std::minmax_element(ids, ids + n);
+    assert(*max_id >> (32 + chunk_bits) == 0);
+    const auto min_key = static_cast<std::uint32_t>(*min_id >> chunk_bits);
+    const size_t span = (*max_id >> chunk_bits) - min_key + 1;
+
+    // containers of chunks are addressed directly unless they are sparse
+    // within [min_key, min_key + span), e.g., for few far apart ids
+    constexpr auto none = std::numeric_limits<std::uint32_t>::max();
+    std::vector<std::uint32_t> direct(span <= n ? span : 0, none);
+    std::unordered_map<std::uint32_t, std::uint32_t> hashed;
+    std::vector<size_t> counts;
+    const auto slot_of = [&](const std::uint64_t id) {
+      const auto key = static_cast<std::uint32_t>(id >> chunk_bits);
+      auto &slot = direct.empty() ? hashed.try_emplace(key, none).first->second
+                                  : direct[key - min_key];
+      if (slot == none) {
+        slot = _containers.size();
+        _containers.emplace_back().key = key;
+        counts.push_back(0);
+      }
+      return slot;
+    };
+
+    for (size_t i = 0; i < n; i++) counts[slot_of(ids[i])]++;
+    for (size_t c = 0; c < _containers.size(); c++) {
+      if (counts[c] > array_limit)
+        _containers[c].bits.resize(words);
+      else
+        _containers[c].array.reserve(counts[c]);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      auto &c = _containers[slot_of(ids[i])];
+      const auto low = static_cast<std::uint16_t>(ids[i]);
+      if (c.bits.empty())
+        c.array.push_back(low);
+      else
+        c.bits[low / 64] |= std::uint64_t{1} << (low % 64);
+    }
+
+    for (auto &c : _containers) {
+      if (c.bits.empty()) {
+        std::sort(c.array.begin(), c.array.end());
+        c.array.erase(std::unique(c.array.begin(), c.array.end()),
+                      c.array.end());
+        c.cardinality = c.array.size();
+      } else {
+        for (const auto word : c.bits) c.cardinality += std::popcount(word);
+        c.shrink();
+      }
+      _cardinality += c.cardinality;
+    }
+    std::sort(
+        _containers.begin(), _containers.end(),
+        [](const Container &a, const Container &b) { return a.key < b.key; });
+  }
+
+  [[nodiscard]] bool contains(const std::uint64_t id) const {
+    const auto key = static_cast<std::uint32_t>(id >> chunk_bits);
+    const auto it = std::lower_bound(
+        _containers.begin(), _containers.end(), key,
+        [](const Container &c, const std::uint32_t k) { return c.key < k; });
+    return it != _containers.end() && it->key == key &&
+           it->contains(static_cast<std::uint16_t>(id));
+  }
+
+  /// Invokes fn(id) for every id of this set in ascending order
+  template <class Fn>
+  void for_each(const Fn &fn) const {
+    for (const auto &c : _containers) {
+      const std::uint64_t high = std::uint64_t{c.key} << chunk_bits;
+      c.for_each([&](const std::uint16_t low) { fn(high | low); });
+    }
+  }
+
+  /// All ids of this set in ascending order
+  [[nodiscard]] std::vector<std::uint64_t> row_ids() const {
+    std::vector<std::uint64_t> ids;
+    ids.reserve(_cardinality);
+    for_each([&](const std::uint64_t id) { ids.push_back(id); });
+    return ids;
+  }
+
+  /// Amount of ids within this set
+  [[nodiscard]] size_t cardinality() const { return _cardinality; }
+
+  [[nodiscard]] bool empty() const { return _cardinality == 0; }
+
+  /// Amount of non empty chunks
+  [[nodiscard]] size_t container_count() const { return _containers.size(); }
+
+  /// Amount of chunks stored as bitmaps
+  [[nodiscard]] size_t bitmap_count() const {
+    return std::count_if(_containers.begin(), _containers.end(),
+                         [](const Container &c) { return !c.bits.empty(); });
+  }
+
+  [[nodiscard]] size_t byte_size() const {
+    size_t bytes = sizeof(RowBitmap);
+    for (const auto &c : _containers) bytes += c.byte_size();
+    return bytes;
+  }
+
+  /// Ids contained in both a and b
+  friend RowBitmap operator&(const RowBitmap &a, const RowBitmap &b) {
+    RowBitmap out;
+    for (size_t i = 0, j = 0;
+         i < a._containers.size() && j < b._containers.size();) {
+      const auto &ca = a._containers[i];
+      const auto &cb = b._containers[j];
+      if (ca.key < cb.key) {
+        i++;
+        continue;
+      }
+      if (cb.key < ca.key) {
+        j++;
+        continue;
+      }
+
+      auto c = intersect(ca, cb);
+      if (c.cardinality > 0) {
+        out._cardinality += c.cardinality;
+        out._containers.push_back(std::move(c));
+      }
+      i++;
+      j++;
+    }
+    return out;
+  }
+
+  friend bool operator==(const RowBitmap &a, const RowBitmap &b) {
+    return a._cardinality == b._cardinality && a._containers == b._containers;
+  }
+};
+}  // namespace learned_secondary_index::util
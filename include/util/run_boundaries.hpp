@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#include "parallel.hpp"
+#include "serialization.hpp"
+#include "support.hpp"
+
+namespace learned_secondary_index::util {
+/**
+ * Encodes where runs of equal keys start and end within a sorted sequence.
+ * One bit per position marks the first position of every run. Since runs
+ * longer than long_run_length would otherwise require scanning many words,
+ * their bounds are additionally retained in a small, sorted table. Both
+ * structures together answer run_end() in O(1) for short and O(log #long
+ * runs) for long runs, without ever accessing keys.
+ */
+class RunBoundaries {
+  /// [first, last) of a run, trivially copyable for (de)serialization
+  struct Run {
+    std::uint64_t first;
+    std::uint64_t last;
+
+    friend bool operator==(const Run &, const Run &) = default;
+  };
+  static_assert(std::is_trivially_copyable_v<Run>);
+
+  /// bit i is set iff position i starts a run. Bit size() is set as sentinel
+  std::vector<std::uint64_t> _starts;
+  /// [first, last) of every run containing at least long_run_length keys
+  std::vector<Run> _long_runs;
+
+ public:
+  static constexpr size_t long_run_length = 512;
+
+  /**
+   * Encodes runs of [first, last), which must be sorted by it->first, e.g.,
+   * (key, offset) pairs. Bits are determined on up to `threads` chunks in
+   * parallel.
+   */
+  template <class RandomIt>
+  void build(const RandomIt &first, const RandomIt &last,
+             const size_t threads = 1) {
+    const size_t n = std::distance(first, last);
+    _starts.assign(n / 64 + 1, 0);
+
+    // chunks of entire words never write the same word
+    parallel_for(_starts.size(), threads, [&](size_t, size_t b, size_t e) {
+      for (size_t w = b; w < e; w++) {
+        std::uint64_t word = 0;
+        for (size_t i = w * 64; i < std::min(n, (w + 1) * 64); i++) {
+          const bool start =
+              i == 0 || (first + i)->first != (first + i - 1)->first;
+          word |= static_cast<std::uint64_t>(start) << (i % 64);
+        }
+        _starts[w] = word;
+      }
+    });
+    _starts[n / 64] |= 0x1LLU << (n % 64);
+
+    // long runs are rare, i.e., collecting them serially is cheap
+    _long_runs.clear();
+    size_t run_start = 0;
+    for (size_t w = 0; w < _starts.size(); w++) {
+      for (auto word = _starts[w]; word != 0; word &= word - 1) {
+        const size_t pos = w * 64 + ctz(word);
+        if (pos == 0) continue;
+        if (pos - run_start >= long_run_length)
+          _long_runs.push_back({run_start, pos});
+        run_start = pos;
+      }
+    }
+  }
+
+  /// Past-the-end position of the run starting at run_start
+  [[nodiscard]] forceinline size_t run_end(const size_t run_start) const {
+    // runs shorter than long_run_length end at most at this position
+    const size_t limit = run_start + long_run_length;
+
+    size_t w = (run_start + 1) / 64;
+    std::uint64_t word = _starts[w] & (~0x0LLU << ((run_start + 1) % 64));
+    while (word == 0 && (w + 1) * 64 <= limit) word = _starts[++w];
+    if (word != 0 && w * 64 + ctz(word) <= limit) return w * 64 + ctz(word);
+
+    const auto it = std::upper_bound(
+        _long_runs.begin(), _long_runs.end(), run_start,
+        [](const size_t pos, const auto &run) { return pos < run.first; });
+    return std::prev(it)->last;
+  }
+
+  [[nodiscard]] size_t long_runs() const { return _long_runs.size(); }
+
+  [[nodiscard]] size_t byte_size() const {
+    return _starts.size() * sizeof(std::uint64_t) +
+           _long_runs.size() * sizeof(_long_runs[0]);
+  }
+
+  /// Serializes bits and long runs, see RunBoundaries::load()
+  void save(Writer &out) const {
+    out.write<std::uint64_t>(_starts.size());
+    out.write_bytes(reinterpret_cast<const char *>(_starts.data()),
+                    _starts.size() * sizeof(std::uint64_t));
+    out.write<std::uint64_t>(_long_runs.size());
+    out.write_bytes(reinterpret_cast<const char *>(_long_runs.data()),
+                    _long_runs.size() * sizeof(_long_runs[0]));
+  }
+
+  /// Restores RunBoundaries written by save()
+  void load(Reader &in) {
+    _starts.resize(in.read<std::uint64_t>());
+    const char *starts = in.read_bytes(_starts.size() * sizeof(std::uint64_t));
+    if (!_starts.empty())
+      std::memcpy(_starts.data(), starts,
+                  _starts.size() * sizeof(std::uint64_t));
+
+    _long_runs.resize(in.read<std::uint64_t>());
+    const char *runs = in.read_bytes(_long_runs.size() * sizeof(_long_runs[0]));
+    if (!_long_runs.empty())
+      std::memcpy(_long_runs.data(), runs,
+                  _long_runs.size() * sizeof(_long_runs[0]));
+  }
+
+  friend bool operator==(const RunBoundaries &a, const RunBoundaries &b) {
+    return a._starts == b._starts && a._long_runs == b._long_runs;
+  }
+};
+}  // namespace learned_secondary_index::util
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace learned_secondary_index::util {
+/// Alignment of bulk payloads (e.g., packed bytes) within serialized files
+static constexpr size_t payload_alignment = 64;
+
+/**
+ * Sequentially writes a binary file. Multi-byte values are written in host
+ * byte order, i.e., files are only portable between machines of the same
+ * endianness
+ */
+class Writer {
+  std::ofstream _out;
+  std::string _path;
+  size_t _pos = 0;
+
+ public:
+  explicit Writer(const std::string &path)
+      : _out(path, std::ios::binary | std::ios::trunc), _path(path) {
+    if (!_out.is_open())
+      throw std::runtime_error("Failed to open '" + path + "' for writing");
+  }
+
+  template <class T>
+  void write(const T &value) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "only trivially copyable values may be written directly");
+    write_bytes(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  void write_bytes(const char *data, const size_t size) {
+    _out.write(data, static_cast<std::streamsize>(size));
+    if (!_out) throw std::runtime_error("Failed to write '" + _path + "'");
+    _pos += size;
+  }
+
+  /// Writes a length prefixed string
+  void write_string(const std::string &str) {
+    write<std::uint64_t>(str.size());
+    write_bytes(str.data(), str.size());
+  }
+
+  /// Pads with zero bytes until the current position is a multiple of
+  /// payload_alignment
+  void align() {
+    static constexpr char zeros[payload_alignment] = {};
+    write_bytes(zeros, (payload_alignment - _pos % payload_alignment) %
+                           payload_alignment);
+  }
+};
+
+/**
+ * Sequentially reads from a memory range, e.g., a MappedFile. Bulk payloads
+ * are not copied but handed out as pointers into the range
+ */
+class Reader {
+  const char *_data;
+  size_t _size;
+  size_t _pos = 0;
+
+  void ensure(const size_t size) const {
+    if (size > _size - _pos)
+      throw std::runtime_error("Serialized data is truncated");
+  }
+
+ public:
+  Reader(const char *data, const size_t size) : _data(data), _size(size) {}
+
+  template <class T>
+  T read() {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "only trivially copyable values may be read directly");
+    T value;
+    std::memcpy(&value, read_bytes(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  /// Pointer to the next size bytes, which are skipped
+  const char *read_bytes(const size_t size) {
+    ensure(size);
+    const char *ptr = _data + _pos;
+    _pos += size;
+    return ptr;
+  }
+
+  /// Reads a length prefixed string
+  std::string read_string() {
+    const auto size = read<std::uint64_t>();
+    const char *ptr = read_bytes(size);
+    return {ptr, size};
+  }
+
+  /// Skips padding written by Writer::align()
+  void align() {
+    read_bytes((payload_alignment - _pos % payload_alignment) %
+               payload_alignment);
+  }
+};
+
+/**
+ * Identifies T's representation within serialized files, i.e., whether it is
+ * an unsigned or signed integer, a floating point number or another (e.g.,
+ * string) type, as well as its size. Types with equal tags are only
+ * distinguished by their names, e.g., via an index' name()
+ */
+template <class T>
+constexpr std::uint32_t type_tag() {
+  constexpr std::uint32_t kind = std::is_floating_point_v<T>   ? 3
+                                 : std::is_signed_v<T>         ? 2
+                                 : std::is_integral_v<T>       ? 1
+                                                               : 4;
+  return kind << 16 | static_cast<std::uint32_t>(sizeof(T));
+}
+
+/// Models persisting their parameters themselves via member hooks
+template <class Model>
+concept SerializableModel = requires(const Model &model, Model &target,
+                                     Writer &out, Reader &in) {
+  model.save(out);
+  target.load(in);
+};
+
+/**
+ * Persists models within index files. Models implementing the
+ * SerializableModel hooks are stored via save() and restored via load(),
+ * trivially copyable models are stored verbatim. Specialize for models that
+ * can't implement hooks themselves. Unsupported models must be retrained
+ * from the indexed keys instead
+ */
+template <class Model>
+struct ModelSerializer {
+  static constexpr bool supported =
+      SerializableModel<Model> || std::is_trivially_copyable_v<Model>;
+
+  static void save(Writer &out, const Model &model) {
+    if constexpr (SerializableModel<Model>) {
+      model.save(out);
+    } else {
+      static_assert(supported, "model is not serializable");
+      out.write(model);
+    }
+  }
+
+  static void load(Reader &in, Model &model) {
+    if constexpr (SerializableModel<Model>) {
+      model.load(in);
+    } else {
+      static_assert(supported, "model is not serializable");
+      model = in.read<Model>();
+    }
+  }
+};
+
+/// Read only, shared memory mapping of an entire file
+class MappedFile {
+  const char *_data = nullptr;
+  size_t _size = 0;
+
+ public:
+  explicit MappedFile(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Failed to open '" + path + "'");
+
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw std::runtime_error("Failed to stat '" + path + "'");
+    }
+    _size = static_cast<size_t>(st.st_size);
+
+    if (_size > 0) {
+      void *addr = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+      if (addr == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("Failed to mmap '" + path + "'");
+      }
+      _data = static_cast<const char *>(addr);
+    }
+
+    // mapping remains valid after closing its file descriptor
+    ::close(fd);
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile() {
+    if (_data != nullptr) ::munmap(const_cast<char *>(_data), _size);
+  }
+
+  [[nodiscard]] const char *data() const { return _data; }
+
+  [[nodiscard]] size_t size() const { return _size; }
+};
+
+/**
+ * Read-only view of a dataset file in SOSD format, i.e., a uint64 key count
+ * followed by that many keys in host byte order. Keys are mapped instead of
+ * loaded, i.e., only occupy page cache while being read
+ */
+template <class Key>
+class MappedKeys {
+  static_assert(std::is_trivially_copyable_v<Key>,
+                "only trivially copyable keys may be mapped");
+
+  MappedFile _file;
+  const Key *_keys = nullptr;
+  size_t _size = 0;
+
+ public:
+  /// @throws std::runtime_error if path can't be mapped or is truncated
+  explicit MappedKeys(const std::string &path) : _file(path) {
+    if (_file.size() < sizeof(std::uint64_t))
+      throw std::runtime_error("'" + path + "' lacks a key count header");
+
+    std::uint64_t size = 0;
+    std::memcpy(&size, _file.data(), sizeof(size));
+    if (size > (_file.size() - sizeof(size)) / sizeof(Key))
+      throw std::runtime_error("'" + path + "' is truncated");
+
+    _size = size;
+    _keys = reinterpret_cast<const Key *>(_file.data() + sizeof(size));
+  }
+
+  [[nodiscard]] const Key *begin() const { return _keys; }
+
+  [[nodiscard]] const Key *end() const { return _keys + _size; }
+
+  [[nodiscard]] size_t size() const { return _size; }
+
+  const Key &operator[](const size_t i) const { return _keys[i]; }
+};
+}  // namespace learned_secondary_index::util
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include "../convenience/builtins.hpp"
+#include "bitpacking/bit_packing.h"
+
+namespace learned_secondary_index::util {
+/**
+ * Compares count <= 64 consecutive values [first, first + count) of a
+ * bit-packed array (see ci::StoreBitPacked) against needle. Uses AVX-512 or
+ * AVX2 gathers if available, falling back to scalar code otherwise.
+ *
+ * @param data start of the bit-packed array. Must be followed by slop bytes
+ * @param bit_width width of each packed value, at most
+ *   ci::internal::kMaxSingleWordBitWidth
+ *
+ * @returns bitmask in which bit k is set iff value first + k equals needle
+ */
+forceinline std::uint64_t match_bit_packed(const char *data,
+                                           const int bit_width,
+                                           const size_t first,
+                                           const size_t count,
+                                           const std::uint64_t needle) {
+  assert(count <= 64);
+  assert(bit_width <= ci::internal::kMaxSingleWordBitWidth);
+
+  const std::uint64_t mask = ci::internal::FastBitMask(bit_width);
+  std::uint64_t matches = 0;
+  size_t k = 0;
+
+#if defined(__AVX512F__)
+  const auto w = static_cast<std::int64_t>(bit_width);
+  const auto b = static_cast<std::int64_t>(first * bit_width);
+  __m512i bits = _mm512_set_epi64(b + 7 * w, b + 6 * w, b + 5 * w, b + 4 * w,
+                                  b + 3 * w, b + 2 * w, b + w, b);
+  const __m512i step = _mm512_set1_epi64(8 * w);
+  const __m512i vmask = _mm512_set1_epi64(static_cast<std::int64_t>(mask));
+  const __m512i vneedle = _mm512_set1_epi64(static_cast<std::int64_t>(needle));
+  const __m512i seven = _mm512_set1_epi64(7);
+
+  for (; k + 8 <= count; k += 8) {
+    const __m512i words =
+        _mm512_i64gather_epi64(_mm512_srli_epi64(bits, 3), data, 1);
+    const __m512i vals = _mm512_and_si512(
+        _mm512_srlv_epi64(words, _mm512_and_si512(bits, seven)), vmask);
+    matches |= static_cast<std::uint64_t>(
+                   _mm512_cmpeq_epi64_mask(vals, vneedle))
+               << k;
+    bits = _mm512_add_epi64(bits, step);
+  }
+#elif defined(__AVX2__)
+  const auto w = static_cast<std::int64_t>(bit_width);
+  const auto b = static_cast<std::int64_t>(first * bit_width);
+  __m256i bits = _mm256_set_epi64x(b + 3 * w, b + 2 * w, b + w, b);
+  const __m256i step = _mm256_set1_epi64x(4 * w);
+  const __m256i vmask = _mm256_set1_epi64x(static_cast<std::int64_t>(mask));
+  const __m256i vneedle =
+      _mm256_set1_epi64x(static_cast<std::int64_t>(needle));
+  const __m256i seven = _mm256_set1_epi64x(7);
+  const auto *base = reinterpret_cast<const long long *>(data);  // NOLINT
+
+  for (; k + 4 <= count; k += 4) {
+    const __m256i words =
+        _mm256_i64gather_epi64(base, _mm256_srli_epi64(bits, 3), 1);
+    const __m256i vals = _mm256_and_si256(
+        _mm256_srlv_epi64(words, _mm256_and_si256(bits, seven)), vmask);
+    const int eq = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(vals, vneedle)));
+    matches |= static_cast<std::uint64_t>(eq) << k;
+    bits = _mm256_add_epi64(bits, step);
+  }
+#endif
+
+  // scalar fallback & remainder
+  for (; k < count; k++) {
+    const size_t bit = (first + k) * bit_width;
+    const std::uint64_t val =
+        (absl::little_endian::Load64(data + (bit >> 3)) >> (bit & 0x7)) & mask;
+    matches |= static_cast<std::uint64_t>(val == needle) << k;
+  }
+
+  return matches;
+}
+
+/**
+ * Compares the low bits selected by mask of count <= 64 values at data +
+ * (first + k) * stride, k < count, against needle, i.e., one gather per
+ * eight (AVX-512) or four (AVX2) values of a byte aligned array of structs.
+ *
+ * @param data start of the array. Must be followed by slop bytes
+ * @param stride bytes between consecutive values
+ *
+ * @returns bitmask in which bit k is set iff value first + k equals needle
+ */
+forceinline std::uint64_t match_strided(const char *data, const size_t stride,
+                                        const size_t first, const size_t count,
+                                        const std::uint64_t mask,
+                                        const std::uint64_t needle) {
+  assert(count <= 64);
+
+  std::uint64_t matches = 0;
+  size_t k = 0;
+
+#if defined(__AVX512F__)
+  const auto s = static_cast<std::int64_t>(stride);
+  const auto b = static_cast<std::int64_t>(first * stride);
+  __m512i pos = _mm512_set_epi64(b + 7 * s, b + 6 * s, b + 5 * s, b + 4 * s,
+                                 b + 3 * s, b + 2 * s, b + s, b);
+  const __m512i step = _mm512_set1_epi64(8 * s);
+  const __m512i vmask = _mm512_set1_epi64(static_cast<std::int64_t>(mask));
+  const __m512i vneedle = _mm512_set1_epi64(static_cast<std::int64_t>(needle));
+
+  for (; k + 8 <= count; k += 8) {
+    const __m512i vals =
+        _mm512_and_si512(_mm512_i64gather_epi64(pos, data, 1), vmask);
+    matches |= static_cast<std::uint64_t>(
+                   _mm512_cmpeq_epi64_mask(vals, vneedle))
+               << k;
+    pos = _mm512_add_epi64(pos, step);
+  }
+#elif defined(__AVX2__)
+  const auto s = static_cast<std::int64_t>(stride);
+  const auto b = static_cast<std::int64_t>(first * stride);
+  __m256i pos = _mm256_set_epi64x(b + 3 * s, b + 2 * s, b + s, b);
+  const __m256i step = _mm256_set1_epi64x(4 * s);
+  const __m256i vmask = _mm256_set1_epi64x(static_cast<std::int64_t>(mask));
+  const __m256i vneedle =
+      _mm256_set1_epi64x(static_cast<std::int64_t>(needle));
+  const auto *base = reinterpret_cast<const long long *>(data);  // NOLINT
+
+  for (; k + 4 <= count; k += 4) {
+    const __m256i vals =
+        _mm256_and_si256(_mm256_i64gather_epi64(base, pos, 1), vmask);
+    const int eq = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(vals, vneedle)));
+    matches |= static_cast<std::uint64_t>(eq) << k;
+    pos = _mm256_add_epi64(pos, step);
+  }
+#endif
+
+  // scalar fallback & remainder
+  for (; k < count; k++) {
+    const std::uint64_t val =
+        absl::little_endian::Load64(data + (first + k) * stride) & mask;
+    matches |= static_cast<std::uint64_t>(val == needle) << k;
+  }
+
+  return matches;
+}
+
+/**
+ * Computes out[i] = keys[i] * multiplier (mod 2^64) for all i < n, eight
+ * (AVX-512DQ) or four (AVX2) keys per instruction if available.
+ */
+forceinline void multiply_batch(const std::uint64_t *keys, const size_t n,
+                                const std::uint64_t multiplier,
+                                std::uint64_t *out) {
+  size_t i = 0;
+
+#if defined(__AVX512DQ__)
+  const __m512i vmul = _mm512_set1_epi64(static_cast<std::int64_t>(multiplier));
+  for (; i + 8 <= n; i += 8) {
+    const __m512i k = _mm512_loadu_si512(keys + i);
+    _mm512_storeu_si512(out + i, _mm512_mullo_epi64(k, vmul));
+  }
+#elif defined(__AVX2__)
+  // 64 bit products from 32 bit multiplications: lo * lo + (hi * lo + lo *
+  // hi) << 32, since hi * hi vanishes mod 2^64
+  const __m256i vmul_lo =
+      _mm256_set1_epi64x(static_cast<std::int64_t>(multiplier));
+  const __m256i vmul_hi =
+      _mm256_set1_epi64x(static_cast<std::int64_t>(multiplier >> 32));
+  for (; i + 4 <= n; i += 4) {
+    const __m256i k =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i));
+    const __m256i lo = _mm256_mul_epu32(k, vmul_lo);
+    const __m256i cross =
+        _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(k, 32), vmul_lo),
+                         _mm256_mul_epu32(k, vmul_hi));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+                        _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32)));
+  }
+#endif
+
+  // scalar fallback & remainder
+  for (; i < n; i++) out[i] = keys[i] * multiplier;
+}
+}  // namespace learned_secondary_index::util
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "instrumentation.hpp"
+
+namespace learned_secondary_index::util {
+/**
+ * Tuning objective and cost model constants, see TunedLearnedSecondaryIndex.
+ * Latencies are predictions of a simple analytical model, i.e., are only
+ * meaningful relative to each other unless the constants are calibrated to
+ * the machine at hand.
+ */
+struct TunerOptions {
+  /// max predicted index bytes, 0 for unbounded
+  size_t memory_budget = 0;
+  /// if > 0, the smallest candidate predicted to meet this per lookup
+  /// latency in nanoseconds is chosen instead of the fastest one
+  double latency_target = 0;
+  /// keys sampled to evaluate candidates. All keys are used if fewer exist
+  size_t sample_size = 0x1LLU << 16;
+  /// equality lookups issued against every candidate built on the sample
+  size_t probe_count = 0x1LLU << 12;
+  /// cost of a dependent random memory access, e.g., a base data probe
+  double random_access_ns = 80;
+  /// cost of streaming an additional cache line of permutation entries
+  double sequential_line_ns = 4;
+  /// cost of a model evaluation, including its own cache misses
+  double model_eval_ns = 60;
+  /// seeds drawing the sample
+  std::uint64_t seed = 42;
+};
+
+/// Predicted cost of a candidate configuration on the full data
+struct CandidateEstimate {
+  std::string name;
+  /// predicted index bytes
+  size_t bytes = 0;
+  /// predicted nanoseconds per equality lookup
+  double latency_ns = 0;
+  /// predicted search window size, i.e., permutation entries per lookup
+  double window_size = 0;
+  /// predicted base data accesses per lookup
+  double base_data_accesses = 0;
+};
+
+/**
+ * Predicts the cost of Index on n keys, of which sample is a sorted uniform
+ * random sample. Index is fitted and probed on sample as well as on every
+ * other key of sample, such that size-independent components can be told
+ * apart from components growing with the data: model bytes are extrapolated
+ * linearly between both fits, whereas search windows are extrapolated as a
+ * power of the key count whose exponent is their growth between both fits,
+ * i.e., stay put for error bounded models. False positives grow with the
+ * window, binary searches take log2 of its growth additional steps. Windows
+ * of models whose error bound exceeds the errors observable on the sample
+ * are overestimated, i.e., predictions err on the side of larger windows.
+ *
+ * @tparam Index LearnedSecondaryIndex with util::CountingInstrumentation
+ */
+template <class Index, class Key>
+CandidateEstimate estimate_candidate(const std::vector<Key> &sample,
+                                     const size_t n,
+                                     const TunerOptions &options) {
+  static_assert(Index::instrumentation::enabled,
+                "candidates must record lookup statistics");
+
+  CandidateEstimate estimate{.name = Index::name()};
+  const size_t s = sample.size();
+  if (s == 0) return estimate;
+
+  std::vector<Key> half;
+  half.reserve(s / 2 + 1);
+  for (size_t i = 0; i < s; i += 2) half.push_back(sample[i]);
+
+  const Index small(half.begin(), half.end());
+  const Index index(sample.begin(), sample.end());
+
+  // equality lookups of keys spread across the entire (half) sample
+  const auto probe = [&](const Index &fitted, const std::vector<Key> &keys) {
+    LookupStats stats;
+    const size_t probes =
+        std::max<size_t>(1, std::min(options.probe_count, keys.size()));
+    for (size_t p = 0; p < probes; p++) {
+      const auto &key = keys[p * keys.size() / probes];
+      fitted.template lookup<false>(keys.begin(), keys.end(), key, stats);
+    }
+    return stats;
+  };
+  const LookupStats small_stats = probe(small, half);
+  const LookupStats stats = probe(index, sample);
+
+  const double scale = static_cast<double>(n) / s;
+  const double lookups = std::max<size_t>(stats.lookups, 1);
+  const double sample_window = stats.window_size / lookups;
+  const double half_window =
+      small_stats.window_size /
+      static_cast<double>(std::max<size_t>(small_stats.lookups, 1));
+
+  // window ~ keys^exponent, where 0 means error bounded and 1 means errors
+  // proportional to the key count
+  const double exponent =
+      std::clamp(std::log2(std::max(1.0, sample_window) /
+                           std::max(1.0, half_window)),
+                 0.0, 1.0);
+  const double window_growth = std::pow(scale, exponent);
+  const double window = sample_window * window_growth;
+  const double entry_bits = std::bit_width(n) + Index::fingerprint_width;
+  const double lines = 1 + window / 2 * entry_bits / 512;
+
+  double random_accesses = 0;
+  if constexpr (Index::scans_linearly) {
+    // scans read half of the window on average, whose false positives (all
+    // entries without fingerprints) each probe base data
+    estimate.base_data_accesses =
+        1 + stats.false_positive_accesses / lookups * window_growth;
+    random_accesses = estimate.base_data_accesses + 1;
+    estimate.latency_ns = (lines - 1) * options.sequential_line_ns;
+  } else {
+    // every binary search step probes base data, the permutation entry is
+    // randomly accessed until the remaining window fits a cache line
+    estimate.base_data_accesses =
+        stats.base_data_accesses / lookups + std::log2(window_growth);
+    random_accesses = estimate.base_data_accesses +
+                      std::min(estimate.base_data_accesses,
+                               1 + std::log2(std::max(1.0, 2 * lines - 1)));
+  }
+  estimate.window_size = window;
+  estimate.latency_ns += options.model_eval_ns +
+                         random_accesses * options.random_access_ns;
+
+  // model bytes grow linearly between the two sample sizes
+  const double model = index.model_byte_size();
+  const double growth =
+      std::max(0.0, model - static_cast<double>(small.model_byte_size())) /
+      std::max<size_t>(1, s - half.size());
+  const double sample_entry_bits =
+      std::bit_width(s) + Index::fingerprint_width;
+  estimate.bytes = static_cast<size_t>(
+      model + growth * (static_cast<double>(n) - s) +
+      index.perm_vector_byte_size() * scale * entry_bits / sample_entry_bits +
+      index.filter_byte_size() * scale);
+
+  return estimate;
+}
+
+/**
+ * Chooses among estimates: the smallest candidate within the memory budget
+ * meeting the latency target if there is one, the fastest candidate within
+ * the memory budget otherwise, or the smallest candidate if none fits.
+ *
+ * @returns index into estimates, which must not be empty
+ */
+inline size_t select_candidate(const std::vector<CandidateEstimate> &estimates,
+                               const TunerOptions &options) {
+  const auto fits = [&](const CandidateEstimate &e) {
+    return options.memory_budget == 0 || e.bytes <= options.memory_budget;
+  };
+  const auto meets = [&](const CandidateEstimate &e) {
+    return options.latency_target > 0 && e.latency_ns <= options.latency_target;
+  };
+
+  size_t smallest = 0, smallest_meeting = estimates.size(),
+         fastest_fitting = estimates.size();
+  for (size_t i = 0; i < estimates.size(); i++) {
+    const auto &e = estimates[i];
+    if (e.bytes < estimates[smallest].bytes) smallest = i;
+    if (!fits(e)) continue;
+
+    if (meets(e) && (smallest_meeting == estimates.size() ||
+                     e.bytes < estimates[smallest_meeting].bytes))
+      smallest_meeting = i;
+    if (fastest_fitting == estimates.size() ||
+        e.latency_ns < estimates[fastest_fitting].latency_ns)
+      fastest_fitting = i;
+  }
+
+  if (smallest_meeting < estimates.size()) return smallest_meeting;
+  if (fastest_fitting < estimates.size()) return fastest_fitting;
+  return smallest;
+}
+}  // namespace learned_secondary_index::util
@@ -1,6 +1,11 @@
 #pragma once
 
+#include "include/cached_lsi.hpp"
+#include "include/composite_lsi.hpp"
 #include "include/lsi.hpp"
+#include "include/sharded_lsi.hpp"
+#include "include/tuned_lsi.hpp"
+#include "include/updatable_lsi.hpp"
 
 // Order is important
 #include "include/convenience/undef.hpp"
@@ -1,10 +1,13 @@
 #include "benchmarks.hpp"
 
+#include <git_revision.hpp>  // generated by src/CMakeLists.txt on every build
 #include <learned_hashing.hpp>
 #include <learned_secondary_index.hpp>
 
 #include "src/competitors.hpp"
 #include "src/support/datasets.hpp"
+#include "src/support/perf_counters.hpp"
+#include "src/support/seed.hpp"
 
 // General
 #define SINGLE_ARG(...) __VA_ARGS__
@@ -133,4 +136,421 @@ EXP_5(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 64>))
 EXP_5(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 128>))
 EXP_5(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 256>))
 
-BENCHMARK_MAIN();
+/// Experiment 6: Batched, software pipelined lookups
+#define EXP_6(Index, lowerbound)                                         \
+  BENCHMARK_TEMPLATE(BatchedLookup, SINGLE_ARG(Index), lowerbound)       \
+      ->ArgsProduct({dataset_sizes,                                      \
+                     {static_cast<std::underlying_type_t<dataset::ID>>(  \
+                         dataset::ID::BOOKS)},                           \
+                     probe_distributions,                                \
+                     {1, 16, 256, 4096}})                                \
+      ->Iterations(10000);
+
+EXP_6(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                 Key, learned_hashing::TrieSplineHash<Key, 16>, 0>),
+      true)
+EXP_6(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                 Key, learned_hashing::TrieSplineHash<Key, 16>, 0>),
+      false)
+EXP_6(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                 Key, learned_hashing::TrieSplineHash<Key, 16>, 8>),
+      false)
+
+/// Experiment 7: Parallel build scaling
+#define EXP_7(Index)                                                    \
+  BENCHMARK_TEMPLATE(BuildScaling, SINGLE_ARG(Index))                   \
+      ->ArgsProduct({dataset_sizes,                                     \
+                     {static_cast<std::underlying_type_t<dataset::ID>>( \
+                         dataset::ID::BOOKS)},                          \
+                     {1, 2, 4, 8, 16, 32}})                             \
+      ->UseRealTime()                                                   \
+      ->Unit(benchmark::kMillisecond)                                   \
+      ->Iterations(3);
+
+EXP_7(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                 Key, learned_hashing::TrieSplineHash<Key, 16>, 0>))
+EXP_7(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                 Key, learned_hashing::TrieSplineHash<Key, 16>, 8>))
+
+/// Experiment 8: Local (per bucket) error bounds
+#define EXP_8(Model, error_bucket_size)                                     \
+  BM_LOWER_BOUND(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex< \
+                            Key, Model, 0, false, error_bucket_size>))      \
+  BM_EQ(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<          \
+                   Key, Model, 8, false, error_bucket_size>))
+
+EXP_8(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 64)
+EXP_8(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 1024)
+EXP_8(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 64>), 64)
+EXP_8(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 64>), 1024)
+
+/// Experiment 9: Interleaved fingerprint + offset layout
+#define EXP_9(Model, fingerprint_size)                                \
+  BM_EQ(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<    \
+                   Key, Model, fingerprint_size, false, 0,            \
+                   learned_secondary_index::util::InterleavedStorage>))
+
+EXP_9(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 4)
+EXP_9(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 8)
+EXP_9(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 16)
+
+/// Experiment 10: Compressed (frame of reference) permutation vector
+#define EXP_10(Model, fingerprint_size)                              \
+  BM_LOWER_BOUND(                                                    \
+      SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<     \
+                 Key, Model, 0, false, 0,                            \
+                 learned_secondary_index::util::CompressedStorage>)) \
+  BM_EQ(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<   \
+                   Key, Model, fingerprint_size, false, 0,           \
+                   learned_secondary_index::util::CompressedStorage>))
+
+EXP_10(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 8)
+EXP_10(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 64>), 8)
+
+/// Experiment 11: Appends via delta buffer & background merge
+#define EXP_11(Index)                                                   \
+  BENCHMARK_TEMPLATE(AppendProbe, SINGLE_ARG(Index))                    \
+      ->ArgsProduct({dataset_sizes,                                     \
+                     {static_cast<std::underlying_type_t<dataset::ID>>( \
+                         dataset::ID::BOOKS)},                          \
+                     {1, 64, 4096},                                     \
+                     {1 << 12, 1 << 16}})                               \
+      ->Iterations(10000);
+
+EXP_11(SINGLE_ARG(learned_secondary_index::UpdatableLearnedSecondaryIndex<
+                  Key, learned_secondary_index::LearnedSecondaryIndex<
+                           Key, learned_hashing::TrieSplineHash<Key, 16>, 8>>))
+
+/// Experiment 12: Range scans with bulk offset decoding
+#define EXP_12(Index)                                                   \
+  BENCHMARK_TEMPLATE(RangeScan, SINGLE_ARG(Index))                      \
+      ->ArgsProduct({dataset_sizes,                                     \
+                     {static_cast<std::underlying_type_t<dataset::ID>>( \
+                         dataset::ID::BOOKS)},                          \
+                     {1, 100, 10000, 1000000}})                         \
+      ->Iterations(1000);
+
+EXP_12(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                  Key, learned_hashing::TrieSplineHash<Key, 16>, 0>))
+EXP_12(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                  Key, learned_hashing::TrieSplineHash<Key, 16>, 0, false, 0,
+                  learned_secondary_index::util::CompressedStorage>))
+
+/// Experiment 13: Concurrent lookup throughput on a shared index
+#define EXP_13(Index)                                                   \
+  BENCHMARK_TEMPLATE(ConcurrentLookup, SINGLE_ARG(Index))               \
+      ->ArgsProduct({dataset_sizes,                                     \
+                     {static_cast<std::underlying_type_t<dataset::ID>>( \
+                         dataset::ID::BOOKS)},                          \
+                     skewed_probe_distributions,                        \
+                     {1, 2, 4, 8, 16, 32, 64}})                         \
+      ->UseRealTime()                                                   \
+      ->Unit(benchmark::kMillisecond)                                   \
+      ->Iterations(10);
+
+EXP_13(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                  Key, learned_hashing::TrieSplineHash<Key, 16>, 8>))
+EXP_13(SINGLE_ARG(lsi_competitors::BTree<Key, false>))
+EXP_13(SINGLE_ARG(lsi_competitors::ART<Key>))
+EXP_13(lsi_competitors::RobinHash<Key>)
+EXP_13(lsi_competitors::FAST64<Key>)
+
+/// Experiment 14: Range partitioned (sharded) LSI
+template <class Model, std::uint8_t fingerprint_size>
+using ShardedLSI = learned_secondary_index::ShardedLearnedSecondaryIndex<
+    Key, learned_secondary_index::LearnedSecondaryIndex<Key, Model,
+                                                        fingerprint_size>>;
+#define EXP_14(Model, fingerprint_size)                   \
+  BM(SINGLE_ARG(ShardedLSI<Model, fingerprint_size>))     \
+  EXP_7(SINGLE_ARG(ShardedLSI<Model, fingerprint_size>))  \
+  EXP_13(SINGLE_ARG(ShardedLSI<Model, fingerprint_size>))
+
+EXP_14(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 0)
+EXP_14(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 8)
+
+/// Experiment 15: Hot key result cache under uniform vs skewed probing
+#define EXP_15(Index)                                                   \
+  BENCHMARK_TEMPLATE(EqualityProbe, SINGLE_ARG(Index))                  \
+      ->ArgsProduct({dataset_sizes,                                     \
+                     {static_cast<std::underlying_type_t<dataset::ID>>( \
+                         dataset::ID::BOOKS)},                          \
+                     skewed_probe_distributions})                       \
+      ->Iterations(10000000);
+
+EXP_15(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                  Key, learned_hashing::TrieSplineHash<Key, 16>, 8>))
+EXP_15(SINGLE_ARG(learned_secondary_index::CachedLearnedSecondaryIndex<
+                  Key,
+                  learned_secondary_index::LearnedSecondaryIndex<
+                      Key, learned_hashing::TrieSplineHash<Key, 16>, 8>,
+                  1 << 12>))
+EXP_15(SINGLE_ARG(learned_secondary_index::CachedLearnedSecondaryIndex<
+                  Key,
+                  learned_secondary_index::LearnedSecondaryIndex<
+                      Key, learned_hashing::TrieSplineHash<Key, 16>, 8>,
+                  1 << 16>))
+
+/// Experiment 16: Duplicate aware equal_range with encoded run boundaries
+#define EXP_16(Model, fingerprint_size, run_boundaries)                   \
+  BENCHMARK_TEMPLATE(                                                     \
+      EqualRangeProbe,                                                    \
+      SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<          \
+                 Key, Model, fingerprint_size, false, 0,                  \
+                 learned_secondary_index::util::SeparateStorage,          \
+                 learned_secondary_index::util::CountingInstrumentation,  \
+                 run_boundaries>))                                        \
+      ->ArgsProduct({dataset_sizes, datasets, probe_distributions})       \
+      ->Iterations(10000000);
+
+EXP_16(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 0, false)
+EXP_16(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 0, true)
+EXP_16(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 8, true)
+
+/// Experiment 17: Multiply-shift fingerprint hashing
+#define EXP_17(Model, fingerprint_size)                                    \
+  BM_EQ(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<         \
+                   Key, Model, fingerprint_size, false, 0,                 \
+                   learned_secondary_index::util::SeparateStorage,         \
+                   learned_secondary_index::util::CountingInstrumentation, \
+                   false, learned_secondary_index::util::MultiplyShift<Key>>))
+
+EXP_17(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 8)
+EXP_17(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 64>), 8)
+EXP_17(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 256>), 8)
+
+/// Experiment 18: Blocked bloom filter in front of negative equality lookups
+#define EXP_18(Model, fingerprint_size, Filter)                          \
+  BENCHMARK_TEMPLATE(                                                    \
+      NegativeProbe,                                                     \
+      SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<         \
+                 Key, Model, fingerprint_size, false, 0,                 \
+                 learned_secondary_index::util::SeparateStorage,         \
+                 learned_secondary_index::util::CountingInstrumentation, \
+                 false, hashing::MurmurFinalizer<Key>, Filter>))         \
+      ->ArgsProduct({dataset_sizes, datasets, probe_distributions,       \
+                     {0, 50, 90, 100}})                                  \
+      ->Iterations(10000000);
+
+EXP_18(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 8,
+       learned_secondary_index::util::NoFilter)
+EXP_18(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 8,
+       learned_secondary_index::util::BlockedBloomFilter<8>)
+EXP_18(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 8,
+       learned_secondary_index::util::BlockedBloomFilter<16>)
+
+/// Experiment 19: Narrow, signed, floating point and string keys
+template <class Data, std::uint8_t fingerprint_size>
+using TypedLSI = learned_secondary_index::LearnedSecondaryIndex<
+    Data,
+    learned_hashing::TrieSplineHash<
+        learned_secondary_index::util::ordered_key_t<Data>, 16>,
+    fingerprint_size>;
+#define EXP_19(Data, fingerprint_size)                                   \
+  BENCHMARK_TEMPLATE(EqualityProbe,                                      \
+                     SINGLE_ARG(TypedLSI<Data, fingerprint_size>), Data) \
+      ->ArgsProduct({dataset_sizes, datasets, probe_distributions})      \
+      ->Iterations(10000000);
+
+EXP_19(std::uint64_t, 8)
+EXP_19(std::uint32_t, 0)
+EXP_19(std::uint32_t, 8)
+EXP_19(std::int64_t, 8)
+EXP_19(double, 8)
+EXP_19(learned_secondary_index::util::FixedString<8>, 8)
+
+/// Experiment 20: Search windows narrowed via in-index key samples
+template <class Model, std::uint8_t fingerprint_size, size_t key_sample_rate>
+using SampledLSI = learned_secondary_index::LearnedSecondaryIndex<
+    Key, Model, fingerprint_size, false, 0,
+    learned_secondary_index::util::SeparateStorage,
+    learned_secondary_index::util::CountingInstrumentation, false,
+    hashing::MurmurFinalizer<Key>, learned_secondary_index::util::NoFilter,
+    key_sample_rate>;
+#define EXP_20(Model, fingerprint_size, key_sample_rate)               \
+  BM(SINGLE_ARG(SampledLSI<Model, fingerprint_size, key_sample_rate>))
+
+EXP_20(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 256>), 0, 0)
+EXP_20(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 256>), 0, 8)
+EXP_20(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 256>), 0, 32)
+EXP_20(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 256>), 8, 32)
+EXP_20(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 1024>), 0, 32)
+
+/// Experiment 21: Memory bounded external build on mapped keys
+#define EXP_21(Index)                                                   \
+  BENCHMARK_TEMPLATE(ExternalBuild, SINGLE_ARG(Index))                  \
+      ->ArgsProduct({dataset_sizes,                                     \
+                     {static_cast<std::underlying_type_t<dataset::ID>>( \
+                         dataset::ID::BOOKS)},                          \
+                     {0, 64, 256, 1024}})                               \
+      ->UseRealTime()                                                   \
+      ->Unit(benchmark::kMillisecond)                                   \
+      ->Iterations(3);
+
+EXP_21(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                  Key, learned_hashing::TrieSplineHash<Key, 256>, 0>))
+EXP_21(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                  Key, learned_hashing::TrieSplineHash<Key, 256>, 8>))
+
+/// Experiment 22: Tuned configurations under memory budgets in bits per key
+#define EXP_22(Index)                                              \
+  BENCHMARK_TEMPLATE(TunedProbe, SINGLE_ARG(Index))                \
+      ->ArgsProduct({dataset_sizes, datasets, probe_distributions, \
+                     {0, 32, 40, 48}})                             \
+      ->Iterations(10000000);
+
+EXP_22(learned_secondary_index::TunedLearnedSecondaryIndex<Key>)
+
+/// Experiment 23: Byte aligned vs bit-packed permutation entries, i.e.,
+/// perm_bytes vs lookup latency
+#define EXP_23(Model, fingerprint_size, PermStorage)                   \
+  BM(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<        \
+                Key, Model, fingerprint_size, false, 0, PermStorage>))
+
+EXP_23(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 0,
+       learned_secondary_index::util::SeparateStorage)
+EXP_23(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 0,
+       learned_secondary_index::util::AlignedStorage)
+EXP_23(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 8,
+       learned_secondary_index::util::SeparateStorage)
+EXP_23(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>), 8,
+       learned_secondary_index::util::AlignedStorage)
+
+/// Experiment 24: Coroutine lookups interleaved round robin
+#define EXP_24(Index, lowerbound)                                       \
+  BENCHMARK_TEMPLATE(CoroutineLookup, SINGLE_ARG(Index), lowerbound)    \
+      ->ArgsProduct({dataset_sizes,                                     \
+                     {static_cast<std::underlying_type_t<dataset::ID>>( \
+                         dataset::ID::BOOKS)},                          \
+                     probe_distributions,                               \
+                     {1, 4, 16, 64}})                                   \
+      ->Iterations(1000000);
+
+EXP_24(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                  Key, learned_hashing::TrieSplineHash<Key, 16>, 0>),
+       true)
+EXP_24(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                  Key, learned_hashing::TrieSplineHash<Key, 16>, 8>),
+       false)
+
+/// Experiment 25: Lookups on paged base data of varying page sizes
+#define EXP_25(Index)                                                   \
+  BENCHMARK_TEMPLATE(PagedProbe, SINGLE_ARG(Index))                     \
+      ->ArgsProduct({dataset_sizes,                                     \
+                     {static_cast<std::underlying_type_t<dataset::ID>>( \
+                         dataset::ID::BOOKS)},                          \
+                     probe_distributions,                               \
+                     {512, 4096, 65536}})                               \
+      ->Iterations(10000000);
+
+EXP_25(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                  Key, learned_hashing::TrieSplineHash<Key, 16>, 0>))
+EXP_25(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                  Key, learned_hashing::TrieSplineHash<Key, 16>, 8>))
+
+/// Experiment 26: Binary search steps decided via in-index key prefixes
+template <class Model, std::uint8_t fingerprint_size,
+          std::uint8_t key_prefix_bits>
+using PrefixedLSI = learned_secondary_index::LearnedSecondaryIndex<
+    Key, Model, fingerprint_size, false, 0,
+    learned_secondary_index::util::SeparateStorage,
+    learned_secondary_index::util::CountingInstrumentation, false,
+    hashing::MurmurFinalizer<Key>, learned_secondary_index::util::NoFilter, 0,
+    key_prefix_bits>;
+#define EXP_26(Model, fingerprint_size, key_prefix_bits)               \
+  BM(SINGLE_ARG(PrefixedLSI<Model, fingerprint_size, key_prefix_bits>))
+
+EXP_26(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 256>), 0, 0)
+EXP_26(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 256>), 0, 8)
+EXP_26(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 256>), 0, 16)
+EXP_26(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 256>), 8, 16)
+EXP_26(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 1024>), 0, 16)
+
+/// Experiment 27: Lookups on index buffers backed by huge pages or an arena,
+/// i.e., BufferBacking::heap, huge_2mb, huge_1gb and arena
+#define EXP_27(Index)                                                   \
+  BENCHMARK_TEMPLATE(BufferProbe, SINGLE_ARG(Index))                    \
+      ->ArgsProduct({dataset_sizes,                                     \
+                     {static_cast<std::underlying_type_t<dataset::ID>>( \
+                         dataset::ID::BOOKS)},                          \
+                     probe_distributions,                               \
+                     {0, 1, 2, 3}})                                     \
+      ->Iterations(10000000);
+
+EXP_27(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                  Key, learned_hashing::TrieSplineHash<Key, 16>, 0>))
+EXP_27(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                  Key, learned_hashing::TrieSplineHash<Key, 16>, 8>))
+
+/// Experiment 28: Composite (tenant, key) range scans, i.e., equality on the
+/// tenant and a range on the key answered by a single slice of the index
+#define EXP_28(Model)                                                   \
+  BENCHMARK_TEMPLATE(CompositeRangeScan,                                \
+                     SINGLE_ARG(learned_secondary_index::               \
+                                    CompositeLearnedSecondaryIndex<     \
+                                        std::uint32_t, Key, Model>))    \
+      ->ArgsProduct({dataset_sizes,                                     \
+                     {static_cast<std::underlying_type_t<dataset::ID>>( \
+                         dataset::ID::BOOKS)},                          \
+                     {100, 10000},                                      \
+                     {16, 1000, 100000}})                               \
+      ->Iterations(100000);
+
+EXP_28(SINGLE_ARG(learned_hashing::RadixSplineHash<Key, 10, 16>))
+EXP_28(SINGLE_ARG(learned_hashing::TrieSplineHash<Key, 16>))
+
+/// Experiment 29: Range results emitted in key order, as ascending row ids or
+/// as a compressed bitmap, i.e., RowIdOutput::key_order, sorted_ids and bitmap
+#define EXP_29(Index)                                                   \
+  BENCHMARK_TEMPLATE(RowIdScan, SINGLE_ARG(Index))                      \
+      ->ArgsProduct({dataset_sizes,                                     \
+                     {static_cast<std::underlying_type_t<dataset::ID>>( \
+                         dataset::ID::BOOKS)},                          \
+                     {100, 10000, 1000000},                             \
+                     {0, 1, 2}})                                        \
+      ->Iterations(1000);
+
+EXP_29(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                  Key, learned_hashing::TrieSplineHash<Key, 16>, 0>))
+
+/// Experiment 30: Equality probes skewed according to a zipf distribution
+/// (skew in hundredths, 0 being uniform) with a varying share of absent keys
+#define EXP_30(Index)                                                   \
+  BENCHMARK_TEMPLATE(MixedProbe, SINGLE_ARG(Index))                     \
+      ->ArgsProduct({dataset_sizes,                                     \
+                     {static_cast<std::underlying_type_t<dataset::ID>>( \
+                         dataset::ID::BOOKS)},                          \
+                     {0, 50, 99, 125},                                  \
+                     {0, 10, 50, 90}})                                  \
+      ->Iterations(10000000);
+
+EXP_30(SINGLE_ARG(lsi_competitors::BTree<Key, true>))
+EXP_30(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                  Key, learned_hashing::TrieSplineHash<Key, 16>, 8>))
+EXP_30(SINGLE_ARG(learned_secondary_index::LearnedSecondaryIndex<
+                  Key, learned_hashing::TrieSplineHash<Key, 16>, 8, false, 0,
+                  learned_secondary_index::util::SeparateStorage,
+                  learned_secondary_index::util::CountingInstrumentation,
+                  false, hashing::MurmurFinalizer<Key>,
+                  learned_secondary_index::util::BlockedBloomFilter<16>>))
+
+int main(int argc, char **argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+  // recorded next to the machine description, such that results of
+  // different runs, e.g., of results/results.json, remain comparable
+  benchmark::AddCustomContext("git_revision", LSI_GIT_REVISION);
+  benchmark::AddCustomContext("seed", std::to_string(dataset::seed()));
+  const perf::Counters counters;
+  std::string events;
+  for (size_t e = 0; e < perf::event_count; e++) {
+    const auto event = static_cast<perf::Event>(e);
+    if (!counters.available(event)) continue;
+    events += (events.empty() ? "" : ",") + perf::name(event);
+  }
+  benchmark::AddCustomContext("perf_events", events.empty() ? "none" : events);
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
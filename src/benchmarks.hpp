@@ -1,18 +1,28 @@
 #pragma once
 
 #include <benchmark/benchmark.h>
+#include <unistd.h>
 
 #include <chrono>
 #include <cstdint>
+#include <filesystem>
 #include <learned_secondary_index.hpp>
+#include <iterator>
 #include <limits>
+#include <memory_resource>
+#include <numeric>
 #include <random>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 #include "include/convenience/builtins.hpp"
 #include "support/datasets.hpp"
+#include "support/perf_counters.hpp"
 #include "support/probing_set.hpp"
+#include "support/seed.hpp"
 
 using namespace learned_secondary_index;
 
@@ -27,17 +37,123 @@ const std::vector<std::int64_t> datasets{
 const std::vector<std::int64_t> probe_distributions{
     static_cast<std::underlying_type_t<dataset::ProbingDistribution>>(
         dataset::ProbingDistribution::UNIFORM)};
+const std::vector<std::int64_t> skewed_probe_distributions{
+    static_cast<std::underlying_type_t<dataset::ProbingDistribution>>(
+        dataset::ProbingDistribution::UNIFORM),
+    static_cast<std::underlying_type_t<dataset::ProbingDistribution>>(
+        dataset::ProbingDistribution::EXPONENTIAL)};
+
+/// Lookup recording into stats if Index supports caller owned
+/// util::LookupStats. Competitors are looked up without instrumentation
+template <bool lowerbound, class Index, class It>
+forceinline auto instrumented_lookup(
+    Index &index, const It &begin, const It &end,
+    const typename std::iterator_traits<It>::value_type &key,
+    util::LookupStats &stats) {
+  if constexpr (requires {
+                  index.template lookup<lowerbound>(begin, end, key, stats);
+                })
+    return index.template lookup<lowerbound>(begin, end, key, stats);
+  else
+    return index.template lookup<lowerbound>(begin, end, key);
+}
+
+static void report_lookup_stats(benchmark::State &state,
+                                const util::LookupStats &stats) {
+  state.counters["base_data_accesses"] =
+      static_cast<double>(stats.base_data_accesses);
+  state.counters["false_positive_accesses"] =
+      static_cast<double>(stats.false_positive_accesses);
+  state.counters["window_size"] = static_cast<double>(stats.window_size);
+  state.counters["fingerprint_hits"] =
+      static_cast<double>(stats.fingerprint_hits);
+  state.counters["filter_rejections"] =
+      static_cast<double>(stats.filter_rejections);
+  state.counters["sample_accesses"] =
+      static_cast<double>(stats.sample_accesses);
+  state.counters["prefix_resolutions"] =
+      static_cast<double>(stats.prefix_resolutions);
+}
+
+/// Reports the hit rate of indices caching lookup results, if any
+template <class Index>
+static void report_cache_stats(benchmark::State &state, const Index &index) {
+  if constexpr (requires { index.cache_hits(); }) {
+    const auto lookups = index.cache_hits() + index.cache_misses();
+    state.counters["cache_hit_rate"] =
+        lookups > 0 ? static_cast<double>(index.cache_hits()) /
+                          static_cast<double>(lookups)
+                    : 0.0;
+  }
+}
+
+/// Adds the build phase breakdown of index to stats, if Index records one
+template <class Index>
+static void add_build_stats(util::BuildStats &stats, const Index &index) {
+  if constexpr (requires { index.build_stats(); }) stats += index.build_stats();
+}
+
+/// Reports build phases in nanoseconds averaged over builds, next to the
+/// overall build_time. Omitted for indices not recording util::BuildStats
+static void report_build_stats(benchmark::State &state,
+                               const util::BuildStats &stats,
+                               const size_t builds = 1) {
+  if (stats.total_ns() == 0) return;
+  const auto avg = [&](const size_t ns) {
+    return static_cast<double>(ns) / static_cast<double>(builds);
+  };
+  state.counters["build_sort_time"] = avg(stats.sort_ns);
+  state.counters["build_train_time"] = avg(stats.train_ns);
+  state.counters["build_scan_time"] = avg(stats.scan_ns);
+  state.counters["build_pack_time"] = avg(stats.pack_ns);
+  state.counters["build_auxiliary_time"] = avg(stats.auxiliary_ns);
+}
 
+/// report_build_stats() of a single index build
 template <class Index>
+static void report_build_stats(benchmark::State &state, const Index &index) {
+  util::BuildStats stats;
+  add_build_stats(stats, index);
+  report_build_stats(state, stats);
+}
+
+/// Reports hardware events counted between counters.start() and stop() per
+/// iteration. Events unavailable on this machine are omitted
+static void report_perf_counters(benchmark::State &state,
+                                 const perf::Counters &counters) {
+  for (size_t e = 0; e < perf::event_count; e++) {
+    const auto event = static_cast<perf::Event>(e);
+    if (!counters.available(event)) continue;
+    state.counters[perf::name(event)] =
+        benchmark::Counter(static_cast<double>(counters.value(event)),
+                           benchmark::Counter::kAvgIterations);
+  }
+}
+
+/// Label suffix naming non default key types, see dataset::convert()
+template <class Data>
+static std::string key_type_name() {
+  if constexpr (std::is_same_v<Data, Key>) {
+    return "";
+  } else if constexpr (std::is_floating_point_v<Data>) {
+    return ":float" + std::to_string(8 * sizeof(Data));
+  } else if constexpr (std::is_integral_v<Data>) {
+    return std::string(std::is_signed_v<Data> ? ":int" : ":uint") +
+           std::to_string(8 * sizeof(Data));
+  } else {
+    return ":string" + std::to_string(sizeof(Data));
+  }
+}
+
+template <class Index, class Data = Key>
 static void EqualityProbe(benchmark::State &state) {
-  std::random_device rd;
-  std::default_random_engine rng(rd());
+  std::default_random_engine rng(dataset::seed());
 
   const auto dataset_size = state.range(0);
   const auto did = static_cast<dataset::ID>(state.range(1));
 
   // load dataset
-  auto dataset = dataset::load_cached(did, dataset_size);
+  auto dataset = dataset::load_cached<Data>(did, dataset_size);
 
   if (dataset.empty()) {
     throw std::runtime_error("can't benchmark on empty dataset");
@@ -61,13 +177,16 @@ static void EqualityProbe(benchmark::State &state) {
 
   size_t i = 0;
   size_t errors = 0;
+  util::LookupStats stats;
+  perf::Counters counters;
+  counters.start();
   for (auto _ : state) {
     // get next lookup element
     while (unlikely(i >= probing_set.size())) i -= probing_set.size();
     const auto probed = probing_set[i++];
 
-    const auto iter =
-        index.template lookup<false>(dataset.begin(), dataset.end(), probed);
+    const auto iter = instrumented_lookup<false>(index, dataset.begin(),
+                                                 dataset.end(), probed, stats);
     benchmark::DoNotOptimize(iter);
 
     errors += dataset[*iter] != probed;
@@ -75,25 +194,25 @@ static void EqualityProbe(benchmark::State &state) {
     // prevent interleaved execution
     full_memory_barrier();
   }
+  counters.stop();
 
   if (errors > 0) throw std::runtime_error("kaputt " + std::to_string(errors));
 
-  state.counters["base_data_accesses"] =
-      static_cast<double>(index.base_data_accesses());
-  state.counters["false_positive_accesses"] =
-      static_cast<double>(index.false_positive_accesses());
+  report_lookup_stats(state, stats);
+  report_cache_stats(state, index);
+  report_perf_counters(state, counters);
+  report_build_stats(state, index);
   state.counters["build_time"] = static_cast<double>(index_build_time);
   state.counters["model_bytes"] = index.model_byte_size();
   state.counters["perm_bytes"] = index.perm_vector_byte_size();
   state.counters["bytes"] = index.byte_size();
   state.SetLabel(Index::name() + ":" + dataset::name(did) + ":" +
-                 dataset::name(probing_dist));
+                 dataset::name(probing_dist) + key_type_name<Data>());
 }
 
 template <class Index>
 static void LowerboundLookup(benchmark::State &state) {
-  std::random_device rd;
-  std::default_random_engine rng(rd());
+  std::default_random_engine rng(dataset::seed());
 
   const auto dataset_size = state.range(0);
   const auto did = static_cast<dataset::ID>(state.range(1));
@@ -125,13 +244,16 @@ static void LowerboundLookup(benchmark::State &state) {
 
   size_t i = 0;
   size_t errors = 0;
+  util::LookupStats stats;
+  perf::Counters counters;
+  counters.start();
   for (auto _ : state) {
     // get next lookup element
     while (unlikely(i >= probing_set.size())) i -= probing_set.size();
     const auto probed = probing_set[i++];
 
-    auto lb_iter = index.template lookup<true>(
-        dataset.begin(), dataset.begin() + insert_end, probed);
+    auto lb_iter = instrumented_lookup<true>(
+        index, dataset.begin(), dataset.begin() + insert_end, probed, stats);
 
     if (lb_iter != index.end() && dataset[*lb_iter] < probed) {
       errors++;
@@ -140,16 +262,1024 @@ static void LowerboundLookup(benchmark::State &state) {
     // prevent interleaved execution
     full_memory_barrier();
   }
+  counters.stop();
 
   if (errors > 0) throw std::runtime_error("kaputt " + std::to_string(errors));
 
-  state.counters["base_data_accesses"] =
-      static_cast<double>(index.base_data_accesses());
-  state.counters["false_positive_accesses"] =
-      static_cast<double>(index.false_positive_accesses());
+  report_lookup_stats(state, stats);
+  report_perf_counters(state, counters);
+  report_build_stats(state, index);
   state.counters["build_time"] = static_cast<double>(index_build_time);
   state.counters["model_bytes"] = index.model_byte_size();
   state.counters["perm_bytes"] = index.perm_vector_byte_size();
   state.counters["bytes"] = index.byte_size();
   state.SetLabel(Index::name() + ":" + dataset::name(did));
 }
+
+template <class Index, bool lowerbound>
+static void BatchedLookup(benchmark::State &state) {
+  std::default_random_engine rng(dataset::seed());
+
+  const auto dataset_size = state.range(0);
+  const auto did = static_cast<dataset::ID>(state.range(1));
+  const auto batch_size = static_cast<size_t>(state.range(3));
+
+  // load dataset
+  auto dataset = dataset::load_cached(did, dataset_size);
+
+  if (dataset.empty()) {
+    throw std::runtime_error("can't benchmark on empty dataset");
+  }
+
+  // probe in random order to limit caching effects
+  const auto probing_dist =
+      static_cast<dataset::ProbingDistribution>(state.range(2));
+  const auto probing_set = dataset::generate_probing_set(dataset, probing_dist);
+
+  // shuffle dataset & build index
+  std::shuffle(dataset.begin(), dataset.end(), rng);
+
+  // Build index
+  const auto start = std::chrono::steady_clock::now();
+  Index index(dataset.begin(), dataset.end());
+  const auto index_build_time =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+
+  using Iter = decltype(index.begin());
+  std::vector<Iter> results;
+  results.reserve(batch_size);
+
+  size_t i = 0;
+  size_t errors = 0;
+  util::LookupStats stats;
+  for (auto _ : state) {
+    // get next batch of lookup elements
+    if (unlikely(i + batch_size > probing_set.size())) i = 0;
+    const auto batch_begin = probing_set.begin() + i;
+    const auto batch_end =
+        batch_begin + std::min(batch_size, probing_set.size() - i);
+    i += batch_size;
+
+    results.clear();
+    index.template lookup_batch<lowerbound>(dataset.begin(), dataset.end(),
+                                            batch_begin, batch_end,
+                                            std::back_inserter(results), stats);
+    benchmark::DoNotOptimize(results.data());
+
+    for (size_t j = 0; j < results.size(); j++) {
+      errors += results[j] == index.end() ||
+                dataset[*results[j]] != *(batch_begin + j);
+    }
+
+    // prevent interleaved execution
+    full_memory_barrier();
+  }
+
+  if (errors > 0) throw std::runtime_error("kaputt " + std::to_string(errors));
+
+  state.SetItemsProcessed(state.iterations() * batch_size);
+  report_lookup_stats(state, stats);
+  state.counters["build_time"] = static_cast<double>(index_build_time);
+  state.counters["model_bytes"] = index.model_byte_size();
+  state.counters["perm_bytes"] = index.perm_vector_byte_size();
+  state.counters["bytes"] = index.byte_size();
+  state.SetLabel(Index::name() + ":" + dataset::name(did) + ":" +
+                 dataset::name(probing_dist) + ":" +
+                 std::to_string(batch_size));
+}
+
+template <class Index, bool lowerbound>
+static void CoroutineLookup(benchmark::State &state) {
+  std::default_random_engine rng(dataset::seed());
+
+  const auto dataset_size = state.range(0);
+  const auto did = static_cast<dataset::ID>(state.range(1));
+  const auto in_flight = static_cast<size_t>(state.range(3));
+
+  // load dataset
+  auto dataset = dataset::load_cached(did, dataset_size);
+
+  if (dataset.empty()) {
+    throw std::runtime_error("can't benchmark on empty dataset");
+  }
+
+  // probe in random order to limit caching effects
+  const auto probing_dist =
+      static_cast<dataset::ProbingDistribution>(state.range(2));
+  const auto probing_set = dataset::generate_probing_set(dataset, probing_dist);
+
+  // shuffle dataset & build index
+  std::shuffle(dataset.begin(), dataset.end(), rng);
+
+  // Build index
+  const auto start = std::chrono::steady_clock::now();
+  Index index(dataset.begin(), dataset.end());
+  const auto index_build_time =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+
+  util::LookupStats stats;
+  const auto launch = [&](const size_t p) {
+    return index.template lookup_coroutine<lowerbound>(
+        dataset.begin(), dataset.end(), probing_set[p], stats);
+  };
+
+  // every iteration resumes each of in_flight tasks once, i.e., emulates a
+  // caller interleaving index probes with its own work. Finished tasks are
+  // verified and replaced with the next probe
+  std::vector<decltype(launch(0))> tasks;
+  std::vector<size_t> probes;
+  size_t i = 0;
+  for (; tasks.size() < in_flight; i = (i + 1) % probing_set.size()) {
+    tasks.push_back(launch(i));
+    probes.push_back(i);
+  }
+
+  size_t completed = 0;
+  size_t errors = 0;
+  for (auto _ : state) {
+    for (size_t t = 0; t < tasks.size(); t++) {
+      if (!tasks[t].resume()) continue;
+
+      const auto iter = tasks[t].result();
+      if constexpr (lowerbound) {
+        errors += iter != index.end() &&
+                  dataset[*iter] < probing_set[probes[t]];
+      } else {
+        errors += iter == index.end() ||
+                  dataset[*iter] != probing_set[probes[t]];
+      }
+      completed++;
+
+      tasks[t] = launch(i);
+      probes[t] = i;
+      i = (i + 1) % probing_set.size();
+    }
+  }
+
+  if (errors > 0) throw std::runtime_error("kaputt " + std::to_string(errors));
+
+  state.SetItemsProcessed(completed);
+  report_lookup_stats(state, stats);
+  state.counters["build_time"] = static_cast<double>(index_build_time);
+  state.counters["model_bytes"] = index.model_byte_size();
+  state.counters["perm_bytes"] = index.perm_vector_byte_size();
+  state.counters["bytes"] = index.byte_size();
+  state.SetLabel(Index::name() + ":" + dataset::name(did) + ":" +
+                 dataset::name(probing_dist) + ":" +
+                 std::to_string(in_flight));
+}
+
+template <class Index>
+static void PagedProbe(benchmark::State &state) {
+  std::default_random_engine rng(dataset::seed());
+
+  const auto dataset_size = state.range(0);
+  const auto did = static_cast<dataset::ID>(state.range(1));
+  const auto page_size = static_cast<size_t>(state.range(3));
+
+  // load dataset
+  auto dataset = dataset::load_cached(did, dataset_size);
+
+  if (dataset.empty()) {
+    throw std::runtime_error("can't benchmark on empty dataset");
+  }
+
+  // probe in random order to limit caching effects
+  const auto probing_dist =
+      static_cast<dataset::ProbingDistribution>(state.range(2));
+  const auto probing_set = dataset::generate_probing_set(dataset, probing_dist);
+
+  // shuffle dataset & copy it into individually allocated pages, i.e.,
+  // emulate a paged column store's buffer frames
+  std::shuffle(dataset.begin(), dataset.end(), rng);
+  std::vector<std::vector<Key>> pages;
+  std::vector<const Key *> frames;
+  for (size_t i = 0; i < dataset.size(); i += page_size) {
+    const auto page_end = std::min(dataset.size(), i + page_size);
+    pages.emplace_back(dataset.begin() + i, dataset.begin() + page_end);
+    frames.push_back(pages.back().data());
+  }
+  const util::PagedColumn<Key> column(std::move(frames), page_size,
+                                      dataset.size());
+
+  // Build index
+  const auto start = std::chrono::steady_clock::now();
+  Index index(column.begin(), column.end());
+  const auto index_build_time =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+
+  size_t i = 0;
+  size_t errors = 0;
+  util::LookupStats stats;
+  for (auto _ : state) {
+    // get next lookup element
+    while (unlikely(i >= probing_set.size())) i -= probing_set.size();
+    const auto probed = probing_set[i++];
+
+    const auto iter = instrumented_lookup<false>(index, column.begin(),
+                                                 column.end(), probed, stats);
+    benchmark::DoNotOptimize(iter);
+
+    errors += column.get(*iter) != probed;
+
+    // prevent interleaved execution
+    full_memory_barrier();
+  }
+
+  if (errors > 0) throw std::runtime_error("kaputt " + std::to_string(errors));
+
+  report_lookup_stats(state, stats);
+  state.counters["build_time"] = static_cast<double>(index_build_time);
+  state.counters["model_bytes"] = index.model_byte_size();
+  state.counters["perm_bytes"] = index.perm_vector_byte_size();
+  state.counters["bytes"] = index.byte_size();
+  state.SetLabel(Index::name() + ":" + dataset::name(did) + ":" +
+                 dataset::name(probing_dist) + ":" +
+                 std::to_string(page_size));
+}
+
+/// Buffer resources compared by BufferProbe, see its range(3)
+enum class BufferBacking : std::int64_t { heap, huge_2mb, huge_1gb, arena };
+
+static std::string name(const BufferBacking backing) {
+  switch (backing) {
+    case BufferBacking::huge_2mb:
+      return "huge_2mb";
+    case BufferBacking::huge_1gb:
+      return "huge_1gb";
+    case BufferBacking::arena:
+      return "arena_2mb";
+    default:
+      return "heap";
+  }
+}
+
+template <class Index>
+static void BufferProbe(benchmark::State &state) {
+  std::default_random_engine rng(dataset::seed());
+
+  const auto dataset_size = state.range(0);
+  const auto did = static_cast<dataset::ID>(state.range(1));
+  const auto backing = static_cast<BufferBacking>(state.range(3));
+
+  // load dataset
+  auto dataset = dataset::load_cached(did, dataset_size);
+
+  if (dataset.empty()) {
+    throw std::runtime_error("can't benchmark on empty dataset");
+  }
+
+  // probe in random order to limit caching effects
+  const auto probing_dist =
+      static_cast<dataset::ProbingDistribution>(state.range(2));
+  const auto probing_set = dataset::generate_probing_set(dataset, probing_dist);
+
+  // shuffle dataset
+  std::shuffle(dataset.begin(), dataset.end(), rng);
+
+  // the index' buffers are allocated from the chosen resource during build
+  util::HugePageResource huge_pages(backing == BufferBacking::huge_1gb
+                                        ? util::PageSize::huge_1gb
+                                        : util::PageSize::huge_2mb);
+  util::Arena arena(size_t{1} << 30, &huge_pages);
+  std::pmr::memory_resource *resource = &huge_pages;
+  if (backing == BufferBacking::heap) resource = nullptr;
+  if (backing == BufferBacking::arena) resource = &arena;
+  auto *previous = util::set_buffer_resource(resource);
+
+  // Build index
+  const auto start = std::chrono::steady_clock::now();
+  Index index(dataset.begin(), dataset.end());
+  const auto index_build_time =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+  util::set_buffer_resource(previous);
+
+  size_t i = 0;
+  size_t errors = 0;
+  util::LookupStats stats;
+  for (auto _ : state) {
+    // get next lookup element
+    while (unlikely(i >= probing_set.size())) i -= probing_set.size();
+    const auto probed = probing_set[i++];
+
+    const auto iter = instrumented_lookup<false>(index, dataset.begin(),
+                                                 dataset.end(), probed, stats);
+    benchmark::DoNotOptimize(iter);
+
+    errors += dataset[*iter] != probed;
+
+    // prevent interleaved execution
+    full_memory_barrier();
+  }
+
+  if (errors > 0) throw std::runtime_error("kaputt " + std::to_string(errors));
+
+  report_lookup_stats(state, stats);
+  state.counters["build_time"] = static_cast<double>(index_build_time);
+  state.counters["model_bytes"] = index.model_byte_size();
+  state.counters["perm_bytes"] = index.perm_vector_byte_size();
+  state.counters["bytes"] = index.byte_size();
+  state.counters["huge_page_fallbacks"] =
+      static_cast<double>(huge_pages.fallbacks());
+  state.SetLabel(Index::name() + ":" + dataset::name(did) + ":" +
+                 dataset::name(probing_dist) + ":" + name(backing));
+}
+
+template <class Index>
+static void BuildScaling(benchmark::State &state) {
+  std::default_random_engine rng(dataset::seed());
+
+  const auto dataset_size = state.range(0);
+  const auto did = static_cast<dataset::ID>(state.range(1));
+  const auto threads = static_cast<size_t>(state.range(2));
+
+  // load dataset
+  auto dataset = dataset::load_cached(did, dataset_size);
+
+  if (dataset.empty()) {
+    throw std::runtime_error("can't benchmark on empty dataset");
+  }
+
+  // shuffle dataset (secondary index case)
+  std::shuffle(dataset.begin(), dataset.end(), rng);
+
+  size_t index_build_time = 0;
+  size_t bytes = 0;
+  util::BuildStats build_stats;
+  for (auto _ : state) {
+    const auto start = std::chrono::steady_clock::now();
+    Index index(dataset.begin(), dataset.end(), threads);
+    index_build_time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+    bytes = index.byte_size();
+    benchmark::DoNotOptimize(bytes);
+    add_build_stats(build_stats, index);
+  }
+
+  report_build_stats(state, build_stats, state.iterations());
+  state.counters["build_time"] =
+      static_cast<double>(index_build_time) / state.iterations();
+  state.counters["threads"] = static_cast<double>(threads);
+  state.counters["bytes"] = bytes;
+  state.SetLabel(Index::name() + ":" + dataset::name(did) + ":" +
+                 std::to_string(threads));
+}
+
+template <class Index>
+static void AppendProbe(benchmark::State &state) {
+  std::default_random_engine rng(dataset::seed());
+
+  const auto dataset_size = state.range(0);
+  const auto did = static_cast<dataset::ID>(state.range(1));
+  const auto batch_size = static_cast<size_t>(state.range(2));
+  const auto merge_threshold = static_cast<size_t>(state.range(3));
+
+  // load dataset
+  auto dataset = dataset::load_cached(did, dataset_size);
+
+  if (dataset.empty()) {
+    throw std::runtime_error("can't benchmark on empty dataset");
+  }
+
+  // shuffle dataset (secondary index case)
+  std::shuffle(dataset.begin(), dataset.end(), rng);
+
+  // initially index 90% of the dataset, the remainder is appended. Rows
+  // must not move while a background merge is pending, hence reserve
+  const size_t initial_size =
+      static_cast<size_t>(static_cast<double>(dataset.size()) * 0.9);
+  std::vector<Key> relation;
+  relation.reserve(dataset.size());
+  relation.assign(dataset.begin(), dataset.begin() + initial_size);
+
+  const auto start = std::chrono::steady_clock::now();
+  Index index(relation.begin(), relation.end(), merge_threshold);
+  const auto index_build_time =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+
+  size_t errors = 0;
+  for (auto _ : state) {
+    // start over once all rows are appended
+    if (unlikely(relation.size() + batch_size > dataset.size())) {
+      state.PauseTiming();
+      index.fit(relation.begin(), relation.begin() + initial_size);
+      relation.resize(initial_size);
+      state.ResumeTiming();
+    }
+
+    relation.insert(relation.end(), dataset.begin() + relation.size(),
+                    dataset.begin() + relation.size() + batch_size);
+    index.append(relation.begin(), relation.end());
+
+    const auto probed = relation[rng() % relation.size()];
+    const auto iter =
+        index.template lookup<false>(relation.begin(), relation.end(), probed);
+    errors += iter == index.end() || relation[*iter] != probed;
+
+    // prevent interleaved execution
+    full_memory_barrier();
+  }
+
+  if (errors > 0) throw std::runtime_error("kaputt " + std::to_string(errors));
+
+  state.SetItemsProcessed(state.iterations() * batch_size);
+  state.counters["build_time"] = static_cast<double>(index_build_time);
+  state.counters["delta_size"] = static_cast<double>(index.delta_size());
+  state.counters["bytes"] = index.byte_size();
+  state.SetLabel(Index::name() + ":" + dataset::name(did) + ":" +
+                 std::to_string(batch_size) + ":" +
+                 std::to_string(merge_threshold));
+}
+
+template <class Index>
+static void RangeScan(benchmark::State &state) {
+  std::default_random_engine rng(dataset::seed());
+
+  const auto dataset_size = state.range(0);
+  const auto did = static_cast<dataset::ID>(state.range(1));
+  const auto range_size = static_cast<size_t>(state.range(2));
+
+  // load dataset
+  auto dataset = dataset::load_cached(did, dataset_size);
+
+  if (dataset.empty()) {
+    throw std::runtime_error("can't benchmark on empty dataset");
+  }
+
+  // range bounds are chosen such that each range contains roughly
+  // range_size keys
+  auto sorted = dataset;
+  std::sort(sorted.begin(), sorted.end());
+
+  // shuffle dataset & build index
+  std::shuffle(dataset.begin(), dataset.end(), rng);
+  Index index(dataset.begin(), dataset.end());
+
+  std::vector<std::uint64_t> buffer(1024);
+  std::uniform_int_distribution<size_t> dist(0, sorted.size() - 1);
+
+  size_t scanned = 0;
+  size_t errors = 0;
+  for (auto _ : state) {
+    const auto lo_i = dist(rng);
+    const auto lo = sorted[lo_i];
+    const auto hi = sorted[std::min(lo_i + range_size, sorted.size() - 1)];
+
+    size_t checksum = 0;
+    const auto cnt = index.range(
+        dataset.begin(), dataset.end(), lo, hi, buffer.data(), buffer.size(),
+        [&](const std::uint64_t *offsets, size_t n) {
+          for (size_t j = 0; j < n; j++) checksum += offsets[j];
+        });
+    benchmark::DoNotOptimize(checksum);
+
+    errors += cnt > 0 && dataset[buffer[0]] < lo;
+    scanned += cnt;
+
+    // prevent interleaved execution
+    full_memory_barrier();
+  }
+
+  if (errors > 0) throw std::runtime_error("kaputt " + std::to_string(errors));
+
+  state.SetItemsProcessed(static_cast<int64_t>(scanned));
+  state.counters["perm_bytes"] = index.perm_vector_byte_size();
+  state.counters["bytes"] = index.byte_size();
+  state.SetLabel(Index::name() + ":" + dataset::name(did) + ":" +
+                 std::to_string(range_size));
+}
+
+template <class Index>
+static void ConcurrentLookup(benchmark::State &state) {
+  std::default_random_engine rng(dataset::seed());
+
+  const auto dataset_size = state.range(0);
+  const auto did = static_cast<dataset::ID>(state.range(1));
+  const auto probing_dist =
+      static_cast<dataset::ProbingDistribution>(state.range(2));
+  const auto threads = static_cast<size_t>(state.range(3));
+  static constexpr size_t lookups_per_thread = 1'000'000;
+
+  // load dataset
+  auto dataset = dataset::load_cached(did, dataset_size);
+
+  if (dataset.empty()) {
+    throw std::runtime_error("can't benchmark on empty dataset");
+  }
+
+  // probe in random order to limit caching effects
+  const auto probing_set = dataset::generate_probing_set(dataset, probing_dist);
+
+  // shuffle dataset & build index, which is shared by all threads
+  std::shuffle(dataset.begin(), dataset.end(), rng);
+  Index index(dataset.begin(), dataset.end());
+
+  std::vector<size_t> errors(threads, 0);
+  size_t round = 0;
+  for (auto _ : state) {
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (size_t t = 0; t < threads; t++) {
+      workers.emplace_back([&, t] {
+        // threads start at different offsets to not probe in lockstep
+        size_t i = (t * probing_set.size() / threads +
+                    round * lookups_per_thread) %
+                   probing_set.size();
+        size_t thread_errors = 0;
+        for (size_t j = 0; j < lookups_per_thread; j++) {
+          if (unlikely(i >= probing_set.size())) i = 0;
+          const auto probed = probing_set[i++];
+
+          const auto iter = index.template lookup<false>(
+              dataset.begin(), dataset.end(), probed);
+          thread_errors += dataset[*iter] != probed;
+        }
+        errors[t] += thread_errors;
+      });
+    }
+    for (auto &worker : workers) worker.join();
+    round++;
+  }
+
+  const auto total_errors = std::accumulate(errors.begin(), errors.end(), 0LU);
+  if (total_errors > 0)
+    throw std::runtime_error("kaputt " + std::to_string(total_errors));
+
+  state.SetItemsProcessed(state.iterations() * threads * lookups_per_thread);
+  state.counters["threads"] = static_cast<double>(threads);
+  state.counters["lookups_per_sec_per_core"] = benchmark::Counter(
+      static_cast<double>(lookups_per_thread),
+      benchmark::Counter::kIsIterationInvariantRate);
+  state.counters["bytes"] = index.byte_size();
+  state.SetLabel(Index::name() + ":" + dataset::name(did) + ":" +
+                 dataset::name(probing_dist) + ":" + std::to_string(threads));
+}
+
+template <class Index>
+static void EqualRangeProbe(benchmark::State &state) {
+  std::default_random_engine rng(dataset::seed());
+
+  const auto dataset_size = state.range(0);
+  const auto did = static_cast<dataset::ID>(state.range(1));
+
+  // load dataset
+  auto dataset = dataset::load_cached(did, dataset_size);
+
+  if (dataset.empty()) {
+    throw std::runtime_error("can't benchmark on empty dataset");
+  }
+
+  // probe in random order to limit caching effects
+  const auto probing_dist =
+      static_cast<dataset::ProbingDistribution>(state.range(2));
+  const auto probing_set = dataset::generate_probing_set(dataset, probing_dist);
+
+  // shuffle dataset & build index
+  std::shuffle(dataset.begin(), dataset.end(), rng);
+  Index index(dataset.begin(), dataset.end());
+
+  size_t i = 0;
+  size_t errors = 0;
+  size_t matches = 0;
+  util::LookupStats stats;
+  for (auto _ : state) {
+    // get next lookup element
+    while (unlikely(i >= probing_set.size())) i -= probing_set.size();
+    const auto probed = probing_set[i++];
+
+    const auto [first, last] =
+        index.equal_range(dataset.begin(), dataset.end(), probed, stats);
+    benchmark::DoNotOptimize(last);
+
+    errors += first == last || dataset[*first] != probed;
+    matches += last - first;
+
+    // prevent interleaved execution
+    full_memory_barrier();
+  }
+
+  if (errors > 0) throw std::runtime_error("kaputt " + std::to_string(errors));
+
+  report_lookup_stats(state, stats);
+  state.counters["matches"] = benchmark::Counter(
+      static_cast<double>(matches), benchmark::Counter::kAvgIterations);
+  state.counters["model_bytes"] = index.model_byte_size();
+  state.counters["perm_bytes"] = index.perm_vector_byte_size();
+  state.counters["bytes"] = index.byte_size();
+  state.SetLabel(Index::name() + ":" + dataset::name(did) + ":" +
+                 dataset::name(probing_dist));
+}
+
+/**
+ * Equality probes of which miss_percent are absent from the dataset, drawn
+ * according to probing_dist. zipf_skew is only used by
+ * ProbingDistribution::ZIPF
+ */
+template <class Index>
+static void probe_with_misses(benchmark::State &state,
+                              const dataset::ProbingDistribution probing_dist,
+                              const double zipf_skew,
+                              const size_t miss_percent) {
+  std::default_random_engine rng(dataset::seed());
+
+  const auto dataset_size = state.range(0);
+  const auto did = static_cast<dataset::ID>(state.range(1));
+
+  // load dataset
+  auto dataset = dataset::load_cached(did, dataset_size);
+
+  if (dataset.empty()) {
+    throw std::runtime_error("can't benchmark on empty dataset");
+  }
+
+  // probe in random order to limit caching effects
+  auto probing_set =
+      dataset::generate_probing_set(dataset, probing_dist, zipf_skew);
+
+  // replace miss_percent of all probes by their closest absent successor
+  const auto present =
+      dataset::replace_with_absent(probing_set, dataset, miss_percent);
+
+  // shuffle dataset & build index
+  std::shuffle(dataset.begin(), dataset.end(), rng);
+  const auto start = std::chrono::steady_clock::now();
+  Index index(dataset.begin(), dataset.end());
+  const auto index_build_time =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+
+  size_t i = 0;
+  size_t errors = 0;
+  util::LookupStats stats;
+  perf::Counters counters;
+  counters.start();
+  for (auto _ : state) {
+    // get next lookup element
+    while (unlikely(i >= probing_set.size())) i -= probing_set.size();
+    const auto probed = probing_set[i];
+
+    const auto iter = instrumented_lookup<false>(index, dataset.begin(),
+                                                 dataset.end(), probed, stats);
+    benchmark::DoNotOptimize(iter);
+
+    errors += present[i++] ? iter == index.end() || dataset[*iter] != probed
+                           : iter != index.end();
+
+    // prevent interleaved execution
+    full_memory_barrier();
+  }
+  counters.stop();
+
+  if (errors > 0) throw std::runtime_error("kaputt " + std::to_string(errors));
+
+  report_lookup_stats(state, stats);
+  report_perf_counters(state, counters);
+  report_build_stats(state, index);
+  state.counters["build_time"] = static_cast<double>(index_build_time);
+  state.counters["model_bytes"] = index.model_byte_size();
+  state.counters["perm_bytes"] = index.perm_vector_byte_size();
+  state.counters["bytes"] = index.byte_size();
+  state.SetLabel(Index::name() + ":" + dataset::name(did) + ":" +
+                 dataset::name(probing_dist) + ":" +
+                 std::to_string(miss_percent));
+}
+
+/// range(2) is the probing distribution, range(3) the percentage of absent
+/// probes
+template <class Index>
+static void NegativeProbe(benchmark::State &state) {
+  probe_with_misses<Index>(
+      state, static_cast<dataset::ProbingDistribution>(state.range(2)),
+      dataset::default_zipf_skew, static_cast<size_t>(state.range(3)));
+}
+
+/// range(2) is the zipf skew in hundredths, with 0 probing uniformly, and
+/// range(3) the percentage of absent probes
+template <class Index>
+static void MixedProbe(benchmark::State &state) {
+  const auto skew_hundredths = state.range(2);
+  probe_with_misses<Index>(state,
+                           skew_hundredths == 0
+                               ? dataset::ProbingDistribution::UNIFORM
+                               : dataset::ProbingDistribution::ZIPF,
+                           static_cast<double>(skew_hundredths) / 100.0,
+                           static_cast<size_t>(state.range(3)));
+  state.counters["zipf_skew"] = static_cast<double>(skew_hundredths) / 100.0;
+}
+
+template <class Index>
+static void ExternalBuild(benchmark::State &state) {
+  std::default_random_engine rng(dataset::seed());
+
+  const auto dataset_size = state.range(0);
+  const auto did = static_cast<dataset::ID>(state.range(1));
+  // 0 builds via fit() on the mapped keys for comparison
+  const auto budget_mib = static_cast<size_t>(state.range(2));
+
+  // load dataset
+  auto dataset = dataset::load_cached(did, dataset_size);
+
+  if (dataset.empty()) {
+    throw std::runtime_error("can't benchmark on empty dataset");
+  }
+
+  // shuffle dataset (secondary index case) and spill it in SOSD format, such
+  // that the build only sees mapped keys
+  std::shuffle(dataset.begin(), dataset.end(), rng);
+  const auto tmp = std::filesystem::temp_directory_path() /
+                   ("lsi_external_" + std::to_string(::getpid()));
+  {
+    util::Writer out(tmp.string() + ".keys");
+    out.write<std::uint64_t>(dataset.size());
+    out.write_bytes(reinterpret_cast<const char *>(dataset.data()),
+                    dataset.size() * sizeof(Key));
+  }
+  std::vector<Key> probes;
+  for (size_t i = 0; i < dataset.size(); i += 1000)
+    probes.push_back(dataset[i]);
+  dataset.clear();
+  dataset.shrink_to_fit();
+  const util::MappedKeys<Key> keys(tmp.string() + ".keys");
+
+  size_t index_build_time = 0;
+  size_t bytes = 0;
+  size_t errors = 0;
+  util::BuildStats build_stats;
+  for (auto _ : state) {
+    Index index;
+    const auto start = std::chrono::steady_clock::now();
+    if (budget_mib == 0) {
+      index.fit(keys.begin(), keys.end());
+    } else {
+      index.fit_external(keys.begin(), keys.end(), tmp.string() + ".sorted",
+                         budget_mib << 20);
+    }
+    index_build_time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+    bytes = index.byte_size();
+    benchmark::DoNotOptimize(bytes);
+    add_build_stats(build_stats, index);
+
+    for (const auto probed : probes) {
+      const auto iter =
+          index.template lookup<false>(keys.begin(), keys.end(), probed);
+      errors += iter == index.end() || keys[*iter] != probed;
+    }
+  }
+  std::filesystem::remove(tmp.string() + ".keys");
+
+  if (errors > 0) throw std::runtime_error("kaputt " + std::to_string(errors));
+
+  report_build_stats(state, build_stats, state.iterations());
+  state.counters["build_time"] =
+      static_cast<double>(index_build_time) / state.iterations();
+  state.counters["budget_bytes"] = static_cast<double>(budget_mib << 20);
+  state.counters["bytes"] = bytes;
+  state.SetLabel(Index::name() + ":" + dataset::name(did) + ":" +
+                 std::to_string(budget_mib));
+}
+
+template <class Index>
+static void TunedProbe(benchmark::State &state) {
+  std::default_random_engine rng(dataset::seed());
+
+  const auto dataset_size = state.range(0);
+  const auto did = static_cast<dataset::ID>(state.range(1));
+  // 0 for an unbounded memory budget
+  const auto budget_bits_per_key = static_cast<size_t>(state.range(3));
+
+  // load dataset
+  auto dataset = dataset::load_cached(did, dataset_size);
+
+  if (dataset.empty()) {
+    throw std::runtime_error("can't benchmark on empty dataset");
+  }
+
+  // probe in random order to limit caching effects
+  const auto probing_dist =
+      static_cast<dataset::ProbingDistribution>(state.range(2));
+  const auto probing_set = dataset::generate_probing_set(dataset, probing_dist);
+
+  // shuffle dataset & tune + build index
+  std::shuffle(dataset.begin(), dataset.end(), rng);
+  const util::TunerOptions options{
+      .memory_budget = budget_bits_per_key * dataset.size() / 8};
+  const auto start = std::chrono::steady_clock::now();
+  const Index index(dataset.begin(), dataset.end(), 1, options);
+  const auto index_build_time =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+
+  size_t i = 0;
+  size_t errors = 0;
+  util::LookupStats stats;
+  for (auto _ : state) {
+    // get next lookup element
+    while (unlikely(i >= probing_set.size())) i -= probing_set.size();
+    const auto probed = probing_set[i++];
+
+    const auto iter = instrumented_lookup<false>(index, dataset.begin(),
+                                                 dataset.end(), probed, stats);
+    benchmark::DoNotOptimize(iter);
+
+    errors += dataset[*iter] != probed;
+
+    // prevent interleaved execution
+    full_memory_barrier();
+  }
+
+  if (errors > 0) throw std::runtime_error("kaputt " + std::to_string(errors));
+
+  const auto &chosen = index.estimates()[index.chosen()];
+  report_lookup_stats(state, stats);
+  state.counters["build_time"] = static_cast<double>(index_build_time);
+  state.counters["predicted_ns"] = chosen.latency_ns;
+  state.counters["predicted_bytes"] = static_cast<double>(chosen.bytes);
+  state.counters["model_bytes"] = index.model_byte_size();
+  state.counters["perm_bytes"] = index.perm_vector_byte_size();
+  state.counters["bytes"] = index.byte_size();
+  state.SetLabel(index.name() + ":" + dataset::name(did) + ":" +
+                 dataset::name(probing_dist) + ":" +
+                 std::to_string(budget_bits_per_key));
+}
+
+template <class Index>
+static void CompositeRangeScan(benchmark::State &state) {
+  std::default_random_engine rng(dataset::seed());
+
+  const auto dataset_size = state.range(0);
+  const auto did = static_cast<dataset::ID>(state.range(1));
+  const auto range_size = static_cast<size_t>(state.range(2));
+  const auto tenants = static_cast<std::uint32_t>(state.range(3));
+
+  // load dataset
+  auto dataset = dataset::load_cached(did, dataset_size);
+
+  if (dataset.empty()) {
+    throw std::runtime_error("can't benchmark on empty dataset");
+  }
+
+  // dataset keys form the suffix column of rows owned by random tenants
+  std::shuffle(dataset.begin(), dataset.end(), rng);
+  std::vector<std::uint32_t> prefixes(dataset.size());
+  std::uniform_int_distribution<std::uint32_t> tenant_dist(0, tenants - 1);
+  for (auto &prefix : prefixes) prefix = tenant_dist(rng);
+
+  // range bounds are chosen such that each range contains roughly
+  // range_size rows of a single tenant
+  std::vector<std::pair<std::uint32_t, Key>> sorted(dataset.size());
+  for (size_t i = 0; i < dataset.size(); i++)
+    sorted[i] = {prefixes[i], dataset[i]};
+  std::sort(sorted.begin(), sorted.end());
+
+  const auto start = std::chrono::steady_clock::now();
+  const Index index(prefixes.begin(), prefixes.end(), dataset.begin());
+  const auto index_build_time =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count();
+
+  std::vector<std::uint64_t> buffer(1024);
+  std::uniform_int_distribution<size_t> dist(0, sorted.size() - 1);
+
+  size_t scanned = 0;
+  size_t errors = 0;
+  util::LookupStats stats;
+  for (auto _ : state) {
+    const auto lo_i = dist(rng);
+    const auto [prefix, lo] = sorted[lo_i];
+    const auto &hi_row =
+        sorted[std::min(lo_i + range_size, sorted.size() - 1)];
+    const auto hi = hi_row.first == prefix ? hi_row.second
+                                           : std::numeric_limits<Key>::max();
+
+    size_t checksum = 0;
+    const auto cnt = index.range(
+        dataset.begin(), dataset.end(), prefix, lo, hi, buffer.data(),
+        buffer.size(),
+        [&](const std::uint64_t *offsets, size_t n) {
+          for (size_t j = 0; j < n; j++) checksum += offsets[j];
+        },
+        stats);
+    benchmark::DoNotOptimize(checksum);
+
+    errors += cnt > 0 &&
+              (prefixes[buffer[0]] != prefix || dataset[buffer[0]] < lo);
+    scanned += cnt;
+
+    // prevent interleaved execution
+    full_memory_barrier();
+  }
+
+  if (errors > 0) throw std::runtime_error("kaputt " + std::to_string(errors));
+
+  report_lookup_stats(state, stats);
+  state.SetItemsProcessed(static_cast<int64_t>(scanned));
+  state.counters["build_time"] = static_cast<double>(index_build_time);
+  state.counters["partitions"] = static_cast<double>(index.partition_count());
+  state.counters["models"] = static_cast<double>(index.model_count());
+  state.counters["model_bytes"] = index.model_byte_size();
+  state.counters["perm_bytes"] = index.perm_vector_byte_size();
+  state.counters["bytes"] = index.byte_size();
+  state.SetLabel(Index::name() + ":" + dataset::name(did) + ":" +
+                 std::to_string(range_size) + ":" + std::to_string(tenants));
+}
+
+/// Result forms compared by RowIdScan, see its range(3)
+enum class RowIdOutput : std::int64_t { key_order, sorted_ids, bitmap };
+
+static std::string name(const RowIdOutput output) {
+  switch (output) {
+    case RowIdOutput::key_order:
+      return "key_order";
+    case RowIdOutput::sorted_ids:
+      return "sorted_ids";
+    case RowIdOutput::bitmap:
+      return "bitmap";
+  }
+  return "unknown";
+}
+
+template <class Index>
+static void RowIdScan(benchmark::State &state) {
+  std::default_random_engine rng(dataset::seed());
+
+  const auto dataset_size = state.range(0);
+  const auto did = static_cast<dataset::ID>(state.range(1));
+  const auto range_size = static_cast<size_t>(state.range(2));
+  const auto output = static_cast<RowIdOutput>(state.range(3));
+
+  // load dataset
+  auto dataset = dataset::load_cached(did, dataset_size);
+
+  if (dataset.empty()) {
+    throw std::runtime_error("can't benchmark on empty dataset");
+  }
+
+  // range bounds are chosen such that each range contains roughly
+  // range_size keys
+  auto sorted = dataset;
+  std::sort(sorted.begin(), sorted.end());
+
+  // shuffle dataset & build index
+  std::shuffle(dataset.begin(), dataset.end(), rng);
+  Index index(dataset.begin(), dataset.end());
+
+  std::vector<std::uint64_t> ids;
+  std::vector<std::uint64_t> scratch;
+  util::RowBitmap bitmap;
+  std::uniform_int_distribution<size_t> dist(0, sorted.size() - 1);
+
+  size_t scanned = 0;
+  for (auto _ : state) {
+    const auto lo_i = dist(rng);
+    const auto lo = sorted[lo_i];
+    const auto hi = sorted[std::min(lo_i + range_size, sorted.size() - 1)];
+    const auto first =
+        index.template lookup<true>(dataset.begin(), dataset.end(), lo);
+    const auto last =
+        index.template lookup<true>(dataset.begin(), dataset.end(), hi);
+
+    // consumers receive row ids in key order, ascending or as a bitmap
+    switch (output) {
+      case RowIdOutput::key_order: {
+        size_t checksum = 0;
+        for (auto it = first; it != last; ++it) checksum += *it;
+        benchmark::DoNotOptimize(checksum);
+        scanned += last - first;
+        break;
+      }
+      case RowIdOutput::sorted_ids:
+        scanned += index.row_ids(first, last, ids, scratch);
+        benchmark::DoNotOptimize(ids.data());
+        break;
+      case RowIdOutput::bitmap:
+        scanned += index.row_bitmap(first, last, bitmap, scratch);
+        benchmark::DoNotOptimize(bitmap);
+        break;
+    }
+
+    // prevent interleaved execution
+    full_memory_barrier();
+  }
+
+  state.SetItemsProcessed(static_cast<int64_t>(scanned));
+  state.counters["bitmap_bytes"] = static_cast<double>(bitmap.byte_size());
+  state.counters["bytes"] = index.byte_size();
+  state.SetLabel(Index::name() + ":" + dataset::name(did) + ":" +
+                 std::to_string(range_size) + ":" + name(output));
+}
@@ -0,0 +1,33 @@
+# Writes OUTPUT, a header defining LSI_GIT_REVISION as the abbreviated hash of
+# SOURCE_DIR's HEAD, suffixed with -dirty if tracked files were modified.
+# Invoked via cmake -P on every build (see src/CMakeLists.txt), whereas OUTPUT
+# is only rewritten if the revision changed, i.e., its includers are only
+# recompiled after a commit or checkout
+set(revision "unknown")
+if (GIT_EXECUTABLE)
+  execute_process(
+      COMMAND ${GIT_EXECUTABLE} rev-parse --short HEAD
+      WORKING_DIRECTORY ${SOURCE_DIR}
+      OUTPUT_VARIABLE head
+      OUTPUT_STRIP_TRAILING_WHITESPACE
+      ERROR_QUIET)
+  if (head)
+    set(revision ${head})
+    execute_process(
+        COMMAND ${GIT_EXECUTABLE} status --porcelain --untracked-files=no
+        WORKING_DIRECTORY ${SOURCE_DIR}
+        OUTPUT_VARIABLE changes
+        ERROR_QUIET)
+    if (changes)
+      string(APPEND revision "-dirty")
+    endif ()
+  endif ()
+endif ()
+
+set(content "#pragma once\n\n#define LSI_GIT_REVISION \"${revision}\"\n")
+if (EXISTS ${OUTPUT})
+  file(READ ${OUTPUT} previous)
+endif ()
+if (NOT content STREQUAL previous)
+  file(WRITE ${OUTPUT} ${content})
+endif ()
@@ -1,17 +1,22 @@
 #pragma once
 
 #include <algorithm>
+#include <bit>
 #include <cassert>
 #include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <random>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
 #include "include/convenience/builtins.hpp"
+#include "include/util/ordered_key.hpp"
+#include "seed.hpp"
 
 namespace dataset {
 template <class T> static void sort(std::vector<T> &vec) {
@@ -21,7 +26,8 @@ template <class T> static void sort(std::vector<T> &vec) {
 }
 
 /**
- * Loads the datasets values into memory
+ * Loads the datasets values into memory. Files store sizeof(Key) bytes per
+ * value, e.g., SOSD's *_uint32 files for 4 byte keys
  * @return a sorted and deduplicated list of all members of the dataset
  */
 template <class Key> std::vector<Key> load(const std::string &filepath) {
@@ -55,7 +61,7 @@ template <class Key> std::vector<Key> load(const std::string &filepath) {
   }
 
   const auto max_num_elements = (size - sizeof(std::uint64_t)) / sizeof(Key);
-  std::vector<uint64_t> dataset(max_num_elements, 0);
+  std::vector<Key> dataset(max_num_elements);
   {
     std::vector<unsigned char> buffer(size);
     if (!input.read(reinterpret_cast<char *>(buffer.data()), size))
@@ -64,22 +70,20 @@ template <class Key> std::vector<Key> load(const std::string &filepath) {
     // Parse file
     uint64_t num_elements = read_little_endian_8(buffer, 0);
     assert(num_elements <= max_num_elements);
-    switch (sizeof(Key)) {
-    case sizeof(std::uint64_t):
+    if constexpr (sizeof(Key) == sizeof(std::uint64_t)) {
       for (uint64_t i = 0; i < num_elements; i++) {
         // 8 byte header, 8 bytes per entry
         uint64_t offset = i * 8 + 8;
-        dataset[i] = read_little_endian_8(buffer, offset);
+        dataset[i] = std::bit_cast<Key>(read_little_endian_8(buffer, offset));
       }
-      break;
-    case sizeof(std::uint32_t):
+    } else if constexpr (sizeof(Key) == sizeof(std::uint32_t)) {
       for (uint64_t i = 0; i < num_elements; i++) {
         // 8 byte header, 4 bytes per entry
         uint64_t offset = i * 4 + 8;
-        dataset[i] = read_little_endian_4(buffer, offset);
+        dataset[i] = std::bit_cast<Key>(
+            static_cast<std::uint32_t>(read_little_endian_4(buffer, offset)));
       }
-      break;
-    default:
+    } else {
       throw std::runtime_error(
           "unimplemented amount of bytes per value in dataset: " +
           std::to_string(sizeof(Key)));
@@ -125,10 +129,46 @@ inline std::string name(ID id) {
   return "unnamed";
 };
 
+/**
+ * Derives a dataset of another key type from 64 bit keys. Keys are scaled
+ * by a power of two such that the largest key occupies the most significant
+ * bit of util::ordered_key_t<Data>, which retains their distribution, and
+ * are then mapped back to Data, i.e., signed keys span negative and positive
+ * numbers and string keys are big endian bytes. Doubles are converted by
+ * value instead.
+ */
+template <class Data>
+std::vector<Data> convert(const std::vector<std::uint64_t> &keys) {
+  using Ordered = learned_secondary_index::util::ordered_key_t<Data>;
+
+  std::vector<Data> ds(keys.size());
+  if constexpr (std::is_floating_point_v<Data>) {
+    for (size_t i = 0; i < keys.size(); i++)
+      ds[i] = static_cast<Data>(keys[i]);
+  } else {
+    const auto max = keys.empty()
+                         ? std::uint64_t{0}
+                         : *std::max_element(keys.begin(), keys.end());
+    const int shift = max == 0 ? 0
+                               : static_cast<int>(std::bit_width(max)) -
+                                     static_cast<int>(8 * sizeof(Ordered));
+    for (size_t i = 0; i < keys.size(); i++) {
+      // std::numeric_limits<Ordered>::max() is avoided as for 64 bit keys
+      auto u = static_cast<Ordered>(shift >= 0 ? keys[i] >> shift
+                                               : keys[i] << -shift);
+      if (u == std::numeric_limits<Ordered>::max()) u--;
+      ds[i] = learned_secondary_index::util::from_ordered<Data>(u);
+    }
+  }
+
+  sort(ds);
+  return ds;
+}
+
 template <class Data = std::uint64_t>
+  requires std::is_same_v<Data, std::uint64_t>
 std::vector<Data> load_cached(ID id, size_t dataset_size) {
-  static std::random_device rd;
-  static std::default_random_engine rng(rd());
+  std::default_random_engine rng(seed());
 
   // cache generated & sampled datasets to speed up repeated benchmarks
   static std::unordered_map<ID, std::unordered_map<size_t, std::vector<Data>>>
@@ -273,4 +313,11 @@ std::vector<Data> load_cached(ID id, size_t dataset_size) {
 
   return ds;
 }
+
+/// Keys of type Data other than std::uint64_t, see convert()
+template <class Data>
+  requires(!std::is_same_v<Data, std::uint64_t>)
+std::vector<Data> load_cached(ID id, size_t dataset_size) {
+  return convert<Data>(load_cached<std::uint64_t>(id, dataset_size));
+}
 }; // namespace dataset
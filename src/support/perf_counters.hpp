@@ -0,0 +1,134 @@
+#pragma once
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace perf {
+/// Hardware events recorded by Counters
+enum class Event : std::uint8_t {
+  cache_misses = 0,
+  dtlb_misses = 1,
+  branch_misses = 2
+};
+
+static constexpr size_t event_count = 3;
+
+inline std::string name(const Event event) {
+  switch (event) {
+    case Event::cache_misses:
+      return "cache_misses";
+    case Event::dtlb_misses:
+      return "dtlb_misses";
+    case Event::branch_misses:
+      return "branch_misses";
+  }
+  return "unnamed";
+}
+
+/**
+ * Hardware performance counters of the calling thread obtained via
+ * perf_event_open(2), counting user space events only. Events the kernel
+ * refuses, e.g., due to perf_event_paranoid, within containers or on other
+ * platforms than Linux, are unavailable and never reported.
+ */
+class Counters {
+  std::array<int, event_count> _fds{};
+  std::array<std::uint64_t, event_count> _values{};
+
+#ifdef __linux__
+  static int open(const Event event) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    switch (event) {
+      case Event::cache_misses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+      case Event::dtlb_misses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+      case Event::branch_misses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    }
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+#endif
+
+ public:
+  Counters() {
+    for (size_t e = 0; e < event_count; e++) {
+#ifdef __linux__
+      _fds[e] = open(static_cast<Event>(e));
+#else
+      _fds[e] = -1;
+#endif
+    }
+  }
+
+  Counters(const Counters &) = delete;
+  Counters &operator=(const Counters &) = delete;
+
+  ~Counters() {
+#ifdef __linux__
+    for (const int fd : _fds)
+      if (fd >= 0) close(fd);
+#endif
+  }
+
+  [[nodiscard]] bool available(const Event event) const {
+    return _fds[static_cast<size_t>(event)] >= 0;
+  }
+
+  /// Whether any event is available
+  [[nodiscard]] bool any_available() const {
+    for (size_t e = 0; e < event_count; e++)
+      if (available(static_cast<Event>(e))) return true;
+    return false;
+  }
+
+  /// Resets all counters and starts counting
+  void start() {
+#ifdef __linux__
+    for (const int fd : _fds) {
+      if (fd < 0) continue;
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  /// Stops counting and retains the events counted since start()
+  void stop() {
+#ifdef __linux__
+    for (size_t e = 0; e < event_count; e++) {
+      if (_fds[e] < 0) continue;
+      ioctl(_fds[e], PERF_EVENT_IOC_DISABLE, 0);
+      if (read(_fds[e], &_values[e], sizeof(std::uint64_t)) !=
+          sizeof(std::uint64_t))
+        _values[e] = 0;
+    }
+#endif
+  }
+
+  /// Events counted between the last start() and stop()
+  [[nodiscard]] std::uint64_t value(const Event event) const {
+    return _values[static_cast<size_t>(event)];
+  }
+};
+}  // namespace perf
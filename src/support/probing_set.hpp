@@ -1,7 +1,14 @@
 #pragma once
 
 #include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
 #include <random>
+#include <string>
+#include <vector>
+
+#include "seed.hpp"
 
 namespace dataset {
 enum class ProbingDistribution {
@@ -9,7 +16,10 @@ enum class ProbingDistribution {
   UNIFORM = 0,
   /// probing skewed according to exponential distribution, i.e.,
   /// some keys are way more likely to be picked than others
-  EXPONENTIAL = 1
+  EXPONENTIAL = 1,
+  /// probing skewed according to a zipf distribution, i.e., the key of rank
+  /// k is queried with probability proportional to 1 / k^skew
+  ZIPF = 2
 };
 
 inline std::string name(ProbingDistribution p_dist) {
@@ -18,21 +28,103 @@ inline std::string name(ProbingDistribution p_dist) {
       return "uniform";
     case ProbingDistribution::EXPONENTIAL:
       return "exponential";
+    case ProbingDistribution::ZIPF:
+      return "zipf";
   }
   return "unnamed";
 };
 
+/// Skew of ProbingDistribution::ZIPF unless specified otherwise
+static constexpr double default_zipf_skew = 0.99;
+
+/**
+ * Samples ranks in [1, n] with probability proportional to 1 / rank^skew in
+ * constant time and space via rejection inversion, see W. Hörmann and G.
+ * Derflinger: "Rejection-inversion to generate variates from monotone
+ * discrete distributions" (1996). Any skew >= 0 is supported, with 0 being
+ * uniform.
+ */
+class ZipfDistribution {
+  double _skew;
+  std::uint64_t _n;
+  double _h_integral_x1;
+  double _h_integral_n;
+  double _s;
+
+  /// log(1 + x) / x, stable for x close to 0
+  static double helper1(const double x) {
+    return std::abs(x) > 1e-8 ? std::log1p(x) / x
+                              : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+  }
+
+  /// (exp(x) - 1) / x, stable for x close to 0
+  static double helper2(const double x) {
+    return std::abs(x) > 1e-8
+               ? std::expm1(x) / x
+               : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+  }
+
+  /// integral of h(x) = 1 / x^skew from 1 to x
+  [[nodiscard]] double h_integral(const double x) const {
+    const double log_x = std::log(x);
+    return helper2((1.0 - _skew) * log_x) * log_x;
+  }
+
+  [[nodiscard]] double h(const double x) const {
+    return std::exp(-_skew * std::log(x));
+  }
+
+  [[nodiscard]] double h_integral_inverse(const double x) const {
+    double t = x * (1.0 - _skew);
+    // guards against rounding errors yielding t < -1
+    if (t < -1.0) t = -1.0;
+    return std::exp(helper1(t) * x);
+  }
+
+ public:
+  ZipfDistribution(const std::uint64_t n, const double skew)
+      : _skew(skew),
+        _n(n),
+        _h_integral_x1(h_integral(1.5) - 1.0),
+        _h_integral_n(h_integral(static_cast<double>(n) + 0.5)),
+        _s(2.0 - h_integral_inverse(h_integral(2.5) - h(2.0))) {
+    assert(n > 0);
+    assert(skew >= 0.0);
+  }
+
+  template <class RNG>
+  std::uint64_t operator()(RNG &rng) const {
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    while (true) {
+      // u is uniformly distributed in (h_integral_x1, h_integral_n]
+      const double u =
+          _h_integral_n + dist(rng) * (_h_integral_x1 - _h_integral_n);
+      const double x = h_integral_inverse(u);
+
+      auto k = static_cast<std::uint64_t>(x + 0.5);
+      k = std::clamp<std::uint64_t>(k, 1, _n);
+
+      // accept k if u is within the area below h(k) or trivially within the
+      // region between x and k, which is below h for all k
+      const double kd = static_cast<double>(k);
+      if (kd - x <= _s || u >= h_integral(kd + 0.5) - h(kd)) return k;
+    }
+  }
+};
+
 /**
  * generates a probing order for any dataset dataset, given a desired
  * distribution
+ *
+ * @param zipf_skew skew of ProbingDistribution::ZIPF, ignored otherwise
  */
 template <class T>
-static std::vector<T> generate_probing_set(std::vector<T> dataset,
-                                           ProbingDistribution distribution) {
+static std::vector<T> generate_probing_set(
+    std::vector<T> dataset, ProbingDistribution distribution,
+    const double zipf_skew = default_zipf_skew) {
   if (dataset.empty()) return {};
 
-  std::random_device rd;
-  std::default_random_engine rng(rd());
+  std::default_random_engine rng(seed());
 
   size_t size = dataset.size();
   std::vector<T> probing_set(size, dataset[0]);
@@ -57,9 +149,44 @@ static std::vector<T> generate_probing_set(std::vector<T> dataset,
             dataset[(dataset.size() - 1) * std::min(1.0, dist(rng))];
       break;
     }
+    case ProbingDistribution::ZIPF: {
+      // shuffle to assign ranks, i.e., popularity, independent of key order
+      std::shuffle(dataset.begin(), dataset.end(), rng);
+
+      const ZipfDistribution dist(dataset.size(), zipf_skew);
+      for (size_t i = 0; i < size; i++) probing_set[i] = dataset[dist(rng) - 1];
+      break;
+    }
   }
 
   return probing_set;
 }
 
+/**
+ * Replaces miss_percent of all probes, picked uniformly at random, by their
+ * closest successor absent from dataset, i.e., by keys an equality lookup
+ * must not find.
+ *
+ * @return for each probe whether it is (still) present in dataset
+ */
+template <class T>
+static std::vector<bool> replace_with_absent(std::vector<T> &probing_set,
+                                             std::vector<T> dataset,
+                                             const size_t miss_percent) {
+  std::default_random_engine rng(seed() + 1);
+
+  std::sort(dataset.begin(), dataset.end());
+  std::uniform_int_distribution<size_t> percent(0, 99);
+  std::vector<bool> present(probing_set.size(), true);
+  for (size_t i = 0; i < probing_set.size(); i++) {
+    if (percent(rng) >= miss_percent) continue;
+    auto absent = probing_set[i];
+    while (std::binary_search(dataset.begin(), dataset.end(), absent))
+      absent++;
+    probing_set[i] = absent;
+    present[i] = false;
+  }
+  return present;
+}
+
 }  // namespace dataset
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+
+namespace dataset {
+/// Seed used if the environment does not specify one via LSI_SEED
+static constexpr std::uint64_t default_seed = 42;
+
+/**
+ * Seed of all pseudo random number generators used to generate, sample and
+ * shuffle datasets and probing sets, i.e., benchmark runs with the same seed
+ * probe the exact same keys in the same order. Read once from the LSI_SEED
+ * environment variable, defaults to default_seed
+ */
+inline std::uint64_t seed() {
+  static const std::uint64_t seed = [] {
+    const char *env = std::getenv("LSI_SEED");
+    return env != nullptr ? std::strtoull(env, nullptr, 10) : default_seed;
+  }();
+  return seed;
+}
+}  // namespace dataset
@@ -1,6 +1,14 @@
+#include "tests/allocation-tests.hpp"
 #include "tests/art-tests.hpp"
+#include "tests/base-data-tests.hpp"
 #include "tests/btree-tests.hpp"
+#include "tests/cached-lsi-tests.hpp"
+#include "tests/composite-lsi-tests.hpp"
 #include "tests/fast64-tests.hpp"
 #include "tests/hash-tests.hpp"
 #include "tests/lsi-tests.hpp"
 #include "tests/permvector-tests.hpp"
+#include "tests/row-set-tests.hpp"
+#include "tests/sharded-lsi-tests.hpp"
+#include "tests/tuned-lsi-tests.hpp"
+#include "tests/updatable-lsi-tests.hpp"
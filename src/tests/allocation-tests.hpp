@@ -0,0 +1,163 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <learned_secondary_index.hpp>
+#include <memory_resource>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace allocation_tests {
+using namespace learned_secondary_index;
+
+using Key = std::uint64_t;
+using Model = learned_hashing::RadixSplineHash<Key, 18, 16>;
+
+/// installs resource as util::buffer_resource() while in scope
+class ScopedBufferResource {
+  std::pmr::memory_resource *_previous;
+
+ public:
+  explicit ScopedBufferResource(std::pmr::memory_resource *resource)
+      : _previous(util::set_buffer_resource(resource)) {}
+  ~ScopedBufferResource() { util::set_buffer_resource(_previous); }
+};
+
+/// buffers must be zeroed, aligned, writable and freeable
+void check_buffers(std::pmr::memory_resource *resource) {
+  std::vector<util::Buffer> buffers;
+  for (const size_t size : {1UL, 100UL, 4096UL, 1UL << 20, 5UL << 20}) {
+    util::Buffer buffer(size, resource);
+    ASSERT_EQ(buffer.size(), size);
+    EXPECT_EQ(buffer.resource(), resource);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(buffer.data()) %
+                  util::Buffer::alignment,
+              0);
+    EXPECT_TRUE(std::all_of(buffer.data(), buffer.data() + size,
+                            [](const char c) { return c == 0; }));
+    std::memset(buffer.data(), 0x5A, size);
+    buffers.push_back(std::move(buffer));
+  }
+
+  // moves retain the bytes' location
+  const char *data = buffers.back().data();
+  util::Buffer moved(std::move(buffers.back()));
+  EXPECT_EQ(moved.data(), data);
+  EXPECT_TRUE(buffers.back().empty());
+  EXPECT_EQ(moved.data()[moved.size() - 1], 0x5A);
+  moved.clear();
+  EXPECT_TRUE(moved.empty());
+  EXPECT_EQ(moved.resource(), nullptr);
+}
+
+TEST(Allocation, Buffer) {
+  check_buffers(std::pmr::new_delete_resource());
+
+  const util::Buffer empty(0);
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(empty.data(), nullptr);
+}
+
+TEST(Allocation, HugePageResource) {
+  // huge pages may not be reserved, which must transparently fall back
+  for (const auto page_size :
+       {util::PageSize::standard, util::PageSize::huge_2mb}) {
+    util::HugePageResource resource(page_size);
+    check_buffers(&resource);
+    if (page_size == util::PageSize::standard)
+      EXPECT_EQ(resource.fallbacks(), 0);
+  }
+  EXPECT_EQ(util::HugePageResource(util::PageSize::huge_1gb).page_bytes(),
+            1UL << 30);
+}
+
+TEST(Allocation, Arena) {
+  util::Arena arena(1UL << 20);
+  check_buffers(&arena);
+  EXPECT_GE(arena.reserved_bytes(), arena.allocated_bytes());
+
+  // concurrent allocations never overlap
+  std::vector<std::vector<util::Buffer>> per_thread(4);
+  std::vector<std::thread> threads;
+  for (auto &buffers : per_thread) {
+    threads.emplace_back([&]() {
+      for (size_t i = 0; i < 100; i++) buffers.emplace_back(1000 + i, &arena);
+    });
+  }
+  for (auto &thread : threads) thread.join();
+
+  std::set<std::pair<const char *, const char *>> ranges;
+  for (const auto &buffers : per_thread)
+    for (const auto &buffer : buffers)
+      ranges.emplace(buffer.data(), buffer.data() + buffer.size());
+  ASSERT_EQ(ranges.size(), 400);
+  for (auto it = ranges.begin(); std::next(it) != ranges.end(); ++it)
+    EXPECT_LE(it->second, std::next(it)->first);
+
+  // huge pages as upstream are shared by all of the arena's buffers
+  util::HugePageResource huge_pages;
+  util::Arena shared(4UL << 20, &huge_pages);
+  util::Buffer a(100, &shared);
+  util::Buffer b(100, &shared);
+  EXPECT_EQ(shared.reserved_bytes(), 4UL << 20);
+  EXPECT_EQ(b.data() - a.data(), 128);
+}
+
+/// indices built on buffers of a resource must answer exactly like indices
+/// on default allocated buffers
+template <std::uint8_t fingerprint_size, class PermStorage,
+          std::uint8_t key_prefix_bits = 0>
+void test_lsi_on(std::pmr::memory_resource *resource) {
+  using Index = LearnedSecondaryIndex<
+      Key, Model, fingerprint_size, false, 0, PermStorage,
+      util::CountingInstrumentation, false, hashing::MurmurFinalizer<Key>,
+      util::NoFilter, 0, key_prefix_bits>;
+
+  std::mt19937_64 rng(42);
+  std::vector<Key> keys(100000);
+  for (auto &key : keys) key = rng() % 50000;
+
+  const Index expected(keys.begin(), keys.end());
+  std::vector<Index> indices;
+  {
+    ScopedBufferResource scope(resource);
+    for (size_t i = 0; i < 3; i++)
+      indices.emplace_back(keys.begin(), keys.end(), 4);
+  }
+  EXPECT_EQ(util::buffer_resource(), std::pmr::new_delete_resource());
+
+  for (const auto &index : indices) {
+    EXPECT_EQ(index.byte_size(), expected.byte_size());
+    for (Key key = 0; key < 50010; key += 3) {
+      EXPECT_EQ(
+          index.template lookup<false>(keys.begin(), keys.end(), key) -
+              index.begin(),
+          expected.template lookup<false>(keys.begin(), keys.end(), key) -
+              expected.begin());
+      EXPECT_EQ(
+          index.template lookup<true>(keys.begin(), keys.end(), key) -
+              index.begin(),
+          expected.template lookup<true>(keys.begin(), keys.end(), key) -
+              expected.begin());
+    }
+  }
+}
+
+TEST(Allocation, LearnedSecondaryIndex) {
+  util::HugePageResource huge_pages;
+  test_lsi_on<0, util::SeparateStorage>(&huge_pages);
+  test_lsi_on<8, util::InterleavedStorage>(&huge_pages);
+
+  util::Arena arena(16UL << 20, &huge_pages);
+  test_lsi_on<8, util::SeparateStorage>(&arena);
+  test_lsi_on<0, util::CompressedStorage>(&arena);
+  test_lsi_on<8, util::AlignedStorage>(&arena);
+  test_lsi_on<0, util::SeparateStorage, 16>(&arena);
+  EXPECT_GT(arena.allocated_bytes(), 0);
+}
+}  // namespace allocation_tests
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <learned_secondary_index.hpp>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace base_data_tests {
+using namespace learned_secondary_index;
+
+using Key = std::uint64_t;
+using Model = learned_hashing::RadixSplineHash<Key, 18, 16>;
+
+static_assert(util::BaseDataAccessor<util::ContiguousColumn<Key>>);
+static_assert(util::BaseDataAccessor<util::PagedColumn<Key>>);
+static_assert(util::BaseDataAccessor<util::MappedColumn<Key>>);
+static_assert(std::random_access_iterator<util::PagedColumn<Key>::iterator>);
+
+std::vector<Key> gen_keys(const size_t n) {
+  std::mt19937_64 rng(42);
+  std::vector<Key> keys;
+  keys.reserve(n);
+  for (size_t i = 0; i < n; i++) keys.push_back(rng() % (n / 2));
+  return keys;
+}
+
+/// splits keys into pages of page_size rows, the last one being partial
+std::vector<std::vector<Key>> paginate(const std::vector<Key> &keys,
+                                       const size_t page_size) {
+  std::vector<std::vector<Key>> pages;
+  for (size_t i = 0; i < keys.size(); i += page_size)
+    pages.emplace_back(keys.begin() + i,
+                       keys.begin() + std::min(keys.size(), i + page_size));
+  return pages;
+}
+
+util::PagedColumn<Key> paged_column(
+    const std::vector<std::vector<Key>> &pages, const size_t page_size,
+    const size_t size) {
+  std::vector<const Key *> frames;
+  for (const auto &page : pages) frames.push_back(page.data());
+  return {std::move(frames), page_size, size};
+}
+
+/// accessors must yield the rows of keys via get(), iterators and gather()
+template <class Accessor>
+void check_accessor(const Accessor &column, const std::vector<Key> &keys) {
+  ASSERT_EQ(column.size(), keys.size());
+  EXPECT_EQ(static_cast<size_t>(column.end() - column.begin()), keys.size());
+  EXPECT_TRUE(std::equal(column.begin(), column.end(), keys.begin()));
+  for (size_t i = 0; i < keys.size(); i += 7) {
+    EXPECT_EQ(column.get(i), keys[i]);
+    EXPECT_EQ(*(column.begin() + i), keys[i]);
+  }
+
+  std::mt19937_64 rng(42);
+  std::vector<std::uint64_t> indices(100);
+  for (auto &i : indices) i = rng() % keys.size();
+  std::vector<Key> out(indices.size());
+  column.gather(indices.data(), indices.size(), out.data());
+  for (size_t k = 0; k < indices.size(); k++)
+    EXPECT_EQ(out[k], keys[indices[k]]);
+
+  // gathers through offset iterators must not forward absolute indices
+  util::gather_base(column.begin() + 1, indices.data(), 10, out.data());
+  for (size_t k = 0; k < 10; k++) EXPECT_EQ(out[k], keys[indices[k] + 1]);
+}
+
+TEST(BaseData, Accessors) {
+  const auto keys = gen_keys(10000);
+
+  check_accessor(util::ContiguousColumn<Key>(keys.data(), keys.size()), keys);
+
+  for (const size_t page_size : {1UL, 64UL, 1024UL, 16384UL}) {
+    const auto pages = paginate(keys, page_size);
+    const auto column = paged_column(pages, page_size, keys.size());
+    EXPECT_EQ(column.page_size(), page_size);
+    check_accessor(column, keys);
+  }
+
+  // raw column behind a header, i.e., at a nonzero byte offset
+  const auto path = testing::TempDir() + "base_data_column.bin";
+  {
+    util::Writer out(path);
+    out.write<std::uint64_t>(0xC0FFEE);
+    out.write_bytes(reinterpret_cast<const char *>(keys.data()),
+                    keys.size() * sizeof(Key));
+  }
+  check_accessor(util::MappedColumn<Key>(path, sizeof(std::uint64_t)), keys);
+  check_accessor(util::MappedColumn<Key>(path, sizeof(std::uint64_t), 10),
+                 std::vector<Key>(keys.begin(), keys.begin() + 10));
+
+  EXPECT_THROW(util::MappedColumn<Key>(path, 1), std::runtime_error);
+  EXPECT_THROW(util::MappedColumn<Key>(path, 8, keys.size() + 1),
+               std::runtime_error);
+  EXPECT_THROW(util::MappedColumn<Key>(path + ".missing"), std::runtime_error);
+  EXPECT_THROW(paged_column({}, 100, 0), std::invalid_argument);
+  EXPECT_THROW(paged_column({}, 64, 1), std::invalid_argument);
+  std::filesystem::remove(path);
+}
+
+/// indices fitted on and probing accessors must behave exactly like indices
+/// on contiguous iterators
+template <std::uint8_t fingerprint_size, bool force_linear_search,
+          class Accessor>
+void test_lsi_on(const Accessor &column, const std::vector<Key> &keys) {
+  using Index =
+      LearnedSecondaryIndex<Key, Model, fingerprint_size, force_linear_search>;
+  const Index expected(keys.begin(), keys.end());
+  const Index index(column.begin(), column.end(), 4);
+  EXPECT_EQ(index.byte_size(), expected.byte_size());
+
+  std::vector<Key> probes;
+  for (Key key = 0; key < keys.size() / 2 + 10; key++) probes.push_back(key);
+
+  for (const auto key : probes) {
+    const auto eq = index.template lookup<false>(column.begin(), column.end(),
+                                                 key);
+    const auto e_eq =
+        expected.template lookup<false>(keys.begin(), keys.end(), key);
+    EXPECT_EQ(eq - index.begin(), e_eq - expected.begin());
+
+    const auto lb =
+        index.template lookup<true>(column.begin(), column.end(), key);
+    const auto e_lb =
+        expected.template lookup<true>(keys.begin(), keys.end(), key);
+    EXPECT_EQ(lb - index.begin(), e_lb - expected.begin());
+  }
+
+  // batched lookups gather through the accessor
+  using Iter = decltype(index.begin());
+  std::vector<Iter> results;
+  index.template lookup_batch<false>(column.begin(), column.end(),
+                                     probes.begin(), probes.end(),
+                                     std::back_inserter(results));
+  ASSERT_EQ(results.size(), probes.size());
+  for (size_t i = 0; i < probes.size(); i++) {
+    EXPECT_EQ(results[i], index.template lookup<false>(
+                              column.begin(), column.end(), probes[i]));
+  }
+
+  auto task = index.template lookup_coroutine<true>(column.begin(),
+                                                    column.end(), probes[1]);
+  EXPECT_EQ(task.get(), index.template lookup<true>(column.begin(),
+                                                    column.end(), probes[1]));
+}
+
+TEST(BaseData, LearnedSecondaryIndex) {
+  const auto keys = gen_keys(100000);
+
+  const size_t page_size = 4096;
+  const auto pages = paginate(keys, page_size);
+  const auto paged = paged_column(pages, page_size, keys.size());
+  test_lsi_on<0, false>(paged, keys);
+  test_lsi_on<0, true>(paged, keys);
+  test_lsi_on<8, false>(paged, keys);
+
+  const auto path = testing::TempDir() + "base_data_lsi.bin";
+  {
+    util::Writer out(path);
+    out.write_bytes(reinterpret_cast<const char *>(keys.data()),
+                    keys.size() * sizeof(Key));
+  }
+  test_lsi_on<0, false>(util::MappedColumn<Key>(path), keys);
+  test_lsi_on<8, false>(util::MappedColumn<Key>(path), keys);
+  std::filesystem::remove(path);
+}
+}  // namespace base_data_tests
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <learned_secondary_index.hpp>
+#include <random>
+#include <vector>
+
+namespace cached_lsi_tests {
+using namespace learned_secondary_index;
+
+using Key = std::uint64_t;
+using Index =
+    LearnedSecondaryIndex<Key, learned_hashing::RadixSplineHash<Key, 18, 16>,
+                          8>;
+
+/// cached lookups must yield exactly what the underlying index yields
+template <size_t cache_slots>
+void test_cached_lookups() {
+  const auto datasize = 20000;
+
+  std::mt19937 rng(42);
+  std::vector<Key> keys;
+  keys.reserve(datasize);
+  for (size_t i = 0; i < datasize; i++) keys.push_back(rng() % datasize);
+
+  const Index index(keys.begin(), keys.end());
+  CachedLearnedSecondaryIndex<Key, Index, cache_slots> cached(index);
+
+  // probe a small set of hot keys (incl. missing ones) repeatedly
+  std::exponential_distribution<> dist(10);
+  for (size_t i = 0; i < 10 * datasize; i++) {
+    const Key key = datasize * std::min(1.0, dist(rng));
+    const auto expected = index.lookup<false>(keys.begin(), keys.end(), key);
+    EXPECT_EQ(cached.template lookup<false>(keys.begin(), keys.end(), key) -
+                  cached.begin(),
+              expected - index.begin());
+    EXPECT_EQ(cached.template lookup<true>(keys.begin(), keys.end(), key) -
+                  cached.begin(),
+              index.lookup<true>(keys.begin(), keys.end(), key) -
+                  index.begin());
+  }
+  EXPECT_EQ(cached.cache_hits() + cached.cache_misses(), 10 * datasize);
+  EXPECT_GT(cached.cache_hits(), 0);
+  if constexpr (cache_slots >= 4096)
+    EXPECT_GT(cached.cache_hits(), cached.cache_misses());
+
+  cached.clear_cache();
+  EXPECT_EQ(cached.cache_hits(), 0);
+  cached.template lookup<false>(keys.begin(), keys.end(), keys[0]);
+  cached.template lookup<false>(keys.begin(), keys.end(), keys[0]);
+  EXPECT_EQ(cached.cache_hits(), 1);
+  EXPECT_EQ(cached.cache_misses(), 1);
+}
+
+TEST(CachedLearnedSecondaryIndex, Lookup) {
+  test_cached_lookups<1>();
+  test_cached_lookups<64>();
+  test_cached_lookups<4096>();
+}
+
+TEST(CachedLearnedSecondaryIndex, Owned) {
+  std::vector<Key> keys;
+  for (Key key = 1000; key > 0; key--) keys.push_back(key % 100);
+
+  CachedLearnedSecondaryIndex<Key, Index> cached(keys.begin(), keys.end());
+  for (size_t round = 0; round < 2; round++) {
+    for (Key key = 0; key < 110; key++) {
+      const auto iter = cached.lookup<false>(keys.begin(), keys.end(), key);
+      EXPECT_EQ(iter != cached.end(), key < 100);
+      if (iter != cached.end()) EXPECT_EQ(keys[*iter], key);
+    }
+  }
+  EXPECT_GE(cached.cache_hits(), 100);
+}
+}  // namespace cached_lsi_tests
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <learned_secondary_index.hpp>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace composite_lsi_tests {
+using namespace learned_secondary_index;
+
+using Prefix = std::uint32_t;
+
+/// rows of a few large and many small tenants with duplicate suffixes
+template <class Suffix>
+std::pair<std::vector<Prefix>, std::vector<Suffix>> make_rows(
+    const size_t n) {
+  std::mt19937_64 rng(42);
+  std::vector<Prefix> prefixes(n);
+  std::vector<Suffix> suffixes(n);
+  for (size_t i = 0; i < n; i++) {
+    // every other row belongs to one of 4 large tenants
+    prefixes[i] = i % 2 == 0 ? 10 * (rng() % 4) : 10 * (rng() % 1000) + 5;
+    suffixes[i] = static_cast<Suffix>(rng() % (n / 8));
+  }
+  return {prefixes, suffixes};
+}
+
+/// checks lookups, ranges and equal ranges against a sorted copy of rows
+template <class Index, class Suffix>
+void check_lookups(const Index &index, const std::vector<Prefix> &prefixes,
+                   const std::vector<Suffix> &suffixes) {
+  std::vector<std::pair<Prefix, Suffix>> sorted;
+  for (size_t i = 0; i < prefixes.size(); i++)
+    sorted.emplace_back(prefixes[i], suffixes[i]);
+  std::sort(sorted.begin(), sorted.end());
+
+  // iterating the entire index yields all rows in lexicographic order
+  size_t i = 0;
+  for (auto it = index.begin(); it != index.end(); it++, i++) {
+    EXPECT_EQ(prefixes[*it], sorted[i].first);
+    EXPECT_EQ(suffixes[*it], sorted[i].second);
+  }
+  EXPECT_EQ(i, sorted.size());
+
+  const auto begin = suffixes.begin();
+  const auto end = suffixes.end();
+  std::vector<std::uint64_t> buffer(7);
+  for (Prefix prefix = 0; prefix < 10010; prefix += 5) {
+    const auto first = std::partition_point(
+        sorted.begin(), sorted.end(),
+        [&](const auto &row) { return row.first < prefix; });
+    const auto last = std::partition_point(
+        first, sorted.end(),
+        [&](const auto &row) { return row.first == prefix; });
+    const auto [eq_first, eq_last] = index.equal_range(prefix);
+    ASSERT_EQ(eq_last - eq_first, static_cast<size_t>(last - first));
+    if (first != last)
+      EXPECT_EQ(eq_first - index.begin(),
+                static_cast<size_t>(first - sorted.begin()));
+
+    // probe suffixes of the prefix's rows as well as absent suffixes
+    const Suffix max_suffix = static_cast<Suffix>(suffixes.size() / 8 + 2);
+    for (Suffix suffix = 0; suffix <= max_suffix; suffix += 97) {
+      const std::pair<Prefix, Suffix> key(prefix, suffix);
+      const auto lb = std::lower_bound(sorted.begin(), sorted.end(), key);
+
+      const auto lb_iter = index.template lookup<true>(begin, end, prefix,
+                                                       suffix);
+      EXPECT_EQ(lb_iter - index.begin(),
+                static_cast<size_t>(lb - sorted.begin()));
+
+      const auto eq_iter = index.template lookup<false>(begin, end, prefix,
+                                                        suffix);
+      if (lb != sorted.end() && *lb == key) {
+        EXPECT_EQ(eq_iter - index.begin(),
+                  static_cast<size_t>(lb - sorted.begin()));
+      } else {
+        EXPECT_EQ(eq_iter, index.end());
+      }
+
+      const Suffix hi = suffix + 300;
+      const auto hi_lb = std::lower_bound(sorted.begin(), sorted.end(),
+                                          std::make_pair(prefix, hi));
+      std::vector<std::uint64_t> scanned;
+      const size_t cnt = index.range(
+          begin, end, prefix, suffix, hi, buffer.data(), buffer.size(),
+          [&](const std::uint64_t *offsets, size_t n) {
+            scanned.insert(scanned.end(), offsets, offsets + n);
+          });
+      ASSERT_EQ(cnt, static_cast<size_t>(hi_lb - lb));
+      ASSERT_EQ(scanned.size(), cnt);
+      for (size_t j = 0; j < cnt; j++) {
+        EXPECT_EQ(prefixes[scanned[j]], prefix);
+        EXPECT_EQ(suffixes[scanned[j]], (lb + j)->second);
+      }
+    }
+  }
+}
+
+TEST(CompositeLearnedSecondaryIndex, Lookup) {
+  const auto [prefixes, suffixes] = make_rows<std::uint64_t>(100000);
+
+  for (const size_t threads : {1, 4}) {
+    // large tenants obtain a model each, small ones are binary searched
+    const CompositeLearnedSecondaryIndex<Prefix, std::uint64_t> index(
+        prefixes.begin(), prefixes.end(), suffixes.begin(), threads);
+    EXPECT_EQ(index.partition_count(), 1004);
+    EXPECT_EQ(index.model_count(), 4);
+    check_lookups(index, prefixes, suffixes);
+  }
+
+  // binary searching the large tenants as well
+  const CompositeLearnedSecondaryIndex<Prefix, std::uint64_t> unmodeled(
+      prefixes.begin(), prefixes.end(), suffixes.begin(), 1, 1UL << 20);
+  EXPECT_EQ(unmodeled.model_count(), 0);
+  check_lookups(unmodeled, prefixes, suffixes);
+}
+
+TEST(CompositeLearnedSecondaryIndex, Options) {
+  const auto [prefixes, suffixes] = make_rows<double>(50000);
+
+  // every tenant modeled
+  const CompositeLearnedSecondaryIndex<
+      Prefix, double,
+      learned_hashing::TrieSplineHash<util::ordered_key_t<double>, 16>,
+      util::CompressedStorage>
+      index(prefixes.begin(), prefixes.end(), suffixes.begin(), 2, 1);
+  EXPECT_EQ(index.model_count(), index.partition_count());
+  check_lookups(index, prefixes, suffixes);
+}
+
+TEST(CompositeLearnedSecondaryIndex, Instrumentation) {
+  const auto [prefixes, suffixes] = make_rows<std::uint64_t>(100000);
+  const CompositeLearnedSecondaryIndex<Prefix, std::uint64_t> index(
+      prefixes.begin(), prefixes.end(), suffixes.begin());
+
+  // models of large tenants narrow the window below a full binary search
+  util::LookupStats stats;
+  for (std::uint64_t suffix = 0; suffix < 1000; suffix++)
+    index.lookup<true>(suffixes.begin(), suffixes.end(), 0, suffix, stats);
+  const auto [first, last] = index.equal_range(0);
+  EXPECT_EQ(stats.lookups, 1000);
+  EXPECT_LT(stats.window_size, 1000 * (last - first) / 16);
+
+  // absent prefixes are rejected by the directory
+  util::LookupStats absent;
+  EXPECT_EQ(index.lookup<false>(suffixes.begin(), suffixes.end(), 1, 0, absent),
+            index.end());
+  EXPECT_EQ(absent.base_data_accesses, 0);
+}
+
+/// predicts the first row of each distinct key seen during training, i.e.,
+/// without error but with a window exhausted by any absent key
+template <class Key>
+struct StepModel {
+  std::vector<std::pair<Key, size_t>> steps;
+
+  template <class It>
+  void train(It begin, It end, size_t) {
+    steps.clear();
+    for (auto it = begin; it < end; it++)
+      if (steps.empty() || steps.back().first != *it)
+        steps.emplace_back(*it, it - begin);
+  }
+
+  size_t operator()(const Key &key) const {
+    const auto it = std::partition_point(
+        steps.begin(), steps.end(),
+        [&](const auto &step) { return !(key < step.first); });
+    return it == steps.begin() ? 0 : (it - 1)->second;
+  }
+
+  size_t byte_size() const { return steps.size() * sizeof(steps[0]); }
+
+  static std::string name() { return "step"; }
+};
+
+/// lower bounds past a long run of duplicates, i.e., past the model's window,
+/// must not scan the run
+TEST(CompositeLearnedSecondaryIndex, DuplicateRun) {
+  std::vector<Prefix> prefixes;
+  std::vector<std::uint64_t> suffixes;
+  for (std::uint64_t suffix = 0; suffix < 10000; suffix++) {
+    prefixes.push_back(1);
+    suffixes.push_back(2 * suffix);
+  }
+  const size_t run_begin = suffixes.size();
+  for (size_t i = 0; i < 100000; i++) {
+    prefixes.push_back(1);
+    suffixes.push_back(20000);
+  }
+  for (std::uint64_t suffix = 0; suffix < 1000; suffix++) {
+    prefixes.push_back(1);
+    suffixes.push_back(30000 + suffix);
+  }
+  const CompositeLearnedSecondaryIndex<
+      Prefix, std::uint64_t, StepModel<util::ordered_key_t<std::uint64_t>>>
+      index(prefixes.begin(), prefixes.end(), suffixes.begin());
+  ASSERT_EQ(index.model_count(), 1);
+
+  const auto begin = suffixes.begin();
+  const auto end = suffixes.end();
+  for (const std::uint64_t absent : {20001, 25000, 29999}) {
+    util::LookupStats stats;
+    const auto lb = index.lookup<true>(begin, end, 1, absent, stats);
+    EXPECT_EQ(lb - index.begin(), run_begin + 100000);
+    EXPECT_EQ(suffixes[*lb], 30000);
+    EXPECT_LT(stats.base_data_accesses, 200);
+    EXPECT_EQ(index.lookup<false>(begin, end, 1, absent), index.end());
+  }
+
+  // past the last suffix of the partition
+  util::LookupStats stats;
+  EXPECT_EQ(index.lookup<true>(begin, end, 1, 40000, stats), index.end());
+  EXPECT_LT(stats.base_data_accesses, 200);
+  EXPECT_EQ(index.lookup<true>(begin, end, 1, 20000) - index.begin(),
+            run_begin);
+}
+
+TEST(CompositeLearnedSecondaryIndex, Empty) {
+  const std::vector<Prefix> prefixes;
+  const std::vector<std::uint64_t> suffixes;
+  const CompositeLearnedSecondaryIndex<Prefix, std::uint64_t> index(
+      prefixes.begin(), prefixes.end(), suffixes.begin());
+
+  EXPECT_EQ(index.begin(), index.end());
+  EXPECT_EQ(index.partition_count(), 0);
+  EXPECT_EQ(index.lookup<true>(suffixes.begin(), suffixes.end(), 3, 3),
+            index.end());
+  EXPECT_EQ(index.equal_range(3).first, index.end());
+}
+}  // namespace composite_lsi_tests
@@ -4,8 +4,13 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <filesystem>
 #include <learned_secondary_index.hpp>
+#include <limits>
 #include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include <unordered_map>
 
 using namespace learned_secondary_index;
@@ -68,10 +73,14 @@ TEST(LearnedSecondaryIndex, LinearSearch) {
 }
 
 /// fingerprint tests
-template <std::uint8_t fingerprint_size>
+template <std::uint8_t fingerprint_size,
+          class PermStorage = util::SeparateStorage,
+          class Hash = hashing::MurmurFinalizer<Key>>
 void test_fingerprint_lsi(const std::vector<Key> &keys) {
   // build LearnedSecondaryIndex on randomly shuffled keys
-  LearnedSecondaryIndex<Key, Model, fingerprint_size> lsi;
+  LearnedSecondaryIndex<Key, Model, fingerprint_size, false, 0, PermStorage,
+                        util::CountingInstrumentation, false, Hash>
+      lsi;
   lsi.fit(keys.begin(), keys.end());
 
   // test that retrieve works for all keys
@@ -102,6 +111,22 @@ TEST(LearnedSecondaryIndex, Fingerprinted) {
   test_fingerprint_lsi<4>(keys);
   test_fingerprint_lsi<8>(keys);
   test_fingerprint_lsi<16>(keys);
+
+  // fingerprint bits interleaved with offsets must behave identically
+  test_fingerprint_lsi<0, util::InterleavedStorage>(keys);
+  test_fingerprint_lsi<4, util::InterleavedStorage>(keys);
+  test_fingerprint_lsi<16, util::InterleavedStorage>(keys);
+  test_fingerprint_lsi<0, util::CompressedStorage>(keys);
+  test_fingerprint_lsi<8, util::CompressedStorage>(keys);
+  test_fingerprint_lsi<0, util::AlignedStorage>(keys);
+  test_fingerprint_lsi<8, util::AlignedStorage>(keys);
+  test_fingerprint_lsi<12, util::AlignedStorage>(keys);
+
+  // cheaper multiplicative fingerprint hashing
+  test_fingerprint_lsi<8, util::SeparateStorage, util::MultiplyShift<Key>>(
+      keys);
+  test_fingerprint_lsi<16, util::InterleavedStorage,
+                       util::MultiplyShift<Key>>(keys);
 }
 
 /// tests for duplicate handling
@@ -204,4 +229,1214 @@ TEST(LearnedSecondaryIndex, LowerBound) {
   test_fingerprinted_lowerbound<4>();
 }
 
+/// batched lookups must yield the same results as individual lookups
+template <std::uint8_t fingerprint_size, bool force_linear_search>
+void test_batch_lookup() {
+  const auto datasize = 100000;
+
+  std::mt19937 rng(42);
+
+  // generate keys
+  std::vector<Key> keys;
+  keys.reserve(datasize);
+  for (size_t i = 0; i < datasize; i++) {
+    const auto key = i * i;
+    const auto dupl_cnt = rng() % 4 + 1;
+    for (size_t j = 0; j < dupl_cnt; j++) keys.push_back(key);
+  }
+
+  // shuffle keys (secondary index case)
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  LearnedSecondaryIndex<Key, Model, fingerprint_size, force_linear_search> lsi;
+  lsi.fit(keys.begin(), keys.end());
+
+  // probe existing keys as well as non-keys
+  std::vector<Key> probes(keys.begin(), keys.end());
+  for (size_t i = 0; i < datasize; i++) probes.push_back(i * i + 1);
+  std::shuffle(probes.begin(), probes.end(), rng);
+
+  using Iter = decltype(lsi.begin());
+  std::vector<Iter> eq_results;
+  lsi.template lookup_batch<false>(keys.begin(), keys.end(), probes.begin(),
+                                   probes.end(),
+                                   std::back_inserter(eq_results));
+  std::vector<Iter> lb_results;
+  lsi.template lookup_batch<true>(keys.begin(), keys.end(), probes.begin(),
+                                  probes.end(),
+                                  std::back_inserter(lb_results));
+
+  ASSERT_EQ(eq_results.size(), probes.size());
+  ASSERT_EQ(lb_results.size(), probes.size());
+  for (size_t i = 0; i < probes.size(); i++) {
+    EXPECT_EQ(eq_results[i], lsi.template lookup<false>(
+                                 keys.begin(), keys.end(), probes[i]));
+    EXPECT_EQ(lb_results[i], lsi.template lookup<true>(
+                                 keys.begin(), keys.end(), probes[i]));
+  }
+}
+
+TEST(LearnedSecondaryIndex, BatchLookup) {
+  test_batch_lookup<0, false>();
+  test_batch_lookup<0, true>();
+  test_batch_lookup<8, false>();
+}
+
+/// interleaved coroutine lookups must yield the same results and statistics
+/// as individual lookups
+template <std::uint8_t fingerprint_size, bool force_linear_search,
+          class Filter = util::NoFilter>
+void test_coroutine_lookup() {
+  const auto datasize = 10000;
+
+  std::mt19937 rng(42);
+
+  // generate keys with duplicates
+  std::vector<Key> keys;
+  for (size_t i = 0; i < datasize; i++) {
+    const auto dupl_cnt = rng() % 4 + 1;
+    for (size_t j = 0; j < dupl_cnt; j++) keys.push_back(i * i);
+  }
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  using Index = LearnedSecondaryIndex<Key, Model, fingerprint_size,
+                                      force_linear_search, 0,
+                                      util::SeparateStorage,
+                                      util::CountingInstrumentation, false,
+                                      hashing::MurmurFinalizer<Key>, Filter>;
+  const Index lsi(keys.begin(), keys.end());
+
+  // probe existing keys as well as non-keys
+  std::vector<Key> probes(keys.begin(), keys.end());
+  for (size_t i = 0; i < datasize; i++) probes.push_back(i * i + 1);
+  std::shuffle(probes.begin(), probes.end(), rng);
+
+  for (const bool lowerbound : {false, true}) {
+    util::LookupStats expected_stats, stats;
+    const auto start = [&](const Key &key) {
+      return lowerbound ? lsi.template lookup_coroutine<true>(
+                              keys.begin(), keys.end(), key, stats)
+                        : lsi.template lookup_coroutine<false>(
+                              keys.begin(), keys.end(), key, stats);
+    };
+
+    // resume a window of tasks round robin, refilling finished slots
+    std::vector<util::LookupTask<typename Index::PermIter>> tasks;
+    std::vector<size_t> probe_of;
+    size_t next = 0, finished = 0;
+    for (; next < 16 && next < probes.size(); next++) {
+      tasks.push_back(start(probes[next]));
+      probe_of.push_back(next);
+    }
+    while (finished < probes.size()) {
+      for (size_t t = 0; t < tasks.size(); t++) {
+        if (tasks[t].done() || !tasks[t].resume()) continue;
+
+        const auto &key = probes[probe_of[t]];
+        const auto expected =
+            lowerbound ? lsi.template lookup<true>(keys.begin(), keys.end(),
+                                                   key, expected_stats)
+                       : lsi.template lookup<false>(keys.begin(), keys.end(),
+                                                    key, expected_stats);
+        EXPECT_EQ(tasks[t].result(), expected);
+        finished++;
+
+        if (next < probes.size()) {
+          tasks[t] = start(probes[next]);
+          probe_of[t] = next++;
+        }
+      }
+    }
+
+    EXPECT_EQ(stats.lookups, expected_stats.lookups);
+    EXPECT_EQ(stats.base_data_accesses, expected_stats.base_data_accesses);
+    EXPECT_EQ(stats.filter_rejections, expected_stats.filter_rejections);
+    EXPECT_EQ(stats.false_positive_accesses,
+              expected_stats.false_positive_accesses);
+  }
+
+  // driving a task to completion equals a plain lookup
+  auto task =
+      lsi.template lookup_coroutine<false>(keys.begin(), keys.end(), keys[0]);
+  EXPECT_FALSE(task.done());
+  EXPECT_EQ(task.get(),
+            lsi.template lookup<false>(keys.begin(), keys.end(), keys[0]));
+}
+
+TEST(LearnedSecondaryIndex, CoroutineLookup) {
+  test_coroutine_lookup<0, false>();
+  test_coroutine_lookup<0, true>();
+  test_coroutine_lookup<8, false>();
+  test_coroutine_lookup<8, false, util::BlockedBloomFilter<8>>();
+}
+
+/// parallel builds must yield an index equivalent to the serial build
+TEST(LearnedSecondaryIndex, ParallelBuild) {
+  const auto datasize = 100000;
+
+  std::mt19937 rng(42);
+
+  // generate keys
+  std::vector<Key> keys;
+  keys.reserve(datasize);
+  for (size_t i = 0; i < datasize; i++) {
+    const auto key = i * i;
+    const auto dupl_cnt = rng() % 10 + 1;
+    for (size_t j = 0; j < dupl_cnt; j++) keys.push_back(key);
+  }
+
+  // shuffle keys (secondary index case)
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  LearnedSecondaryIndex<Key, Model, 8> serial(keys.begin(), keys.end());
+  for (const size_t threads : {2, 3, 8}) {
+    LearnedSecondaryIndex<Key, Model, 8> parallel(keys.begin(), keys.end(),
+                                                  threads);
+    EXPECT_EQ(parallel.byte_size(), serial.byte_size());
+
+    for (size_t i = 0; i < keys.size(); i++) {
+      const auto iter =
+          parallel.lookup<false>(keys.begin(), keys.end(), keys[i]);
+      EXPECT_NE(iter, parallel.end());
+      EXPECT_EQ(keys[*iter], keys[i]);
+      if (parallel.begin() < iter) EXPECT_NE(keys[*(iter - 1)], keys[i]);
+    }
+  }
+}
+
+/// local error bounds must not break equality or lowerbound lookups
+template <std::uint8_t fingerprint_size, size_t error_bucket_size>
+void test_local_error_bounds() {
+  const auto datasize = 100000;
+
+  std::mt19937 rng(42);
+
+  // generate keys with a long run of duplicates as outlier region
+  std::vector<Key> keys;
+  keys.reserve(datasize);
+  for (size_t i = 0; i < datasize; i++) {
+    const auto key = i * i;
+    const auto dupl_cnt = i == datasize / 2 ? 5000 : rng() % 4 + 1;
+    for (size_t j = 0; j < dupl_cnt; j++) keys.push_back(key);
+  }
+
+  // shuffle keys (secondary index case)
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  // build on 90% of keys to also obtain non-key probes
+  const auto training_end =
+      keys.begin() + static_cast<int>(static_cast<double>(keys.size()) * 0.9);
+  const auto max_training_elem = *std::max_element(keys.begin(), training_end);
+
+  LearnedSecondaryIndex<Key, Model, fingerprint_size, false,
+                        error_bucket_size>
+      lsi(keys.begin(), training_end, 4);
+
+  auto it = keys.begin();
+  for (; it < training_end; it++) {
+    const auto key = *it;
+    const auto eq_iter =
+        lsi.template lookup<false>(keys.begin(), training_end, key);
+    EXPECT_NE(eq_iter, lsi.end());
+    EXPECT_EQ(keys[*eq_iter], key);
+    if (lsi.begin() < eq_iter) EXPECT_NE(keys[*(eq_iter - 1)], key);
+
+    const auto lb_iter =
+        lsi.template lookup<true>(keys.begin(), training_end, key);
+    EXPECT_EQ(lb_iter, eq_iter);
+  }
+  for (; it < keys.end(); it++) {
+    const auto key = *it;
+    const auto iter =
+        lsi.template lookup<true>(keys.begin(), training_end, key);
+    if (key <= max_training_elem) {
+      EXPECT_NE(iter, lsi.end());
+      EXPECT_LE(key, keys[*iter]);
+      if (lsi.begin() < iter) EXPECT_LT(keys[*(iter - 1)], key);
+    } else {
+      EXPECT_EQ(iter, lsi.end());
+    }
+  }
+
+  // local bounds should only shrink search intervals
+  LearnedSecondaryIndex<Key, Model, fingerprint_size, false,
+                        error_bucket_size>
+      local(keys.begin(), training_end);
+  LearnedSecondaryIndex<Key, Model, fingerprint_size> global(keys.begin(),
+                                                             training_end);
+  EXPECT_GT(local.model_byte_size(), global.model_byte_size());
+  util::LookupStats local_stats, global_stats;
+  for (auto it = keys.begin(); it < training_end; it++) {
+    local.template lookup<false>(keys.begin(), training_end, *it, local_stats);
+    global.template lookup<false>(keys.begin(), training_end, *it,
+                                  global_stats);
+  }
+  EXPECT_LE(local_stats.window_size, global_stats.window_size);
+  EXPECT_LE(local_stats.base_data_accesses, global_stats.base_data_accesses);
+}
+
+TEST(LearnedSecondaryIndex, LocalErrorBounds) {
+  test_local_error_bounds<0, 1>();
+  test_local_error_bounds<0, 64>();
+  test_local_error_bounds<8, 256>();
+}
+
+/// concurrent lookups into caller owned stats must not interfere, and
+/// disabled instrumentation must not record anything
+TEST(LearnedSecondaryIndex, Instrumentation) {
+  const auto datasize = 100000;
+
+  std::mt19937 rng(42);
+  std::vector<Key> keys;
+  keys.reserve(datasize);
+  for (size_t i = 0; i < datasize; i++) keys.push_back(rng() % datasize);
+
+  const LearnedSecondaryIndex<Key, Model, 8> lsi(keys.begin(), keys.end());
+
+  util::LookupStats expected;
+  for (const auto &key : keys)
+    lsi.lookup<false>(keys.begin(), keys.end(), key, expected);
+  EXPECT_EQ(expected.lookups, keys.size());
+  EXPECT_GE(expected.window_size, expected.fingerprint_hits);
+  EXPECT_GE(expected.fingerprint_hits, keys.size());
+  EXPECT_EQ(expected.base_data_accesses, expected.fingerprint_hits);
+  EXPECT_LT(expected.false_positive_accesses, expected.base_data_accesses);
+
+  std::vector<util::LookupStats> stats(4);
+  std::vector<std::thread> workers;
+  for (auto &s : stats) {
+    workers.emplace_back([&] {
+      for (const auto &key : keys)
+        lsi.lookup<false>(keys.begin(), keys.end(), key, s);
+    });
+  }
+  for (auto &worker : workers) worker.join();
+  for (const auto &s : stats) {
+    EXPECT_EQ(s.lookups, expected.lookups);
+    EXPECT_EQ(s.base_data_accesses, expected.base_data_accesses);
+    EXPECT_EQ(s.false_positive_accesses, expected.false_positive_accesses);
+    EXPECT_EQ(s.window_size, expected.window_size);
+    EXPECT_EQ(s.fingerprint_hits, expected.fingerprint_hits);
+  }
+
+  const LearnedSecondaryIndex<Key, Model, 8, false, 0, util::SeparateStorage,
+                              util::NoInstrumentation>
+      uninstrumented(keys.begin(), keys.end());
+  util::LookupStats ignored;
+  for (const auto &key : keys) {
+    const auto iter =
+        uninstrumented.lookup<false>(keys.begin(), keys.end(), key, ignored);
+    EXPECT_EQ(iter - uninstrumented.begin(),
+              lsi.lookup<false>(keys.begin(), keys.end(), key) - lsi.begin());
+  }
+  EXPECT_EQ(ignored.lookups, 0);
+  EXPECT_EQ(ignored.base_data_accesses, 0);
+  EXPECT_EQ(util::NoInstrumentation::thread_stats().base_data_accesses, 0);
+}
+
+/// every build phase is timed, and phases skipped by fit_sorted() are zero
+TEST(LearnedSecondaryIndex, BuildStats) {
+  const auto datasize = 100000;
+
+  std::mt19937 rng(42);
+  std::vector<Key> keys;
+  keys.reserve(datasize);
+  for (size_t i = 0; i < datasize; i++) keys.push_back(rng());
+
+  const LearnedSecondaryIndex<Key, Model, 8> lsi(keys.begin(), keys.end(), 2);
+  const auto &stats = lsi.build_stats();
+  EXPECT_GT(stats.sort_ns, 0);
+  EXPECT_GT(stats.train_ns, 0);
+  EXPECT_GT(stats.scan_ns, 0);
+  EXPECT_GT(stats.pack_ns, 0);
+  EXPECT_EQ(stats.total_ns(), stats.sort_ns + stats.train_ns + stats.scan_ns +
+                                  stats.pack_ns + stats.auxiliary_ns);
+
+  std::vector<std::pair<Key, size_t>> sorted;
+  for (size_t i = 0; i < keys.size(); i++) sorted.emplace_back(keys[i], i);
+  std::sort(sorted.begin(), sorted.end());
+  LearnedSecondaryIndex<Key, Model, 8> presorted;
+  presorted.fit_sorted(sorted.begin(), sorted.end());
+  EXPECT_EQ(presorted.build_stats().sort_ns, 0);
+  EXPECT_GT(presorted.build_stats().pack_ns, 0);
+}
+
+/// indices restored via load() must behave exactly like the saved ones
+template <std::uint8_t fingerprint_size, size_t error_bucket_size,
+          class PermStorage>
+void test_save_load() {
+  const auto datasize = 100000;
+
+  std::mt19937 rng(42);
+
+  // generate keys with duplicates
+  std::vector<Key> keys;
+  keys.reserve(datasize);
+  for (size_t i = 0; i < datasize; i++) keys.push_back(rng() % (datasize / 2));
+
+  using Index = LearnedSecondaryIndex<Key, Model, fingerprint_size, false,
+                                      error_bucket_size, PermStorage>;
+  const Index saved(keys.begin(), keys.end());
+
+  const auto path = testing::TempDir() + "lsi_save_load_" +
+                    std::to_string(fingerprint_size) + "_" +
+                    std::to_string(error_bucket_size) + "_" +
+                    PermStorage::name() + ".bin";
+  saved.save(path);
+
+  Index loaded;
+  loaded.load(path, keys.begin(), keys.end(), 3);
+  EXPECT_EQ(loaded.model_byte_size(), saved.model_byte_size());
+
+  for (Key key = 0; key < datasize / 2 + 10; key++) {
+    const auto s_eq =
+        saved.template lookup<false>(keys.begin(), keys.end(), key);
+    const auto l_eq =
+        loaded.template lookup<false>(keys.begin(), keys.end(), key);
+    EXPECT_EQ(s_eq - saved.begin(), l_eq - loaded.begin());
+    if (l_eq != loaded.end()) EXPECT_EQ(*l_eq, *s_eq);
+
+    const auto s_lb =
+        saved.template lookup<true>(keys.begin(), keys.end(), key);
+    const auto l_lb =
+        loaded.template lookup<true>(keys.begin(), keys.end(), key);
+    EXPECT_EQ(s_lb - saved.begin(), l_lb - loaded.begin());
+    if (l_lb != loaded.end()) EXPECT_EQ(*l_lb, *s_lb);
+  }
+
+  // mismatching index type or data must be rejected
+  LearnedSecondaryIndex<Key, Model, fingerprint_size + 1> other;
+  EXPECT_THROW(other.load(path, keys.begin(), keys.end()), std::runtime_error);
+  EXPECT_THROW(loaded.load(path, keys.begin(), keys.end() - 1),
+               std::runtime_error);
+  EXPECT_THROW(loaded.load(path + ".missing", keys.begin(), keys.end()),
+               std::runtime_error);
+}
+
+TEST(LearnedSecondaryIndex, SaveLoad) {
+  test_save_load<0, 0, util::SeparateStorage>();
+  test_save_load<8, 0, util::SeparateStorage>();
+  test_save_load<0, 64, util::SeparateStorage>();
+  test_save_load<8, 0, util::InterleavedStorage>();
+  test_save_load<4, 256, util::InterleavedStorage>();
+  test_save_load<8, 64, util::CompressedStorage>();
+  test_save_load<8, 0, util::AlignedStorage>();
+}
+
+/// piecewise linear model owning heap memory, persisted via its hooks
+struct HookedModel {
+  static inline size_t trainings = 0;
+
+  /// (key, position) of every 64th sorted key and the last one
+  std::vector<std::pair<double, double>> knots;
+
+  template <class It>
+  void train(const It &begin, const It &end, const size_t full_size) {
+    trainings++;
+    knots.clear();
+    size_t i = 0;
+    for (auto it = begin; it != end; ++it, i++)
+      if (i % 64 == 0 || i + 1 == full_size)
+        knots.emplace_back(static_cast<double>(*it), static_cast<double>(i));
+  }
+
+  size_t operator()(const Key &key) const {
+    const double k = static_cast<double>(key);
+    const auto it = std::upper_bound(
+        knots.begin(), knots.end(), k,
+        [](const double x, const auto &knot) { return x < knot.first; });
+    if (it == knots.begin()) return 0;
+    if (it == knots.end()) return static_cast<size_t>(knots.back().second);
+    const auto &[x0, y0] = *(it - 1);
+    const auto &[x1, y1] = *it;
+    return static_cast<size_t>(y0 + (k - x0) / (x1 - x0) * (y1 - y0));
+  }
+
+  void save(util::Writer &out) const {
+    out.write<std::uint64_t>(knots.size());
+    for (const auto &[x, y] : knots) {
+      out.write<double>(x);
+      out.write<double>(y);
+    }
+  }
+
+  void load(util::Reader &in) {
+    knots.resize(in.read<std::uint64_t>());
+    for (auto &[x, y] : knots) {
+      x = in.read<double>();
+      y = in.read<double>();
+    }
+  }
+
+  [[nodiscard]] size_t byte_size() const {
+    return sizeof(*this) + knots.size() * sizeof(knots[0]);
+  }
+
+  static std::string name() { return "hooked"; }
+};
+
+/// models providing save() and load() hooks are restored without retraining,
+/// i.e., without accessing base data
+TEST(LearnedSecondaryIndex, SaveLoadModel) {
+  static_assert(util::ModelSerializer<HookedModel>::supported);
+
+  std::mt19937 rng(42);
+  std::vector<Key> keys(50000);
+  for (auto &key : keys) key = rng() % 100000;
+
+  using Index = LearnedSecondaryIndex<Key, HookedModel, 8>;
+  const Index saved(keys.begin(), keys.end());
+  const auto path = testing::TempDir() + "lsi_save_load_model.bin";
+  saved.save(path);
+
+  HookedModel::trainings = 0;
+  Index loaded;
+  loaded.load(path, keys.begin(), keys.end());
+  EXPECT_EQ(HookedModel::trainings, 0);
+  EXPECT_EQ(loaded.model_byte_size(), saved.model_byte_size());
+
+  for (Key key = 0; key < 100010; key += 3) {
+    const auto s_lb = saved.lookup<true>(keys.begin(), keys.end(), key);
+    const auto l_lb = loaded.lookup<true>(keys.begin(), keys.end(), key);
+    EXPECT_EQ(s_lb - saved.begin(), l_lb - loaded.begin());
+    const auto l_eq = loaded.lookup<false>(keys.begin(), keys.end(), key);
+    if (l_eq != loaded.end()) EXPECT_EQ(keys[*l_eq], key);
+  }
+}
+
+/// files are tagged with their key type, i.e., keys of equal size and models
+/// on the same ordered representation do not load into each other
+TEST(LearnedSecondaryIndex, SaveLoadKeyType) {
+  std::vector<std::int64_t> signed_keys(1000);
+  std::vector<Key> unsigned_keys(1000);
+  std::vector<double> double_keys(1000);
+  for (size_t i = 0; i < 1000; i++) {
+    signed_keys[i] = static_cast<std::int64_t>(i) - 500;
+    unsigned_keys[i] = i;
+    double_keys[i] = static_cast<double>(i) / 3;
+  }
+
+  const auto path = testing::TempDir() + "lsi_save_load_key_type.bin";
+  const LearnedSecondaryIndex<std::int64_t, Model> saved(signed_keys.begin(),
+                                                         signed_keys.end());
+  saved.save(path);
+
+  LearnedSecondaryIndex<Key, Model> as_unsigned;
+  EXPECT_THROW(as_unsigned.load(path, unsigned_keys.begin(),
+                                unsigned_keys.end()),
+               std::runtime_error);
+  LearnedSecondaryIndex<double, Model> as_double;
+  EXPECT_THROW(as_double.load(path, double_keys.begin(), double_keys.end()),
+               std::runtime_error);
+
+  LearnedSecondaryIndex<std::int64_t, Model> as_signed;
+  as_signed.load(path, signed_keys.begin(), signed_keys.end());
+  EXPECT_EQ(*as_signed.lookup<false>(signed_keys.begin(), signed_keys.end(),
+                                     -3),
+            497);
+}
+
+/// lookups specialized on the offsets bit width must match generic lookups
+template <std::uint8_t fingerprint_size, bool force_linear_search,
+          class PermStorage = util::SeparateStorage>
+void test_specialized_kernels(const size_t datasize) {
+  std::mt19937 rng(42);
+
+  // generate keys with duplicates and gaps
+  std::vector<Key> keys;
+  keys.reserve(datasize);
+  for (size_t i = 0; i < datasize; i++) keys.push_back(2 * (rng() % datasize));
+
+  // InterleavedStorage has no fixed width, i.e., always uses the generic
+  // kernel, whereas fixed width storages specialize on widths >= 16
+  const LearnedSecondaryIndex<Key, Model, fingerprint_size,
+                              force_linear_search, 0, PermStorage>
+      specialized(keys.begin(), keys.end());
+  const LearnedSecondaryIndex<Key, Model, fingerprint_size,
+                              force_linear_search, 0, util::InterleavedStorage>
+      generic(keys.begin(), keys.end());
+
+  for (Key key = 0; key < 2 * datasize + 10; key++) {
+    const auto s_eq =
+        specialized.template lookup<false>(keys.begin(), keys.end(), key);
+    const auto g_eq =
+        generic.template lookup<false>(keys.begin(), keys.end(), key);
+    EXPECT_EQ(s_eq - specialized.begin(), g_eq - generic.begin());
+    if (g_eq != generic.end()) EXPECT_EQ(*s_eq, *g_eq);
+
+    const auto s_lb =
+        specialized.template lookup<true>(keys.begin(), keys.end(), key);
+    const auto g_lb =
+        generic.template lookup<true>(keys.begin(), keys.end(), key);
+    EXPECT_EQ(s_lb - specialized.begin(), g_lb - generic.begin());
+    if (g_lb != generic.end()) EXPECT_EQ(*s_lb, *g_lb);
+  }
+}
+
+TEST(LearnedSecondaryIndex, SpecializedKernels) {
+  // below min_kernel_width
+  test_specialized_kernels<0, false>(1000);
+  test_specialized_kernels<8, true>(1000);
+
+  // 17 bit offsets
+  test_specialized_kernels<0, false>(100000);
+  test_specialized_kernels<0, true>(100000);
+  test_specialized_kernels<8, true>(100000);
+  test_specialized_kernels<0, false, util::AlignedStorage>(100000);
+  test_specialized_kernels<8, true, util::AlignedStorage>(100000);
+}
+
+/// range scans must yield exactly the offsets of all keys in [lo, hi)
+template <std::uint8_t fingerprint_size, class PermStorage>
+void test_range() {
+  const auto datasize = 100000;
+
+  std::mt19937 rng(42);
+  std::vector<Key> keys;
+  keys.reserve(datasize);
+  for (size_t i = 0; i < datasize; i++) keys.push_back(rng() % (datasize / 4));
+
+  LearnedSecondaryIndex<Key, Model, fingerprint_size, false, 0, PermStorage>
+      lsi(keys.begin(), keys.end());
+
+  std::vector<std::pair<Key, std::uint64_t>> sorted;
+  for (size_t i = 0; i < keys.size(); i++) sorted.emplace_back(keys[i], i);
+  std::sort(sorted.begin(), sorted.end());
+
+  std::vector<std::uint64_t> buffer(37);
+  for (Key lo = 0; lo < datasize / 4 + 10; lo += 997) {
+    for (const Key width : {0, 1, 13, 1000, datasize}) {
+      const Key hi = lo + width;
+
+      std::vector<std::uint64_t> offsets;
+      const auto cnt =
+          lsi.range(keys.begin(), keys.end(), lo, hi, buffer.data(),
+                    buffer.size(), [&](const std::uint64_t *b, size_t n) {
+                      EXPECT_LE(n, buffer.size());
+                      offsets.insert(offsets.end(), b, b + n);
+                    });
+      EXPECT_EQ(cnt, offsets.size());
+
+      // yielded in key order
+      for (size_t i = 1; i < offsets.size(); i++)
+        EXPECT_LE(keys[offsets[i - 1]], keys[offsets[i]]);
+
+      std::vector<std::uint64_t> expected;
+      for (auto it = std::lower_bound(sorted.begin(), sorted.end(),
+                                      std::make_pair(lo, std::uint64_t{0}));
+           it < sorted.end() && it->first < hi; it++)
+        expected.push_back(it->second);
+      std::sort(offsets.begin(), offsets.end());
+      std::sort(expected.begin(), expected.end());
+      EXPECT_EQ(offsets, expected);
+    }
+  }
+}
+
+TEST(LearnedSecondaryIndex, Range) {
+  test_range<0, util::SeparateStorage>();
+  test_range<8, util::SeparateStorage>();
+  test_range<8, util::InterleavedStorage>();
+  test_range<0, util::CompressedStorage>();
+}
+
+/// equal_range must yield exactly all duplicates, with run boundaries not
+/// requiring any additional base data accesses
+template <std::uint8_t fingerprint_size, bool run_boundaries>
+void test_equal_range() {
+  std::mt19937 rng(42);
+
+  // mix of unique keys, short runs, word crossing runs and long runs
+  std::vector<Key> keys;
+  for (Key key = 0; key < 2000; key++) {
+    const size_t run = key % 100 == 0 ? 3000 : key % 7 == 0 ? 70 : key % 3;
+    keys.insert(keys.end(), run, key);
+  }
+  std::shuffle(keys.begin(), keys.end(), rng);
+  auto sorted = keys;
+  std::sort(sorted.begin(), sorted.end());
+
+  using Index = LearnedSecondaryIndex<Key, Model, fingerprint_size, false, 0,
+                                      util::SeparateStorage,
+                                      util::CountingInstrumentation,
+                                      run_boundaries>;
+  const Index lsi(keys.begin(), keys.end());
+
+  const auto check = [&](const Index &index) {
+    for (Key key = 0; key <= 2001; key++) {
+      util::LookupStats lookup_stats, range_stats;
+      index.template lookup<false>(keys.begin(), keys.end(), key,
+                                   lookup_stats);
+      const auto [first, last] =
+          index.equal_range(keys.begin(), keys.end(), key, range_stats);
+
+      const auto expected =
+          std::equal_range(sorted.begin(), sorted.end(), key);
+      EXPECT_EQ(last - first, expected.second - expected.first);
+      for (auto it = first; it != last; it++) EXPECT_EQ(keys[*it], key);
+      if (first == last) EXPECT_EQ(first, index.end());
+
+      if constexpr (run_boundaries) {
+        EXPECT_EQ(range_stats.base_data_accesses,
+                  lookup_stats.base_data_accesses);
+      } else if (first != last) {
+        EXPECT_GE(range_stats.base_data_accesses,
+                  lookup_stats.base_data_accesses + (last - first) - 1);
+      }
+    }
+  };
+  check(lsi);
+
+  const auto path = testing::TempDir() + "lsi_equal_range_" +
+                    std::to_string(fingerprint_size) + "_" +
+                    std::to_string(run_boundaries) + ".bin";
+  lsi.save(path);
+  Index loaded;
+  loaded.load(path, keys.begin(), keys.end());
+  EXPECT_EQ(loaded.model_byte_size(), lsi.model_byte_size());
+  check(loaded);
+}
+
+TEST(LearnedSecondaryIndex, EqualRange) {
+  test_equal_range<0, false>();
+  test_equal_range<0, true>();
+  test_equal_range<8, true>();
+}
+
+/// filtered indices must never reject present keys, reject most absent keys
+/// and otherwise answer exactly like unfiltered indices
+template <std::uint8_t fingerprint_size, class Filter>
+void test_filtered(const size_t threads) {
+  const auto datasize = 100000;
+
+  std::mt19937 rng(42);
+
+  // even keys with duplicates, i.e., odd keys are absent
+  std::vector<Key> keys;
+  for (Key key = 0; key < 2 * datasize; key += 2)
+    keys.insert(keys.end(), rng() % 3 + 1, key);
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  using Index = LearnedSecondaryIndex<
+      Key, Model, fingerprint_size, false, 0, util::SeparateStorage,
+      util::CountingInstrumentation, false, hashing::MurmurFinalizer<Key>,
+      Filter>;
+  const Index lsi(keys.begin(), keys.end(), threads);
+  const LearnedSecondaryIndex<Key, Model, fingerprint_size> unfiltered(
+      keys.begin(), keys.end());
+  EXPECT_EQ(lsi.byte_size(), unfiltered.byte_size() + lsi.filter_byte_size());
+
+  std::vector<Key> probes;
+  for (Key key = 0; key < 2 * datasize + 10; key++) probes.push_back(key);
+
+  util::LookupStats stats;
+  for (const auto key : probes) {
+    const auto iter =
+        lsi.template lookup<false>(keys.begin(), keys.end(), key, stats);
+    const auto expected =
+        unfiltered.template lookup<false>(keys.begin(), keys.end(), key);
+    EXPECT_EQ(iter - lsi.begin(), expected - unfiltered.begin());
+    if (key % 2 == 0 && key < 2 * datasize) EXPECT_NE(iter, lsi.end());
+
+    // lowerbound lookups are never filtered
+    EXPECT_EQ(
+        lsi.template lookup<true>(keys.begin(), keys.end(), key) - lsi.begin(),
+        unfiltered.template lookup<true>(keys.begin(), keys.end(), key) -
+            unfiltered.begin());
+  }
+  EXPECT_EQ(stats.lookups, probes.size());
+  EXPECT_LE(stats.filter_rejections, probes.size() / 2 + 10);
+  if constexpr (!std::is_same_v<Filter, util::NoFilter>) {
+    EXPECT_GE(stats.filter_rejections, 9 * (probes.size() / 2) / 10);
+  }
+
+  std::shuffle(probes.begin(), probes.end(), rng);
+  std::vector<decltype(lsi.begin())> results;
+  lsi.template lookup_batch<false>(keys.begin(), keys.end(), probes.begin(),
+                                   probes.end(), std::back_inserter(results));
+  ASSERT_EQ(results.size(), probes.size());
+  for (size_t i = 0; i < probes.size(); i++)
+    EXPECT_EQ(results[i], lsi.template lookup<false>(keys.begin(), keys.end(),
+                                                     probes[i]));
+
+  const auto path = testing::TempDir() + "lsi_filtered_" +
+                    std::to_string(fingerprint_size) + "_" + Filter::name() +
+                    ".bin";
+  lsi.save(path);
+  Index loaded;
+  loaded.load(path, keys.begin(), keys.end());
+  EXPECT_EQ(loaded.byte_size(), lsi.byte_size());
+  for (const auto key : probes) {
+    const auto l_eq =
+        loaded.template lookup<false>(keys.begin(), keys.end(), key);
+    const auto s_eq = lsi.template lookup<false>(keys.begin(), keys.end(), key);
+    EXPECT_EQ(l_eq - loaded.begin(), s_eq - lsi.begin());
+  }
+}
+
+TEST(LearnedSecondaryIndex, Filtered) {
+  test_filtered<0, util::NoFilter>(1);
+  test_filtered<0, util::BlockedBloomFilter<8>>(1);
+  test_filtered<8, util::BlockedBloomFilter<8>>(4);
+  test_filtered<0, util::BlockedBloomFilter<16>>(4);
+}
+
+/// to_ordered() must preserve order and be inverted by from_ordered()
+template <class T>
+void test_ordered_key(std::vector<T> values) {
+  std::sort(values.begin(), values.end());
+  for (size_t i = 0; i < values.size(); i++) {
+    EXPECT_EQ(util::from_ordered<T>(util::to_ordered(values[i])), values[i]);
+    if (i > 0)
+      EXPECT_EQ(values[i - 1] < values[i],
+                util::to_ordered(values[i - 1]) < util::to_ordered(values[i]));
+  }
+}
+
+TEST(OrderedKey, Roundtrip) {
+  test_ordered_key<std::uint32_t>({0, 1, 7, 1U << 31, ~0U});
+  test_ordered_key<std::int32_t>({-2147483647 - 1, -5, -1, 0, 1, 2147483647});
+  test_ordered_key<std::int64_t>(
+      {std::numeric_limits<std::int64_t>::min(), -1, 0, 42,
+       std::numeric_limits<std::int64_t>::max()});
+  test_ordered_key<double>({-std::numeric_limits<double>::infinity(), -1e300,
+                            -1.5, -1e-300, 0.0, 1e-300, 1.5, 1e300,
+                            std::numeric_limits<double>::infinity()});
+  test_ordered_key<float>({-3.5F, -1e-30F, 0.0F, 1e-30F, 2.25F});
+  test_ordered_key<util::FixedString<3>>(
+      {util::FixedString<3>("abc"), util::FixedString<3>("ab"),
+       util::FixedString<3>("b"), util::FixedString<3>("\xff"),
+       util::FixedString<3>("abcd")});
+  test_ordered_key<util::FixedString<8>>(
+      {util::FixedString<8>("apple"), util::FixedString<8>("apples"),
+       util::FixedString<8>("banana"), util::FixedString<8>("")});
+
+  // -0.0 == 0.0, i.e., both must be indexed alike
+  EXPECT_EQ(util::to_ordered(-0.0), util::to_ordered(0.0));
+  EXPECT_EQ(util::FixedString<4>("abcdef").str(), "abcd");
+}
+
+/// indices on non uint64 key types must answer exactly like std algorithms
+template <class T, std::uint8_t fingerprint_size, class Filter = util::NoFilter>
+void test_key_type(const std::vector<T> &keys) {
+  using Index = LearnedSecondaryIndex<
+      T, learned_hashing::RadixSplineHash<util::ordered_key_t<T>, 18, 16>,
+      fingerprint_size, false, 64, util::SeparateStorage,
+      util::CountingInstrumentation, false,
+      hashing::MurmurFinalizer<util::ordered_key_t<T>>, Filter>;
+  const Index lsi(keys.begin(), keys.end(), 2);
+
+  auto sorted = keys;
+  std::sort(sorted.begin(), sorted.end());
+
+  // probe all keys as well as every key's successor, which is mostly absent
+  std::vector<T> probes(sorted.begin(), sorted.end());
+  for (const auto &key : sorted)
+    probes.push_back(util::from_ordered<T>(util::to_ordered(key) + 1));
+
+  for (const auto &key : probes) {
+    const auto eq = lsi.template lookup<false>(keys.begin(), keys.end(), key);
+    if (std::binary_search(sorted.begin(), sorted.end(), key)) {
+      ASSERT_NE(eq, lsi.end());
+      EXPECT_EQ(keys[*eq], key);
+    } else {
+      EXPECT_EQ(eq, lsi.end());
+    }
+
+    const auto lb = lsi.template lookup<true>(keys.begin(), keys.end(), key);
+    const auto expected = std::lower_bound(sorted.begin(), sorted.end(), key);
+    if (expected == sorted.end()) {
+      EXPECT_EQ(lb, lsi.end());
+    } else {
+      ASSERT_NE(lb, lsi.end());
+      EXPECT_EQ(keys[*lb], *expected);
+    }
+  }
+
+  std::vector<decltype(lsi.begin())> results;
+  lsi.template lookup_batch<false>(keys.begin(), keys.end(), probes.begin(),
+                                   probes.end(), std::back_inserter(results));
+  ASSERT_EQ(results.size(), probes.size());
+  for (size_t i = 0; i < probes.size(); i++)
+    EXPECT_EQ(results[i], lsi.template lookup<false>(keys.begin(), keys.end(),
+                                                     probes[i]));
+}
+
+TEST(LearnedSecondaryIndex, KeyTypes) {
+  std::mt19937_64 rng(42);
+  const size_t datasize = 20000;
+
+  std::vector<std::uint32_t> u32;
+  std::vector<std::int64_t> i64;
+  std::vector<double> f64;
+  std::vector<util::FixedString<6>> str;
+  std::normal_distribution<double> normal(0.0, 1e6);
+  for (size_t i = 0; i < datasize; i++) {
+    u32.push_back(static_cast<std::uint32_t>(rng()) | 0x1U);
+    i64.push_back(static_cast<std::int64_t>(rng() % 1000000) - 500000);
+    f64.push_back(i % 7 == 0 ? -0.0 : normal(rng));
+    str.emplace_back("k" + std::to_string(rng() % (datasize / 2)));
+  }
+
+  test_key_type<std::uint32_t, 0>(u32);
+  test_key_type<std::uint32_t, 8, util::BlockedBloomFilter<8>>(u32);
+  test_key_type<std::int64_t, 8>(i64);
+  test_key_type<double, 0>(f64);
+  test_key_type<double, 8, util::BlockedBloomFilter<8>>(f64);
+  test_key_type<util::FixedString<6>, 8>(str);
+}
+
+/// sampled indices must answer exactly like unsampled indices while probing
+/// base data at most log2(key_sample_rate) + 1 times per binary search
+template <std::uint8_t fingerprint_size, bool force_linear_search,
+          size_t error_bucket_size, size_t key_sample_rate>
+void test_sampled() {
+  const auto datasize = 100000;
+
+  std::mt19937 rng(42);
+
+  // generate keys with duplicates and gaps
+  std::vector<Key> keys;
+  for (size_t i = 0; i < datasize; i++)
+    keys.insert(keys.end(), rng() % 3 + 1, 3 * i * i);
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  using Index = LearnedSecondaryIndex<
+      Key, Model, fingerprint_size, force_linear_search, error_bucket_size,
+      util::SeparateStorage, util::CountingInstrumentation, false,
+      hashing::MurmurFinalizer<Key>, util::NoFilter, key_sample_rate>;
+  const Index lsi(keys.begin(), keys.end(), 3);
+  const LearnedSecondaryIndex<Key, Model, fingerprint_size,
+                              force_linear_search, error_bucket_size>
+      unsampled(keys.begin(), keys.end());
+  EXPECT_GT(lsi.model_byte_size(), unsampled.model_byte_size());
+
+  std::vector<Key> probes;
+  for (size_t i = 0; i < datasize + 10; i++) {
+    probes.push_back(3 * i * i);
+    probes.push_back(3 * i * i + 1);
+  }
+
+  util::LookupStats stats;
+  for (const auto key : probes) {
+    const auto eq =
+        lsi.template lookup<false>(keys.begin(), keys.end(), key, stats);
+    EXPECT_EQ(eq - lsi.begin(),
+              unsampled.template lookup<false>(keys.begin(), keys.end(), key) -
+                  unsampled.begin());
+
+    const auto lb = lsi.template lookup<true>(keys.begin(), keys.end(), key);
+    EXPECT_EQ(lb - lsi.begin(),
+              unsampled.template lookup<true>(keys.begin(), keys.end(), key) -
+                  unsampled.begin());
+  }
+  EXPECT_GT(stats.sample_accesses, 0);
+  if constexpr (!force_linear_search && fingerprint_size == 0) {
+    // binary search on key_sample_rate - 1 entries plus finalize()
+    size_t steps = 1;
+    while ((size_t{1} << steps) < key_sample_rate) steps++;
+    EXPECT_LE(stats.base_data_accesses, probes.size() * (steps + 1));
+  }
+
+  std::vector<decltype(lsi.begin())> results;
+  lsi.template lookup_batch<true>(keys.begin(), keys.end(), probes.begin(),
+                                  probes.end(), std::back_inserter(results));
+  ASSERT_EQ(results.size(), probes.size());
+  for (size_t i = 0; i < probes.size(); i++)
+    EXPECT_EQ(results[i], lsi.template lookup<true>(keys.begin(), keys.end(),
+                                                    probes[i]));
+
+  const auto path = testing::TempDir() + "lsi_sampled_" +
+                    std::to_string(fingerprint_size) + "_" +
+                    std::to_string(key_sample_rate) + ".bin";
+  lsi.save(path);
+  Index loaded;
+  loaded.load(path, keys.begin(), keys.end());
+  EXPECT_EQ(loaded.model_byte_size(), lsi.model_byte_size());
+  for (const auto key : probes) {
+    const auto l_lb =
+        loaded.template lookup<true>(keys.begin(), keys.end(), key);
+    const auto s_lb = lsi.template lookup<true>(keys.begin(), keys.end(), key);
+    EXPECT_EQ(l_lb - loaded.begin(), s_lb - lsi.begin());
+  }
+}
+
+TEST(LearnedSecondaryIndex, Sampled) {
+  test_sampled<0, false, 0, 1>();
+  test_sampled<0, false, 0, 8>();
+  test_sampled<0, false, 64, 16>();
+  test_sampled<0, true, 0, 32>();
+  test_sampled<8, false, 0, 32>();
+}
+
+/// decided prefix comparisons must agree with comparing the actual keys
+template <class K, class Prefix>
+void test_prefix_compare(std::vector<K> keys, const std::vector<K> &probes) {
+  std::sort(keys.begin(), keys.end());
+  std::vector<std::pair<K, size_t>> pairs;
+  for (const auto &key : keys) pairs.emplace_back(key, pairs.size());
+
+  util::KeyPrefixes<K, Prefix> prefixes;
+  prefixes.build(pairs.begin(), pairs.end(), 3);
+  ASSERT_EQ(prefixes.size(), keys.size());
+
+  size_t decided = 0;
+  for (size_t i = 0; i < keys.size(); i++) {
+    for (const auto &probe : probes) {
+      const auto order = prefixes.compare(i, util::to_ordered(probe));
+      if (order == util::PrefixOrder::unknown) continue;
+      decided++;
+      const auto expected = keys[i] < probe    ? util::PrefixOrder::less
+                            : keys[i] == probe ? util::PrefixOrder::equal
+                                               : util::PrefixOrder::greater;
+      EXPECT_EQ(order, expected) << keys[i] << " vs " << probe;
+    }
+  }
+  EXPECT_GT(decided, keys.size() * probes.size() / 2);
+}
+
+TEST(KeyPrefixes, Compare) {
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> dist(-1e6, 1e6);
+
+  std::vector<double> doubles;
+  for (size_t i = 0; i < 1000; i++) doubles.push_back(dist(rng));
+  doubles.insert(doubles.end(), 100, 0.5);
+  doubles.push_back(std::numeric_limits<double>::lowest());
+  doubles.push_back(std::numeric_limits<double>::max());
+  std::vector<double> probes = {std::numeric_limits<double>::lowest(), -0.0,
+                                0.5, std::numeric_limits<double>::max()};
+  for (size_t i = 0; i < 100; i++) probes.push_back(dist(rng));
+  for (size_t i = 0; i < 100; i++) probes.push_back(doubles[i]);
+  test_prefix_compare<double, std::uint8_t>(doubles, probes);
+  test_prefix_compare<double, std::uint16_t>(doubles, probes);
+
+  // dense keys fit 8 bits per block exactly, i.e., comparisons are decided
+  std::vector<std::int64_t> dense;
+  for (std::int64_t i = -500; i < 500; i++) dense.insert(dense.end(), 2, i);
+  std::vector<std::int64_t> dense_probes;
+  for (std::int64_t i = -600; i < 600; i += 7) dense_probes.push_back(i);
+  test_prefix_compare<std::int64_t, std::uint8_t>(dense, dense_probes);
+
+  util::KeyPrefixes<std::int64_t, std::uint8_t> prefixes;
+  std::vector<std::pair<std::int64_t, size_t>> pairs;
+  for (const auto key : dense) pairs.emplace_back(key, pairs.size());
+  prefixes.build(pairs.begin(), pairs.end());
+  for (size_t i = 0; i < dense.size(); i++)
+    EXPECT_NE(prefixes.compare(i, util::to_ordered(dense[i])),
+              util::PrefixOrder::unknown);
+}
+
+/// indices with key prefixes must answer exactly like indices without, while
+/// deciding comparisons without base data accesses
+template <std::uint8_t fingerprint_size, bool force_linear_search,
+          size_t error_bucket_size, std::uint8_t key_prefix_bits>
+void test_key_prefixes() {
+  const auto datasize = 100000;
+
+  std::mt19937 rng(42);
+
+  // generate keys with duplicates and gaps as well as dense runs
+  std::vector<Key> keys;
+  for (size_t i = 0; i < datasize; i++)
+    keys.insert(keys.end(), rng() % 3 + 1, 3 * i * i);
+  for (size_t i = 0; i < datasize / 10; i++)
+    keys.insert(keys.end(), rng() % 100 + 1, i);
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  using Index = LearnedSecondaryIndex<
+      Key, Model, fingerprint_size, force_linear_search, error_bucket_size,
+      util::SeparateStorage, util::CountingInstrumentation, false,
+      hashing::MurmurFinalizer<Key>, util::NoFilter, 0, key_prefix_bits>;
+  const Index lsi(keys.begin(), keys.end(), 3);
+  const LearnedSecondaryIndex<Key, Model, fingerprint_size,
+                              force_linear_search, error_bucket_size>
+      unprefixed(keys.begin(), keys.end());
+  EXPECT_GT(lsi.model_byte_size(), unprefixed.model_byte_size());
+
+  std::vector<Key> probes;
+  for (size_t i = 0; i < datasize + 10; i += 7) {
+    probes.push_back(3 * i * i);
+    probes.push_back(3 * i * i + 1);
+    probes.push_back(i / 7);
+  }
+
+  util::LookupStats stats;
+  util::LookupStats unprefixed_stats;
+  for (const auto key : probes) {
+    const auto eq =
+        lsi.template lookup<false>(keys.begin(), keys.end(), key, stats);
+    EXPECT_EQ(eq - lsi.begin(),
+              unprefixed.template lookup<false>(keys.begin(), keys.end(), key,
+                                                unprefixed_stats) -
+                  unprefixed.begin());
+
+    const auto lb =
+        lsi.template lookup<true>(keys.begin(), keys.end(), key, stats);
+    EXPECT_EQ(lb - lsi.begin(),
+              unprefixed.template lookup<true>(keys.begin(), keys.end(), key,
+                                               unprefixed_stats) -
+                  unprefixed.begin());
+
+    const auto [first, last] =
+        lsi.equal_range(keys.begin(), keys.end(), key, stats);
+    const auto [e_first, e_last] = unprefixed.equal_range(
+        keys.begin(), keys.end(), key, unprefixed_stats);
+    EXPECT_EQ(first - lsi.begin(), e_first - unprefixed.begin());
+    EXPECT_EQ(last - lsi.begin(), e_last - unprefixed.begin());
+  }
+  EXPECT_GT(stats.prefix_resolutions, 0);
+  EXPECT_EQ(unprefixed_stats.prefix_resolutions, 0);
+  if constexpr (!force_linear_search && fingerprint_size == 0) {
+    EXPECT_LT(2 * stats.base_data_accesses,
+              unprefixed_stats.base_data_accesses);
+  } else {
+    EXPECT_LE(stats.base_data_accesses, unprefixed_stats.base_data_accesses);
+  }
+
+  // batched and coroutine lookups decide the same steps via prefixes
+  for (const bool lowerbound : {false, true}) {
+    std::vector<decltype(lsi.begin())> results;
+    util::LookupStats batch_stats;
+    util::LookupStats single_stats;
+    if (lowerbound) {
+      lsi.template lookup_batch<true>(keys.begin(), keys.end(),
+                                      probes.begin(), probes.end(),
+                                      std::back_inserter(results), batch_stats);
+    } else {
+      lsi.template lookup_batch<false>(keys.begin(), keys.end(),
+                                       probes.begin(), probes.end(),
+                                       std::back_inserter(results),
+                                       batch_stats);
+    }
+    ASSERT_EQ(results.size(), probes.size());
+    for (size_t i = 0; i < probes.size(); i++) {
+      const auto expected =
+          lowerbound ? lsi.template lookup<true>(keys.begin(), keys.end(),
+                                                 probes[i], single_stats)
+                     : lsi.template lookup<false>(keys.begin(), keys.end(),
+                                                  probes[i], single_stats);
+      EXPECT_EQ(results[i], expected);
+    }
+    EXPECT_EQ(batch_stats.prefix_resolutions, single_stats.prefix_resolutions);
+    EXPECT_EQ(batch_stats.base_data_accesses, single_stats.base_data_accesses);
+  }
+  for (size_t i = 0; i < probes.size(); i += 13) {
+    auto task = lsi.template lookup_coroutine<true>(keys.begin(), keys.end(),
+                                                    probes[i]);
+    EXPECT_EQ(task.get(), lsi.template lookup<true>(keys.begin(), keys.end(),
+                                                    probes[i]));
+  }
+
+  const auto path = testing::TempDir() + "lsi_prefixed_" +
+                    std::to_string(fingerprint_size) + "_" +
+                    std::to_string(key_prefix_bits) + ".bin";
+  lsi.save(path);
+  Index loaded;
+  loaded.load(path, keys.begin(), keys.end());
+  EXPECT_EQ(loaded.model_byte_size(), lsi.model_byte_size());
+  for (const auto key : probes) {
+    const auto l_lb =
+        loaded.template lookup<true>(keys.begin(), keys.end(), key);
+    const auto s_lb = lsi.template lookup<true>(keys.begin(), keys.end(), key);
+    EXPECT_EQ(l_lb - loaded.begin(), s_lb - lsi.begin());
+  }
+  std::filesystem::remove(path);
+}
+
+TEST(LearnedSecondaryIndex, KeyPrefixes) {
+  test_key_prefixes<0, false, 0, 8>();
+  test_key_prefixes<0, false, 0, 16>();
+  test_key_prefixes<0, false, 64, 32>();
+  test_key_prefixes<0, true, 0, 8>();
+  test_key_prefixes<8, false, 0, 16>();
+}
+
+/// indices built from mapped keys in external memory must answer exactly like
+/// indices built via fit()
+template <std::uint8_t fingerprint_size, class PermStorage>
+void test_external_build(const size_t memory_budget, const size_t threads) {
+  const auto datasize = 50000;
+
+  std::mt19937 rng(42);
+
+  // generate keys with duplicates
+  std::vector<Key> keys;
+  keys.reserve(datasize);
+  for (size_t i = 0; i < datasize; i++) keys.push_back(rng() % (datasize / 2));
+
+  // write keys in SOSD format, i.e., prefixed by their count
+  const auto prefix = testing::TempDir() + "lsi_external_" +
+                      std::to_string(fingerprint_size) + "_" +
+                      std::to_string(memory_budget) + "_" +
+                      PermStorage::name();
+  {
+    util::Writer out(prefix + ".keys");
+    out.write<std::uint64_t>(keys.size());
+    out.write_bytes(reinterpret_cast<const char *>(keys.data()),
+                    keys.size() * sizeof(Key));
+  }
+  const util::MappedKeys<Key> mapped(prefix + ".keys");
+  ASSERT_EQ(mapped.size(), keys.size());
+  EXPECT_TRUE(std::equal(mapped.begin(), mapped.end(), keys.begin()));
+
+  using Index = LearnedSecondaryIndex<Key, Model, fingerprint_size, false, 0,
+                                      PermStorage>;
+  const Index fitted(keys.begin(), keys.end());
+  Index external;
+  external.fit_external(mapped.begin(), mapped.end(), prefix + ".sorted",
+                        memory_budget, threads);
+
+  // runs and merged pairs are removed while the mapped keys remain
+  EXPECT_FALSE(std::filesystem::exists(prefix + ".sorted"));
+  EXPECT_FALSE(std::filesystem::exists(prefix + ".sorted.run0"));
+  EXPECT_EQ(external.end() - external.begin(), fitted.end() - fitted.begin());
+  if constexpr (!std::is_same_v<PermStorage, util::CompressedStorage>)
+    EXPECT_EQ(external.byte_size(), fitted.byte_size());
+  EXPECT_EQ(external.model_byte_size(), fitted.model_byte_size());
+
+  // duplicates may be ordered differently since fit() doesn't sort by offset
+  for (Key key = 0; key < datasize / 2 + 10; key++) {
+    const auto eq =
+        external.template lookup<false>(keys.begin(), keys.end(), key);
+    const auto f_eq =
+        fitted.template lookup<false>(keys.begin(), keys.end(), key);
+    ASSERT_EQ(eq == external.end(), f_eq == fitted.end());
+    if (eq != external.end()) EXPECT_EQ(keys[*eq], key);
+
+    const auto lb =
+        external.template lookup<true>(keys.begin(), keys.end(), key);
+    const auto f_lb =
+        fitted.template lookup<true>(keys.begin(), keys.end(), key);
+    EXPECT_EQ(lb - external.begin(), f_lb - fitted.begin());
+  }
+
+  std::filesystem::remove(prefix + ".keys");
+}
+
+TEST(LearnedSecondaryIndex, ExternalBuild) {
+  // a budget of 4096 bytes results in 256 pairs per run, i.e., ~200 runs
+  test_external_build<0, util::SeparateStorage>(4096, 1);
+  test_external_build<8, util::SeparateStorage>(4096, 4);
+  test_external_build<8, util::SeparateStorage>(1 << 30, 4);
+  test_external_build<8, util::InterleavedStorage>(1 << 16, 3);
+  test_external_build<4, util::CompressedStorage>(1 << 16, 2);
+
+  using Sorter = util::ExternalSorter<Key>;
+  const std::vector<Key> empty;
+  Sorter sorter(testing::TempDir() + "lsi_external_empty", 4096);
+  sorter.sort(empty.begin(), empty.end());
+  EXPECT_EQ(sorter.begin(), sorter.end());
+
+  const std::vector<Key> keys = {3, 1, 2, 1, 3, 0};
+  sorter.sort(keys.begin(), keys.end(), 2);
+  const std::vector<std::pair<Key, size_t>> expected = {
+      {0, 5}, {1, 1}, {1, 3}, {2, 2}, {3, 0}, {3, 4}};
+  ASSERT_EQ(sorter.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_EQ(sorter.begin()[i].first, expected[i].first);
+    EXPECT_EQ(sorter.begin()[i].second, expected[i].second);
+  }
+}
+
 }  // namespace lsi_tests
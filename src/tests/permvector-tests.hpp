@@ -9,9 +9,12 @@
 #include <learned_secondary_index.hpp>
 #include <limits>
 #include <random>
+#include <unordered_set>
+#include <vector>
 
 #include "include/util/permvector.hpp"
 
+template <class Storage = ::learned_secondary_index::util::SeparateStorage>
 void test_permvector_width(const size_t width) {
   using Key = std::uint64_t;
 
@@ -35,7 +38,7 @@ void test_permvector_width(const size_t width) {
     const LearnedSecondaryIndex<Key>::PairIter<true> pe(dataset.end());
 
     // build permutation vector
-    PermVector<Fingerprinter<Key, 8>> pv;
+    PermVector<Fingerprinter<Key, 8>, Storage> pv;
     pv.build(pb, pe);
 
     EXPECT_EQ(pv.size(), dataset.size());
@@ -57,3 +60,272 @@ TEST(PermVector, E2E) {
     test_permvector_width(i);
   }
 }
+
+template <class Storage>
+void test_permvector_parallel_build() {
+  using Key = std::uint64_t;
+
+  using ::learned_secondary_index::LearnedSecondaryIndex;
+  using ::learned_secondary_index::util::Fingerprinter;
+  using ::learned_secondary_index::util::PermVector;
+
+  std::default_random_engine rng(42);
+
+  for (const auto size : {0UL, 10UL, 1001UL, 100003UL}) {
+    // gen permutation vector
+    std::vector<std::pair<Key, size_t>> dataset;
+    dataset.reserve(size);
+    for (size_t i = 0; i < size; i++) dataset.emplace_back(rng(), i);
+    std::shuffle(dataset.begin(), dataset.end(), rng);
+
+    const LearnedSecondaryIndex<Key>::PairIter<false> pb(dataset.begin());
+    const LearnedSecondaryIndex<Key>::PairIter<false> pe(dataset.end());
+
+    PermVector<Fingerprinter<Key, 7>, Storage> serial;
+    serial.build(pb, pe);
+
+    for (const size_t threads : {2, 5, 16}) {
+      PermVector<Fingerprinter<Key, 7>, Storage> parallel;
+      parallel.build(pb, pe, threads);
+
+      // packed representation must be bit identical
+      EXPECT_EQ(parallel, serial);
+      for (auto i = 0UL; i < parallel.size(); i++) {
+        EXPECT_EQ(parallel[i].index, dataset[i].second);
+        EXPECT_EQ(parallel[i].fingerprint_bits, serial[i].fingerprint_bits);
+      }
+    }
+  }
+}
+
+TEST(PermVector, ParallelBuild) {
+  test_permvector_parallel_build<
+      ::learned_secondary_index::util::SeparateStorage>();
+}
+
+template <size_t fingerprint_size,
+          class Storage = ::learned_secondary_index::util::SeparateStorage>
+void test_permvector_match() {
+  using Key = std::uint64_t;
+
+  using ::learned_secondary_index::LearnedSecondaryIndex;
+  using ::learned_secondary_index::util::Fingerprinter;
+  using ::learned_secondary_index::util::PermVector;
+
+  std::default_random_engine rng(42);
+
+  std::vector<std::pair<Key, size_t>> dataset;
+  for (size_t i = 0; i < 1000; i++) dataset.emplace_back(rng(), i);
+
+  const LearnedSecondaryIndex<Key>::PairIter<false> pb(dataset.begin());
+  const LearnedSecondaryIndex<Key>::PairIter<false> pe(dataset.end());
+
+  PermVector<Fingerprinter<Key, fingerprint_size>, Storage> pv;
+  pv.build(pb, pe);
+
+  // match bitmask must agree with individual tests for arbitrary windows
+  for (size_t first = 0; first < pv.size(); first += 13) {
+    for (const size_t count : {1UL, 3UL, 8UL, 37UL, 64UL}) {
+      if (first + count > pv.size()) continue;
+
+      for (const auto probe_i : {first, first + count - 1}) {
+        const auto key = dataset[probe_i].first;
+        const auto matches = pv.match(pv.fingerprint(key), first, count);
+
+        for (size_t k = 0; k < count; k++) {
+          EXPECT_EQ((matches >> k) & 0x1, pv.test(key, pv[first + k]));
+        }
+        if (count < 64) EXPECT_EQ(matches >> count, 0);
+      }
+    }
+  }
+}
+
+/// batched fingerprints must equal individually computed ones
+template <size_t fingerprint_size, class Hash>
+void test_fingerprint_batch() {
+  using Key = std::uint64_t;
+  using ::learned_secondary_index::util::Fingerprinter;
+
+  std::default_random_engine rng(42);
+  std::vector<Key> keys(100);
+  for (auto &key : keys) key = rng();
+  // sequential keys must not collide on a few fingerprints either
+  for (Key key = 0; key < 64; key++) keys.push_back(key);
+
+  const Fingerprinter<Key, fingerprint_size, Hash> fingerprinter;
+  for (const size_t n : {0UL, 1UL, 5UL, 16UL, 37UL, keys.size()}) {
+    std::vector<std::uint64_t> prints(n);
+    fingerprinter.fingerprint_batch(keys.data(), n, prints.data());
+    for (size_t i = 0; i < n; i++) {
+      EXPECT_EQ(prints[i], fingerprinter.fingerprint(keys[i]));
+      EXPECT_LT(prints[i], 0x1LLU << fingerprint_size);
+    }
+  }
+
+  std::unordered_set<std::uint64_t> distinct;
+  for (Key key = 0; key < 64; key++)
+    distinct.insert(fingerprinter.fingerprint(key));
+  EXPECT_GT(distinct.size(), 32);
+}
+
+TEST(Fingerprinter, Batch) {
+  using Key = std::uint64_t;
+  test_fingerprint_batch<8, hashing::MurmurFinalizer<Key>>();
+  test_fingerprint_batch<16, hashing::MurmurFinalizer<Key>>();
+  test_fingerprint_batch<8,
+                         ::learned_secondary_index::util::MultiplyShift<Key>>();
+  test_fingerprint_batch<16,
+                         ::learned_secondary_index::util::MultiplyShift<Key>>();
+}
+
+TEST(PermVector, MatchFingerprints) {
+  test_permvector_match<1>();
+  test_permvector_match<4>();
+  test_permvector_match<7>();
+  test_permvector_match<16>();
+  test_permvector_match<33>();
+  test_permvector_match<63>();
+}
+
+TEST(PermVector, InterleavedStorage) {
+  using ::learned_secondary_index::util::InterleavedStorage;
+
+  for (size_t i = 1; i <= 64; ++i) {
+    test_permvector_width<InterleavedStorage>(i);
+  }
+
+  test_permvector_parallel_build<InterleavedStorage>();
+
+  // covers blocks of 64 down to 8 entries, i.e., windows spanning blocks
+  test_permvector_match<1, InterleavedStorage>();
+  test_permvector_match<7, InterleavedStorage>();
+  test_permvector_match<16, InterleavedStorage>();
+  test_permvector_match<33, InterleavedStorage>();
+  test_permvector_match<63, InterleavedStorage>();
+}
+
+TEST(PermVector, CompressedStorage) {
+  using ::learned_secondary_index::LearnedSecondaryIndex;
+  using ::learned_secondary_index::util::CompressedStorage;
+  using ::learned_secondary_index::util::Fingerprinter;
+  using ::learned_secondary_index::util::PermVector;
+  using ::learned_secondary_index::util::SeparateStorage;
+  using Key = std::uint64_t;
+
+  for (size_t i = 1; i <= 64; ++i) {
+    test_permvector_width<CompressedStorage>(i);
+  }
+
+  test_permvector_parallel_build<CompressedStorage>();
+
+  test_permvector_match<1, CompressedStorage>();
+  test_permvector_match<16, CompressedStorage>();
+  test_permvector_match<63, CompressedStorage>();
+
+  // partially sorted base data, i.e., sorted runs with local disorder,
+  // should compress well below log2(n) bits per entry
+  std::default_random_engine rng(42);
+  std::vector<std::pair<Key, size_t>> dataset;
+  for (size_t i = 0; i < 100000; i++) dataset.emplace_back(i, 0);
+  for (size_t i = 0; i + 16 <= dataset.size(); i += 16)
+    std::shuffle(dataset.begin() + i, dataset.begin() + i + 16, rng);
+  for (size_t i = 0; i < dataset.size(); i++) dataset[i].second = i;
+  std::sort(dataset.begin(), dataset.end());
+
+  const LearnedSecondaryIndex<Key>::PairIter<false> pb(dataset.begin());
+  const LearnedSecondaryIndex<Key>::PairIter<false> pe(dataset.end());
+
+  PermVector<Fingerprinter<Key, 0>, SeparateStorage> plain;
+  plain.build(pb, pe);
+  PermVector<Fingerprinter<Key, 0>, CompressedStorage> compressed;
+  compressed.build(pb, pe, 4);
+
+  EXPECT_LT(compressed.byte_size() * 2, plain.byte_size());
+  for (size_t i = 0; i < dataset.size(); i++)
+    EXPECT_EQ(compressed[i].index, dataset[i].second);
+}
+
+TEST(PermVector, AlignedStorage) {
+  using ::learned_secondary_index::LearnedSecondaryIndex;
+  using ::learned_secondary_index::util::AlignedStorage;
+  using ::learned_secondary_index::util::Fingerprinter;
+  using ::learned_secondary_index::util::PermVector;
+  using Key = std::uint64_t;
+
+  for (size_t i = 1; i <= 64; ++i) {
+    test_permvector_width<AlignedStorage>(i);
+  }
+
+  test_permvector_parallel_build<AlignedStorage>();
+
+  // fingerprints of 1 up to 8 bytes
+  test_permvector_match<1, AlignedStorage>();
+  test_permvector_match<7, AlignedStorage>();
+  test_permvector_match<16, AlignedStorage>();
+  test_permvector_match<33, AlignedStorage>();
+  test_permvector_match<63, AlignedStorage>();
+
+  // 17 bit offsets and 4 fingerprint bits round up to 3 + 1 bytes per entry
+  std::vector<std::pair<Key, size_t>> dataset;
+  for (size_t i = 0; i < 100000; i++) dataset.emplace_back(i, i);
+
+  const LearnedSecondaryIndex<Key>::PairIter<false> pb(dataset.begin());
+  const LearnedSecondaryIndex<Key>::PairIter<false> pe(dataset.end());
+
+  PermVector<Fingerprinter<Key, 4>, AlignedStorage> pv;
+  pv.build(pb, pe, 4);
+
+  EXPECT_EQ(pv.offsets_bit_width(), 17);
+  EXPECT_EQ(pv.fingerprint_bits_bit_width(), 4);
+  EXPECT_GE(pv.byte_size(), dataset.size() * 4);
+  EXPECT_LT(pv.byte_size(), dataset.size() * 4 + 1024);
+  for (size_t i = 0; i < dataset.size(); i++) {
+    EXPECT_EQ(pv.offset(i), i);
+    EXPECT_EQ(pv.offset<17>(i), i);
+    EXPECT_TRUE(pv.test(dataset[i].first, pv[i]));
+  }
+}
+
+template <class Storage>
+void test_permvector_decode() {
+  using Key = std::uint64_t;
+
+  using ::learned_secondary_index::LearnedSecondaryIndex;
+  using ::learned_secondary_index::util::Fingerprinter;
+  using ::learned_secondary_index::util::PermVector;
+
+  std::default_random_engine rng(42);
+
+  // sizes cover bit widths below and above GetBatch's 32 bit limit
+  for (const auto size : {1UL, 1000UL, 70000UL}) {
+    for (const auto max_offset : {size, std::numeric_limits<Key>::max()}) {
+      std::uniform_int_distribution<Key> dist(0, max_offset - 1);
+      std::vector<std::pair<Key, size_t>> dataset;
+      for (size_t i = 0; i < size; i++) dataset.emplace_back(0, dist(rng));
+
+      const LearnedSecondaryIndex<Key>::PairIter<false> pb(dataset.begin());
+      const LearnedSecondaryIndex<Key>::PairIter<false> pe(dataset.end());
+
+      PermVector<Fingerprinter<Key, 5>, Storage> pv;
+      pv.build(pb, pe);
+
+      std::vector<std::uint64_t> out(size);
+      for (size_t first = 0; first < size; first += 1 + first / 2) {
+        for (const size_t count : {1UL, 31UL, 32UL, 100UL, size}) {
+          const size_t cnt = std::min(count, size - first);
+          pv.decode(first, cnt, out.data());
+          for (size_t k = 0; k < cnt; k++)
+            EXPECT_EQ(out[k], dataset[first + k].second);
+        }
+      }
+    }
+  }
+}
+
+TEST(PermVector, Decode) {
+  test_permvector_decode<::learned_secondary_index::util::SeparateStorage>();
+  test_permvector_decode<::learned_secondary_index::util::InterleavedStorage>();
+  test_permvector_decode<::learned_secondary_index::util::CompressedStorage>();
+  test_permvector_decode<::learned_secondary_index::util::AlignedStorage>();
+}
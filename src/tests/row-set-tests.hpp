@@ -0,0 +1,219 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <learned_secondary_index.hpp>
+#include <random>
+#include <vector>
+
+namespace row_set_tests {
+using namespace learned_secondary_index;
+
+using Key = std::uint64_t;
+using Model = learned_hashing::RadixSplineHash<Key, 18, 16>;
+
+TEST(RowSet, SortRowIds) {
+  std::mt19937_64 rng(42);
+  std::vector<std::uint64_t> scratch;
+  for (const size_t n : {0UL, 1UL, 100UL, util::radix_sort_threshold - 1,
+                         util::radix_sort_threshold, 5000UL, 100000UL}) {
+    for (const int width : {8, 20, 40, 63, 64}) {
+      std::vector<std::uint64_t> ids(n);
+      for (auto &id : ids) id = width == 64 ? rng() : rng() >> (64 - width);
+      auto expected = ids;
+      std::sort(expected.begin(), expected.end());
+
+      util::sort_row_ids(ids.data(), ids.size(), scratch);
+      EXPECT_EQ(ids, expected);
+    }
+  }
+
+  // passes whose digit all ids share are skipped
+  std::vector<std::uint64_t> ids(10000);
+  for (auto &id : ids) id = (rng() % 100) << 30 | 7;
+  auto expected = ids;
+  std::sort(expected.begin(), expected.end());
+  util::sort_row_ids(ids.data(), ids.size());
+  EXPECT_EQ(ids, expected);
+}
+
+/// ascending unique ids, dense within the first chunks and sparse after
+std::vector<std::uint64_t> make_ids(const std::uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  std::vector<std::uint64_t> ids;
+  for (std::uint64_t id = 0; id < 4 * 65536; id++)
+    if (rng() % 3 == 0) ids.push_back(id);
+  for (size_t i = 0; i < 10000; i++) ids.push_back(rng() % (1UL << 40));
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  return ids;
+}
+
+TEST(RowSet, RowBitmap) {
+  const auto ids = make_ids(42);
+
+  // duplicates are retained once
+  auto duplicated = ids;
+  duplicated.insert(duplicated.end(), ids.begin(), ids.begin() + 1000);
+  std::sort(duplicated.begin(), duplicated.end());
+
+  const util::RowBitmap bitmap(duplicated.data(), duplicated.size());
+  EXPECT_EQ(bitmap.cardinality(), ids.size());
+  EXPECT_EQ(bitmap.row_ids(), ids);
+  EXPECT_EQ(bitmap.bitmap_count(), 4);
+  EXPECT_GT(bitmap.container_count(), bitmap.bitmap_count());
+
+  for (const auto id : ids) ASSERT_TRUE(bitmap.contains(id));
+  for (std::uint64_t id = 0; id < 65536; id++)
+    EXPECT_EQ(bitmap.contains(id),
+              std::binary_search(ids.begin(), ids.end(), id));
+  EXPECT_FALSE(bitmap.contains(1UL << 41));
+
+  const util::RowBitmap empty;
+  EXPECT_TRUE(empty.empty());
+  EXPECT_TRUE((bitmap & empty).empty());
+  EXPECT_EQ(bitmap & bitmap, bitmap);
+}
+
+TEST(RowSet, RowBitmapUnsorted) {
+  std::mt19937_64 rng(42);
+  const auto ids = make_ids(42);
+  const std::vector<std::uint64_t> dense(
+      ids.begin(), std::lower_bound(ids.begin(), ids.end(), 4 * 65536));
+
+  // chunks are addressed directly for dense and hashed for sparse ids
+  for (const auto *sorted : {&ids, &dense}) {
+    auto shuffled = *sorted;
+    shuffled.insert(shuffled.end(), sorted->begin(), sorted->begin() + 1000);
+    std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+    util::RowBitmap bitmap;
+    bitmap.assign(shuffled.data(), shuffled.size());
+    EXPECT_EQ(bitmap, util::RowBitmap(sorted->data(), sorted->size()));
+    EXPECT_EQ(bitmap.row_ids(), *sorted);
+    EXPECT_EQ(bitmap.bitmap_count(), 4);
+  }
+
+  // chunks of bitmaps shrink if duplicates leave at most array_limit ids
+  std::vector<std::uint64_t> repeated;
+  for (size_t i = 0; i < 3 * util::RowBitmap::array_limit; i++)
+    repeated.push_back(65536 + (i * 7919) % 1000);
+  util::RowBitmap bitmap;
+  bitmap.assign(repeated.data(), repeated.size());
+  EXPECT_EQ(bitmap.cardinality(), 1000);
+  EXPECT_EQ(bitmap.bitmap_count(), 0);
+  EXPECT_TRUE(bitmap.contains(65536 + 999));
+
+  bitmap.assign(nullptr, 0);
+  EXPECT_TRUE(bitmap.empty());
+}
+
+TEST(RowSet, Intersection) {
+  const auto a = make_ids(1);
+  const auto b = make_ids(2);
+  std::vector<std::uint64_t> expected;
+  std::set_intersection(a.begin(), a.end(), b.begin(), b.end(),
+                        std::back_inserter(expected));
+
+  // dense chunks intersect into sparse ones, i.e., all formats are combined
+  const auto both = util::RowBitmap(a.data(), a.size()) &
+                    util::RowBitmap(b.data(), b.size());
+  EXPECT_EQ(both.row_ids(), expected);
+  EXPECT_EQ(both.cardinality(), expected.size());
+
+  std::vector<std::uint64_t> sparse(a.begin(), a.begin() + 1000);
+  const auto with_sparse = util::RowBitmap(sparse.data(), sparse.size()) &
+                           util::RowBitmap(b.data(), b.size());
+  expected.clear();
+  std::set_intersection(sparse.begin(), sparse.end(), b.begin(), b.end(),
+                        std::back_inserter(expected));
+  EXPECT_EQ(with_sparse.row_ids(), expected);
+}
+
+/// row ids emitted for ranges and duplicates must be the matching rows in
+/// ascending order
+template <class PermStorage>
+void test_lsi_row_ids() {
+  using Index = LearnedSecondaryIndex<Key, Model, 0, false, 0, PermStorage>;
+
+  std::mt19937_64 rng(42);
+  std::vector<Key> keys(100000);
+  for (auto &key : keys) key = rng() % 20000;
+  const Index index(keys.begin(), keys.end());
+  const auto begin = keys.begin();
+  const auto end = keys.end();
+
+  std::vector<std::uint64_t> ids;
+  std::vector<std::uint64_t> scratch;
+  for (const auto &[lo, hi] : std::vector<std::pair<Key, Key>>{
+           {0, 1}, {10, 20}, {500, 900}, {0, 20000}, {19999, 30000}}) {
+    std::vector<std::uint64_t> expected;
+    for (size_t i = 0; i < keys.size(); i++)
+      if (lo <= keys[i] && keys[i] < hi) expected.push_back(i);
+
+    const auto first = index.template lookup<true>(begin, end, lo);
+    const auto last = index.template lookup<true>(begin, end, hi);
+    EXPECT_EQ(index.row_ids(first, last, ids, scratch), expected.size());
+    EXPECT_EQ(ids, expected);
+
+    util::RowBitmap bitmap;
+    EXPECT_EQ(index.row_bitmap(first, last, bitmap, scratch), expected.size());
+    EXPECT_EQ(bitmap.row_ids(), expected);
+  }
+
+  // multi predicate intersection of two ranges' bitmaps
+  const auto range_bitmap = [&](const Key lo, const Key hi) {
+    util::RowBitmap bitmap;
+    index.row_bitmap(index.template lookup<true>(begin, end, lo),
+                     index.template lookup<true>(begin, end, hi), bitmap);
+    return bitmap;
+  };
+  EXPECT_EQ((range_bitmap(0, 15000) & range_bitmap(10000, 20000)).row_ids(),
+            range_bitmap(10000, 15000).row_ids());
+
+  const auto [first, last] = index.equal_range(begin, end, keys[123]);
+  index.row_ids(first, last, ids);
+  EXPECT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+  EXPECT_TRUE(std::binary_search(ids.begin(), ids.end(), 123));
+  for (const auto id : ids) EXPECT_EQ(keys[id], keys[123]);
+}
+
+TEST(RowSet, LearnedSecondaryIndex) {
+  test_lsi_row_ids<util::SeparateStorage>();
+  test_lsi_row_ids<util::CompressedStorage>();
+  test_lsi_row_ids<util::InterleavedStorage>();
+}
+
+TEST(RowSet, CompositeLearnedSecondaryIndex) {
+  std::mt19937_64 rng(42);
+  std::vector<std::uint32_t> prefixes(50000);
+  std::vector<Key> suffixes(50000);
+  for (size_t i = 0; i < prefixes.size(); i++) {
+    prefixes[i] = rng() % 8;
+    suffixes[i] = rng() % 1000;
+  }
+  const CompositeLearnedSecondaryIndex<std::uint32_t, Key> index(
+      prefixes.begin(), prefixes.end(), suffixes.begin());
+
+  std::vector<std::uint64_t> expected;
+  for (size_t i = 0; i < prefixes.size(); i++)
+    if (prefixes[i] == 3 && suffixes[i] >= 100 && suffixes[i] < 200)
+      expected.push_back(i);
+
+  std::vector<std::uint64_t> ids;
+  index.row_ids(
+      index.lookup<true>(suffixes.begin(), suffixes.end(), 3, 100),
+      index.lookup<true>(suffixes.begin(), suffixes.end(), 3, 200), ids);
+  EXPECT_EQ(ids, expected);
+
+  const auto [first, last] = index.equal_range(3);
+  util::RowBitmap bitmap;
+  EXPECT_EQ(index.row_bitmap(first, last, bitmap),
+            static_cast<size_t>(
+                std::count(prefixes.begin(), prefixes.end(), 3)));
+  for (const auto id : expected) EXPECT_TRUE(bitmap.contains(id));
+}
+}  // namespace row_set_tests
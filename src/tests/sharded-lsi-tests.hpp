@@ -0,0 +1,110 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <learned_secondary_index.hpp>
+#include <random>
+#include <vector>
+
+namespace sharded_lsi_tests {
+using namespace learned_secondary_index;
+
+using Key = std::uint64_t;
+using Index =
+    LearnedSecondaryIndex<Key, learned_hashing::RadixSplineHash<Key, 18, 16>,
+                          8>;
+using Sharded = ShardedLearnedSecondaryIndex<Key, Index>;
+
+/// checks equality & lowerbound lookups against a sorted copy of keys
+void check_lookups(const Sharded &lsi, const std::vector<Key> &keys) {
+  auto sorted = keys;
+  std::sort(sorted.begin(), sorted.end());
+
+  for (Key key = 0; key <= sorted.back() + 1; key += 3) {
+    const auto eq_iter = lsi.lookup<false>(keys.begin(), keys.end(), key);
+    const auto lb_iter = lsi.lookup<true>(keys.begin(), keys.end(), key);
+
+    const auto [first, last] =
+        std::equal_range(sorted.begin(), sorted.end(), key);
+    EXPECT_EQ(eq_iter != lsi.end(), first != last);
+
+    // iterating from an equality match must yield all duplicates
+    size_t matches = 0;
+    for (auto it = eq_iter; it != lsi.end() && keys[*it] == key; it++)
+      matches++;
+    EXPECT_EQ(matches, std::distance(first, last));
+
+    EXPECT_EQ(lb_iter != lsi.end(), first != sorted.end());
+    if (lb_iter != lsi.end()) EXPECT_EQ(keys[*lb_iter], *first);
+  }
+
+  // iterating the entire index yields all keys in sorted order
+  size_t i = 0;
+  for (auto it = lsi.begin(); it != lsi.end(); it++, i++)
+    EXPECT_EQ(keys[*it], sorted[i]);
+  EXPECT_EQ(i, keys.size());
+}
+
+TEST(ShardedLearnedSecondaryIndex, Lookup) {
+  const auto datasize = 50000;
+
+  std::mt19937 rng(42);
+  std::vector<Key> keys;
+  keys.reserve(datasize);
+  for (size_t i = 0; i < datasize; i++) keys.push_back(rng() % (2 * datasize));
+
+  for (const size_t shard_count : {1, 3, 16}) {
+    for (const size_t threads : {1, 4}) {
+      const Sharded lsi(keys.begin(), keys.end(), threads, shard_count);
+      EXPECT_EQ(lsi.shard_count(), shard_count);
+#ifdef __linux__
+      // nodes only list cpus of the process' affinity mask
+      EXPECT_EQ(lsi.placed_shards(), shard_count);
+#endif
+      check_lookups(lsi, keys);
+    }
+  }
+
+  const Sharded unplaced(keys.begin(), keys.end(), 2, 4, false);
+  EXPECT_EQ(unplaced.placed_shards(), 0);
+  check_lookups(unplaced, keys);
+}
+
+TEST(ShardedLearnedSecondaryIndex, NumaNodes) {
+  EXPECT_EQ(util::parse_cpu_list("0-3,8,10-11\n"),
+            (std::vector<size_t>{0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(util::parse_cpu_list("0-17,36-53").size(), 36);
+  EXPECT_TRUE(util::parse_cpu_list("").empty());
+
+  // every allowed cpu belongs to exactly one node
+  const auto nodes = util::numa_nodes();
+  ASSERT_FALSE(nodes.empty());
+  std::vector<size_t> cpus;
+  for (const auto &node : nodes) {
+    EXPECT_FALSE(node.empty());
+    cpus.insert(cpus.end(), node.begin(), node.end());
+  }
+  std::sort(cpus.begin(), cpus.end());
+  EXPECT_EQ(cpus, util::allowed_cpus());
+}
+
+TEST(ShardedLearnedSecondaryIndex, Duplicates) {
+  std::mt19937 rng(42);
+
+  // heavy duplicates must never straddle shards
+  std::vector<Key> keys;
+  for (Key key = 0; key < 5; key++) keys.insert(keys.end(), 1000 + key, key);
+  std::shuffle(keys.begin(), keys.end(), rng);
+
+  const Sharded lsi(keys.begin(), keys.end(), 2, 16);
+  EXPECT_LE(lsi.shard_count(), 5);
+  check_lookups(lsi, keys);
+
+  std::vector<Key> empty;
+  const Sharded none(empty.begin(), empty.end());
+  EXPECT_EQ(none.shard_count(), 0);
+  EXPECT_EQ(none.lookup<true>(empty.begin(), empty.end(), 0), none.end());
+}
+}  // namespace sharded_lsi_tests
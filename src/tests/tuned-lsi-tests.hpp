@@ -0,0 +1,154 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <learned_secondary_index.hpp>
+#include <random>
+#include <vector>
+
+namespace tuned_lsi_tests {
+using namespace learned_secondary_index;
+
+using Key = std::uint64_t;
+using Tuned = TunedLearnedSecondaryIndex<Key>;
+
+/// checks equality & lowerbound lookups against a sorted copy of keys
+void check_lookups(const Tuned &lsi, const std::vector<Key> &keys) {
+  auto sorted = keys;
+  std::sort(sorted.begin(), sorted.end());
+
+  for (Key key = 0; key <= sorted.back() + 1; key += 7) {
+    const auto eq_iter = lsi.lookup<false>(keys.begin(), keys.end(), key);
+    const auto lb_iter = lsi.lookup<true>(keys.begin(), keys.end(), key);
+
+    const auto [first, last] =
+        std::equal_range(sorted.begin(), sorted.end(), key);
+    EXPECT_EQ(eq_iter != lsi.end(), first != last);
+    if (eq_iter != lsi.end()) EXPECT_EQ(keys[*eq_iter], key);
+
+    EXPECT_EQ(lb_iter - lsi.begin(), first - sorted.begin());
+    if (lb_iter != lsi.end()) EXPECT_EQ(keys[*lb_iter], *first);
+  }
+}
+
+std::vector<Key> gen_keys(const size_t n) {
+  std::mt19937_64 rng(42);
+  std::vector<Key> keys;
+  keys.reserve(n);
+  // clustered keys with duplicates, i.e., neither trivially learnable nor
+  // uniform
+  for (size_t i = 0; i < n; i++)
+    keys.push_back((rng() % 64) * 1000000 + rng() % (n / 4));
+  return keys;
+}
+
+TEST(TunedLearnedSecondaryIndex, Lookups) {
+  const auto keys = gen_keys(50000);
+
+  const Tuned tuned(keys.begin(), keys.end(), 2);
+  ASSERT_EQ(tuned.estimates().size(), 8);
+  EXPECT_EQ(tuned.end() - tuned.begin(), keys.size());
+  EXPECT_EQ(tuned.name(),
+            "Tuned<" + tuned.estimates()[tuned.chosen()].name + ">");
+  check_lookups(tuned, keys);
+
+  // all keys are sampled, i.e., predicted sizes are exact
+  for (const auto &estimate : tuned.estimates()) {
+    EXPECT_GT(estimate.latency_ns, 0);
+    EXPECT_GE(estimate.base_data_accesses, 1);
+  }
+  EXPECT_NEAR(tuned.estimates()[tuned.chosen()].bytes, tuned.byte_size(),
+              sizeof(size_t));
+
+  // unbounded budget picks the candidate predicted to be fastest
+  for (const auto &estimate : tuned.estimates())
+    EXPECT_GE(estimate.latency_ns,
+              tuned.estimates()[tuned.chosen()].latency_ns);
+
+  Tuned empty;
+  EXPECT_THROW(empty.lookup<false>(keys.begin(), keys.end(), keys[0]),
+               std::logic_error);
+}
+
+TEST(TunedLearnedSecondaryIndex, Objectives) {
+  const auto keys = gen_keys(200000);
+
+  // budgets no candidate meets fall back to the smallest candidate
+  util::TunerOptions options{.memory_budget = 1, .sample_size = 0x1LLU << 14};
+  const Tuned smallest(keys.begin(), keys.end(), 1, options);
+  for (const auto &estimate : smallest.estimates())
+    EXPECT_GE(estimate.bytes, smallest.estimates()[smallest.chosen()].bytes);
+  check_lookups(smallest, keys);
+
+  // extrapolated sizes of the sampled candidates must be roughly accurate
+  const auto predicted = smallest.estimates()[smallest.chosen()].bytes;
+  EXPECT_LT(predicted, smallest.byte_size() * 3 / 2);
+  EXPECT_GT(predicted, smallest.byte_size() * 2 / 3);
+
+  // any latency target is met by the fastest candidate, hence the smallest
+  // candidate meeting it must be at most as large
+  options = {.sample_size = 0x1LLU << 14};
+  const Tuned fastest(keys.begin(), keys.end(), 1, options);
+  options.latency_target = fastest.estimates()[fastest.chosen()].latency_ns;
+  const Tuned target(keys.begin(), keys.end(), 1, options);
+  EXPECT_LE(target.estimates()[target.chosen()].latency_ns,
+            options.latency_target);
+  EXPECT_LE(target.estimates()[target.chosen()].bytes,
+            fastest.estimates()[fastest.chosen()].bytes);
+}
+
+/// predictions extrapolated from a small sample must match those measured on
+/// all keys, for scanning as well as binary searching candidates
+template <class Index>
+void test_extrapolation(const std::vector<Key> &keys) {
+  auto sorted = keys;
+  std::sort(sorted.begin(), sorted.end());
+
+  const util::TunerOptions options{.sample_size = 0x1LLU << 13};
+  std::mt19937_64 rng(options.seed);
+  std::uniform_int_distribution<size_t> dist(0, keys.size() - 1);
+  std::vector<Key> sample;
+  for (size_t i = 0; i < options.sample_size; i++)
+    sample.push_back(keys[dist(rng)]);
+  std::sort(sample.begin(), sample.end());
+
+  const auto predicted =
+      util::estimate_candidate<Index>(sample, keys.size(), options);
+  const auto measured =
+      util::estimate_candidate<Index>(sorted, keys.size(), options);
+
+  EXPECT_LT(predicted.window_size, measured.window_size * 2);
+  EXPECT_GT(predicted.window_size, measured.window_size / 2);
+  EXPECT_LT(predicted.latency_ns, measured.latency_ns * 3 / 2);
+  EXPECT_GT(predicted.latency_ns, measured.latency_ns * 2 / 3);
+}
+
+TEST(TunedLearnedSecondaryIndex, Extrapolation) {
+  // 128 times as many keys as sampled. Model errors reach their bound on the
+  // sample already, i.e., windows must not grow with the key count
+  const auto keys = gen_keys(0x1LLU << 20);
+
+  test_extrapolation<LearnedSecondaryIndex<
+      Key, learned_hashing::TrieSplineHash<Key, 16>, 0>>(keys);
+  test_extrapolation<LearnedSecondaryIndex<
+      Key, learned_hashing::TrieSplineHash<Key, 64>, 8>>(keys);
+}
+
+TEST(TunedLearnedSecondaryIndex, SelectCandidate) {
+  const std::vector<util::CandidateEstimate> estimates = {
+      {.name = "a", .bytes = 100, .latency_ns = 300},
+      {.name = "b", .bytes = 200, .latency_ns = 200},
+      {.name = "c", .bytes = 400, .latency_ns = 100}};
+
+  EXPECT_EQ(util::select_candidate(estimates, {}), 2);
+  EXPECT_EQ(util::select_candidate(estimates, {.memory_budget = 300}), 1);
+  EXPECT_EQ(util::select_candidate(estimates, {.memory_budget = 50}), 0);
+  EXPECT_EQ(util::select_candidate(estimates, {.latency_target = 250}), 1);
+  EXPECT_EQ(util::select_candidate(estimates, {.latency_target = 50}), 2);
+  EXPECT_EQ(util::select_candidate(
+                estimates, {.memory_budget = 150, .latency_target = 250}),
+            0);
+}
+}  // namespace tuned_lsi_tests
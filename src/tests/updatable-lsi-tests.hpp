@@ -0,0 +1,138 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <learned_secondary_index.hpp>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace updatable_lsi_tests {
+using namespace learned_secondary_index;
+
+using Key = std::uint64_t;
+using Index =
+    LearnedSecondaryIndex<Key, learned_hashing::RadixSplineHash<Key, 18, 16>,
+                          8>;
+
+/// checks equality & lowerbound lookups against a sorted copy of keys
+void check_lookups(const UpdatableLearnedSecondaryIndex<Key, Index> &lsi,
+                   const std::vector<Key> &keys) {
+  EXPECT_EQ(lsi.size(), keys.size());
+
+  auto sorted = keys;
+  std::sort(sorted.begin(), sorted.end());
+
+  for (Key key = 0; key < 2 * keys.size(); key += 7) {
+    const auto eq_iter = lsi.lookup<false>(keys.begin(), keys.end(), key);
+    const auto lb_iter = lsi.lookup<true>(keys.begin(), keys.end(), key);
+
+    const auto [first, last] =
+        std::equal_range(sorted.begin(), sorted.end(), key);
+    EXPECT_EQ(eq_iter != lsi.end(), first != last);
+    if (first != last) EXPECT_EQ(keys[*eq_iter], key);
+
+    EXPECT_EQ(lb_iter != lsi.end(), first != sorted.end());
+    if (lb_iter != lsi.end()) EXPECT_EQ(keys[*lb_iter], *first);
+
+    size_t matches = 0;
+    lsi.for_each_match(keys.begin(), keys.end(), key, [&](size_t offset) {
+      EXPECT_EQ(keys[offset], key);
+      matches++;
+    });
+    EXPECT_EQ(matches, std::distance(first, last));
+  }
+}
+
+TEST(UpdatableLearnedSecondaryIndex, Append) {
+  const auto datasize = 20000;
+
+  std::mt19937 rng(42);
+  std::vector<Key> keys;
+  keys.reserve(2 * datasize);
+  for (size_t i = 0; i < datasize; i++) keys.push_back(rng() % (2 * datasize));
+
+  UpdatableLearnedSecondaryIndex<Key, Index> lsi(keys.begin(), keys.end(),
+                                                 1000, 2);
+  check_lookups(lsi, keys);
+
+  // appends below threshold are only indexed by the delta
+  for (size_t i = 0; i < 500; i++) keys.push_back(rng() % (2 * datasize));
+  lsi.append(keys.begin(), keys.end());
+  EXPECT_EQ(lsi.delta_size(), 500);
+  EXPECT_FALSE(lsi.merge_pending());
+  check_lookups(lsi, keys);
+
+  // exceeding threshold triggers background rebuild. Lookups remain correct
+  // until (and after) it is installed
+  for (size_t i = 0; i < 1000; i++) keys.push_back(rng() % (2 * datasize));
+  lsi.append(keys.begin(), keys.end());
+  EXPECT_TRUE(lsi.merge_pending());
+  check_lookups(lsi, keys);
+
+  const auto merged_size = keys.size();
+  for (size_t i = 0; i < 10; i++) keys.push_back(rng() % (2 * datasize));
+  lsi.append(keys.begin(), keys.end());
+  lsi.finish_merge();
+  EXPECT_FALSE(lsi.merge_pending());
+  EXPECT_EQ(lsi.delta_size(), keys.size() - merged_size);
+  check_lookups(lsi, keys);
+
+  // synchronous merge folds everything into the learned index
+  lsi.merge(keys.begin(), keys.end());
+  EXPECT_EQ(lsi.delta_size(), 0);
+  check_lookups(lsi, keys);
+}
+
+/// rows inserted ahead of append() are indexed exactly once, and gaps left
+/// by insert() are filled by append()
+TEST(UpdatableLearnedSecondaryIndex, InsertAndAppend) {
+  std::mt19937 rng(42);
+  std::vector<Key> keys;
+  keys.reserve(3000);
+  for (size_t i = 0; i < 1000; i++) keys.push_back(rng() % 2000);
+
+  UpdatableLearnedSecondaryIndex<Key, Index> lsi(keys.begin(), keys.end(),
+                                                 1UL << 20);
+  for (size_t i = 0; i < 20; i++) keys.push_back(rng() % 2000);
+
+  // at the cursor, ahead of it with a gap, and the gap's first row
+  lsi.insert(keys[1000], 1000);
+  EXPECT_EQ(lsi.appended(), 1001);
+  lsi.insert(keys[1005], 1005);
+  lsi.insert(keys[1010], 1010);
+  EXPECT_EQ(lsi.appended(), 1001);
+  lsi.insert(keys[1001], 1001);
+  EXPECT_EQ(lsi.appended(), 1002);
+  EXPECT_THROW(lsi.insert(keys[1000], 1000), std::invalid_argument);
+  EXPECT_THROW(lsi.insert(keys[1005], 1005), std::invalid_argument);
+
+  lsi.append(keys.begin(), keys.end());
+  EXPECT_EQ(lsi.appended(), keys.size());
+  EXPECT_EQ(lsi.delta_size(), 20);
+  check_lookups(lsi, keys);
+
+  // the cursor survives merges
+  lsi.merge(keys.begin(), keys.end());
+  keys.push_back(rng() % 2000);
+  lsi.insert(keys.back(), keys.size() - 1);
+  keys.push_back(rng() % 2000);
+  lsi.append(keys.begin(), keys.end());
+  EXPECT_EQ(lsi.delta_size(), 2);
+  check_lookups(lsi, keys);
+}
+
+TEST(UpdatableLearnedSecondaryIndex, Empty) {
+  std::vector<Key> keys;
+  keys.reserve(100);
+
+  UpdatableLearnedSecondaryIndex<Key, Index> lsi;
+  EXPECT_EQ(lsi.lookup<true>(keys.begin(), keys.end(), 0), lsi.end());
+
+  for (Key key = 100; key > 0; key--) keys.push_back(key);
+  lsi.append(keys.begin(), keys.end());
+  check_lookups(lsi, keys);
+}
+}  // namespace updatable_lsi_tests